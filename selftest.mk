@@ -0,0 +1,51 @@
+#******************************************************************************
+#  Free implementation of Bullfrog's Dungeon Keeper strategy game.
+#******************************************************************************
+#   @file selftest.mk
+#      A script used by GNU Make to recompile the project.
+#  @par Purpose:
+#      Defines make rules for data files used by "-selftest" option.
+#  @par Comment:
+#      The files are created in pkg/rnctest; copy that folder into the game
+#      folder before running "keeperfx -selftest rnc".
+#  @author   KeeperFX Team
+#  @date     19 Oct 2026 - 19 Oct 2026
+#  @par  Copying and copyrights:
+#      This program is free software; you can redistribute it and/or modify
+#      it under the terms of the GNU General Public License as published by
+#      the Free Software Foundation; either version 2 of the License, or
+#      (at your option) any later version.
+#
+#******************************************************************************
+
+# Game folder with original data files, which RNC test files are made from
+RNCTEST_GAMEDIR ?= pkg
+
+.PHONY: rnctest clean-rnctest
+
+clean: clean-rnctest
+
+# For every data file, stores unpacked content as .raw, made by the dernc tool
+# if the file was packed; then packs the .raw with rnc tool into .pck
+rnctest: $(RNC) $(DERNC)
+	-$(ECHO) 'Creating RNC test files from: $(RNCTEST_GAMEDIR)'
+	$(MKDIR) pkg/rnctest
+	for fdir in data ldata; do \
+	  for fname in $(RNCTEST_GAMEDIR)/$$fdir/*; do \
+	    [ -s "$$fname" ] || continue; \
+	    tname="pkg/rnctest/$${fdir}_$$(basename "$$fname")"; \
+	    $(CP) "$$fname" "$$tname.raw"; \
+	    if [ "$$(head -c 3 "$$fname")" = "RNC" ]; then \
+	      $(DERNC) "$$tname.raw" || exit 1; \
+	    fi; \
+	    $(CP) "$$tname.raw" "$$tname.pck"; \
+	    $(RNC) "$$tname.pck" || $(RM) "$$tname.pck"; \
+	  done; \
+	done
+	-$(ECHO) 'Finished creating RNC test files'
+	-$(ECHO) ' '
+
+clean-rnctest:
+	-$(RM) -R pkg/rnctest
+
+#******************************************************************************
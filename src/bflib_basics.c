@@ -27,6 +27,8 @@
 #include <winbase.h>
 #include <wingdi.h>
 #include <winuser.h>
+#include <SDL/SDL.h>
+#include <SDL/SDL_thread.h>
 
 #include "bflib_datetm.h"
 #include "bflib_memory.h"
@@ -223,9 +225,41 @@ short error_dialog_fatal(const char *codefile,const int ecode,const char *messag
   return 0;
 }
 
+/******************************************************************************/
+/** Time, in milliseconds, after which waiting for log file access is abandoned. */
+#define LOG_RING_LOCK_TIMEOUT 1000
+
+/** Slot of the log ring buffer; holds one formatted line. */
+struct TbLogRingSlot {
+    /** Sequence number; equal to line index if the slot is free, index+1 if the line is ready to write. */
+    volatile LONG seq;
+    struct TbLog *log;
+    /** Allocated text of a line which didn't fit into the slot, or NULL. */
+    char *long_text;
+    char text[LOG_RING_LINE_LEN];
+};
+
+/**
+ * Ring buffer of log lines. Producers only format the line and copy it into a slot reserved
+ * with atomic increment; the writer thread keeps log files open and writes the lines in batches.
+ */
+struct TbLogRing {
+    struct TbLogRingSlot slots[LOG_RING_SLOTS];
+    /** Index of the next line to be reserved by a producer. */
+    volatile LONG head;
+    /** Index of the next line to be written; modified only with file lock held. */
+    unsigned long tail;
+    /** Lock of log files and ring tail; a semaphore, so that crash handler can wait for it with timeout. */
+    SDL_sem *file_lock;
+    SDL_sem *wake_sem;
+    SDL_Thread *writer;
+    volatile TbBool running;
+    volatile TbBool quit;
+};
 /******************************************************************************/
 short error_log_initialised=false;
 struct TbLog error_log;
+static struct TbLogRing log_ring;
 /******************************************************************************/
 int LbLog(struct TbLog *log, const char *fmt_str, va_list arg);
 /******************************************************************************/
@@ -239,6 +273,8 @@ int LbErrorLog(const char *format, ...)
     va_start(val, format);
     int result=LbLog(&error_log, format, val);
     va_end(val);
+    // Errors may be followed by a crash, so they're always written immediately
+    LbLogFlush(&error_log);
     return result;
 }
 
@@ -344,6 +380,18 @@ int LbJustLog(const char *format, ...)
     return result;
 }
 
+/**
+ * Writes a message into given log, which isn't the error log.
+ */
+int LbLogMessage(struct TbLog *log, const char *format, ...)
+{
+    va_list val;
+    va_start(val, format);
+    int result=LbLog(log, format, val);
+    va_end(val);
+    return result;
+}
+
 int LbErrorLogSetup(const char *directory, const char *filename, TbBool flag)
 {
   if ( error_log_initialised )
@@ -363,6 +411,8 @@ int LbErrorLogSetup(const char *directory, const char *filename, TbBool flag)
   if ( LbLogSetup(&error_log, log_filename, flags) == 1 )
   {
     error_log_initialised = 1;
+    // Without the writer thread, lines are just written directly
+    LbLogRingStart();
     result = 1;
   } else
   {
@@ -375,24 +425,47 @@ int LbErrorLogClose(void)
 {
     if (!error_log_initialised)
         return -1;
+    error_log_initialised = 0;
+    LbLogRingStop();
     return LbLogClose(&error_log);
 }
 
-int LbLog(struct TbLog *log, const char *fmt_str, va_list arg)
+int LbErrorLogFlush(void)
+{
+    if (!error_log_initialised)
+        return -1;
+    return LbLogFlush(&error_log);
+}
+
+static TbBool log_lock(void)
+{
+    if (log_ring.file_lock == NULL)
+        return true;
+    return (SDL_SemWaitTimeout(log_ring.file_lock, LOG_RING_LOCK_TIMEOUT) == 0);
+}
+
+static void log_unlock(void)
+{
+    if (log_ring.file_lock != NULL)
+        SDL_SemPost(log_ring.file_lock);
+}
+
+/**
+ * Opens the log file, if it's not opened yet, and writes header if needed.
+ * Requires the log file lock.
+ */
+static FILE *log_open_file(struct TbLog *log)
 {
   enum Header {
         NONE   = 0,
         CREATE = 1,
         APPEND = 2,
   };
-//  printf(fmt_str, arg);
-  if (!log->Initialised)
-    return -1;
   FILE *file;
   short need_initial_newline;
   char header;
-  if ( log->Suspended )
-    return 1;
+  if (log->file != NULL)
+    return (FILE *)log->file;
   header = NONE;
   need_initial_newline = false;
   if ( !log->Created )
@@ -421,8 +494,9 @@ int LbLog(struct TbLog *log, const char *fmt_str, va_list arg)
     file = fopen(log->filename, accmode);
     if (file == NULL)
     {
-      return -1;
+      return NULL;
     }
+    log->file = file;
     log->Created = true;
     if (header != NONE)
     {
@@ -461,24 +535,267 @@ int LbLog(struct TbLog *log, const char *fmt_str, va_list arg)
       }
       fprintf(file, "\n\n");
     }
+    return file;
+}
+
+/**
+ * Writes formatted line into the log file. Requires the log file lock.
+ */
+static int log_write_text(struct TbLog *log, const char *text)
+{
+    FILE *file;
+    if (!log->Initialised)
+      return -1;
+    file = log_open_file(log);
+    if (file == NULL)
+      return -1;
+    fputs(text, file);
+    return 1;
+}
+
+static void log_flush_file(struct TbLog *log)
+{
+    if (log->file == NULL)
+      return;
+    fflush((FILE *)log->file);
+    log->position = ftell((FILE *)log->file);
+}
+
+/**
+ * Reads sequence number of ring buffer slot, with memory barrier; text of the slot
+ * can be accessed only after the sequence number shows it's ready.
+ */
+static unsigned long log_slot_seq(struct TbLogRingSlot *slot)
+{
+    return (unsigned long)InterlockedCompareExchange(&slot->seq, 0, 0);
+}
+
+/**
+ * Writes all lines which are ready in the ring buffer, in order of reserving them.
+ * Requires the log file lock.
+ */
+static void log_ring_drain(void)
+{
+    struct TbLogRingSlot *slot;
+    struct TbLog *prev_log;
+    prev_log = NULL;
+    while (1)
+    {
+        slot = &log_ring.slots[log_ring.tail & (LOG_RING_SLOTS-1)];
+        if (log_slot_seq(slot) != log_ring.tail+1)
+            break;
+        if ((prev_log != NULL) && (prev_log != slot->log))
+            log_flush_file(prev_log);
+        prev_log = slot->log;
+        if (slot->long_text != NULL)
+        {
+            log_write_text(slot->log, slot->long_text);
+            LbMemoryFree(slot->long_text);
+            slot->long_text = NULL;
+        } else
+        {
+            log_write_text(slot->log, slot->text);
+        }
+        InterlockedExchange(&slot->seq, (LONG)(log_ring.tail + LOG_RING_SLOTS));
+        log_ring.tail++;
+    }
+    if (prev_log != NULL)
+        log_flush_file(prev_log);
+}
+
+/**
+ * Writes ring buffer lines until the line with given index is written.
+ * Gives up after some time, so that it won't hang if a producer died with a reserved slot.
+ */
+static void log_ring_flush_upto(unsigned long end_idx)
+{
+    TbBool done;
+    int i;
+    for (i=0; i < LOG_RING_LOCK_TIMEOUT; i++)
+    {
+        if (!log_lock())
+            return;
+        log_ring_drain();
+        done = ((long)(log_ring.tail - end_idx) >= 0);
+        log_unlock();
+        if (done)
+            return;
+        SDL_Delay(1);
+    }
+}
+
+/**
+ * Reserves slot in the ring buffer and copies formatted line into it.
+ */
+static void log_ring_put(struct TbLog *log, const char *text)
+{
+    struct TbLogRingSlot *slot;
+    unsigned long idx;
+    long len;
+    idx = (unsigned long)InterlockedIncrement(&log_ring.head) - 1;
+    slot = &log_ring.slots[idx & (LOG_RING_SLOTS-1)];
+    while (log_slot_seq(slot) != idx)
+    {
+        // The ring is full; write the waiting lines instead of the writer thread
+        if (log_lock())
+        {
+            log_ring_drain();
+            log_unlock();
+        }
+        if (log_slot_seq(slot) != idx)
+            SDL_Delay(1);
+    }
+    slot->log = log;
+    len = strlen(text);
+    if (len < LOG_RING_LINE_LEN)
+    {
+        memcpy(slot->text, text, len+1);
+    } else
+    {
+        slot->long_text = (char *)LbMemoryAlloc(len+1);
+        if (slot->long_text != NULL) {
+            memcpy(slot->long_text, text, len+1);
+        } else {
+            LbStringCopy(slot->text, text, LOG_RING_LINE_LEN);
+        }
+    }
+    InterlockedExchange(&slot->seq, (LONG)(idx + 1));
+}
+
+static int log_ring_writer_main(void *arg)
+{
+    while (!log_ring.quit)
+    {
+        SDL_SemWaitTimeout(log_ring.wake_sem, LOG_RING_FLUSH_INTERVAL);
+        if (log_lock())
+        {
+            log_ring_drain();
+            log_unlock();
+        }
+    }
+    return 0;
+}
+
+/**
+ * Starts the thread which writes log lines in background.
+ * Until it's started, log lines are written directly.
+ */
+TbResult LbLogRingStart(void)
+{
+    unsigned long i;
+    if (log_ring.running)
+        return Lb_OK;
+    if (log_ring.file_lock == NULL)
+    {
+        for (i=0; i < LOG_RING_SLOTS; i++)
+            log_ring.slots[i].seq = i;
+        log_ring.head = 0;
+        log_ring.tail = 0;
+        log_ring.wake_sem = SDL_CreateSemaphore(0);
+        if (log_ring.wake_sem == NULL)
+            return Lb_FAIL;
+        log_ring.file_lock = SDL_CreateSemaphore(1);
+        if (log_ring.file_lock == NULL)
+        {
+            SDL_DestroySemaphore(log_ring.wake_sem);
+            log_ring.wake_sem = NULL;
+            return Lb_FAIL;
+        }
+    }
+    log_ring.quit = false;
+    log_ring.running = true;
+    log_ring.writer = SDL_CreateThread(log_ring_writer_main, NULL);
+    if (log_ring.writer == NULL)
+    {
+        log_ring.running = false;
+        return Lb_FAIL;
+    }
+    return Lb_SUCCESS;
+}
+
+/**
+ * Stops the log writer thread, writing all lines which are waiting.
+ */
+TbResult LbLogRingStop(void)
+{
+    if (!log_ring.running)
+        return Lb_OK;
+    log_ring.running = false;
+    log_ring.quit = true;
+    SDL_SemPost(log_ring.wake_sem);
+    // Crash handler may be executed by the writer thread itself
+    if (SDL_ThreadID() != SDL_GetThreadID(log_ring.writer))
+        SDL_WaitThread(log_ring.writer, NULL);
+    log_ring.writer = NULL;
+    log_ring_flush_upto((unsigned long)log_ring.head);
+    return Lb_SUCCESS;
+}
+
+/**
+ * Formats log line, including date, time and prefix.
+ */
+static void log_format_line(struct TbLog *log, char *text, const char *fmt_str, va_list arg)
+{
+    int len;
+    len = 0;
     if ((log->flags & LbLog_DateInLines) != 0)
     {
         struct TbDate curr_date;
         LbDate(&curr_date);
-        fprintf(file,"%02d-%02d-%d ",curr_date.Day,curr_date.Month,curr_date.Year);
+        len += sprintf(text+len,"%02d-%02d-%d ",curr_date.Day,curr_date.Month,curr_date.Year);
     }
     if ((log->flags & LbLog_TimeInLines) != 0)
     {
         struct TbTime curr_time;
         LbTime(&curr_time);
-        fprintf(file, "%02d:%02d:%02d ",
+        len += sprintf(text+len, "%02d:%02d:%02d ",
             curr_time.Hour,curr_time.Minute,curr_time.Second);
     }
     if (log->prefix[0] != '\0')
-      fprintf(file, log->prefix);
-  vfprintf(file, fmt_str, arg);
-  log->position = ftell(file);
-  fclose(file);
+    {
+        LbStringCopy(text+len, log->prefix, LOG_PREFIX_LEN);
+        len += strlen(text+len);
+    }
+    vsnprintf(text+len, LOG_LINE_MAX_LEN-len, fmt_str, arg);
+    text[LOG_LINE_MAX_LEN-1] = '\0';
+}
+
+int LbLog(struct TbLog *log, const char *fmt_str, va_list arg)
+{
+  char text[LOG_LINE_MAX_LEN];
+  int result;
+  if (!log->Initialised)
+    return -1;
+  if ( log->Suspended )
+    return 1;
+  log_format_line(log, text, fmt_str, arg);
+  if (log_ring.running)
+  {
+      log_ring_put(log, text);
+      return 1;
+  }
+  if (!log_lock())
+      return -1;
+  // Lines left in the ring need to go first
+  log_ring_drain();
+  result = log_write_text(log, text);
+  log_flush_file(log);
+  log_unlock();
+  return result;
+}
+
+/**
+ * Makes sure all the lines logged so far are written into the log file.
+ */
+int LbLogFlush(struct TbLog *log)
+{
+  if (!log->Initialised)
+    return -1;
+  log_ring_flush_upto((unsigned long)log_ring.head);
+  if (!log_lock())
+    return -1;
+  log_flush_file(log);
+  log_unlock();
   return 1;
 }
 
@@ -527,6 +844,7 @@ int LbLogSetup(struct TbLog *log, const char *filename, ulong flags)
   log->flags = flags;
   log->Initialised = true;
   log->position = 0;
+  log->file = NULL;
   return 1;
 }
 
@@ -534,6 +852,14 @@ int LbLogClose(struct TbLog *log)
 {
   if ( !log->Initialised )
     return -1;
+  LbLogFlush(log);
+  if (log_lock())
+  {
+    if (log->file != NULL)
+      fclose((FILE *)log->file);
+    log->file = NULL;
+    log_unlock();
+  }
   LbMemorySet(log->filename, 0, DISKPATH_SIZE);
   LbMemorySet(log->prefix, 0, LOG_PREFIX_LEN);
   log->flags = 0;
@@ -79,6 +79,7 @@ struct TbDate {
         unsigned char DayOfWeek;
 };
 typedef long TbClockMSec;
+typedef unsigned long long TbClockUSec;
 typedef time_t TbTimeSec;
 
 typedef unsigned char TbChecksum;
@@ -102,6 +103,14 @@ struct TbFileFind {
 };
 
 #define LOG_PREFIX_LEN 32
+/** Amount of lines which can wait in log ring buffer; needs to be power of 2. */
+#define LOG_RING_SLOTS 4096
+/** Length of line stored directly in log ring buffer slot; longer lines are allocated. */
+#define LOG_RING_LINE_LEN 256
+/** Max length of a single log message; longer messages are truncated. */
+#define LOG_LINE_MAX_LEN 4096
+/** Interval, in milliseconds, in which log writer thread flushes the ring buffer. */
+#define LOG_RING_FLUSH_INTERVAL 100
 
 struct TbLog {
         char filename[DISKPATH_SIZE];
@@ -111,6 +120,8 @@ struct TbLog {
         TbBool Created;
         TbBool Suspended;
         long position;
+        /** Log file kept open between writes, or NULL. */
+        void *file;
 };
 
 struct TbNetworkCallbackData;
@@ -141,11 +152,16 @@ int LbConfigLog(unsigned long line,const char *format, ...);
 
 int LbErrorLogSetup(const char *directory, const char *filename, TbBool flag);
 int LbErrorLogClose(void);
+int LbErrorLogFlush(void);
 
 int LbLogClose(struct TbLog *log);
+int LbLogFlush(struct TbLog *log);
+TbResult LbLogRingStart(void);
+TbResult LbLogRingStop(void);
 int LbLogSetup(struct TbLog *log, const char *filename, ulong flags);
 int LbLogSetPrefix(struct TbLog *log, const char *prefix);
 int LbLogSetPrefixFmt(struct TbLog *log, const char *format, ...);
+int LbLogMessage(struct TbLog *log, const char *format, ...);
 /******************************************************************************/
 typedef void __stdcall (*TbNetworkCallbackFunc)(struct TbNetworkCallbackData *, void *);
 /******************************************************************************/
@@ -188,6 +188,30 @@ TbResult LbTimerInit(void)
   return Lb_SUCCESS;
 }
 
+/**
+ * Returns precise time counter value, in microseconds.
+ * Only differences between two values returned by this function make sense;
+ * it is meant for measuring execution time of engine parts.
+ */
+TbClockUSec LbTimerClockMicro(void)
+{
+#if defined(WIN32)
+    static LARGE_INTEGER freq = {{0,0}};
+    LARGE_INTEGER cntr;
+    if (freq.QuadPart == 0)
+    {
+        if (!QueryPerformanceFrequency(&freq))
+            freq.QuadPart = -1;
+    }
+    if ((freq.QuadPart > 0) && QueryPerformanceCounter(&cntr))
+    {
+        return (TbClockUSec)(cntr.QuadPart / freq.QuadPart) * 1000000
+            + (TbClockUSec)(cntr.QuadPart % freq.QuadPart) * 1000000 / freq.QuadPart;
+    }
+#endif
+    return (TbClockUSec)clock() * 1000000 / CLOCKS_PER_SEC;
+}
+
 /******************************************************************************/
 #ifdef __cplusplus
 }
@@ -40,6 +40,7 @@ TbResult LbDate(struct TbDate *curr_date);
 TbResult LbDateTime(struct TbDate *curr_date, struct TbTime *curr_time);
 TbResult LbDateTimeDecode(const time_t *datetime,struct TbDate *curr_date, struct TbTime *curr_time);
 TbResult LbTimerInit(void);
+TbClockUSec LbTimerClockMicro(void);
 double LbMoonPhase(void);
 /******************************************************************************/
 #ifdef __cplusplus
@@ -40,6 +40,10 @@ typedef struct {
     int bitcount;               /* how many bits does bitbuf hold? */
 } bit_stream;
 
+/* amount of low bits of the stream used to find a Huffman code in lookup table */
+#define HUF_LOOKUP_BITS 9
+#define HUF_LOOKUP_SIZE (1 << HUF_LOOKUP_BITS)
+
 typedef struct {
     int num;                   /* number of nodes in the tree */
     struct {
@@ -47,6 +51,8 @@ typedef struct {
     int codelen;
     int value;
     } table[32];
+    int long_first;            /* index of first node with codelen above HUF_LOOKUP_BITS */
+    unsigned char lookup[HUF_LOOKUP_SIZE]; /* node index plus one for every value of low bits, or 0 */
 } huf_table;
 
 static void read_huftable (huf_table *h, bit_stream *bs,
@@ -118,6 +124,10 @@ long rnc_unpack (void *packed, void *unpacked, unsigned int flags
     inp_len = blong (input+8);
     if ((ret_len>(1<<30))||(inp_len>(1<<30)))
         return RNC_HEADER_VAL_ERROR;
+    // Tables are kept between chunks; make sure the first chunk doesn't start with garbage
+    LbMemorySet(&raw, 0, sizeof(huf_table));
+    LbMemorySet(&dist, 0, sizeof(huf_table));
+    LbMemorySet(&len, 0, sizeof(huf_table));
 
     outputend = output + ret_len;
     inputend = input + 18 + inp_len;
@@ -284,6 +294,26 @@ static void read_huftable (huf_table *h, bit_stream *bs,
     }
 
     h->num = k;
+
+    // Prepare lookup table for short codes; nodes are sorted by codelen, so
+    // the first node matching given bits is the one found by linear search
+    LbMemorySet(h->lookup, 0, sizeof(h->lookup));
+    for (k=0; k < h->num; k++)
+    {
+        unsigned long n;
+        i = h->table[k].codelen;
+        if (i > HUF_LOOKUP_BITS)
+            break;
+        // Codes of oversubscribed trees may not fit in codelen; these never match
+        if ((h->table[k].code >> i) != 0)
+            continue;
+        for (n = h->table[k].code; n < HUF_LOOKUP_SIZE; n += (1 << i))
+        {
+            if (h->lookup[n] == 0)
+                h->lookup[n] = k + 1;
+        }
+    }
+    h->long_first = k;
 }
 
 // Read a value out of the bit stream using the given Huffman table.
@@ -293,14 +323,19 @@ static long huf_read (huf_table *h, bit_stream *bs,
     int i;
     unsigned long val;
 
-    for (i=0; i<h->num; i++)
+    i = h->lookup[bit_peek(bs, HUF_LOOKUP_SIZE-1)] - 1;
+    if (i < 0)
     {
-        unsigned long mask = (1 << h->table[i].codelen) - 1;
-        if (bit_peek(bs, mask) == h->table[i].code)
-            break;
+        // Not a short code; search the long ones
+        for (i=h->long_first; i<h->num; i++)
+        {
+            unsigned long mask = (1 << h->table[i].codelen) - 1;
+            if (bit_peek(bs, mask) == h->table[i].code)
+                break;
+        }
+        if (i == h->num)
+            return -1;
     }
-    if (i == h->num)
-        return -1;
     bit_advance (bs, h->table[i].codelen, p, pend);
 
     val = h->table[i].value;
@@ -382,7 +417,9 @@ static unsigned long mirror (unsigned long x, int n) {
     return x;
 }
 
-unsigned short crctab[256];
+// CRC tables for processing 8 bytes at once; crctab[0] is the classic byte-wise table,
+// crctab[n] gives CRC of a byte followed by n zero bytes
+unsigned short crctab[8][256];
 short crctab_ready=false;
 
 // Calculate a CRC, the RNC way
@@ -405,22 +442,51 @@ long rnc_crc(void *data, unsigned long len)
           else
             val = (val >> 1);
         }
-        crctab[i] = val;
+        crctab[0][i] = val;
+    }
+    for (i=0; i<256; i++)
+    {
+        val = crctab[0][i];
+        for (j=1; j<8; j++)
+        {
+            val = (val >> 8) ^ crctab[0][val & 0xFF];
+            crctab[j][i] = val;
+        }
     }
   crctab_ready=true;
   }
 
   val = 0;
+  while (len >= 8)
+  {
+     val ^= p[0] | (p[1] << 8);
+     val = crctab[7][val & 0xFF] ^ crctab[6][val >> 8]
+         ^ crctab[5][p[2]] ^ crctab[4][p[3]] ^ crctab[3][p[4]]
+         ^ crctab[2][p[5]] ^ crctab[1][p[6]] ^ crctab[0][p[7]];
+     p += 8;
+     len -= 8;
+  }
   while (len--)
   {
      val ^= *p++;
-     val = (val >> 8) ^ crctab[val & 0xFF];
+     val = (val >> 8) ^ crctab[0][val & 0xFF];
   }
   return val;
 }
 
 long LbFileLengthRnc(const char *fname)
 {
+  return LbFileLengthRncInfo(fname, NULL);
+}
+
+/**
+ * Returns length of the file after unpacking; also informs whether the file is RNC packed.
+ * @param is_packed If not NULL, set to whether the file starts with RNC header.
+ */
+long LbFileLengthRncInfo(const char *fname, TbBool *is_packed)
+{
+  if (is_packed != NULL)
+      *is_packed = false;
   TbFileHandle handle = LbFileOpen(fname, Lb_FILE_MODE_READ_ONLY);
   if ( handle == -1 )
       return -1;
@@ -439,6 +505,8 @@ long LbFileLengthRnc(const char *fname)
   long flength;
   if (blong(buffer+0)==RNC_SIGNATURE)
   {
+      if (is_packed != NULL)
+          *is_packed = true;
       flength = blong(buffer+4);
   #if (BFDEBUG_LEVEL > 19)
       LbSyncLog("%s: file size from RNC header: %ld bytes\n",func_name,RNC_HEADER_LEN,flength);
@@ -20,6 +20,8 @@
 #ifndef BFLIB_DERNC_H
 #define BFLIB_DERNC_H
 
+#include "bflib_basics.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -54,6 +56,7 @@ extern "C" {
 
 /******************************************************************************/
 long LbFileLengthRnc(const char *fname);
+long LbFileLengthRncInfo(const char *fname, TbBool *is_packed);
 long LbFileLoadAt(const char *fname, void *buffer);
 long LbFileSaveAt(const char *fname, const void *buffer,unsigned long len);
 long UnpackM1(unsigned char *buffer, unsigned long bufsize);
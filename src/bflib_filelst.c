@@ -23,6 +23,8 @@
 #include "bflib_memory.h"
 #include "bflib_fileio.h"
 #include "bflib_dernc.h"
+#include "bflib_datetm.h"
+#include "bflib_workers.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -33,6 +35,23 @@ DLLIMPORT extern ModifyDataLoadFnameFunc *_DK_modify_data_load_filename_function
 
 ModifyDataLoadFnameFunc *modify_data_load_filename_function=&defaultModifyDataLoadFilename;
 
+/** If set, time of loading every file is written into log. */
+TbBool lbDataLoadTimingReport = false;
+
+/**
+ * Entry of files list being loaded by LbDataLoadAll().
+ * Memory is allocated before the jobs start, so that worker threads only read and unpack.
+ */
+struct DataLoadJob {
+    struct TbLoadFiles *load_file;
+    char fname[2048];
+    /** Buffer for RNC packed data, or NULL if the file is not packed. */
+    unsigned char *packed;
+    /** Result, in the form returned by LbDataLoad(); zero while the file is yet to be loaded. */
+    short ret_val;
+    TbClockMSec load_time;
+};
+
 /******************************************************************************/
 
 short LbDataFree(struct TbLoadFiles *load_file)
@@ -118,37 +137,179 @@ short LbDataLoad(struct TbLoadFiles *load_file)
   return 1;
 }
 
-/*
+/**
+ * Allocates memory for a files list entry, in the same way LbDataLoad() does.
+ * @return Returns LbDataLoad() result if the entry is finished, or 0 if the file is yet to be read.
+ */
+static short data_load_prepare(struct DataLoadJob *job)
+{
+  struct TbLoadFiles *load_file;
+  MemAllocFunc *alloc_func;
+  TbBool is_packed;
+  load_file = job->load_file;
+  if (load_file->Flags & 0x0001)
+    alloc_func = LbMemoryAllocLow;
+  else
+    alloc_func = LbMemoryAlloc;
+  LbDataFree(load_file);
+  char *fname = modify_data_load_filename_function(load_file);
+  strncpy(job->fname, fname, sizeof(job->fname)-1);
+  job->fname[sizeof(job->fname)-1] = '\0';
+  if (fname[0] == '*')
+  {
+    *(load_file->Start) = alloc_func(load_file->SLength);
+    if ( (*(load_file->Start)) == NULL )
+        return -100;
+    return 1;
+  }
+  long slength = LbFileLengthRncInfo(job->fname, &is_packed);
+  load_file->SLength = slength;
+  if (slength <= 0)
+      return -101;
+  *(load_file->Start) = alloc_func(slength + 512);
+  if ((*(load_file->Start)) == NULL)
+      return -100;
+  if (is_packed)
+  {
+      // LbFileLoadAt() unpacks from a copy of unpacked file length
+      job->packed = LbMemoryAlloc(slength);
+      if (job->packed == NULL)
+      {
+          LbMemoryFree(*(load_file->Start));
+          *(load_file->Start) = NULL;
+          return -100;
+      }
+  }
+  return 0;
+}
+
+/**
+ * Reads and unpacks a files list entry; executed by worker threads.
+ * Gives the same result as LbFileLoadAt(), but doesn't allocate memory nor write log.
+ */
+static void data_load_job(void *data, long job_idx)
+{
+  struct DataLoadJob *job;
+  struct TbLoadFiles *load_file;
+  TbFileHandle handle;
+  TbClockMSec start_time;
+  unsigned char *buf;
+  long len;
+  job = &((struct DataLoadJob *)data)[job_idx];
+  if (job->ret_val != 0)
+      return;
+  start_time = 0;
+  if (lbDataLoadTimingReport)
+      start_time = LbTimerClock();
+  load_file = job->load_file;
+  if (job->packed != NULL)
+      buf = job->packed;
+  else
+      buf = *(load_file->Start);
+  len = -1;
+  handle = LbFileOpen(job->fname, Lb_FILE_MODE_READ_ONLY);
+  if (handle != -1)
+  {
+      if (LbFileRead(handle, buf, load_file->SLength) != -1)
+          len = load_file->SLength;
+      LbFileClose(handle);
+  }
+  if ((len >= 0) && (job->packed != NULL))
+  {
+      len = rnc_unpack(job->packed, *(load_file->Start), 0);
+  }
+  if (len == load_file->SLength)
+      job->ret_val = 1;
+  else
+      job->ret_val = -101;
+  if (lbDataLoadTimingReport)
+      job->load_time = LbTimerClock() - start_time;
+}
+
+/**
  * Loads a list of files. Allocates memory and loads new data.
+ * Memory is allocated in the list order, and then the files are read and unpacked
+ * by worker threads; the result is the same as when loading entries one by one.
  * @return Returns amount of entries failed, or 0 on success.
  */
 short LbDataLoadAll(struct TbLoadFiles load_files[])
 {
-  struct TbLoadFiles *t_lfile;
+  struct DataLoadJob *jobs;
+  struct DataLoadJob *job;
+  TbClockMSec start_time;
+  long total_length;
   int ferror;
-  int ret_val;
+  int jobs_count;
   int i;
   LbMemorySetup();
   LbDataFreeAll(load_files);
+  start_time = 0;
+  if (lbDataLoadTimingReport)
+      start_time = LbTimerClock();
+  jobs_count = 0;
+  while (load_files[jobs_count].Start != NULL)
+      jobs_count++;
+  if (jobs_count <= 0)
+      return 0;
+  jobs = (struct DataLoadJob *)LbMemoryAlloc(jobs_count*sizeof(struct DataLoadJob));
+  if (jobs == NULL)
+  {
+      ERRORLOG("Can't allocate memory for loading files list");
+      return jobs_count;
+  }
+  for (i=0; i < jobs_count; i++)
+  {
+      job = &jobs[i];
+      job->load_file = &load_files[i];
+      job->ret_val = data_load_prepare(job);
+  }
+  // Make sure CRC tables are computed before the threads start unpacking
+  rnc_crc(NULL, 0);
+  LbWorkersRun(data_load_job, jobs, jobs_count);
   ferror = 0;
-  i = 0;
-  t_lfile = &load_files[i];
-  while (t_lfile->Start != NULL)
+  total_length = 0;
+  for (i=0; i < jobs_count; i++)
   {
-    ret_val = LbDataLoad(t_lfile);
-    if ( ret_val == -100 )
+    job = &jobs[i];
+    struct TbLoadFiles *t_lfile;
+    t_lfile = job->load_file;
+    if (job->packed != NULL)
+      LbMemoryFree(job->packed);
+    if ( job->ret_val == -100 )
     {
       ERRORLOG("Can't allocate memory for \"%s\"", t_lfile->FName);
       ferror++;
     } else
-    if ( ret_val == -101 )
+    if ( job->ret_val == -101 )
     {
       ERRORLOG("Can't load file \"%s\"", t_lfile->FName);
+      if (*(t_lfile->Start) != NULL)
+      {
+          LbMemoryFree(*(t_lfile->Start));
+          *(t_lfile->Start) = NULL;
+          if (t_lfile->SEnd != NULL)
+            *(t_lfile->SEnd) = NULL;
+          t_lfile->SLength = 0;
+      }
       ferror++;
+    } else
+    {
+      if (t_lfile->SEnd != NULL)
+        *(t_lfile->SEnd) = *(t_lfile->Start) + t_lfile->SLength;
+      total_length += t_lfile->SLength;
+      if (lbDataLoadTimingReport)
+      {
+        SYNCMSG("Loaded \"%s\", %ld bytes%s in %ld ms",job->fname,(long)t_lfile->SLength,
+            (job->packed != NULL)?" (RNC)":"",(long)job->load_time);
+      }
     }
-    i++;
-    t_lfile = &load_files[i];
   }
+  if (lbDataLoadTimingReport)
+  {
+      SYNCMSG("Loaded %d files, %ld bytes, in %ld ms using %d threads",jobs_count,total_length,
+          (long)(LbTimerClock() - start_time),(int)LbWorkersCount());
+  }
+  LbMemoryFree(jobs);
   return ferror;
 }
 
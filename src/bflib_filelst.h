@@ -43,6 +43,8 @@ struct TbLoadFiles {
 
 #pragma pack()
 /******************************************************************************/
+extern TbBool lbDataLoadTimingReport;
+/******************************************************************************/
 char *defaultModifyDataLoadFilename(struct TbLoadFiles *ldfiles);
 ModifyDataLoadFnameFunc *LbDataLoadSetModifyFilenameFunction(ModifyDataLoadFnameFunc *newfunc);
 
@@ -24,6 +24,8 @@
 #include <stdarg.h>
 #include <windef.h>
 #include <winbase.h>
+#include <SDL/SDL.h>
+#include <SDL/SDL_thread.h>
 
 #include "bflib_basics.h"
 #include "bflib_memory.h"
@@ -38,22 +40,43 @@ extern "C" {
 #endif
 /******************************************************************************/
 // Constants and defines
-#define FLI_PREFIX 0xF100u
-#define FLI_COLOR256 4
-#define FLI_SS2      7
-#define FLI_COLOR   11
-#define FLI_LC      12
-#define FLI_BLACK   13
-#define FLI_BRUN    15
-#define FLI_COPY    16
-#define FLI_PSTAMP  18
+/** Frame captured from screen, waiting for the encoder. */
+struct AnimQueuedFrame {
+    unsigned char *screenbuf;
+    long line_stride;
+    unsigned char palette[768];
+};
+
+/**
+ * Queue of captured frames and the thread which compresses them into FLI chunks.
+ * Only the capturing thread modifies head, and only the encoder thread modifies tail;
+ * the semaphores count free and filled queue entries.
+ */
+struct AnimEncoder {
+    struct AnimQueuedFrame frames[ANIM_QUEUE_LENGTH];
+    /** Size of every frame buffer, in bytes. */
+    unsigned long frame_size;
+    unsigned long head;
+    unsigned long tail;
+    SDL_sem *free_sem;
+    SDL_sem *filled_sem;
+    SDL_Thread *thread;
+    volatile TbBool failed;
+    TbBool running;
+    unsigned long frames_queued;
+    unsigned long frames_dropped;
+};
 
 /******************************************************************************/
 // Global variables
 SmackDrawCallback smack_draw_callback = NULL;
 unsigned char smk_palette[768];
+/** Distance between lines of the frame being encoded, in bytes. */
+static long anim_line_stride;
+static struct AnimEncoder anim_encoder;
 /******************************************************************************/
 void copy_to_screen(unsigned char *srcbuf, unsigned long width, unsigned long height, unsigned int flags);
+TbBool anim_make_next_frame(unsigned char *screenbuf, unsigned char *palette);
 /******************************************************************************/
 // Functions
 typedef char (WINAPI *FARPROCP_C)(void *);
@@ -767,8 +790,8 @@ long anim_make_FLI_SS2(unsigned char *curdat, unsigned char *prvdat)
         if (2*(long)k == animation.header.width)
         {
           wend--;
-          cbf += LbGraphicsScreenWidth();
-          pbf += LbGraphicsScreenWidth();
+          cbf += anim_line_stride;
+          pbf += anim_line_stride;
           continue;
         }
         if ( w > 0 )
@@ -855,8 +878,8 @@ long anim_make_FLI_SS2(unsigned char *curdat, unsigned char *prvdat)
           }
         }
       }
-        cbuf += LbGraphicsScreenWidth();
-        pbuf += LbGraphicsScreenWidth();
+        cbuf += anim_line_stride;
+        pbuf += anim_line_stride;
     }
 
     if (animation.header.height+wend == 0)
@@ -909,8 +932,8 @@ long anim_make_FLI_LC(unsigned char *curdat, unsigned char *prvdat)
       }
       if ( wend != animation.header.width )
         break;
-      cbuf += LbGraphicsScreenWidth();
-      pbuf += LbGraphicsScreenWidth();
+      cbuf += anim_line_stride;
+      pbuf += anim_line_stride;
     }
 
     if (hend != 0)
@@ -929,8 +952,8 @@ long anim_make_FLI_LC(unsigned char *curdat, unsigned char *prvdat)
         }
         if ( wend != animation.header.width )
           break;
-        cbuf -= LbGraphicsScreenWidth();
-        pbuf -= LbGraphicsScreenWidth();
+        cbuf -= anim_line_stride;
+        pbuf -= anim_line_stride;
       }
       hdim = h - hend;
       blksize = animation.header.width * (long)hend;
@@ -1028,8 +1051,8 @@ long anim_make_FLI_LC(unsigned char *curdat, unsigned char *prvdat)
               }
             }
           }
-          cbuf += LbGraphicsScreenWidth();
-          pbuf += LbGraphicsScreenWidth();
+          cbuf += anim_line_stride;
+          pbuf += anim_line_stride;
       }
     } else
     {
@@ -1074,9 +1097,138 @@ short anim_format_matches(int width,int height,int bpp)
     return true;
 }
 
+static void anim_encoder_free(void)
+{
+    long i;
+    for (i=0; i < ANIM_QUEUE_LENGTH; i++)
+    {
+        LbMemoryFree(anim_encoder.frames[i].screenbuf);
+        anim_encoder.frames[i].screenbuf = NULL;
+    }
+    if (anim_encoder.free_sem != NULL)
+        SDL_DestroySemaphore(anim_encoder.free_sem);
+    anim_encoder.free_sem = NULL;
+    if (anim_encoder.filled_sem != NULL)
+        SDL_DestroySemaphore(anim_encoder.filled_sem);
+    anim_encoder.filled_sem = NULL;
+}
+
+static int anim_encoder_main(void *arg)
+{
+    struct AnimQueuedFrame *frame;
+    while (true)
+    {
+        SDL_SemWait(anim_encoder.filled_sem);
+        // Stopping the encoder posts the semaphore once more than there are frames
+        if (anim_encoder.tail == anim_encoder.head)
+            break;
+        frame = &anim_encoder.frames[anim_encoder.tail % ANIM_QUEUE_LENGTH];
+        if (!anim_encoder.failed)
+        {
+            anim_line_stride = frame->line_stride;
+            if (!anim_make_next_frame(frame->screenbuf, frame->palette))
+                anim_encoder.failed = true;
+        }
+        anim_encoder.tail++;
+        SDL_SemPost(anim_encoder.free_sem);
+    }
+    return 0;
+}
+
+/**
+ * Starts the thread which compresses captured frames, and allocates its queue.
+ * Frame buffers are big enough to store the screen buffer of current video mode.
+ */
+TbBool anim_encoder_start(void)
+{
+    long i;
+    if (anim_encoder.running)
+        return true;
+    LbMemorySet(&anim_encoder, 0, sizeof(struct AnimEncoder));
+    anim_encoder.frame_size = animation.header.height * LbGraphicsScreenWidth();
+    for (i=0; i < ANIM_QUEUE_LENGTH; i++)
+    {
+        // BRUN compressor may look a few bytes past the last line, so leave some zeroed space there
+        anim_encoder.frames[i].screenbuf = LbMemoryAlloc(anim_encoder.frame_size + 4);
+        if (anim_encoder.frames[i].screenbuf == NULL)
+        {
+            anim_encoder_free();
+            return false;
+        }
+    }
+    anim_encoder.free_sem = SDL_CreateSemaphore(ANIM_QUEUE_LENGTH);
+    anim_encoder.filled_sem = SDL_CreateSemaphore(0);
+    if ((anim_encoder.free_sem == NULL) || (anim_encoder.filled_sem == NULL))
+    {
+        anim_encoder_free();
+        return false;
+    }
+    anim_encoder.thread = SDL_CreateThread(anim_encoder_main, NULL);
+    if (anim_encoder.thread == NULL)
+    {
+        anim_encoder_free();
+        return false;
+    }
+    anim_encoder.running = true;
+    return true;
+}
+
+/**
+ * Waits until all queued frames are compressed and written, then stops the encoder thread.
+ */
+void anim_encoder_stop(void)
+{
+    if (!anim_encoder.running)
+        return;
+    SDL_SemPost(anim_encoder.filled_sem);
+    SDL_WaitThread(anim_encoder.thread, NULL);
+    anim_encoder.thread = NULL;
+    anim_encoder.running = false;
+    SYNCLOG("Movie encoder finished; %lu frames queued, %lu dropped.",
+        anim_encoder.frames_queued, anim_encoder.frames_dropped);
+    if (anim_encoder.failed)
+        ERRORLOG("Movie write error; frames after the error were not recorded.");
+    anim_encoder_free();
+}
+
+/**
+ * Copies the frame and palette into the encoder queue.
+ * If the encoder is behind and the queue stays full for too long, the frame is dropped,
+ * so that recording never stalls the game for more than ANIM_QUEUE_MAX_WAIT.
+ * @return Returns false if the recording failed; dropping a frame isn't treated as failure.
+ */
+static TbBool anim_encoder_queue_frame(unsigned char *screenbuf, long line_stride, unsigned char *palette)
+{
+    struct AnimQueuedFrame *frame;
+    unsigned long frame_size;
+    if (anim_encoder.failed)
+        return false;
+    frame_size = animation.header.height * line_stride;
+    if (frame_size > anim_encoder.frame_size)
+    {
+        anim_encoder.frames_dropped++;
+        return true;
+    }
+    if (SDL_SemWaitTimeout(anim_encoder.free_sem, ANIM_QUEUE_MAX_WAIT) != 0)
+    {
+        anim_encoder.frames_dropped++;
+        SYNCDBG(8,"Encoder queue full, frame dropped");
+        return true;
+    }
+    frame = &anim_encoder.frames[anim_encoder.head % ANIM_QUEUE_LENGTH];
+    LbMemoryCopy(frame->screenbuf, screenbuf, frame_size);
+    LbMemoryCopy(frame->palette, palette, sizeof(frame->palette));
+    frame->line_stride = line_stride;
+    anim_encoder.head++;
+    anim_encoder.frames_queued++;
+    SDL_SemPost(anim_encoder.filled_sem);
+    return true;
+}
+
 short anim_stop(void)
 {
     SYNCLOG("Finishing movie recording.");
+    anim_encoder_stop();
     if ( ((animation.field_0 & 0x01)==0) || (animation.outfhndl==0))
     {
       ERRORLOG("Can't stop recording movie");
@@ -1211,7 +1363,7 @@ TbBool anim_make_next_frame(unsigned char *screenbuf, unsigned char *palette)
     animation.field_C = animation.chunkdata;
     max_chunk_size = anim_buffer_size(width,height,animation.header.depth);
     LbMemorySet(animation.chunkdata, 0, max_chunk_size);
-    animation.prefix.ctype = 0xF1FAu;
+    animation.prefix.ctype = FLI_FRAME;
     animation.prefix.nchunks = 0;
     animation.prefix.csize = 0;
     LbMemorySet(animation.prefix.reserved, 0, sizeof(animation.prefix.reserved));
@@ -1321,6 +1473,9 @@ TbBool anim_record_frame(unsigned char *screenbuf, unsigned char *palette)
       return false;
     if (!anim_format_matches(MyScreenWidth/pixel_size,MyScreenHeight/pixel_size,LbGraphicsScreenBPP()))
       return false;
+    if (anim_encoder.running)
+        return anim_encoder_queue_frame(screenbuf, LbGraphicsScreenWidth(), palette);
+    anim_line_stride = LbGraphicsScreenWidth();
     return anim_make_next_frame(screenbuf, palette);
 }
 
@@ -1339,7 +1494,11 @@ short anim_record(void)
         sprintf(finalname, "%s/game%04d.flc","scrshots",idx);
         if (LbFileExists(finalname))
           continue;
-        return anim_open(finalname, 0, 0, MyScreenWidth/pixel_size,MyScreenHeight/pixel_size,8, 1);
+        if (!anim_open(finalname, 0, 0, MyScreenWidth/pixel_size,MyScreenHeight/pixel_size,8, 1))
+            return 0;
+        if (!anim_encoder_start())
+            WARNLOG("Cannot start movie encoder thread; frames will be encoded while capturing");
+        return 1;
     }
     ERRORLOG("No free file name for recorded movie");
     return 0;
@@ -27,6 +27,23 @@
 extern "C" {
 #endif
 /******************************************************************************/
+/** Amount of captured frames which can wait for the movie encoder thread. */
+#define ANIM_QUEUE_LENGTH 8
+/** Max time, in milliseconds, for which capturing a frame waits for free queue entry before dropping the frame. */
+#define ANIM_QUEUE_MAX_WAIT 40
+
+/** Types of FLI chunks. */
+#define FLI_PREFIX 0xF100u
+#define FLI_FRAME  0xF1FAu
+#define FLI_COLOR256 4
+#define FLI_SS2      7
+#define FLI_COLOR   11
+#define FLI_LC      12
+#define FLI_BLACK   13
+#define FLI_BRUN    15
+#define FLI_COPY    16
+#define FLI_PSTAMP  18
+
 enum SmackerPlayFlags {
     SMK_NoStopOnUserInput  = 0x02,
     SMK_PixelDoubleLine    = 0x04,
@@ -172,6 +189,8 @@ short anim_open(char *fname, int arg1, short arg2, int width, int height, int ar
 short anim_stop(void);
 short anim_record(void);
 TbBool anim_record_frame(unsigned char *screenbuf, unsigned char *palette);
+TbBool anim_encoder_start(void);
+void anim_encoder_stop(void);
 
 /******************************************************************************/
 #ifdef __cplusplus
@@ -0,0 +1,358 @@
+/******************************************************************************/
+// Bullfrog Engine Emulation Library - for use to remake classic games like
+// Syndicate Wars, Magic Carpet or Dungeon Keeper.
+/******************************************************************************/
+/** @file bflib_sprcache.c
+ *     Cache of pre-decoded sprites, used to speed up sprite drawing.
+ * @par Purpose:
+ *     Decodes RLE sprites into lists of opaque spans for every line, optionally
+ *     scaled to given size, and keeps them in a size-bounded LRU cache.
+ * @par Comment:
+ *     Entries are identified by sprite pointer, its data pointer and dimensions.
+ *     The whole cache is dropped whenever sprites are set up again, as new sprite
+ *     data may be loaded at addresses used before.
+ * @author   KeeperFX Team
+ * @date     19 Oct 2026 - 19 Oct 2026
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+/******************************************************************************/
+#include "bflib_sprcache.h"
+
+#include "globals.h"
+#include "bflib_basics.h"
+#include "bflib_memory.h"
+#include <limits.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/******************************************************************************/
+struct SpriteCache {
+    struct TbSpriteSpans *hash[SPRITE_CACHE_HASH_SIZE];
+    /** Most recently used entry. */
+    struct TbSpriteSpans *lru_first;
+    /** Least recently used entry, which will be removed first. */
+    struct TbSpriteSpans *lru_last;
+    struct TbSpriteCacheStats stats;
+};
+/******************************************************************************/
+/** Allows disabling the cache; sprites are then decoded on every draw. */
+TbBool lbSpriteCacheEnabled = true;
+static struct SpriteCache sprite_cache = { {NULL}, NULL, NULL, {0, 0, 0, 0, 0, SPRITE_CACHE_DEFAULT_LIMIT} };
+/******************************************************************************/
+static unsigned long sprite_cache_hash(const struct TbSprite *spr, long dest_width, long dest_height)
+{
+    unsigned long key;
+    key = ((unsigned long)spr >> 2) ^ ((unsigned long)dest_width * 31) ^ ((unsigned long)dest_height * 7919);
+    return (key ^ (key >> 10)) % SPRITE_CACHE_HASH_SIZE;
+}
+
+static void sprite_cache_lru_unlink(struct TbSpriteSpans *spans)
+{
+    if (spans->lru_prev != NULL)
+        spans->lru_prev->lru_next = spans->lru_next;
+    else
+        sprite_cache.lru_first = spans->lru_next;
+    if (spans->lru_next != NULL)
+        spans->lru_next->lru_prev = spans->lru_prev;
+    else
+        sprite_cache.lru_last = spans->lru_prev;
+    spans->lru_prev = NULL;
+    spans->lru_next = NULL;
+}
+
+static void sprite_cache_lru_push_front(struct TbSpriteSpans *spans)
+{
+    spans->lru_prev = NULL;
+    spans->lru_next = sprite_cache.lru_first;
+    if (sprite_cache.lru_first != NULL)
+        sprite_cache.lru_first->lru_prev = spans;
+    else
+        sprite_cache.lru_last = spans;
+    sprite_cache.lru_first = spans;
+}
+
+static void sprite_cache_remove(struct TbSpriteSpans *spans)
+{
+    struct TbSpriteSpans **pspans;
+    pspans = &sprite_cache.hash[sprite_cache_hash(spans->sprite, spans->key_width, spans->key_height)];
+    while (*pspans != NULL)
+    {
+        if (*pspans == spans) {
+            *pspans = spans->hash_next;
+            break;
+        }
+        pspans = &(*pspans)->hash_next;
+    }
+    sprite_cache_lru_unlink(spans);
+    sprite_cache.stats.bytes_used -= spans->size;
+    sprite_cache.stats.entries_count--;
+    LbMemoryFree(spans);
+}
+
+/**
+ * Fills scaling steps for given dimension, the same way LbSpriteSetScalingData() does
+ * for sprites which are not clipped. Positions are relative to the first step.
+ * @return Position of the first step relative to drawing position.
+ */
+static long sprite_cache_fill_steps(long *steps, long src_len, long dest_len, long *total_len)
+{
+    long factor,tmp;
+    long first,cur;
+    long i;
+    factor = (dest_len << 16) / src_len;
+    tmp = (factor >> 1);
+    first = (tmp >> 16);
+    cur = first;
+    for (i=0; i < src_len; i++)
+    {
+        steps[2*i+0] = cur - first;
+        tmp += factor;
+        steps[2*i+1] = (tmp >> 16) - cur;
+        cur = (tmp >> 16);
+    }
+    *total_len = cur - first;
+    return first;
+}
+
+/**
+ * Decodes RLE sprite into spans. If no target entry is given, only counts spans and pixels.
+ */
+static void sprite_cache_decode(const struct TbSprite *spr, const long *xsteps, const long *ysteps,
+    TbPixel *row_px, unsigned char *row_mask, TbPixel *out_px, unsigned char *out_mask, long out_width,
+    struct TbSpriteSpans *spans, unsigned long *spans_count, unsigned long *pixels_count)
+{
+    const unsigned char *sp;
+    long x,y,k,n;
+    unsigned long nspans,npixels;
+    sp = spr->Data;
+    nspans = 0;
+    npixels = 0;
+    for (y=0; y < spr->SHeight; y++)
+    {
+        // Decode the source line
+        LbMemorySet(row_mask, 0, spr->SWidth);
+        x = 0;
+        while (1)
+        {
+            long pxlen;
+            pxlen = (signed char)*sp;
+            sp++;
+            if (pxlen == 0)
+                break;
+            if (pxlen < 0) {
+                x -= pxlen;
+                continue;
+            }
+            for (k=0; k < pxlen; k++)
+            {
+                if ((x >= 0) && (x < spr->SWidth)) {
+                    row_px[x] = sp[k];
+                    row_mask[x] = 1;
+                }
+                x++;
+            }
+            sp += pxlen;
+        }
+        if (ysteps[2*y+1] <= 0)
+            continue;
+        // Scale it horizontally
+        LbMemorySet(out_mask, 0, out_width);
+        for (x=0; x < spr->SWidth; x++)
+        {
+            if (row_mask[x] == 0)
+                continue;
+            for (k=xsteps[2*x+0]; k < xsteps[2*x+0]+xsteps[2*x+1]; k++)
+            {
+                out_px[k] = row_px[x];
+                out_mask[k] = 1;
+            }
+        }
+        // Create spans out of opaque runs
+        unsigned long line_first;
+        line_first = nspans;
+        x = 0;
+        while (x < out_width)
+        {
+            if (out_mask[x] == 0) {
+                x++;
+                continue;
+            }
+            k = x;
+            while ((k < out_width) && (out_mask[k] != 0) && (k-x < SHRT_MAX))
+                k++;
+            if (spans != NULL)
+            {
+                spans->spans[nspans].x = x;
+                spans->spans[nspans].len = k - x;
+                spans->spans[nspans].pixels_pos = npixels;
+                LbMemoryCopy(&spans->pixels[npixels], &out_px[x], k - x);
+            }
+            nspans++;
+            npixels += k - x;
+            x = k;
+        }
+        // Fill all destination lines made from this source line
+        if (spans != NULL)
+        {
+            for (n=ysteps[2*y+0]; n < ysteps[2*y+0]+ysteps[2*y+1]; n++)
+            {
+                spans->line_first[n] = line_first;
+                spans->line_count[n] = nspans - line_first;
+            }
+        }
+    }
+    *spans_count = nspans;
+    *pixels_count = npixels;
+}
+
+static struct TbSpriteSpans *sprite_cache_create(const struct TbSprite *spr, long dest_width, long dest_height)
+{
+    struct TbSpriteSpans *spans;
+    unsigned char *tmpbuf;
+    long *xsteps;
+    long *ysteps;
+    long shift_x,shift_y,width,height;
+    unsigned long nspans,npixels,size;
+    // Don't even decode sprites which would take too much of the cache in worst case
+    size = sizeof(struct TbSpriteSpans) + (dest_height+1) * ((dest_width+1)
+        + (dest_width/2+1) * sizeof(struct TbSpriteSpan) + sizeof(unsigned long) + sizeof(unsigned short));
+    if (size > sprite_cache.stats.bytes_limit / 4)
+        return NULL;
+    tmpbuf = LbMemoryAlloc(2*(spr->SWidth+spr->SHeight)*sizeof(long) + 2*spr->SWidth + 2*dest_width + 16);
+    if (tmpbuf == NULL)
+        return NULL;
+    xsteps = (long *)tmpbuf;
+    ysteps = xsteps + 2*spr->SWidth;
+    shift_x = sprite_cache_fill_steps(xsteps, spr->SWidth, dest_width, &width);
+    shift_y = sprite_cache_fill_steps(ysteps, spr->SHeight, dest_height, &height);
+    TbPixel *row_px;
+    unsigned char *row_mask;
+    TbPixel *out_px;
+    unsigned char *out_mask;
+    row_px = (TbPixel *)(ysteps + 2*spr->SHeight);
+    row_mask = row_px + spr->SWidth;
+    out_px = row_mask + spr->SWidth;
+    out_mask = out_px + width;
+    // Count the spans first, then allocate everything in one block
+    sprite_cache_decode(spr, xsteps, ysteps, row_px, row_mask, out_px, out_mask, width, NULL, &nspans, &npixels);
+    size = sizeof(struct TbSpriteSpans) + nspans * sizeof(struct TbSpriteSpan)
+        + height * (sizeof(unsigned long) + sizeof(unsigned short)) + npixels;
+    spans = (struct TbSpriteSpans *)LbMemoryAlloc(size);
+    if (spans == NULL)
+    {
+        LbMemoryFree(tmpbuf);
+        return NULL;
+    }
+    spans->sprite = spr;
+    spans->data = spr->Data;
+    spans->src_width = spr->SWidth;
+    spans->src_height = spr->SHeight;
+    spans->key_width = dest_width;
+    spans->key_height = dest_height;
+    spans->width = width;
+    spans->height = height;
+    spans->shift_x = shift_x;
+    spans->shift_y = shift_y;
+    spans->spans = (struct TbSpriteSpan *)(spans + 1);
+    spans->line_first = (unsigned long *)(spans->spans + nspans);
+    spans->line_count = (unsigned short *)(spans->line_first + height);
+    spans->pixels = (TbPixel *)(spans->line_count + height);
+    spans->size = size;
+    spans->lru_prev = NULL;
+    spans->lru_next = NULL;
+    spans->hash_next = NULL;
+    LbMemorySet(spans->line_first, 0, height * sizeof(unsigned long));
+    LbMemorySet(spans->line_count, 0, height * sizeof(unsigned short));
+    sprite_cache_decode(spr, xsteps, ysteps, row_px, row_mask, out_px, out_mask, width, spans, &nspans, &npixels);
+    LbMemoryFree(tmpbuf);
+    return spans;
+}
+
+/**
+ * Gives pre-decoded version of given sprite, scaled to given size.
+ * Entries are created on first use; if the cache is full, least recently used entries are removed.
+ * For unscaled drawing, dest_width and dest_height should be equal to sprite dimensions.
+ * @return The decoded sprite, or NULL if it can't be cached - then the sprite should be drawn normally.
+ */
+struct TbSpriteSpans *LbSpriteCacheGet(const struct TbSprite *spr, long dest_width, long dest_height)
+{
+    struct TbSpriteSpans *spans;
+    unsigned long hash;
+    if ((!lbSpriteCacheEnabled) || (spr == NULL) || (spr->Data == NULL))
+        return NULL;
+    if ((spr->SWidth < 1) || (spr->SHeight < 1) || (dest_width < 1) || (dest_height < 1))
+        return NULL;
+    hash = sprite_cache_hash(spr, dest_width, dest_height);
+    for (spans = sprite_cache.hash[hash]; spans != NULL; spans = spans->hash_next)
+    {
+        if ((spans->sprite == spr) && (spans->data == spr->Data)
+         && (spans->src_width == spr->SWidth) && (spans->src_height == spr->SHeight)
+         && (spans->key_width == dest_width) && (spans->key_height == dest_height))
+            break;
+    }
+    if (spans != NULL)
+    {
+        sprite_cache.stats.hits++;
+        sprite_cache_lru_unlink(spans);
+        sprite_cache_lru_push_front(spans);
+        return spans;
+    }
+    sprite_cache.stats.misses++;
+    spans = sprite_cache_create(spr, dest_width, dest_height);
+    if (spans == NULL)
+        return NULL;
+    while ((sprite_cache.lru_last != NULL) && (sprite_cache.stats.bytes_used + spans->size > sprite_cache.stats.bytes_limit))
+    {
+        sprite_cache_remove(sprite_cache.lru_last);
+        sprite_cache.stats.evictions++;
+    }
+    spans->hash_next = sprite_cache.hash[hash];
+    sprite_cache.hash[hash] = spans;
+    sprite_cache_lru_push_front(spans);
+    sprite_cache.stats.bytes_used += spans->size;
+    sprite_cache.stats.entries_count++;
+    return spans;
+}
+
+/**
+ * Removes all entries from the cache. Needs to be called when sprites data is reloaded.
+ */
+TbResult LbSpriteCacheClear(void)
+{
+    if (sprite_cache.stats.entries_count > 0)
+    {
+        SYNCDBG(8,"Dropping %lu entries, %lu bytes; hits %lu, misses %lu, evictions %lu",
+            sprite_cache.stats.entries_count, sprite_cache.stats.bytes_used,
+            sprite_cache.stats.hits, sprite_cache.stats.misses, sprite_cache.stats.evictions);
+    }
+    while (sprite_cache.lru_last != NULL)
+    {
+        sprite_cache_remove(sprite_cache.lru_last);
+    }
+    return Lb_SUCCESS;
+}
+
+TbResult LbSpriteCacheSetLimit(unsigned long bytes_limit)
+{
+    sprite_cache.stats.bytes_limit = bytes_limit;
+    while ((sprite_cache.lru_last != NULL) && (sprite_cache.stats.bytes_used > sprite_cache.stats.bytes_limit))
+    {
+        sprite_cache_remove(sprite_cache.lru_last);
+        sprite_cache.stats.evictions++;
+    }
+    return Lb_SUCCESS;
+}
+
+void LbSpriteCacheGetStats(struct TbSpriteCacheStats *stats)
+{
+    LbMemoryCopy(stats, &sprite_cache.stats, sizeof(struct TbSpriteCacheStats));
+}
+/******************************************************************************/
+#ifdef __cplusplus
+}
+#endif
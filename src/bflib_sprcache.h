@@ -0,0 +1,95 @@
+/******************************************************************************/
+// Bullfrog Engine Emulation Library - for use to remake classic games like
+// Syndicate Wars, Magic Carpet or Dungeon Keeper.
+/******************************************************************************/
+/** @file bflib_sprcache.h
+ *     Header file for bflib_sprcache.c.
+ * @par Purpose:
+ *     Cache of pre-decoded sprites, used to speed up sprite drawing.
+ * @par Comment:
+ *     Just a header file - #defines, typedefs, function prototypes etc.
+ * @author   KeeperFX Team
+ * @date     19 Oct 2026 - 19 Oct 2026
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+/******************************************************************************/
+#ifndef BFLIB_SPRCACHE_H
+#define BFLIB_SPRCACHE_H
+
+#include "bflib_basics.h"
+#include "bflib_sprite.h"
+#include "bflib_video.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/******************************************************************************/
+/** Amount of hash table entries used to find cached sprites. */
+#define SPRITE_CACHE_HASH_SIZE 1024
+/** Default limit of memory used by the cache, in bytes. */
+#define SPRITE_CACHE_DEFAULT_LIMIT (4*1024*1024)
+
+/** Continuous run of opaque pixels within a line of pre-decoded sprite. */
+struct TbSpriteSpan {
+    /** Position of the first pixel within the line. */
+    short x;
+    /** Amount of pixels in the run. */
+    short len;
+    /** Position of the run pixels in pixels buffer of the sprite. */
+    unsigned long pixels_pos;
+};
+
+/**
+ * Sprite decoded from RLE stream into lists of opaque spans, at specific size.
+ * Spans of neighbouring runs are merged, so that they can be drawn with one copy.
+ */
+struct TbSpriteSpans {
+    const struct TbSprite *sprite;
+    TbSpriteData data;
+    long src_width;
+    long src_height;
+    /** Size requested when the entry was created; used, with the sprite, to identify the entry. */
+    long key_width;
+    long key_height;
+    /** Size of the decoded image; different than source sprite size for scaled entries. */
+    long width;
+    long height;
+    /** Shift of the decoded image relative to drawing position; non-zero only for scaled entries. */
+    long shift_x;
+    long shift_y;
+    /** Index of the first span of every line. Scaled lines which are duplicated share their spans. */
+    unsigned long *line_first;
+    unsigned short *line_count;
+    struct TbSpriteSpan *spans;
+    TbPixel *pixels;
+    /** Memory used by this entry, in bytes. */
+    unsigned long size;
+    struct TbSpriteSpans *lru_prev;
+    struct TbSpriteSpans *lru_next;
+    struct TbSpriteSpans *hash_next;
+};
+
+struct TbSpriteCacheStats {
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long evictions;
+    unsigned long entries_count;
+    unsigned long bytes_used;
+    unsigned long bytes_limit;
+};
+/******************************************************************************/
+extern TbBool lbSpriteCacheEnabled;
+/******************************************************************************/
+struct TbSpriteSpans *LbSpriteCacheGet(const struct TbSprite *spr, long dest_width, long dest_height);
+TbResult LbSpriteCacheClear(void);
+TbResult LbSpriteCacheSetLimit(unsigned long bytes_limit);
+void LbSpriteCacheGetStats(struct TbSpriteCacheStats *stats);
+/******************************************************************************/
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -20,6 +20,7 @@
 #include "bflib_sprite.h"
 
 #include "bflib_basics.h"
+#include "bflib_sprcache.h"
 #include "globals.h"
 
 #ifdef __cplusplus
@@ -31,6 +32,8 @@ short LbSpriteSetup(struct TbSprite *start, const struct TbSprite *end, const un
 {
     struct TbSprite *sprt;
     int n;
+    // New sprite data may reuse addresses of sprites which were decoded before
+    LbSpriteCacheClear();
     n = 0;
     sprt = start;
     while (sprt < end)
@@ -71,6 +74,7 @@ int LbSpriteClearAll(struct TbSetupSprite t_setup[])
 {
   struct TbSetupSprite *stp_sprite;
   int idx;
+  LbSpriteCacheClear();
   idx=0;
   stp_sprite=&t_setup[idx];
   while (stp_sprite->Data != NULL)
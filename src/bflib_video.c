@@ -24,6 +24,8 @@
 #include "bflib_vidsurface.h"
 #include "bflib_sprfnt.h"
 #include "bflib_inputctrl.h"
+#include "bflib_memory.h"
+#include <limits.h>
 #include <SDL/SDL.h>
 #include <SDL/SDL_syswm.h>
 
@@ -944,17 +946,26 @@ TbScreenMode LbRegisterVideoModeString(const char *desc)
     return LbRegisterVideoMode(desc, width, height, bpp, flags);
 }
 
-TbPixel LbPaletteFindColour(const unsigned char *pal, unsigned char r, unsigned char g, unsigned char b)
+/**
+ * Finds palette colour closest to given RGB values, checking only the colours from given list.
+ * The list has to be sorted by colour index, and contain all colours which may be the closest
+ * one; if it's NULL, all palette colours are checked.
+ * Tie-breaking rules are the same regardless of the list used, so the result is always identical
+ * to the one of full palette search.
+ */
+static TbPixel palette_find_colour_in_list(const unsigned char *pal, const unsigned char *cols, int cols_count,
+    unsigned char r, unsigned char g, unsigned char b)
 {
     int min_delta;
     const unsigned char *c;
-    int i;
+    int i,k;
     // Compute minimal square difference in color; return exact match if found
     min_delta = 999999;
-    c = pal;
-    for (i = 0; i < 256; i++)
+    for (k = 0; k < cols_count; k++)
     {
         int dr,dg,db;
+        i = (cols != NULL) ? cols[k] : k;
+        c = &pal[3 * i];
         dr = (r - c[0]) * (r - c[0]);
         dg = (g - c[1]) * (g - c[1]);
         db = (b - c[2]) * (b - c[2]);
@@ -965,7 +976,6 @@ TbPixel LbPaletteFindColour(const unsigned char *pal, unsigned char r, unsigned
                 return i;
             }
         }
-        c += 3;
     }
     // Gather all the colors with minimal square difference
     unsigned char tmcol[256];
@@ -973,10 +983,11 @@ TbPixel LbPaletteFindColour(const unsigned char *pal, unsigned char r, unsigned
     int n;
     n = 0;
     o = tmcol;
-    c = pal;
-    for (i = 0; i < 256; i++)
+    for (k = 0; k < cols_count; k++)
     {
         int dr,dg,db;
+        i = (cols != NULL) ? cols[k] : k;
+        c = &pal[3 * i];
         dr = (r - c[0]) * (r - c[0]);
         dg = (g - c[1]) * (g - c[1]);
         db = (b - c[2]) * (b - c[2]);
@@ -986,7 +997,6 @@ TbPixel LbPaletteFindColour(const unsigned char *pal, unsigned char r, unsigned
             *o = i;
             o++;
         }
-        c += 3;
     }
     // If there's only one left on list - return it
     if (n == 1) {
@@ -1046,6 +1056,126 @@ TbPixel LbPaletteFindColour(const unsigned char *pal, unsigned char r, unsigned
     }
     return *o;
 }
+
+TbPixel LbPaletteFindColour(const unsigned char *pal, unsigned char r, unsigned char g, unsigned char b)
+{
+    return palette_find_colour_in_list(pal, NULL, PALETTE_COLORS, r, g, b);
+}
+
+/**
+ * Computes hash of given palette. Used to identify data computed for specific palette.
+ */
+unsigned long LbPaletteHash(const unsigned char *pal)
+{
+    unsigned long hash;
+    int i;
+    // FNV-1a
+    hash = 2166136261UL;
+    for (i = 0; i < PALETTE_SIZE; i++)
+    {
+        hash ^= pal[i];
+        hash = (hash * 16777619UL) & 0xFFFFFFFFUL;
+    }
+    return hash;
+}
+
+/**
+ * Builds list of colours which may be the closest to any RGB value within given grid cell.
+ * Every colour whose minimal distance to the cell is not larger than the smallest
+ * maximal distance of any colour to the cell is kept.
+ */
+static void palette_match_build_cell(struct TbPaletteMatch *pmatch, long cell)
+{
+    long min_dist[PALETTE_COLORS];
+    long lo[3],hi[3];
+    long bound;
+    int i,n;
+    lo[0] = ((cell >> (2*PALETTE_MATCH_GRID_BITS)) & (PALETTE_MATCH_GRID_DIM-1)) << PALETTE_MATCH_CELL_BITS;
+    lo[1] = ((cell >> PALETTE_MATCH_GRID_BITS) & (PALETTE_MATCH_GRID_DIM-1)) << PALETTE_MATCH_CELL_BITS;
+    lo[2] = (cell & (PALETTE_MATCH_GRID_DIM-1)) << PALETTE_MATCH_CELL_BITS;
+    for (n = 0; n < 3; n++)
+        hi[n] = lo[n] + (1 << PALETTE_MATCH_CELL_BITS) - 1;
+    bound = LONG_MAX;
+    for (i = 0; i < PALETTE_COLORS; i++)
+    {
+        long dmin,dmax,dlo,dhi;
+        dmin = 0;
+        dmax = 0;
+        for (n = 0; n < 3; n++)
+        {
+            long c;
+            c = pmatch->pal[3*i+n];
+            dlo = labs(c - lo[n]);
+            dhi = labs(c - hi[n]);
+            if (c < lo[n])
+                dmin += dlo * dlo;
+            else if (c > hi[n])
+                dmin += dhi * dhi;
+            if (dlo > dhi)
+                dmax += dlo * dlo;
+            else
+                dmax += dhi * dhi;
+        }
+        min_dist[i] = dmin;
+        if (bound > dmax)
+            bound = dmax;
+    }
+    n = 0;
+    for (i = 0; i < PALETTE_COLORS; i++)
+    {
+        if (min_dist[i] <= bound)
+            n++;
+    }
+    if (pmatch->cols_used + n > PALETTE_MATCH_POOL_SIZE)
+    {
+        // No space - this cell will use full palette search
+        pmatch->cell_first[cell] = PALETTE_MATCH_CELL_FULL;
+        return;
+    }
+    pmatch->cell_first[cell] = pmatch->cols_used;
+    pmatch->cell_count[cell] = n;
+    for (i = 0; i < PALETTE_COLORS; i++)
+    {
+        if (min_dist[i] <= bound)
+        {
+            pmatch->cols[pmatch->cols_used] = i;
+            pmatch->cols_used++;
+        }
+    }
+}
+
+/**
+ * Prepares nearest colour search structure for given palette.
+ * The palette is copied, so the structure stays valid if source buffer changes.
+ * Grid cells are filled lazily, on first search which falls into them.
+ */
+TbResult LbPaletteMatchInit(struct TbPaletteMatch *pmatch, const unsigned char *pal)
+{
+    long i;
+    LbMemoryCopy(pmatch->pal, pal, PALETTE_SIZE);
+    for (i = 0; i < PALETTE_MATCH_CELLS_COUNT; i++)
+        pmatch->cell_first[i] = PALETTE_MATCH_CELL_EMPTY;
+    pmatch->cols_used = 0;
+    return Lb_SUCCESS;
+}
+
+/**
+ * Finds palette colour closest to given RGB values, using prepared search structure.
+ * Returns exactly the same colour as LbPaletteFindColour() would return for the palette.
+ */
+TbPixel LbPaletteMatchColour(struct TbPaletteMatch *pmatch, unsigned char r, unsigned char g, unsigned char b)
+{
+    long cell;
+    cell = ((r >> PALETTE_MATCH_CELL_BITS) << (2*PALETTE_MATCH_GRID_BITS))
+         | ((g >> PALETTE_MATCH_CELL_BITS) << PALETTE_MATCH_GRID_BITS)
+         | (b >> PALETTE_MATCH_CELL_BITS);
+    if (pmatch->cell_first[cell] == PALETTE_MATCH_CELL_EMPTY)
+        palette_match_build_cell(pmatch, cell);
+    if (pmatch->cell_first[cell] == PALETTE_MATCH_CELL_FULL)
+        return palette_find_colour_in_list(pmatch->pal, NULL, PALETTE_COLORS, r, g, b);
+    return palette_find_colour_in_list(pmatch->pal, &pmatch->cols[pmatch->cell_first[cell]],
+        pmatch->cell_count[cell], r, g, b);
+}
 /******************************************************************************/
 #ifdef __cplusplus
 }
@@ -31,6 +31,14 @@ extern "C" {
 
 #define PALETTE_COLORS 256
 #define PALETTE_SIZE (3*PALETTE_COLORS)
+/** Amount of RGB values covered by one cell of nearest colour search grid, as power of 2. */
+#define PALETTE_MATCH_CELL_BITS 3
+#define PALETTE_MATCH_GRID_BITS (8-PALETTE_MATCH_CELL_BITS)
+#define PALETTE_MATCH_GRID_DIM (1<<PALETTE_MATCH_GRID_BITS)
+#define PALETTE_MATCH_CELLS_COUNT (PALETTE_MATCH_GRID_DIM*PALETTE_MATCH_GRID_DIM*PALETTE_MATCH_GRID_DIM)
+#define PALETTE_MATCH_POOL_SIZE (128*1024)
+#define PALETTE_MATCH_CELL_EMPTY -1
+#define PALETTE_MATCH_CELL_FULL  -2
 
 #define MAX_SUPPORTED_SCREEN_WIDTH  3840
 #define MAX_SUPPORTED_SCREEN_HEIGHT 2160
@@ -221,6 +229,17 @@ struct DisplayStructEx {
 };
 typedef struct DisplayStructEx TbDisplayStructEx;
 
+/** Nearest colour search structure; divides RGB space into a grid of cells,
+ * each having its own list of colours which may be the closest ones. */
+struct TbPaletteMatch {
+    unsigned char pal[PALETTE_SIZE];
+    /** Index of the first colour of each cell in cols[], or one of PALETTE_MATCH_CELL_* values. */
+    long cell_first[PALETTE_MATCH_CELLS_COUNT];
+    unsigned short cell_count[PALETTE_MATCH_CELLS_COUNT];
+    unsigned char cols[PALETTE_MATCH_POOL_SIZE];
+    long cols_used;
+};
+
 struct SSurface;
 typedef struct SSurface TSurface;
 
@@ -308,6 +327,9 @@ TbResult LbPaletteStopOpenFade(void);
 TbResult LbPaletteSet(unsigned char *palette);
 TbResult LbPaletteGet(unsigned char *palette);
 TbPixel LbPaletteFindColour(const unsigned char *pal, unsigned char r, unsigned char g, unsigned char b);
+unsigned long LbPaletteHash(const unsigned char *pal);
+TbResult LbPaletteMatchInit(struct TbPaletteMatch *pmatch, const unsigned char *pal);
+TbPixel LbPaletteMatchColour(struct TbPaletteMatch *pmatch, unsigned char r, unsigned char g, unsigned char b);
 TbResult LbPaletteDataFillBlack(unsigned char *palette);
 TbResult LbPaletteDataFillWhite(unsigned char *palette);
 
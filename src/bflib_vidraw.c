@@ -30,6 +30,7 @@
 #include "bflib_video.h"
 #include "bflib_memory.h"
 #include "bflib_sprite.h"
+#include "bflib_sprcache.h"
 #include "bflib_mouse.h"
 #include "bflib_render.h"
 
@@ -37,6 +38,26 @@
 extern "C" {
 #endif
 /******************************************************************************/
+/** Pixel operations used when drawing pre-decoded sprites; named after RLE routines doing the same. */
+enum SpriteSpansDrawModes {
+    SSDM_Transpr = 0,
+    SSDM_Solid,
+    SSDM_FastCpy,
+    SSDM_TrRemap,
+    SSDM_SlRemap,
+    SSDM_FCRemap,
+    SSDM_TrOneColour,
+    SSDM_SlOneColour,
+    SSDM_FCOneColour,
+};
+
+/** Pixel operations used when drawing scaled pre-decoded sprites. */
+enum SpriteScaledSpansDrawModes {
+    SSSDM_Solid = 0,
+    SSSDM_Trans1,
+    SSSDM_Trans2,
+};
+
 struct TbSpriteDrawData {
     char *sp;
     short Wd;
@@ -45,6 +66,8 @@ struct TbSpriteDrawData {
     int nextRowDelta;
     short startShift;
     TbBool mirror;
+    /** First sprite line to be drawn. */
+    short top;
 };
 /******************************************************************************/
 long xsteps_array[2*SPRITE_SCALING_XSTEPS];
@@ -432,11 +455,36 @@ static inline TbResult LbSpriteDrawPrepare(struct TbSpriteDrawData *spd, long x,
     spd->Ht = btm - top;
     spd->Wd = right - left;
     spd->sp = (char *)spr->Data;
+    spd->top = top;
     SYNCDBG(19,"Sprite coords X=%d...%d Y=%d...%d data=%08x",left,right,top,btm,spd->sp);
+    SYNCDBG(19,"Drawing sprite of size (%d,%d)",(int)spd->Ht,(int)spd->Wd);
+    if ((lbDisplay.DrawFlags & Lb_SPRITE_FLIP_HORIZ) != 0)
+    {
+        spd->r += spd->Wd - 1;
+        spd->mirror = true;
+        short tmpwidth = spr->SWidth;
+        short tmpright = right;
+        right = tmpwidth - left;
+        spd->startShift = tmpwidth - tmpright;
+    } else
+    {
+        spd->mirror = false;
+        spd->startShift = left;
+    }
+    return Lb_SUCCESS;
+}
+
+/** Internal function used to skip sprite lines above the drawing area.
+ *  Required before drawing from RLE data; pre-decoded sprites don't need it.
+ *
+ * @param spd The TbSpriteDrawData struct filled by LbSpriteDrawPrepare().
+ */
+static inline void LbSpriteDrawSkipTopLines(struct TbSpriteDrawData *spd)
+{
     long htIndex;
-    if ( top )
+    if ( spd->top )
     {
-        htIndex = top;
+        htIndex = spd->top;
         while ( 1 )
         {
             char chr = *(spd->sp);
@@ -453,21 +501,6 @@ static inline TbResult LbSpriteDrawPrepare(struct TbSpriteDrawData *spd, long x,
             }
         }
     }
-    SYNCDBG(19,"Drawing sprite of size (%d,%d)",(int)spd->Ht,(int)spd->Wd);
-    if ((lbDisplay.DrawFlags & Lb_SPRITE_FLIP_HORIZ) != 0)
-    {
-        spd->r += spd->Wd - 1;
-        spd->mirror = true;
-        short tmpwidth = spr->SWidth;
-        short tmpright = right;
-        right = tmpwidth - left;
-        spd->startShift = tmpwidth - tmpright;
-    } else
-    {
-        spd->mirror = false;
-        spd->startShift = left;
-    }
-    return Lb_SUCCESS;
 }
 
 /** Internal function used to skip some of sprite data before drawing is started.
@@ -810,6 +843,88 @@ static inline void LbDrawBufferFCRemap(unsigned char **buf_out,const char *buf_i
     }
 }
 
+/** Internal routine to draw a sprite from pre-decoded spans.
+ *  Uses the same buffer routines as drawing from RLE data, so the result is identical.
+ *
+ * @param spd The TbSpriteDrawData struct filled by LbSpriteDrawPrepare().
+ * @param spans Pre-decoded sprite, at its original size.
+ * @param mode Pixel operation, one of SpriteSpansDrawModes.
+ * @param cmap Colour remap table, for remapping modes.
+ * @param colour Colour for the one colour modes.
+ */
+static TbResult LbSpriteDrawUsingSpans(const struct TbSpriteDrawData *spd, const struct TbSpriteSpans *spans,
+    unsigned short mode, const unsigned char *cmap, TbPixel colour)
+{
+    const struct TbSpriteSpan *span;
+    const struct TbSpriteSpan *span_end;
+    unsigned char *row;
+    unsigned char *out;
+    const char *inp;
+    long j;
+    short lim_left;
+    short lim_right;
+    short c0;
+    short c1;
+    lim_left = spd->startShift;
+    lim_right = spd->startShift + spd->Wd;
+    row = spd->r;
+    for (j=0; j < spd->Ht; j++)
+    {
+        span = &spans->spans[spans->line_first[spd->top+j]];
+        span_end = span + spans->line_count[spd->top+j];
+        for (; span < span_end; span++)
+        {
+            c0 = span->x;
+            c1 = span->x + span->len;
+            if (c1 <= lim_left)
+                continue;
+            if (c0 >= lim_right)
+                break;
+            if (c0 < lim_left)
+                c0 = lim_left;
+            if (c1 > lim_right)
+                c1 = lim_right;
+            if (spd->mirror)
+                out = row - (c0 - lim_left);
+            else
+                out = row + (c0 - lim_left);
+            inp = (const char *)&spans->pixels[span->pixels_pos + (c0 - span->x)];
+            switch (mode)
+            {
+            case SSDM_Transpr:
+                LbDrawBufferTranspr(&out,inp,c1-c0,spd->mirror);
+                break;
+            case SSDM_Solid:
+                LbDrawBufferSolid(&out,inp,c1-c0,spd->mirror);
+                break;
+            case SSDM_FastCpy:
+                memcpy(out,inp,c1-c0);
+                break;
+            case SSDM_TrRemap:
+                LbDrawBufferTrRemap(&out,inp,c1-c0,cmap,spd->mirror);
+                break;
+            case SSDM_SlRemap:
+                LbDrawBufferSlRemap(&out,inp,c1-c0,cmap,spd->mirror);
+                break;
+            case SSDM_FCRemap:
+                LbDrawBufferFCRemap(&out,inp,c1-c0,cmap);
+                break;
+            case SSDM_TrOneColour:
+                LbDrawBufferOneColour(&out,colour,c1-c0,spd->mirror);
+                break;
+            case SSDM_SlOneColour:
+                LbDrawBufferOneColorSolid(&out,colour,c1-c0,spd->mirror);
+                break;
+            case SSDM_FCOneColour:
+                memset(out,colour,c1-c0);
+                break;
+            }
+        }
+        row += spd->nextRowDelta;
+    }
+    return Lb_SUCCESS;
+}
+
 /** Internal routine to draw one line of a transparent sprite.
  *
  * @param sp
@@ -1029,7 +1144,6 @@ static inline void LbSpriteDrawLineFastCpy(const char **sp, unsigned char **r, s
             if (drawOut > (*x1))
               drawOut = (*x1);
             LbDrawBufferSolid(r, (*sp)+(lpos+1), drawOut, false);
-            (*r) += drawOut;
             (*sp) += (*(*sp)) + 1;
         }
         (*x1) -= drawOut;
@@ -1103,11 +1217,24 @@ static inline TbResult LbSpriteDrawFastCpy(const char *sp,short sprWd,short sprH
 TbResult LbSpriteDraw(long x, long y, const struct TbSprite *spr)
 {
     struct TbSpriteDrawData spd;
+    struct TbSpriteSpans *spans;
     TbResult ret;
     SYNCDBG(19,"At (%ld,%ld)",x,y);
     ret = LbSpriteDrawPrepare(&spd, x, y, spr);
     if (ret != Lb_SUCCESS)
         return ret;
+    spans = LbSpriteCacheGet(spr, spr->SWidth, spr->SHeight);
+    if (spans != NULL)
+    {
+        if ((lbDisplay.DrawFlags & (Lb_SPRITE_TRANSPAR4|Lb_SPRITE_TRANSPAR8)) != 0)
+            return LbSpriteDrawUsingSpans(&spd, spans, SSDM_Transpr, NULL, 0);
+        else
+        if ((lbDisplay.DrawFlags & Lb_SPRITE_FLIP_HORIZ) != 0)
+            return LbSpriteDrawUsingSpans(&spd, spans, SSDM_Solid, NULL, 0);
+        else
+            return LbSpriteDrawUsingSpans(&spd, spans, SSDM_FastCpy, NULL, 0);
+    }
+    LbSpriteDrawSkipTopLines(&spd);
     if ((lbDisplay.DrawFlags & (Lb_SPRITE_TRANSPAR4|Lb_SPRITE_TRANSPAR8)) != 0)
         return LbSpriteDrawTranspr(spd.sp,spd.Wd,spd.Ht,spd.r,spd.nextRowDelta,spd.startShift,spd.mirror);
     else
@@ -1399,11 +1526,24 @@ static inline TbResult LbSpriteDrawFCRemap(const char *sp,short sprWd,short sprH
 int LbSpriteDrawRemap(long x, long y, const struct TbSprite *spr,const unsigned char *cmap)
 {
     struct TbSpriteDrawData spd;
+    struct TbSpriteSpans *spans;
     TbResult ret;
     SYNCDBG(19,"At (%ld,%ld)",x,y);
     ret = LbSpriteDrawPrepare(&spd, x, y, spr);
     if (ret != Lb_SUCCESS)
         return ret;
+    spans = LbSpriteCacheGet(spr, spr->SWidth, spr->SHeight);
+    if (spans != NULL)
+    {
+        if ((lbDisplay.DrawFlags & (Lb_SPRITE_TRANSPAR4|Lb_SPRITE_TRANSPAR8)) != 0)
+            return LbSpriteDrawUsingSpans(&spd, spans, SSDM_TrRemap, cmap, 0);
+        else
+        if ((lbDisplay.DrawFlags & Lb_SPRITE_FLIP_HORIZ) != 0)
+            return LbSpriteDrawUsingSpans(&spd, spans, SSDM_SlRemap, cmap, 0);
+        else
+            return LbSpriteDrawUsingSpans(&spd, spans, SSDM_FCRemap, cmap, 0);
+    }
+    LbSpriteDrawSkipTopLines(&spd);
     if ((lbDisplay.DrawFlags & (Lb_SPRITE_TRANSPAR4|Lb_SPRITE_TRANSPAR8)) != 0) {
         return LbSpriteDrawTrRemap(spd.sp,spd.Wd,spd.Ht,spd.r,cmap,spd.nextRowDelta,spd.startShift,spd.mirror);
     } else
@@ -1615,7 +1755,6 @@ static inline void LbSpriteDrawLineFCOneColour(const char **sp, unsigned char **
             if (drawOut > (*x1))
               drawOut = (*x1);
             LbDrawBufferOneColorSolid(r, colour, drawOut, false);
-            (*r) += drawOut;
             (*sp) += (*(*sp)) + 1;
         }
         (*x1) -= drawOut;
@@ -1689,11 +1828,24 @@ static inline TbResult LbSpriteDrawFCOneColour(const char *sp,short sprWd,short
 TbResult LbSpriteDrawOneColour(long x, long y, const struct TbSprite *spr, const TbPixel colour)
 {
     struct TbSpriteDrawData spd;
+    struct TbSpriteSpans *spans;
     TbResult ret;
     SYNCDBG(19,"At (%ld,%ld)",x,y);
     ret = LbSpriteDrawPrepare(&spd, x, y, spr);
     if (ret != Lb_SUCCESS)
         return ret;
+    spans = LbSpriteCacheGet(spr, spr->SWidth, spr->SHeight);
+    if (spans != NULL)
+    {
+        if ((lbDisplay.DrawFlags & (Lb_SPRITE_TRANSPAR4|Lb_SPRITE_TRANSPAR8)) != 0)
+            return LbSpriteDrawUsingSpans(&spd, spans, SSDM_TrOneColour, NULL, colour);
+        else
+        if ((lbDisplay.DrawFlags & Lb_SPRITE_FLIP_HORIZ) != 0)
+            return LbSpriteDrawUsingSpans(&spd, spans, SSDM_SlOneColour, NULL, colour);
+        else
+            return LbSpriteDrawUsingSpans(&spd, spans, SSDM_FCOneColour, NULL, colour);
+    }
+    LbSpriteDrawSkipTopLines(&spd);
     if ((lbDisplay.DrawFlags & (Lb_SPRITE_TRANSPAR4|Lb_SPRITE_TRANSPAR8)) != 0) {
         return LbSpriteDrawTrOneColour(spd.sp,spd.Wd,spd.Ht,spd.r,colour,spd.nextRowDelta,spd.startShift,spd.mirror);
     } else
@@ -2067,6 +2219,103 @@ void SetAlphaScalingData(long x, long y, long swidth, long sheight, long dwidth,
     }
 }
 
+/**
+ * Checks whether scaled sprite can be drawn from pre-decoded spans.
+ * Only sprites which aren't flipped and for which LbSpriteSetScalingData() doesn't need
+ * clipped step arrays qualify; only then drawing spans gives the same result.
+ */
+static TbBool LbSpriteDrawScaledCanUseSpans(long xpos, long ypos, const struct TbSprite *sprite, long dest_width, long dest_height)
+{
+    if ((lbDisplay.DrawFlags & (Lb_SPRITE_FLIP_HORIZ|Lb_SPRITE_FLIP_VERTIC)) != 0)
+        return false;
+    if ((sprite->SWidth > SPRITE_SCALING_XSTEPS) || (sprite->SHeight > SPRITE_SCALING_YSTEPS))
+        return false;
+    if ((xpos < 0) || ((dest_width+sprite->SWidth+xpos) >= lbDisplay.GraphicsWindowWidth))
+        return false;
+    if ((ypos < 0) || ((dest_height+sprite->SHeight+ypos) >= lbDisplay.GraphicsWindowHeight))
+        return false;
+    return true;
+}
+
+/**
+ * Draws scaled sprite from pre-decoded spans.
+ *
+ * @param xpos The X coord within current graphics window.
+ * @param ypos The Y coord within current graphics window.
+ * @param spans Pre-decoded sprite, scaled to destination size.
+ * @param mode Pixel operation, one of SpriteScaledSpansDrawModes.
+ * @param cmap Colour remap table, or NULL if colours shouldn't be remapped.
+ * @param one_colour If true, all sprite pixels are drawn with given colour.
+ * @param colour The colour to be used if one_colour is set.
+ * @return Gives 0 on success.
+ */
+static TbResult LbSpriteDrawScaledUsingSpans(long xpos, long ypos, const struct TbSpriteSpans *spans,
+    unsigned short mode, const TbPixel *cmap, TbBool one_colour, TbPixel colour)
+{
+    const struct TbSpriteSpan *span;
+    const struct TbSpriteSpan *span_end;
+    const TbPixel *inp;
+    unsigned char *row;
+    unsigned char *out;
+    long i,j;
+    unsigned int val;
+    row = &lbDisplay.GraphicsWindowPtr[(xpos+spans->shift_x) + lbDisplay.GraphicsScreenWidth * (ypos+spans->shift_y)];
+    for (j=0; j < spans->height; j++)
+    {
+        span = &spans->spans[spans->line_first[j]];
+        span_end = span + spans->line_count[j];
+        for (; span < span_end; span++)
+        {
+            out = row + span->x;
+            inp = &spans->pixels[span->pixels_pos];
+            switch (mode)
+            {
+            case SSSDM_Trans1:
+                for (i=0; i < span->len; i++)
+                {
+                    val = one_colour ? colour : (cmap != NULL) ? cmap[inp[i]] : inp[i];
+                    out[i] = render_ghost[(val << 8) | out[i]];
+                }
+                break;
+            case SSSDM_Trans2:
+                for (i=0; i < span->len; i++)
+                {
+                    val = one_colour ? colour : (cmap != NULL) ? cmap[inp[i]] : inp[i];
+                    out[i] = render_ghost[(out[i] << 8) | val];
+                }
+                break;
+            case SSSDM_Solid:
+            default:
+                if (one_colour) {
+                    memset(out, colour, span->len);
+                } else
+                if (cmap != NULL) {
+                    for (i=0; i < span->len; i++)
+                        out[i] = cmap[inp[i]];
+                } else {
+                    memcpy(out, inp, span->len);
+                }
+                break;
+            }
+        }
+        row += lbDisplay.GraphicsScreenWidth;
+    }
+    return 0;
+}
+
+/**
+ * Selects pixel operation for drawing scaled sprite from pre-decoded spans;
+ * the same as LbSpriteDraw*UsingScalingData() functions would select.
+ */
+static unsigned short LbSpriteDrawScaledSpansMode(void)
+{
+    if ((lbDisplay.DrawFlags & Lb_SPRITE_TRANSPAR4) != 0)
+        return SSSDM_Trans1;
+    if ((lbDisplay.DrawFlags & Lb_SPRITE_TRANSPAR8) != 0)
+        return SSSDM_Trans2;
+    return SSSDM_Solid;
+}
+
 TbResult LbSpriteDrawScaled(long xpos, long ypos, const struct TbSprite *sprite, long dest_width, long dest_height)
 {
     SYNCDBG(19,"At (%ld,%ld) size (%ld,%ld)",xpos,ypos,dest_width,dest_height);
@@ -2075,6 +2324,17 @@ TbResult LbSpriteDrawScaled(long xpos, long ypos, const struct TbSprite *sprite,
     if ((lbDisplay.DrawFlags & Lb_TEXT_UNDERLNSHADOW) != 0)
         lbSpriteReMapPtr = lbDisplay.FadeTable + ((lbDisplay.FadeStep & 0x3F) << 8);
     LbSpriteSetScalingData(xpos, ypos, sprite->SWidth, sprite->SHeight, dest_width, dest_height);
+    if (LbSpriteDrawScaledCanUseSpans(xpos, ypos, sprite, dest_width, dest_height))
+    {
+        struct TbSpriteSpans *spans;
+        spans = LbSpriteCacheGet(sprite, dest_width, dest_height);
+        if (spans != NULL)
+        {
+            if ((lbDisplay.DrawFlags & Lb_TEXT_UNDERLNSHADOW) != 0)
+                return LbSpriteDrawScaledUsingSpans(xpos, ypos, spans, SSSDM_Solid, lbSpriteReMapPtr, false, 0);
+            return LbSpriteDrawScaledUsingSpans(xpos, ypos, spans, LbSpriteDrawScaledSpansMode(), NULL, false, 0);
+        }
+    }
     return LbSpriteDrawUsingScalingData(0, 0, sprite);
 }
 
@@ -2086,6 +2346,13 @@ TbResult LbSpriteDrawScaledOneColour(long xpos, long ypos, const struct TbSprite
     if ((lbDisplay.DrawFlags & Lb_TEXT_UNDERLNSHADOW) != 0)
         lbSpriteReMapPtr = lbDisplay.FadeTable + ((lbDisplay.FadeStep & 0x3F) << 8);
     LbSpriteSetScalingData(xpos, ypos, sprite->SWidth, sprite->SHeight, dest_width, dest_height);
+    if (LbSpriteDrawScaledCanUseSpans(xpos, ypos, sprite, dest_width, dest_height))
+    {
+        struct TbSpriteSpans *spans;
+        spans = LbSpriteCacheGet(sprite, dest_width, dest_height);
+        if (spans != NULL)
+            return LbSpriteDrawScaledUsingSpans(xpos, ypos, spans, LbSpriteDrawScaledSpansMode(), NULL, true, colour);
+    }
     return LbSpriteDrawOneColourUsingScalingData(0, 0, sprite, colour);
 }
 
@@ -2097,6 +2364,13 @@ int LbSpriteDrawScaledRemap(long xpos, long ypos, const struct TbSprite *sprite,
     if ((lbDisplay.DrawFlags & Lb_TEXT_UNDERLNSHADOW) != 0)
         lbSpriteReMapPtr = lbDisplay.FadeTable + ((lbDisplay.FadeStep & 0x3F) << 8);
     LbSpriteSetScalingData(xpos, ypos, sprite->SWidth, sprite->SHeight, dest_width, dest_height);
+    if (LbSpriteDrawScaledCanUseSpans(xpos, ypos, sprite, dest_width, dest_height))
+    {
+        struct TbSpriteSpans *spans;
+        spans = LbSpriteCacheGet(sprite, dest_width, dest_height);
+        if (spans != NULL)
+            return LbSpriteDrawScaledUsingSpans(xpos, ypos, spans, LbSpriteDrawScaledSpansMode(), cmap, false, 0);
+    }
     return LbSpriteDrawRemapUsingScalingData(0, 0, sprite, cmap);
 }
 
@@ -0,0 +1,250 @@
+/******************************************************************************/
+// Bullfrog Engine Emulation Library - for use to remake classic games like
+// Syndicate Wars, Magic Carpet or Dungeon Keeper.
+/******************************************************************************/
+/** @file bflib_workers.c
+ *     Worker threads pool for splitting heavy computations.
+ * @par Purpose:
+ *     Allows executing a set of independent jobs on all CPU cores.
+ * @par Comment:
+ *     The jobs are dispatched in a blocking way - LbWorkersRun() returns when
+ *     all jobs are finished, so callers don't have to care about thread safety
+ *     of anything else than the jobs themselves.
+ *     Depends on the threads support library, which is SDL in this implementation.
+ * @author   KeeperFX Team
+ * @date     19 Oct 2026 - 19 Oct 2026
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+/******************************************************************************/
+#include "bflib_workers.h"
+
+#include "bflib_basics.h"
+#include "globals.h"
+#include <SDL/SDL.h>
+#include <SDL/SDL_thread.h>
+
+#if defined(WIN32)
+#include <windows.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/******************************************************************************/
+struct WorkersBands {
+    TbWorkerBandFunc func;
+    void *data;
+    long items_count;
+    long bands_count;
+};
+
+struct WorkersPool {
+    SDL_Thread *threads[WORKERS_MAX_COUNT];
+    /** Amount of additional threads; the main thread is not counted. */
+    long threads_count;
+    SDL_mutex *job_lock;
+    SDL_sem *start_sem;
+    SDL_sem *done_sem;
+    TbWorkerJobFunc func;
+    void *data;
+    long jobs_count;
+    long next_job;
+    TbBool running;
+    TbBool quit;
+};
+/******************************************************************************/
+static struct WorkersPool workers;
+/******************************************************************************/
+static long workers_get_cpu_count(void)
+{
+#if defined(WIN32)
+    SYSTEM_INFO sysinfo;
+    GetSystemInfo(&sysinfo);
+    return sysinfo.dwNumberOfProcessors;
+#else
+    return 1;
+#endif
+}
+
+/**
+ * Executes jobs from the current batch until there are none left.
+ * Called by both the worker threads and the thread which started the batch.
+ */
+static void workers_process_jobs(void)
+{
+    long job_idx;
+    while (1)
+    {
+        SDL_mutexP(workers.job_lock);
+        job_idx = workers.next_job;
+        if (job_idx < workers.jobs_count)
+            workers.next_job++;
+        SDL_mutexV(workers.job_lock);
+        if (job_idx >= workers.jobs_count)
+            break;
+        workers.func(workers.data, job_idx);
+    }
+}
+
+static int workers_thread_main(void *arg)
+{
+    while (1)
+    {
+        SDL_SemWait(workers.start_sem);
+        if (workers.quit)
+            break;
+        workers_process_jobs();
+        SDL_SemPost(workers.done_sem);
+    }
+    return 0;
+}
+
+/**
+ * Starts the worker threads.
+ * @param threads_count Amount of threads to execute jobs, including the main thread.
+ *     If zero or negative, the amount of CPU cores is used.
+ */
+TbResult LbWorkersInit(long threads_count)
+{
+    long i;
+    if (workers.job_lock != NULL)
+        LbWorkersFree();
+    if (threads_count <= 0)
+        threads_count = workers_get_cpu_count();
+    if (threads_count > WORKERS_MAX_COUNT)
+        threads_count = WORKERS_MAX_COUNT;
+    workers.threads_count = 0;
+    workers.running = false;
+    workers.quit = false;
+    workers.job_lock = SDL_CreateMutex();
+    workers.start_sem = SDL_CreateSemaphore(0);
+    workers.done_sem = SDL_CreateSemaphore(0);
+    if ((workers.job_lock == NULL) || (workers.start_sem == NULL) || (workers.done_sem == NULL))
+    {
+        ERRORLOG("Cannot create synchronization objects for workers");
+        LbWorkersFree();
+        return Lb_FAIL;
+    }
+    for (i=0; i < threads_count-1; i++)
+    {
+        workers.threads[i] = SDL_CreateThread(workers_thread_main, NULL);
+        if (workers.threads[i] == NULL)
+        {
+            WARNLOG("Cannot create worker thread %d",(int)i);
+            break;
+        }
+        workers.threads_count++;
+    }
+    SYNCMSG("Workers pool started with %d threads",(int)workers.threads_count+1);
+    return Lb_SUCCESS;
+}
+
+TbResult LbWorkersFree(void)
+{
+    long i;
+    workers.quit = true;
+    for (i=0; i < workers.threads_count; i++)
+        SDL_SemPost(workers.start_sem);
+    for (i=0; i < workers.threads_count; i++)
+    {
+        SDL_WaitThread(workers.threads[i], NULL);
+        workers.threads[i] = NULL;
+    }
+    workers.threads_count = 0;
+    if (workers.done_sem != NULL)
+        SDL_DestroySemaphore(workers.done_sem);
+    workers.done_sem = NULL;
+    if (workers.start_sem != NULL)
+        SDL_DestroySemaphore(workers.start_sem);
+    workers.start_sem = NULL;
+    if (workers.job_lock != NULL)
+        SDL_DestroyMutex(workers.job_lock);
+    workers.job_lock = NULL;
+    workers.quit = false;
+    return Lb_SUCCESS;
+}
+
+/**
+ * Returns amount of threads which will execute jobs, including the main thread.
+ */
+long LbWorkersCount(void)
+{
+    return workers.threads_count + 1;
+}
+
+/**
+ * Executes given amount of jobs, splitting them between all worker threads.
+ * Returns after all the jobs are finished. The order in which jobs are executed
+ * is undefined, so the jobs have to be independent.
+ * If the pool is not initialized, or the function is called from inside
+ * of a job, the jobs are just executed one by one.
+ */
+TbResult LbWorkersRun(TbWorkerJobFunc func, void *data, long jobs_count)
+{
+    long i,n;
+    if (jobs_count <= 0)
+        return Lb_OK;
+    if ((workers.threads_count < 1) || (workers.running) || (jobs_count == 1))
+    {
+        for (i=0; i < jobs_count; i++)
+            func(data, i);
+        return Lb_SUCCESS;
+    }
+    workers.running = true;
+    workers.func = func;
+    workers.data = data;
+    workers.jobs_count = jobs_count;
+    workers.next_job = 0;
+    // No need to wake more threads than there are jobs
+    n = min(workers.threads_count, jobs_count-1);
+    for (i=0; i < n; i++)
+        SDL_SemPost(workers.start_sem);
+    workers_process_jobs();
+    for (i=0; i < n; i++)
+        SDL_SemWait(workers.done_sem);
+    workers.func = NULL;
+    workers.data = NULL;
+    workers.running = false;
+    return Lb_SUCCESS;
+}
+
+static void workers_band_job(void *data, long job_idx)
+{
+    struct WorkersBands *bands;
+    bands = (struct WorkersBands *)data;
+    bands->func(bands->data, bands->items_count * job_idx / bands->bands_count,
+        bands->items_count * (job_idx+1) / bands->bands_count);
+}
+
+/**
+ * Splits given amount of items, ie. image rows, into continuous bands and executes
+ * the bands on all worker threads. Returns after all the bands are finished.
+ * @param min_band_size Minimal amount of items in a band; smaller work won't be split.
+ */
+TbResult LbWorkersRunBands(TbWorkerBandFunc func, void *data, long items_count, long min_band_size)
+{
+    struct WorkersBands bands;
+    if (items_count <= 0)
+        return Lb_OK;
+    if (min_band_size < 1)
+        min_band_size = 1;
+    bands.func = func;
+    bands.data = data;
+    bands.items_count = items_count;
+    // Twice as many bands as threads, so that uneven bands won't stall the whole batch
+    bands.bands_count = min(2*LbWorkersCount(), items_count / min_band_size);
+    if (bands.bands_count <= 1)
+    {
+        func(data, 0, items_count);
+        return Lb_SUCCESS;
+    }
+    return LbWorkersRun(workers_band_job, &bands, bands.bands_count);
+}
+/******************************************************************************/
+#ifdef __cplusplus
+}
+#endif
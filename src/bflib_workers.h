@@ -0,0 +1,55 @@
+/******************************************************************************/
+// Bullfrog Engine Emulation Library - for use to remake classic games like
+// Syndicate Wars, Magic Carpet or Dungeon Keeper.
+/******************************************************************************/
+/** @file bflib_workers.h
+ *     Header file for bflib_workers.c.
+ * @par Purpose:
+ *     Worker threads pool for splitting heavy computations.
+ * @par Comment:
+ *     Just a header file - #defines, typedefs, function prototypes etc.
+ * @author   KeeperFX Team
+ * @date     19 Oct 2026 - 19 Oct 2026
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+/******************************************************************************/
+#ifndef BFLIB_WORKERS_H
+#define BFLIB_WORKERS_H
+
+#include "bflib_basics.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/******************************************************************************/
+/** Max amount of threads which may execute jobs, including the main thread. */
+#define WORKERS_MAX_COUNT 8
+
+/**
+ * Job function executed by workers.
+ * @param data Data pointer given when running the jobs.
+ * @param job_idx Index of the job to execute, from 0 to jobs_count-1.
+ */
+typedef void (*TbWorkerJobFunc)(void *data, long job_idx);
+/**
+ * Band function executed by workers.
+ * @param data Data pointer given when running the bands.
+ * @param start_idx Index of the first item of the band.
+ * @param end_idx Index beyond the last item of the band.
+ */
+typedef void (*TbWorkerBandFunc)(void *data, long start_idx, long end_idx);
+/******************************************************************************/
+TbResult LbWorkersInit(long threads_count);
+TbResult LbWorkersFree(void);
+long LbWorkersCount(void);
+TbResult LbWorkersRun(TbWorkerJobFunc func, void *data, long jobs_count);
+TbResult LbWorkersRunBands(TbWorkerBandFunc func, void *data, long items_count, long min_band_size);
+/******************************************************************************/
+#ifdef __cplusplus
+}
+#endif
+#endif
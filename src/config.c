@@ -20,6 +20,7 @@
 #include "config.h"
 
 #include <stdarg.h>
+#include <ctype.h>
 #include "globals.h"
 #include "bflib_basics.h"
 #include "bflib_memory.h"
@@ -105,6 +106,8 @@ const struct NamedCommand logicval_type[] = {
 unsigned long features_enabled = 0;
 /** Line number, used when loading text files. */
 unsigned long text_line_number;
+/** If disabled, config blocks and commands are searched linearly; allows comparing speed of both ways. */
+TbBool conf_index_enabled = true;
 
 short is_full_moon = 0;
 short is_near_full_moon = 0;
@@ -184,12 +187,180 @@ TbBool skip_conf_spaces(const char *buf, long *pos, long buflen)
   return ((*pos) < buflen);
 }
 
+/** Amount of hash slots in config blocks index; needs to be power of 2. */
+#define CONF_BLOCKS_HASH_SIZE 1024
+/** Amount of command tables which can have a lookup index; others are searched linearly. */
+#define CONF_COMMAND_TABLES_COUNT 128
+/** Amount of hash slots in lookup index of one command table; needs to be power of 2. */
+#define CONF_COMMANDS_HASH_SIZE 128
+
 /**
- * Searches for start of INI file block with given name.
- * Starts at position given with pos, and sets it to position of block data.
- * @return Returns 1 if the block is found, -1 if buffer exceeded.
+ * Position of a block within config file buffer.
  */
-short find_conf_block(const char *buf,long *pos,long buflen,const char *blockname)
+struct ConfBlockEntry {
+    /** Position at which the block header line starts. */
+    long line_pos;
+    long name_pos;
+    long name_len;
+    unsigned long hash;
+    /** Position of block data, and text line number at that position. */
+    long data_pos;
+    unsigned long data_line;
+    /** Index of next entry in the same hash slot, or -1. */
+    long next;
+};
+
+/**
+ * Index of all blocks within config file buffer, made in one pass through the buffer.
+ * Parsers look for every block from the start of the buffer, so without the index,
+ * loading files with many blocks (ie. creature instances, or campaign levels) would be quadratic.
+ */
+struct ConfBlocksIndex {
+    const char *buf;
+    long buflen;
+    struct ConfBlockEntry *entries;
+    long entries_count;
+    long entries_allocated;
+    unsigned long end_line;
+    long slots[CONF_BLOCKS_HASH_SIZE];
+};
+
+/**
+ * Hash table of commands from one NamedCommand table, to find a command without comparing all names.
+ */
+struct ConfCommandsIndex {
+    const struct NamedCommand *commands;
+    /** If the table contains names which can't be found by hash, it is searched linearly. */
+    TbBool linear;
+    /** Command index in the table, increased by 1; zero for unused slots. */
+    unsigned short slots[CONF_COMMANDS_HASH_SIZE];
+};
+
+static struct ConfBlocksIndex conf_blocks_index;
+static struct ConfCommandsIndex conf_commands_index[CONF_COMMAND_TABLES_COUNT];
+
+/**
+ * Returns case insensitive hash of given name.
+ */
+static unsigned long conf_name_hash(const char *name, long len)
+{
+    unsigned long hash;
+    long i;
+    hash = 5381;
+    for (i=0; i < len; i++)
+        hash = (hash * 33) ^ (unsigned long)tolower((unsigned char)name[i]);
+    return hash;
+}
+
+static TbBool conf_char_is_space(char c)
+{
+    return (c == ' ') || (c == '\t') || (c == 26) || ((unsigned char)c < 7);
+}
+
+static TbBool conf_blocks_index_add(long line_pos, long name_pos, long name_len, long data_pos)
+{
+    struct ConfBlocksIndex *blidx;
+    struct ConfBlockEntry *entry;
+    long slot;
+    blidx = &conf_blocks_index;
+    if (blidx->entries_count >= blidx->entries_allocated)
+    {
+        long num_entries;
+        num_entries = blidx->entries_allocated + 64;
+        entry = (struct ConfBlockEntry *)LbMemoryGrow(blidx->entries, num_entries*sizeof(struct ConfBlockEntry));
+        if (entry == NULL) {
+            WARNLOG("Can't allocate memory for config blocks index");
+            return false;
+        }
+        blidx->entries = entry;
+        blidx->entries_allocated = num_entries;
+    }
+    entry = &blidx->entries[blidx->entries_count];
+    entry->line_pos = line_pos;
+    entry->name_pos = name_pos;
+    entry->name_len = name_len;
+    entry->hash = conf_name_hash(&blidx->buf[name_pos], name_len);
+    entry->data_pos = data_pos;
+    entry->data_line = text_line_number;
+    slot = entry->hash & (CONF_BLOCKS_HASH_SIZE-1);
+    entry->next = blidx->slots[slot];
+    blidx->slots[slot] = blidx->entries_count;
+    blidx->entries_count++;
+    return true;
+}
+
+/**
+ * Makes sure the blocks index contains blocks of given buffer.
+ * The sweep through buffer lines is the same as in find_conf_block_linear(),
+ * so block data positions and line numbers are exactly the same.
+ * @return True if the index can be used, false if the buffer has to be searched linearly.
+ */
+static TbBool conf_blocks_index_prepare(const char *buf, long buflen)
+{
+    struct ConfBlocksIndex *blidx;
+    long pos,i;
+    blidx = &conf_blocks_index;
+    if ((blidx->buf == buf) && (blidx->buflen == buflen))
+        return true;
+    blidx->buf = buf;
+    blidx->buflen = buflen;
+    blidx->entries_count = 0;
+    for (i=0; i < CONF_BLOCKS_HASH_SIZE; i++)
+        blidx->slots[i] = -1;
+    text_line_number = 1;
+    pos = 0;
+    while (pos < buflen)
+    {
+        long line_pos,name_pos,name_end;
+        line_pos = pos;
+        // Skipping starting spaces
+        if (!skip_conf_spaces(buf,&pos,buflen))
+            break;
+        // Checking if this line is start of a block
+        if (buf[pos] == '[')
+        {
+            name_pos = pos+1;
+            skip_conf_spaces(buf,&name_pos,buflen);
+            name_end = name_pos;
+            while ((name_end < buflen) && (buf[name_end] != ']') && (buf[name_end] != '\r') && (buf[name_end] != '\n'))
+                name_end++;
+            if ((name_end < buflen) && (buf[name_end] == ']'))
+            {
+                pos = name_end;
+                while ((name_end > name_pos) && conf_char_is_space(buf[name_end-1]))
+                    name_end--;
+                skip_conf_to_next_line(buf,&pos,buflen);
+                if (!conf_blocks_index_add(line_pos, name_pos, name_end-name_pos, pos))
+                {
+                    blidx->buf = NULL;
+                    return false;
+                }
+                continue;
+            }
+        }
+        skip_conf_to_next_line(buf,&pos,buflen);
+    }
+    blidx->end_line = text_line_number;
+    return true;
+}
+
+/**
+ * Drops the blocks index of given buffer. Needs to be called before the buffer is freed,
+ * as another config file may then be loaded at the same address.
+ */
+void clear_conf_blocks_index(const char *buf)
+{
+    if (conf_blocks_index.buf == buf)
+    {
+        conf_blocks_index.buf = NULL;
+        conf_blocks_index.entries_count = 0;
+    }
+}
+
+/**
+ * Searches for start of INI file block by sweeping through lines of the buffer.
+ */
+static short find_conf_block_linear(const char *buf,long *pos,long buflen,const char *blockname)
 {
   int blname_len;
   text_line_number = 1;
@@ -232,35 +403,112 @@ short find_conf_block(const char *buf,long *pos,long buflen,const char *blocknam
 }
 
 /**
- * Recognizes config command and returns its number, or negative status code.
- * @param buf
- * @param pos
- * @param buflen
- * @param commands
- * @return If positive integer is returned, it is the command number recognized in the line.
- * If 0 is returned, that means the current line did not contained any command and should be skipped.
- * If -1 is returned, that means we've reached end of file.
- * If -2 is returned, that means the command wasn't recognized.
- * If -3 is returned, that means we've reached end of the INI block.
+ * Searches for start of INI file block with given name.
+ * Starts at position given with pos, and sets it to position of block data.
+ * @return Returns 1 if the block is found, -1 if buffer exceeded.
  */
-int recognize_conf_command(const char *buf,long *pos,long buflen,const struct NamedCommand commands[])
+short find_conf_block(const char *buf,long *pos,long buflen,const char *blockname)
 {
-    int i,cmdname_len;
-    SYNCDBG(19,"Starting");
-    if ((*pos) >= buflen) return -1;
-    // Skipping starting spaces
-    while ((buf[*pos] == ' ') || (buf[*pos] == '\t') || (buf[*pos] == '\n') || (buf[*pos] == '\r') || (buf[*pos] == 26) || ((unsigned char)buf[*pos] < 7))
+    struct ConfBlocksIndex *blidx;
+    struct ConfBlockEntry *found;
+    unsigned long hash;
+    int blname_len;
+    long i;
+    // Blocks index is used only for searches from the start of the buffer
+    if (!conf_index_enabled || ((*pos) != 0) || !conf_blocks_index_prepare(buf, buflen))
+        return find_conf_block_linear(buf,pos,buflen,blockname);
+    blidx = &conf_blocks_index;
+    blname_len = strlen(blockname);
+    hash = conf_name_hash(blockname, blname_len);
+    found = NULL;
+    for (i = blidx->slots[hash & (CONF_BLOCKS_HASH_SIZE-1)]; i >= 0; i = blidx->entries[i].next)
     {
-        (*pos)++;
-        if ((*pos) >= buflen) return -1;
+        struct ConfBlockEntry *entry;
+        entry = &blidx->entries[i];
+        if ((entry->hash != hash) || (entry->name_len != blname_len))
+            continue;
+        if (strncasecmp(&buf[entry->name_pos],blockname,blname_len) != 0)
+            continue;
+        // If there are more blocks with the same name, the first one counts
+        if ((found == NULL) || (entry->line_pos < found->line_pos))
+            found = entry;
     }
-    // Checking if this line is a comment
-    if (buf[*pos] == ';')
-        return 0;
-    // Checking if this line is start of a block
-    if (buf[*pos] == '[')
-        return -3;
-    // Finding command number
+    // Linear search ends when remaining part of the buffer is too short to contain the block name
+    if ((found != NULL) && (found->line_pos+blname_len+2 < buflen) && (found->name_pos+blname_len+2 < buflen))
+    {
+        *pos = found->data_pos;
+        text_line_number = found->data_line;
+        return 1;
+    }
+    text_line_number = blidx->end_line;
+    return -1;
+}
+
+static TbBool conf_char_ends_command(char c)
+{
+    return (c == ' ') || (c == '\t') || (c == '=') || ((unsigned char)c < 7);
+}
+
+/**
+ * Returns lookup index of given commands table, making it if it doesn't exist yet.
+ * Config commands tables are constant, so the index never has to be updated.
+ * @return The index, or NULL if there's no space for more tables.
+ */
+static struct ConfCommandsIndex *get_conf_commands_index(const struct NamedCommand commands[])
+{
+    struct ConfCommandsIndex *cmdidx;
+    long i,n;
+    n = ((size_t)commands >> 4) % CONF_COMMAND_TABLES_COUNT;
+    for (i=0; i < CONF_COMMAND_TABLES_COUNT; i++)
+    {
+        cmdidx = &conf_commands_index[(n+i) % CONF_COMMAND_TABLES_COUNT];
+        if (cmdidx->commands == commands)
+            return cmdidx;
+        if (cmdidx->commands == NULL)
+            break;
+    }
+    if (i >= CONF_COMMAND_TABLES_COUNT)
+        return NULL;
+    cmdidx->commands = commands;
+    cmdidx->linear = false;
+    LbMemorySet(cmdidx->slots, 0, sizeof(cmdidx->slots));
+    for (i=0; commands[i].num > 0; i++)
+    {
+        const char *name;
+        long name_len,slot,k;
+        name = commands[i].name;
+        name_len = strlen(name);
+        // Hash lookup needs the whole name to be one word, and a lot of free slots
+        for (k=0; k < name_len; k++) {
+            if (conf_char_ends_command(name[k]))
+                break;
+        }
+        if ((name_len < 1) || (k < name_len) || (i >= CONF_COMMANDS_HASH_SIZE/2))
+        {
+            cmdidx->linear = true;
+            break;
+        }
+        slot = conf_name_hash(name, name_len) & (CONF_COMMANDS_HASH_SIZE-1);
+        while (cmdidx->slots[slot] != 0)
+        {
+            // If there are more commands with the same name, the first one counts
+            if (strcasecmp(commands[cmdidx->slots[slot]-1].name, name) == 0)
+                break;
+            slot = (slot+1) & (CONF_COMMANDS_HASH_SIZE-1);
+        }
+        if (cmdidx->slots[slot] == 0)
+            cmdidx->slots[slot] = i+1;
+    }
+    return cmdidx;
+}
+
+/**
+ * Recognizes config command by comparing the line with every command name.
+ * Used for command tables which have no lookup index.
+ */
+static int recognize_conf_command_linear(const char *buf,long *pos,long buflen,const struct NamedCommand commands[])
+{
+    int i,cmdname_len;
     i = 0;
     while (commands[i].num > 0)
     {
@@ -299,6 +547,68 @@ int recognize_conf_command(const char *buf,long *pos,long buflen,const struct Na
     return -2;
 }
 
+/**
+ * Recognizes config command and returns its number, or negative status code.
+ * @param buf
+ * @param pos
+ * @param buflen
+ * @param commands
+ * @return If positive integer is returned, it is the command number recognized in the line.
+ * If 0 is returned, that means the current line did not contained any command and should be skipped.
+ * If -1 is returned, that means we've reached end of file.
+ * If -2 is returned, that means the command wasn't recognized.
+ * If -3 is returned, that means we've reached end of the INI block.
+ */
+int recognize_conf_command(const char *buf,long *pos,long buflen,const struct NamedCommand commands[])
+{
+    struct ConfCommandsIndex *cmdidx;
+    long cmdname_len,slot;
+    SYNCDBG(19,"Starting");
+    if ((*pos) >= buflen) return -1;
+    // Skipping starting spaces
+    while ((buf[*pos] == ' ') || (buf[*pos] == '\t') || (buf[*pos] == '\n') || (buf[*pos] == '\r') || (buf[*pos] == 26) || ((unsigned char)buf[*pos] < 7))
+    {
+        (*pos)++;
+        if ((*pos) >= buflen) return -1;
+    }
+    // Checking if this line is a comment
+    if (buf[*pos] == ';')
+        return 0;
+    // Checking if this line is start of a block
+    if (buf[*pos] == '[')
+        return -3;
+    cmdidx = NULL;
+    if (conf_index_enabled)
+        cmdidx = get_conf_commands_index(commands);
+    if ((cmdidx == NULL) || (cmdidx->linear))
+        return recognize_conf_command_linear(buf,pos,buflen,commands);
+    // The command has to be followed by separator, so it is the whole word
+    cmdname_len = 0;
+    while (((*pos)+cmdname_len < buflen) && !conf_char_ends_command(buf[(*pos)+cmdname_len]))
+        cmdname_len++;
+    slot = conf_name_hash(&buf[*pos], cmdname_len) & (CONF_COMMANDS_HASH_SIZE-1);
+    while (cmdidx->slots[slot] != 0)
+    {
+        const struct NamedCommand *cmd;
+        cmd = &commands[cmdidx->slots[slot]-1];
+        if ((strlen(cmd->name) == cmdname_len) && (strnicmp(buf+(*pos), cmd->name, cmdname_len) == 0))
+        {
+            (*pos) += cmdname_len;
+            // Skipping spaces between command and parameters
+            while ((*pos) < buflen)
+            {
+                if ((buf[*pos] != ' ') && (buf[*pos] != '\t')
+                 && (buf[*pos] != '=') && ((unsigned char)buf[*pos] >= 7))
+                    break;
+                (*pos)++;
+            }
+            return cmd->num;
+        }
+        slot = (slot+1) & (CONF_COMMANDS_HASH_SIZE-1);
+    }
+    return -2;
+}
+
 int get_conf_parameter_whole(const char *buf,long *pos,long buflen,char *dst,long dstlen)
 {
   int i;
@@ -1398,6 +1708,8 @@ TbBool setup_campaign_credits_data(struct GameCampaign *campgn)
     result = parse_credits_block(campgn->credits, campgn->credits_data, credits_data_end);
     if (!result)
       WARNMSG("Parsing credits file \"%s\" credits block failed",campgn->credits_fname);
+    // Credits data stays loaded, but is not going to be searched for blocks again
+    clear_conf_blocks_index(campgn->credits_data);
   }
   SYNCDBG(19,"Finished");
   return result;
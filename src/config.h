@@ -184,6 +184,7 @@ extern short is_near_full_moon;
 extern short is_new_moon;
 extern short is_near_new_moon;
 extern unsigned long text_line_number;
+extern TbBool conf_index_enabled;
 extern const struct NamedCommand lang_type[];
 /******************************************************************************/
 char *prepare_file_path_buf(char *ffullpath,short fgroup,const char *fname);
@@ -248,6 +249,7 @@ TbBool reset_credits(struct CreditsItem *credits);
 TbBool setup_campaign_credits_data(struct GameCampaign *campgn);
 /******************************************************************************/
 short find_conf_block(const char *buf,long *pos,long buflen,const char *blockname);
+void clear_conf_blocks_index(const char *buf);
 int recognize_conf_command(const char *buf,long *pos,long buflen,const struct NamedCommand *commands);
 TbBool skip_conf_to_next_line(const char *buf,long *pos,long buflen);
 int get_conf_parameter_single(const char *buf,long *pos,long buflen,char *dst,long dstlen);
@@ -0,0 +1,893 @@
+/******************************************************************************/
+// Free implementation of Bullfrog's Dungeon Keeper strategy game.
+/******************************************************************************/
+/** @file config_cache.c
+ *     Binary caches of parsed config and level files.
+ * @par Purpose:
+ *     Allows skipping the parsing of terrain, traps and doors, magic and
+ *     creature model configs, level scripts and level terrain, if none of
+ *     their source files have changed since the cache was written.
+ * @par Comment:
+ *     Every cache file has the same header, with a key computed from the
+ *     executable version and contents of all source files, and a checksum
+ *     of the cached data. Each campaign has its own cache files, stored
+ *     in the save folder.
+ *     Rules config isn't cached. It sets over a hundred separate fields of
+ *     Game and GameAdd structs, so the list of fields to cache would have to
+ *     be kept in sync with the parser by hand, and a field missing from it
+ *     would silently take its value from whatever was loaded before; the file
+ *     is also small enough for parsing it to take little time.
+ * @author   KeeperFX Team
+ * @date     19 Oct 2026 - 19 Oct 2026
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+/******************************************************************************/
+#include "config_cache.h"
+#include "globals.h"
+
+#include "bflib_basics.h"
+#include "bflib_memory.h"
+#include "bflib_fileio.h"
+#include "bflib_dernc.h"
+
+#include "config.h"
+#include "config_campaigns.h"
+#include "config_creature.h"
+#include "config_crtrstates.h"
+#include "config_effects.h"
+#include "config_lenses.h"
+#include "config_magic.h"
+#include "config_objects.h"
+#include "config_rules.h"
+#include "config_terrain.h"
+#include "config_trapdoor.h"
+#include "creature_graphics.h"
+#include "room_data.h"
+#include "thing_doors.h"
+#include "game_legacy.h"
+#include "version.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/******************************************************************************/
+#define CONFIG_CACHE_MAGIC "KFXC"
+
+/** Header which starts every cache file; the cached data follows it. */
+struct CacheFileHeader {
+    char magic[4];
+    unsigned long version;
+    /** Hash of executable version, all source files, and sizes of cached structs. */
+    unsigned long key;
+    unsigned long data_size;
+    /** Hash of the data which follows the header. */
+    unsigned long checksum;
+};
+
+/**
+ * Everything which loading creature model config file sets for one creature model.
+ */
+struct CreatureModelCacheEntry {
+    struct CreatureStats stats;
+    struct CreatureModelConfig model_conf;
+    /** Fields of the Creatures struct which are set from the config file. */
+    unsigned short evil_start_state;
+    unsigned short good_start_state;
+    unsigned char natural_death_kind;
+    unsigned char swipe_idx;
+    short shot_shift_x;
+    short shot_shift_y;
+    short shot_shift_z;
+    unsigned short graphics[CREATURE_GRAPHICS_INSTANCES];
+    /** Special breeds in CreatureConfig which were set to this model. */
+    unsigned char special_breeds;
+};
+
+/**
+ * Copy of everything which creature models cache entries are applied to.
+ * Used to compare models applied from the cache with models loaded from text.
+ */
+struct CreatureModelsState {
+    struct CreatureStats stats[CREATURE_TYPES_MAX];
+    struct CreatureStatsOLD stats_old[CREATURE_TYPES_COUNT];
+    struct CreatureModelConfig model_conf[CREATURE_TYPES_MAX];
+    struct Creatures creatures[CREATURE_TYPES_COUNT];
+    unsigned short graphics[CREATURE_TYPES_COUNT][CREATURE_GRAPHICS_INSTANCES];
+    ThingModel special_digger_good;
+    ThingModel special_digger_evil;
+    ThingModel spectator_breed;
+};
+
+enum CreatureModelCacheSpecialBreeds {
+    CMCSB_DiggerEvil = 0x01,
+    CMCSB_DiggerGood = 0x02,
+    CMCSB_Spectator  = 0x04,
+};
+
+/**
+ * Fields of RoomData which are set from terrain config.
+ * Update functions are stored as indexes in the functions lists.
+ */
+struct RoomDataCacheEntry {
+    short assigned_slab;
+    short medsym_sprite_idx;
+    short name_stridx;
+    short tooltip_stridx;
+    short update_total_capacity_idx;
+    short update_storage_in_room_idx;
+    short update_workers_in_room_idx;
+};
+
+/**
+ * Everything which loading terrain config sets.
+ */
+struct TerrainConfigCache {
+    struct SlabsConfig slab_conf;
+    unsigned short slab_tooltip_stridx[SLAB_TYPES_COUNT];
+    struct RoomStats room_stats[ROOM_TYPES_COUNT];
+    struct RoomDataCacheEntry room_data[ROOM_TYPES_COUNT+1];
+    unsigned short block_health[9];
+};
+
+/**
+ * Everything which loading traps and doors config sets.
+ */
+struct TrapDoorConfigCache {
+    struct TrapDoorConfig trapdoor_conf;
+    struct ManfctrConfig traps_config[TRAP_TYPES_COUNT];
+    struct ManfctrConfig doors_config[DOOR_TYPES_COUNT];
+    long door_health[DOOR_TYPES_COUNT][2];
+    ThingModel object_to_door_or_trap[OBJECT_TYPES_MAX];
+    ThingClass workshop_object_class[OBJECT_TYPES_MAX];
+};
+
+/**
+ * Fields of ShotStats which are set from magic config.
+ */
+struct ShotStatsCacheEntry {
+    short damage;
+    short speed;
+    unsigned char push_on_hit;
+};
+
+/**
+ * Everything which loading magic config sets.
+ * Pointers within MagicConfig are cleared, and stored as indexes instead.
+ */
+struct MagicConfigCache {
+    struct MagicConfig magic_conf;
+    /** Index of ShotStats of every shot model, or -1. */
+    short shot_stats_idx[MAGIC_ITEMS_MAX];
+    /** Index of the overcharge check function of every power, or -1. */
+    short overcharge_check_idx[MAGIC_ITEMS_MAX];
+    struct SpellConfig spells_config[MAGIC_TYPES_COUNT];
+    struct SpellInfo spell_info[MAGIC_TYPES_COUNT];
+    struct MagicStats keeper_power_stats[POWER_TYPES_COUNT];
+    struct ShotStatsCacheEntry shot_stats[30];
+    ThingModel object_to_power_artifact[OBJECT_TYPES_MAX];
+    ThingModel object_to_special_artifact[OBJECT_TYPES_MAX];
+};
+
+typedef void (*ConfigCache_Fill_Func)(void *data);
+typedef void (*ConfigCache_Apply_Func)(const void *data);
+
+/**
+ * Describes a config which can be loaded from cache, in place of its standard load.
+ */
+struct ConfigCacheKind {
+    /** Name used in cache file name and messages. */
+    const char *name;
+    unsigned long data_size;
+    /** Fills cache data from what is currently loaded. */
+    ConfigCache_Fill_Func fill;
+    /** Sets everything which the config load sets, from cache data. */
+    ConfigCache_Apply_Func apply;
+};
+/******************************************************************************/
+static void fill_terrain_config_cache(void *data);
+static void apply_terrain_config_cache(const void *data);
+static void fill_trapdoor_config_cache(void *data);
+static void apply_trapdoor_config_cache(const void *data);
+static void fill_magic_config_cache(void *data);
+static void apply_magic_config_cache(const void *data);
+/******************************************************************************/
+/** Config files which the cached configs depend on, through names of things used in them. */
+static const char *config_cache_source_files[] = {
+    keeper_creaturetp_file,
+    keeper_terrain_file,
+    keeper_objects_file,
+    keeper_trapdoor_file,
+    keeper_effects_file,
+    keeper_lenses_file,
+    keeper_magic_file,
+    creature_states_file,
+    keeper_rules_file,
+};
+
+static const struct ConfigCacheKind config_cache_kinds[] = {
+    {"terrain",  sizeof(struct TerrainConfigCache),  fill_terrain_config_cache,  apply_terrain_config_cache},
+    {"trapdoor", sizeof(struct TrapDoorConfigCache), fill_trapdoor_config_cache, apply_trapdoor_config_cache},
+    {"magic",    sizeof(struct MagicConfigCache),    fill_magic_config_cache,    apply_magic_config_cache},
+};
+
+/** Whether configs may be loaded from and saved into the cache. */
+TbBool config_cache_enabled = true;
+/** Amount of configs loaded from the cache; allows checking that the cache was used. */
+unsigned long config_cache_loads = 0;
+/** Key of all config caches, computed once per loading of config files. */
+static unsigned long config_cache_key = 0;
+/******************************************************************************/
+unsigned long cache_hash(unsigned long hash, const void *data, unsigned long len)
+{
+    const unsigned char *ptr;
+    unsigned long i;
+    ptr = (const unsigned char *)data;
+    for (i=0; i < len; i++)
+    {
+        hash ^= ptr[i];
+        hash = (hash * 16777619UL) & 0xffffffffUL;
+    }
+    return hash;
+}
+
+unsigned long cache_hash_long(unsigned long hash, long val)
+{
+    return cache_hash(hash, &val, sizeof(val));
+}
+
+/**
+ * Adds contents of given file to the hash. Missing files are hashed too,
+ * so that adding an optional or campaign file makes the cache invalid.
+ */
+unsigned long cache_hash_file(unsigned long hash, const char *fname)
+{
+    char *buf;
+    long len;
+    if (fname[0] == '\0') {
+        return cache_hash_long(hash, -2);
+    }
+    len = LbFileLengthRnc(fname);
+    if (len <= 0) {
+        return cache_hash_long(hash, -1);
+    }
+    buf = (char *)LbMemoryAlloc(len+256);
+    if (buf == NULL) {
+        return cache_hash_long(hash, -1);
+    }
+    len = LbFileLoadAt(fname, buf);
+    hash = cache_hash_long(hash, len);
+    if (len > 0) {
+        hash = cache_hash(hash, buf, len);
+    }
+    LbMemoryFree(buf);
+    return hash;
+}
+
+/**
+ * Starts computing a cache key. Every key includes version of the executable,
+ * as parsing may change between builds even when the cached structs stay the same.
+ * @param format_version Version of the specific cache file format.
+ */
+unsigned long cache_key_init(unsigned long format_version)
+{
+    unsigned long hash;
+    hash = 2166136261UL;
+    hash = cache_hash(hash, VER_STRING, strlen(VER_STRING));
+    hash = cache_hash_long(hash, VER_BUILD);
+    hash = cache_hash_long(hash, format_version);
+    return hash;
+}
+
+/**
+ * Gives name of current campaign, for use in cache file names.
+ * Each campaign has its own cache files, as the campaign files may replace the global ones.
+ */
+void get_cache_campaign_name(char *cmpgn_name, long cmpgn_name_len)
+{
+    char *ext;
+    if (campaign.fname[0] != '\0') {
+        LbStringCopy(cmpgn_name, campaign.fname, cmpgn_name_len);
+    } else {
+        LbStringCopy(cmpgn_name, "default", cmpgn_name_len);
+    }
+    ext = strrchr(cmpgn_name, '.');
+    if (ext != NULL) {
+        *ext = '\0';
+    }
+}
+
+/**
+ * Loads cached data from given cache file, if the file is valid for given key.
+ * @param magic Identifier of the cache kind; 4 characters.
+ * @param data_size Output variable for size of the cached data.
+ * @return Newly allocated buffer with the cached data, which needs to be freed by caller,
+ *     or NULL if the cache can't be used.
+ */
+unsigned char *load_cache_file(const char *fname, const char *magic, unsigned long version, unsigned long key, unsigned long *data_size)
+{
+    struct CacheFileHeader *hdr;
+    unsigned char *buf;
+    long len;
+    len = LbFileLength(fname);
+    if (len < (long)sizeof(struct CacheFileHeader)) {
+        SYNCDBG(7,"No valid cache \"%s\"",fname);
+        return NULL;
+    }
+    buf = (unsigned char *)LbMemoryAlloc(len);
+    if (buf == NULL) {
+        return NULL;
+    }
+    hdr = (struct CacheFileHeader *)buf;
+    if ((LbFileLoadAt(fname, buf) != len) || (memcmp(hdr->magic, magic, 4) != 0)
+      || (hdr->version != version) || (hdr->key != key))
+    {
+        SYNCDBG(7,"Cache \"%s\" is outdated",fname);
+        LbMemoryFree(buf);
+        return NULL;
+    }
+    if ((hdr->data_size != len - sizeof(struct CacheFileHeader))
+      || (hdr->checksum != cache_hash(2166136261UL, buf + sizeof(struct CacheFileHeader), hdr->data_size)))
+    {
+        WARNLOG("Cache \"%s\" is damaged",fname);
+        LbMemoryFree(buf);
+        return NULL;
+    }
+    *data_size = hdr->data_size;
+    memmove(buf, buf + sizeof(struct CacheFileHeader), hdr->data_size);
+    return buf;
+}
+
+/**
+ * Writes given data into cache file. The file is then read back and compared
+ * with the data, so that a cache which can't reproduce it is never left.
+ * @param magic Identifier of the cache kind; 4 characters.
+ * @return True if the cache was written.
+ */
+TbBool save_cache_file(const char *fname, const char *magic, unsigned long version, unsigned long key, const void *data, unsigned long data_size)
+{
+    struct CacheFileHeader *hdr;
+    unsigned char *buf;
+    unsigned long rd_size;
+    long len;
+    len = sizeof(struct CacheFileHeader) + data_size;
+    buf = (unsigned char *)LbMemoryAlloc(len);
+    if (buf == NULL)
+        return false;
+    hdr = (struct CacheFileHeader *)buf;
+    memcpy(hdr->magic, magic, 4);
+    hdr->version = version;
+    hdr->key = key;
+    hdr->data_size = data_size;
+    hdr->checksum = cache_hash(2166136261UL, data, data_size);
+    if (data_size > 0)
+        LbMemoryCopy(buf + sizeof(struct CacheFileHeader), data, data_size);
+    if (LbFileSaveAt(fname, buf, len) != len)
+    {
+        WARNLOG("Cannot write cache \"%s\"",fname);
+        LbMemoryFree(buf);
+        return false;
+    }
+    LbMemoryFree(buf);
+    buf = load_cache_file(fname, magic, version, key, &rd_size);
+    if ((buf == NULL) || (rd_size != data_size) || (memcmp(buf, data, data_size) != 0))
+    {
+        WARNLOG("Cannot read back cache \"%s\"",fname);
+        LbMemoryFree(buf);
+        LbFileDelete(fname);
+        return false;
+    }
+    LbMemoryFree(buf);
+    SYNCDBG(7,"Cache \"%s\" written",fname);
+    return true;
+}
+/******************************************************************************/
+/**
+ * Computes the key of config caches from contents of all config files which affect them.
+ * Needs to be called after the list-only pass of loading config files, as file names
+ * of creature models come from it, and before any config is loaded from the cache.
+ */
+void update_config_cache_key(void)
+{
+    char fname[DISKPATH_SIZE];
+    char conf_fnstr[COMMAND_WORD_LEN];
+    unsigned long hash;
+    long i;
+    if (!config_cache_enabled)
+        return;
+    hash = cache_key_init(CONFIG_CACHE_VERSION);
+    hash = cache_hash_long(hash, sizeof(struct CreatureModelCacheEntry));
+    hash = cache_hash_long(hash, sizeof(struct CreatureStats));
+    for (i=0; i < sizeof(config_cache_kinds)/sizeof(config_cache_kinds[0]); i++)
+    {
+        hash = cache_hash_long(hash, config_cache_kinds[i].data_size);
+    }
+    hash = cache_hash_long(hash, crtr_conf.model_count);
+    for (i=0; i < sizeof(config_cache_source_files)/sizeof(config_cache_source_files[0]); i++)
+    {
+        prepare_file_path_buf(fname, FGrp_FxData, config_cache_source_files[i]);
+        hash = cache_hash_file(hash, fname);
+        prepare_file_path_buf(fname, FGrp_CmpgConfig, config_cache_source_files[i]);
+        hash = cache_hash_file(hash, fname);
+    }
+    for (i=1; i < crtr_conf.model_count; i++)
+    {
+        LbStringToLowerCopy(conf_fnstr,get_conf_parameter_text(creature_desc,i),COMMAND_WORD_LEN);
+        hash = cache_hash(hash, conf_fnstr, strlen(conf_fnstr));
+        LbStringCopy(fname, prepare_file_fmtpath(FGrp_CrtrData,"%s.cfg",conf_fnstr), sizeof(fname));
+        hash = cache_hash_file(hash, fname);
+        LbStringCopy(fname, prepare_file_fmtpath(FGrp_CmpgCrtrs,"%s.cfg",conf_fnstr), sizeof(fname));
+        hash = cache_hash_file(hash, fname);
+    }
+    config_cache_key = hash;
+}
+
+static void config_cache_fname(char *fname, const char *cache_name)
+{
+    char cmpgn_name[DISKPATH_SIZE];
+    get_cache_campaign_name(cmpgn_name, sizeof(cmpgn_name));
+    LbStringCopy(fname, prepare_file_fmtpath(FGrp_Save, "%s_%s.cache", cache_name, cmpgn_name), DISKPATH_SIZE);
+}
+
+/**
+ * Removes all config cache files of current campaign.
+ */
+void clear_config_caches(void)
+{
+    char fname[DISKPATH_SIZE];
+    long i;
+    for (i=0; i < sizeof(config_cache_kinds)/sizeof(config_cache_kinds[0]); i++)
+    {
+        config_cache_fname(fname, config_cache_kinds[i].name);
+        LbFileDelete(fname);
+    }
+    config_cache_fname(fname, "crmodels");
+    LbFileDelete(fname);
+}
+/******************************************************************************/
+static void fill_terrain_config_cache(void *data)
+{
+    struct TerrainConfigCache *cch;
+    struct RoomDataCacheEntry *entry;
+    struct RoomData *rdata;
+    long i;
+    cch = (struct TerrainConfigCache *)data;
+    LbMemorySet(cch, 0, sizeof(struct TerrainConfigCache));
+    LbMemoryCopy(&cch->slab_conf, &slab_conf, sizeof(struct SlabsConfig));
+    for (i=0; i < SLAB_TYPES_COUNT; i++)
+    {
+        cch->slab_tooltip_stridx[i] = get_slab_kind_attrs(i)->tooltip_stridx;
+    }
+    LbMemoryCopy(cch->room_stats, game.room_stats, sizeof(cch->room_stats));
+    for (i=0; i < ROOM_TYPES_COUNT+1; i++)
+    {
+        rdata = &room_data[i];
+        entry = &cch->room_data[i];
+        entry->assigned_slab = rdata->assigned_slab;
+        entry->medsym_sprite_idx = rdata->medsym_sprite_idx;
+        entry->name_stridx = rdata->name_stridx;
+        entry->tooltip_stridx = rdata->tooltip_stridx;
+        entry->update_total_capacity_idx = get_room_total_capacity_func_index(rdata->update_total_capacity);
+        entry->update_storage_in_room_idx = get_room_used_capacity_func_index(rdata->update_storage_in_room);
+        entry->update_workers_in_room_idx = get_room_used_capacity_func_index(rdata->update_workers_in_room);
+    }
+    LbMemoryCopy(cch->block_health, game.block_health, sizeof(cch->block_health));
+}
+
+static void apply_terrain_config_cache(const void *data)
+{
+    const struct TerrainConfigCache *cch;
+    const struct RoomDataCacheEntry *entry;
+    struct RoomData *rdata;
+    long i;
+    cch = (const struct TerrainConfigCache *)data;
+    LbMemoryCopy(&slab_conf, &cch->slab_conf, sizeof(struct SlabsConfig));
+    for (i=0; i < SLAB_TYPES_COUNT; i++)
+    {
+        get_slab_kind_attrs(i)->tooltip_stridx = cch->slab_tooltip_stridx[i];
+    }
+    LbMemoryCopy(game.room_stats, cch->room_stats, sizeof(cch->room_stats));
+    for (i=0; i < ROOM_TYPES_COUNT+1; i++)
+    {
+        rdata = &room_data[i];
+        entry = &cch->room_data[i];
+        rdata->assigned_slab = entry->assigned_slab;
+        rdata->medsym_sprite_idx = entry->medsym_sprite_idx;
+        rdata->name_stridx = entry->name_stridx;
+        rdata->tooltip_stridx = entry->tooltip_stridx;
+        rdata->update_total_capacity = get_room_total_capacity_func(entry->update_total_capacity_idx);
+        rdata->update_storage_in_room = get_room_used_capacity_func(entry->update_storage_in_room_idx);
+        rdata->update_workers_in_room = get_room_used_capacity_func(entry->update_workers_in_room_idx);
+    }
+    LbMemoryCopy(game.block_health, cch->block_health, sizeof(cch->block_health));
+}
+
+static void fill_trapdoor_config_cache(void *data)
+{
+    struct TrapDoorConfigCache *cch;
+    long i;
+    cch = (struct TrapDoorConfigCache *)data;
+    LbMemorySet(cch, 0, sizeof(struct TrapDoorConfigCache));
+    LbMemoryCopy(&cch->trapdoor_conf, &trapdoor_conf, sizeof(struct TrapDoorConfig));
+    LbMemoryCopy(cch->traps_config, game.traps_config, sizeof(cch->traps_config));
+    LbMemoryCopy(cch->doors_config, game.doors_config, sizeof(cch->doors_config));
+    for (i=0; i < DOOR_TYPES_COUNT; i++)
+    {
+        cch->door_health[i][0] = door_stats[i][0].health;
+        cch->door_health[i][1] = door_stats[i][1].health;
+    }
+    LbMemoryCopy(cch->object_to_door_or_trap, object_conf.object_to_door_or_trap, sizeof(cch->object_to_door_or_trap));
+    LbMemoryCopy(cch->workshop_object_class, object_conf.workshop_object_class, sizeof(cch->workshop_object_class));
+}
+
+static void apply_trapdoor_config_cache(const void *data)
+{
+    const struct TrapDoorConfigCache *cch;
+    long i;
+    cch = (const struct TrapDoorConfigCache *)data;
+    LbMemoryCopy(&trapdoor_conf, &cch->trapdoor_conf, sizeof(struct TrapDoorConfig));
+    LbMemoryCopy(game.traps_config, cch->traps_config, sizeof(cch->traps_config));
+    LbMemoryCopy(game.doors_config, cch->doors_config, sizeof(cch->doors_config));
+    for (i=0; i < DOOR_TYPES_COUNT; i++)
+    {
+        door_stats[i][0].health = cch->door_health[i][0];
+        door_stats[i][1].health = cch->door_health[i][1];
+    }
+    LbMemoryCopy(object_conf.object_to_door_or_trap, cch->object_to_door_or_trap, sizeof(cch->object_to_door_or_trap));
+    LbMemoryCopy(object_conf.workshop_object_class, cch->workshop_object_class, sizeof(cch->workshop_object_class));
+}
+
+static void fill_magic_config_cache(void *data)
+{
+    struct MagicConfigCache *cch;
+    struct ShotConfigStats *shotst;
+    struct PowerConfigStats *powerst;
+    long i;
+    cch = (struct MagicConfigCache *)data;
+    LbMemorySet(cch, 0, sizeof(struct MagicConfigCache));
+    LbMemoryCopy(&cch->magic_conf, &magic_conf, sizeof(struct MagicConfig));
+    for (i=0; i < MAGIC_ITEMS_MAX; i++)
+    {
+        shotst = &cch->magic_conf.shot_cfgstats[i];
+        if (shotst->old != NULL)
+            cch->shot_stats_idx[i] = shotst->old - &shot_stats[0];
+        else
+            cch->shot_stats_idx[i] = -1;
+        shotst->old = NULL;
+        powerst = &cch->magic_conf.power_cfgstats[i];
+        cch->overcharge_check_idx[i] = get_power_expand_check_func_index(powerst->overcharge_check);
+        powerst->overcharge_check = NULL;
+    }
+    LbMemoryCopy(cch->spells_config, game.spells_config, sizeof(cch->spells_config));
+    LbMemoryCopy(cch->spell_info, spell_info, sizeof(cch->spell_info));
+    LbMemoryCopy(cch->keeper_power_stats, game.keeper_power_stats, sizeof(cch->keeper_power_stats));
+    for (i=0; i < sizeof(cch->shot_stats)/sizeof(cch->shot_stats[0]); i++)
+    {
+        cch->shot_stats[i].damage = shot_stats[i].damage;
+        cch->shot_stats[i].speed = shot_stats[i].speed;
+        cch->shot_stats[i].push_on_hit = shot_stats[i].push_on_hit;
+    }
+    LbMemoryCopy(cch->object_to_power_artifact, object_conf.object_to_power_artifact, sizeof(cch->object_to_power_artifact));
+    LbMemoryCopy(cch->object_to_special_artifact, object_conf.object_to_special_artifact, sizeof(cch->object_to_special_artifact));
+}
+
+static void apply_magic_config_cache(const void *data)
+{
+    const struct MagicConfigCache *cch;
+    long i,n;
+    cch = (const struct MagicConfigCache *)data;
+    LbMemoryCopy(&magic_conf, &cch->magic_conf, sizeof(struct MagicConfig));
+    for (i=0; i < MAGIC_ITEMS_MAX; i++)
+    {
+        n = cch->shot_stats_idx[i];
+        if ((n >= 0) && (n < sizeof(shot_stats)/sizeof(shot_stats[0])))
+            magic_conf.shot_cfgstats[i].old = &shot_stats[n];
+        else
+            magic_conf.shot_cfgstats[i].old = NULL;
+        magic_conf.power_cfgstats[i].overcharge_check = get_power_expand_check_func(cch->overcharge_check_idx[i]);
+    }
+    LbMemoryCopy(game.spells_config, cch->spells_config, sizeof(cch->spells_config));
+    LbMemoryCopy(spell_info, cch->spell_info, sizeof(cch->spell_info));
+    LbMemoryCopy(game.keeper_power_stats, cch->keeper_power_stats, sizeof(cch->keeper_power_stats));
+    for (i=0; i < sizeof(cch->shot_stats)/sizeof(cch->shot_stats[0]); i++)
+    {
+        shot_stats[i].damage = cch->shot_stats[i].damage;
+        shot_stats[i].speed = cch->shot_stats[i].speed;
+        shot_stats[i].push_on_hit = cch->shot_stats[i].push_on_hit;
+    }
+    LbMemoryCopy(object_conf.object_to_power_artifact, cch->object_to_power_artifact, sizeof(cch->object_to_power_artifact));
+    LbMemoryCopy(object_conf.object_to_special_artifact, cch->object_to_special_artifact, sizeof(cch->object_to_special_artifact));
+}
+
+/**
+ * Applies given cache data, and checks if that gives the same config as currently loaded.
+ * The loaded config is kept, whatever the result.
+ * @return True if the config applied from cache is identical to the loaded one.
+ */
+static TbBool config_cache_data_matches_loaded(const struct ConfigCacheKind *cckind, const void *data)
+{
+    unsigned char *loaded;
+    unsigned char *applied;
+    TbBool result;
+    loaded = (unsigned char *)LbMemoryAlloc(cckind->data_size);
+    applied = (unsigned char *)LbMemoryAlloc(cckind->data_size);
+    if ((loaded == NULL) || (applied == NULL))
+    {
+        LbMemoryFree(loaded);
+        LbMemoryFree(applied);
+        return false;
+    }
+    cckind->fill(loaded);
+    cckind->apply(data);
+    cckind->fill(applied);
+    cckind->apply(loaded);
+    result = (memcmp(loaded, applied, cckind->data_size) == 0);
+    LbMemoryFree(loaded);
+    LbMemoryFree(applied);
+    return result;
+}
+
+/**
+ * Sets given config from the cache, if it matches current config files.
+ * Needs to be called in place of the standard load of the config.
+ * @param cache_kind Config to be loaded, from ConfigCacheKinds enumeration.
+ * @return True if the config was loaded; false if it has to be loaded from text file.
+ */
+TbBool load_config_from_cache(long cache_kind)
+{
+    const struct ConfigCacheKind *cckind;
+    char fname[DISKPATH_SIZE];
+    unsigned char *buf;
+    unsigned long data_size;
+    if (!config_cache_enabled)
+        return false;
+    if ((cache_kind < 0) || (cache_kind >= sizeof(config_cache_kinds)/sizeof(config_cache_kinds[0])))
+        return false;
+    cckind = &config_cache_kinds[cache_kind];
+    config_cache_fname(fname, cckind->name);
+    buf = load_cache_file(fname, CONFIG_CACHE_MAGIC, CONFIG_CACHE_VERSION, config_cache_key, &data_size);
+    if (buf == NULL)
+        return false;
+    if (data_size != cckind->data_size)
+    {
+        WARNLOG("Config cache \"%s\" has wrong size",fname);
+        LbMemoryFree(buf);
+        return false;
+    }
+    cckind->apply(buf);
+    LbMemoryFree(buf);
+    config_cache_loads++;
+    SYNCDBG(3,"Config %s loaded from cache \"%s\"",cckind->name,fname);
+    return true;
+}
+
+/**
+ * Writes given config, as loaded from text file, into the cache.
+ * The cache data is first applied, and the result is compared with the loaded config,
+ * so that a cache which can't reproduce the config is never left.
+ * @param cache_kind Config to be saved, from ConfigCacheKinds enumeration.
+ */
+TbBool save_config_cache(long cache_kind)
+{
+    const struct ConfigCacheKind *cckind;
+    char fname[DISKPATH_SIZE];
+    unsigned char *data;
+    TbBool result;
+    if (!config_cache_enabled)
+        return false;
+    if ((cache_kind < 0) || (cache_kind >= sizeof(config_cache_kinds)/sizeof(config_cache_kinds[0])))
+        return false;
+    cckind = &config_cache_kinds[cache_kind];
+    config_cache_fname(fname, cckind->name);
+    data = (unsigned char *)LbMemoryAlloc(cckind->data_size);
+    if (data == NULL)
+        return false;
+    cckind->fill(data);
+    if (!config_cache_data_matches_loaded(cckind, data))
+    {
+        ERRORLOG("Config %s from cache differs from text config; cache \"%s\" removed",cckind->name,fname);
+        LbMemoryFree(data);
+        LbFileDelete(fname);
+        return false;
+    }
+    result = save_cache_file(fname, CONFIG_CACHE_MAGIC, CONFIG_CACHE_VERSION, config_cache_key, data, cckind->data_size);
+    LbMemoryFree(data);
+    return result;
+}
+/******************************************************************************/
+static void fill_creaturemodel_cache_entry(struct CreatureModelCacheEntry *entry, ThingModel crmodel)
+{
+    long n;
+    LbMemorySet(entry, 0, sizeof(struct CreatureModelCacheEntry));
+    LbMemoryCopy(&entry->stats, creature_stats_get(crmodel), sizeof(struct CreatureStats));
+    LbMemoryCopy(&entry->model_conf, &crtr_conf.model[crmodel], sizeof(struct CreatureModelConfig));
+    entry->evil_start_state = creatures[crmodel].evil_start_state;
+    entry->good_start_state = creatures[crmodel].good_start_state;
+    entry->natural_death_kind = creatures[crmodel].natural_death_kind;
+    entry->swipe_idx = creatures[crmodel].swipe_idx;
+    entry->shot_shift_x = creatures[crmodel].shot_shift_x;
+    entry->shot_shift_y = creatures[crmodel].shot_shift_y;
+    entry->shot_shift_z = creatures[crmodel].shot_shift_z;
+    for (n=0; n < CREATURE_GRAPHICS_INSTANCES; n++) {
+        entry->graphics[n] = get_creature_model_graphics(crmodel, n);
+    }
+    // Special breeds are cleared by creature types config, and then set by the models
+    if (crtr_conf.special_digger_evil == crmodel)
+        entry->special_breeds |= CMCSB_DiggerEvil;
+    if (crtr_conf.special_digger_good == crmodel)
+        entry->special_breeds |= CMCSB_DiggerGood;
+    if (crtr_conf.spectator_breed == crmodel)
+        entry->special_breeds |= CMCSB_Spectator;
+}
+
+static void apply_creaturemodel_cache_entry(const struct CreatureModelCacheEntry *entry, ThingModel crmodel)
+{
+    long n;
+    LbMemoryCopy(creature_stats_get(crmodel), &entry->stats, sizeof(struct CreatureStats));
+    LbMemoryCopy(&crtr_conf.model[crmodel], &entry->model_conf, sizeof(struct CreatureModelConfig));
+    creatures[crmodel].evil_start_state = entry->evil_start_state;
+    creatures[crmodel].good_start_state = entry->good_start_state;
+    creatures[crmodel].natural_death_kind = entry->natural_death_kind;
+    creatures[crmodel].swipe_idx = entry->swipe_idx;
+    creatures[crmodel].shot_shift_x = entry->shot_shift_x;
+    creatures[crmodel].shot_shift_y = entry->shot_shift_y;
+    creatures[crmodel].shot_shift_z = entry->shot_shift_z;
+    for (n=0; n < CREATURE_GRAPHICS_INSTANCES; n++) {
+        set_creature_model_graphics(crmodel, n, entry->graphics[n]);
+    }
+    if ((entry->special_breeds & CMCSB_DiggerEvil) != 0)
+        crtr_conf.special_digger_evil = crmodel;
+    if ((entry->special_breeds & CMCSB_DiggerGood) != 0)
+        crtr_conf.special_digger_good = crmodel;
+    if ((entry->special_breeds & CMCSB_Spectator) != 0)
+        crtr_conf.spectator_breed = crmodel;
+    // Same as after loading the model from text file
+    creature_stats_updated(crmodel);
+}
+
+static void store_creaturemodels_state(struct CreatureModelsState *state)
+{
+    long crmodel,n;
+    LbMemorySet(state, 0, sizeof(struct CreatureModelsState));
+    LbMemoryCopy(state->stats, gameadd.creature_stats, sizeof(state->stats));
+    LbMemoryCopy(state->stats_old, game.creature_stats_OLD, sizeof(state->stats_old));
+    LbMemoryCopy(state->model_conf, crtr_conf.model, sizeof(state->model_conf));
+    LbMemoryCopy(state->creatures, creatures, sizeof(state->creatures));
+    for (crmodel=0; crmodel < CREATURE_TYPES_COUNT; crmodel++)
+    {
+        for (n=0; n < CREATURE_GRAPHICS_INSTANCES; n++) {
+            state->graphics[crmodel][n] = get_creature_model_graphics(crmodel, n);
+        }
+    }
+    state->special_digger_good = crtr_conf.special_digger_good;
+    state->special_digger_evil = crtr_conf.special_digger_evil;
+    state->spectator_breed = crtr_conf.spectator_breed;
+}
+
+static void restore_creaturemodels_state(const struct CreatureModelsState *state)
+{
+    long crmodel,n;
+    LbMemoryCopy(gameadd.creature_stats, state->stats, sizeof(state->stats));
+    LbMemoryCopy(game.creature_stats_OLD, state->stats_old, sizeof(state->stats_old));
+    LbMemoryCopy(crtr_conf.model, state->model_conf, sizeof(state->model_conf));
+    LbMemoryCopy(creatures, state->creatures, sizeof(state->creatures));
+    for (crmodel=0; crmodel < CREATURE_TYPES_COUNT; crmodel++)
+    {
+        for (n=0; n < CREATURE_GRAPHICS_INSTANCES; n++) {
+            set_creature_model_graphics(crmodel, n, state->graphics[crmodel][n]);
+        }
+    }
+    crtr_conf.special_digger_good = state->special_digger_good;
+    crtr_conf.special_digger_evil = state->special_digger_evil;
+    crtr_conf.spectator_breed = state->spectator_breed;
+}
+
+/**
+ * Applies given cache entries, and checks if that gives the same creature models as currently loaded.
+ * The loaded models are kept, whatever the result.
+ * @return True if the models applied from cache are identical to the loaded ones.
+ */
+static TbBool creaturemodel_cache_entries_match_loaded(const struct CreatureModelCacheEntry *entries)
+{
+    struct CreatureModelsState *loaded;
+    struct CreatureModelsState *applied;
+    TbBool result;
+    long i;
+    loaded = (struct CreatureModelsState *)LbMemoryAlloc(sizeof(struct CreatureModelsState));
+    applied = (struct CreatureModelsState *)LbMemoryAlloc(sizeof(struct CreatureModelsState));
+    if ((loaded == NULL) || (applied == NULL))
+    {
+        LbMemoryFree(loaded);
+        LbMemoryFree(applied);
+        return false;
+    }
+    store_creaturemodels_state(loaded);
+    for (i=1; i < crtr_conf.model_count; i++)
+    {
+        apply_creaturemodel_cache_entry(&entries[i-1], i);
+    }
+    store_creaturemodels_state(applied);
+    restore_creaturemodels_state(loaded);
+    result = (memcmp(loaded, applied, sizeof(struct CreatureModelsState)) == 0);
+    LbMemoryFree(loaded);
+    LbMemoryFree(applied);
+    return result;
+}
+
+/**
+ * Sets creature models from the cache, if it matches current config files.
+ * Needs to be called after all other config files are loaded, in place of loading
+ * config files of every creature model.
+ * @return True if the creature models were loaded; false if they have to be loaded from text files.
+ */
+TbBool load_creaturemodel_configs_from_cache(void)
+{
+    struct CreatureModelCacheEntry *entries;
+    char fname[DISKPATH_SIZE];
+    unsigned char *buf;
+    unsigned long data_size;
+    long i;
+    if ((!config_cache_enabled) || (crtr_conf.model_count <= 1))
+        return false;
+    config_cache_fname(fname, "crmodels");
+    buf = load_cache_file(fname, CONFIG_CACHE_MAGIC, CONFIG_CACHE_VERSION, config_cache_key, &data_size);
+    if (buf == NULL)
+        return false;
+    if (data_size != (crtr_conf.model_count-1) * sizeof(struct CreatureModelCacheEntry))
+    {
+        WARNLOG("Creature models cache \"%s\" has wrong size",fname);
+        LbMemoryFree(buf);
+        return false;
+    }
+    entries = (struct CreatureModelCacheEntry *)buf;
+    for (i=1; i < crtr_conf.model_count; i++)
+    {
+        apply_creaturemodel_cache_entry(&entries[i-1], i);
+    }
+    LbMemoryFree(buf);
+    config_cache_loads++;
+    SYNCMSG("Creature models loaded from cache \"%s\"",fname);
+    return true;
+}
+
+/**
+ * Writes creature models, as loaded from text files, into the cache.
+ * The entries are first applied, and the result is compared with the loaded models,
+ * so that a cache which can't reproduce the models is never left.
+ */
+TbBool save_creaturemodel_configs_cache(void)
+{
+    struct CreatureModelCacheEntry *entries;
+    char fname[DISKPATH_SIZE];
+    unsigned long data_size;
+    TbBool result;
+    long i;
+    if ((!config_cache_enabled) || (crtr_conf.model_count <= 1))
+        return false;
+    config_cache_fname(fname, "crmodels");
+    data_size = (crtr_conf.model_count-1) * sizeof(struct CreatureModelCacheEntry);
+    entries = (struct CreatureModelCacheEntry *)LbMemoryAlloc(data_size);
+    if (entries == NULL)
+        return false;
+    for (i=1; i < crtr_conf.model_count; i++)
+    {
+        fill_creaturemodel_cache_entry(&entries[i-1], i);
+    }
+    if (!creaturemodel_cache_entries_match_loaded(entries))
+    {
+        ERRORLOG("Creature models from cache differ from text config; cache \"%s\" removed",fname);
+        LbMemoryFree(entries);
+        LbFileDelete(fname);
+        return false;
+    }
+    result = save_cache_file(fname, CONFIG_CACHE_MAGIC, CONFIG_CACHE_VERSION, config_cache_key, entries, data_size);
+    LbMemoryFree(entries);
+    return result;
+}
+/******************************************************************************/
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,60 @@
+/******************************************************************************/
+// Free implementation of Bullfrog's Dungeon Keeper strategy game.
+/******************************************************************************/
+/** @file config_cache.h
+ *     Header file for config_cache.c.
+ * @par Purpose:
+ *     Binary caches of parsed config and level files.
+ * @par Comment:
+ *     Just a header file - #defines, typedefs, function prototypes etc.
+ * @author   KeeperFX Team
+ * @date     19 Oct 2026 - 19 Oct 2026
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+/******************************************************************************/
+#ifndef DK_CFGCACHE_H
+#define DK_CFGCACHE_H
+
+#include "globals.h"
+#include "bflib_basics.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/******************************************************************************/
+/** Version of the config cache files format; needs to be increased when cached structs change. */
+#define CONFIG_CACHE_VERSION 2
+/******************************************************************************/
+/** Configs which can be loaded from cache in place of their text files. */
+enum ConfigCacheKinds {
+    CfgCch_Terrain = 0,
+    CfgCch_TrapDoor,
+    CfgCch_Magic,
+};
+/******************************************************************************/
+extern TbBool config_cache_enabled;
+extern unsigned long config_cache_loads;
+/******************************************************************************/
+unsigned long cache_hash(unsigned long hash, const void *data, unsigned long len);
+unsigned long cache_hash_long(unsigned long hash, long val);
+unsigned long cache_hash_file(unsigned long hash, const char *fname);
+unsigned long cache_key_init(unsigned long format_version);
+void get_cache_campaign_name(char *cmpgn_name, long cmpgn_name_len);
+unsigned char *load_cache_file(const char *fname, const char *magic, unsigned long version, unsigned long key, unsigned long *data_size);
+TbBool save_cache_file(const char *fname, const char *magic, unsigned long version, unsigned long key, const void *data, unsigned long data_size);
+
+void update_config_cache_key(void);
+void clear_config_caches(void);
+TbBool load_config_from_cache(long cache_kind);
+TbBool save_config_cache(long cache_kind);
+TbBool load_creaturemodel_configs_from_cache(void);
+TbBool save_creaturemodel_configs_cache(void);
+/******************************************************************************/
+#ifdef __cplusplus
+}
+#endif
+#endif
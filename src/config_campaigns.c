@@ -1026,6 +1026,7 @@ TbBool load_campaign(const char *cmpgn_fname,struct GameCampaign *campgn,unsigne
           WARNMSG("Parsing campaign file \"%s\" map blocks failed.",cmpgn_fname);
     }
     //Freeing and exiting
+    clear_conf_blocks_index(buf);
     LbMemoryFree(buf);
     if ((flags & CnfLd_ListOnly) == 0)
     {
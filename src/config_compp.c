@@ -1143,6 +1143,7 @@ TbBool load_computer_player_config(unsigned short flags)
         parse_computer_player_computer_blocks(buf, len, textname, flags);
     }
     //Freeing and exiting
+    clear_conf_blocks_index(buf);
     LbMemoryFree(buf);
     // Hack to synchronize local structure with the one inside DLL.
     // Remove when it's not needed anymore.
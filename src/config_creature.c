@@ -1593,6 +1593,7 @@ TbBool load_creaturetypes_config_file(const char *textname, const char *fname, u
           WARNMSG("Parsing %s file \"%s\" attackpref blocks failed.",textname,fname);
     }
     //Freeing and exiting
+    clear_conf_blocks_index(buf);
     LbMemoryFree(buf);
     return result;
 }
@@ -2180,6 +2180,7 @@ TbBool load_creaturemodel_config_file(long crtr_model,const char *textname,const
     // Mark the fact that stats were updated
     creature_stats_updated(crtr_model);
     // Freeing and exiting
+    clear_conf_blocks_index(buf);
     LbMemoryFree(buf);
     return result;
 }
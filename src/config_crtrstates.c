@@ -241,6 +241,7 @@ TbBool load_creaturestates_config_file(const char *textname, const char *fname,
           WARNMSG("Parsing %s file \"%s\" state blocks failed.",textname,fname);
     }
     //Freeing and exiting
+    clear_conf_blocks_index(buf);
     LbMemoryFree(buf);
     return result;
 }
@@ -291,6 +291,7 @@ TbBool load_cubes_config_file(const char *textname, const char *fname, unsigned
             WARNMSG("Parsing %s file \"%s\" cube blocks failed.",textname,fname);
     }
     //Freeing and exiting
+    clear_conf_blocks_index(buf);
     LbMemoryFree(buf);
     return result;
 }
@@ -423,6 +424,7 @@ long load_cube_file(void)
         result = true;
     }
     //Freeing and exiting
+    clear_conf_blocks_index(buf);
     LbMemoryFree(buf);
     return result;
 }
@@ -353,6 +353,7 @@ TbBool load_effects_config_file(const char *textname, const char *fname, unsigne
             WARNMSG("Parsing %s file \"%s\" effect blocks failed.",textname,fname);
     }
     //Freeing and exiting
+    clear_conf_blocks_index(buf);
     LbMemoryFree(buf);
     SYNCDBG(19,"Done");
     return result;
@@ -349,6 +349,7 @@ TbBool load_lenses_config_file(const char *textname, const char *fname, unsigned
             WARNMSG("Parsing Lenses file \"%s\" data blocks failed.",fname);
     }
     //Freeing and exiting
+    clear_conf_blocks_index(buf);
     LbMemoryFree(buf);
     return result;
 }
@@ -287,6 +287,29 @@ struct MagicStats *get_power_dynamic_stats(PowerKind pwkind)
     return &game.keeper_power_stats[pwkind];
 }
 
+/**
+ * Returns index of given function in the power expand check functions list.
+ * Used to store the function in a file, where pointers can't be kept.
+ * @return The index, or -1 if the function isn't on the list.
+ */
+int get_power_expand_check_func_index(Expand_Check_Func func)
+{
+    int i;
+    for (i=0; i < sizeof(powermodel_expand_check_func_list)/sizeof(powermodel_expand_check_func_list[0]); i++)
+    {
+        if (powermodel_expand_check_func_list[i] == func)
+            return i;
+    }
+    return -1;
+}
+
+Expand_Check_Func get_power_expand_check_func(int func_idx)
+{
+    if ((func_idx < 0) || (func_idx >= sizeof(powermodel_expand_check_func_list)/sizeof(powermodel_expand_check_func_list[0])))
+        return NULL;
+    return powermodel_expand_check_func_list[func_idx];
+}
+
 TbBool power_is_instinctive(int pwkind)
 {
     const struct PowerConfigStats *powerst;
@@ -1412,6 +1435,7 @@ TbBool load_magic_config_file(const char *textname, const char *fname, unsigned
           WARNMSG("Parsing %s file \"%s\" special blocks failed.",textname,fname);
     }
     //Freeing and exiting
+    clear_conf_blocks_index(buf);
     LbMemoryFree(buf);
     return result;
 }
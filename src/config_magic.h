@@ -415,6 +415,8 @@ struct ShotConfigStats *get_shot_model_stats(ThingModel tngmodel);
 struct PowerConfigStats *get_power_model_stats(PowerKind pwmodel);
 TbBool power_model_stats_invalid(const struct PowerConfigStats *powerst);
 struct MagicStats *get_power_dynamic_stats(PowerKind pwkind);
+int get_power_expand_check_func_index(Expand_Check_Func func);
+Expand_Check_Func get_power_expand_check_func(int func_idx);
 struct SpecialConfigStats *get_special_model_stats(SpecialKind spckind);
 const char *spell_code_name(SpellKind spmodel);
 const char *shot_code_name(ThingModel tngmodel);
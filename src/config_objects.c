@@ -378,6 +378,7 @@ TbBool load_objects_config_file(const char *textname, const char *fname, unsigne
             WARNMSG("Parsing %s file \"%s\" object blocks failed.",textname,fname);
     }
     //Freeing and exiting
+    clear_conf_blocks_index(buf);
     LbMemoryFree(buf);
     return result;
 }
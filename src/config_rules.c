@@ -85,6 +85,7 @@ const struct NamedCommand rules_computer_commands[] = {
   {"CHECKEXPANDTIME",            3},
   {"MAXDISTANCETODIG",           4},
   {"WAITAFTERROOMAREA",          5},
+  {"CHECKSPERTURN",              6},
   {NULL,                         0},
   };
 
@@ -656,6 +657,7 @@ TbBool parse_rules_computer_blocks(char *buf, long len, const char *config_textn
         game.check_expand_time = 1000;
         game.max_distance_to_dig = 96;
         game.wait_after_room_area = 200;
+        gameadd.computer_checks_per_turn = 0;
     }
     // Find the block
     sprintf(block_buf,"computer");
@@ -732,6 +734,22 @@ TbBool parse_rules_computer_blocks(char *buf, long len, const char *config_textn
                   COMMAND_TEXT(cmd_num),block_buf,config_textname);
             }
             break;
+        case 6: // CHECKSPERTURN
+            if (get_conf_parameter_single(buf,&pos,len,word_buf,sizeof(word_buf)) > 0)
+            {
+              k = atoi(word_buf);
+              if ((k >= 0) && (k <= 255))
+              {
+                  gameadd.computer_checks_per_turn = k;
+                  n++;
+              }
+            }
+            if (n < 1)
+            {
+              CONFWRNLOG("Incorrect value of \"%s\" parameter in [%s] block of %s file.",
+                  COMMAND_TEXT(cmd_num),block_buf,config_textname);
+            }
+            break;
         case 0: // comment
             break;
         case -1: // end of buffer
@@ -2149,6 +2167,7 @@ TbBool load_rules_config_file(const char *textname, const char *fname, unsigned
             WARNMSG("Parsing %s file \"%s\" sacrifices blocks failed.",textname,fname);
     }
     //Freeing and exiting
+    clear_conf_blocks_index(buf);
     LbMemoryFree(buf);
     return result;
 }
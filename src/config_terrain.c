@@ -263,6 +263,52 @@ struct SlabAttr *get_slab_attrs(const struct SlabMap *slb)
     return get_slab_kind_attrs(slb->kind);
 }
 
+/**
+ * Returns index of given function in the room total capacity functions list.
+ * Used to store the function in a file, where pointers can't be kept.
+ * @return The index, or -1 if the function isn't on the list.
+ */
+int get_room_total_capacity_func_index(Room_Update_Func func)
+{
+    int i;
+    for (i=0; i < sizeof(terrain_room_total_capacity_func_list)/sizeof(terrain_room_total_capacity_func_list[0]); i++)
+    {
+        if (terrain_room_total_capacity_func_list[i] == func)
+            return i;
+    }
+    return -1;
+}
+
+Room_Update_Func get_room_total_capacity_func(int func_idx)
+{
+    if ((func_idx < 0) || (func_idx >= sizeof(terrain_room_total_capacity_func_list)/sizeof(terrain_room_total_capacity_func_list[0])))
+        return NULL;
+    return terrain_room_total_capacity_func_list[func_idx];
+}
+
+/**
+ * Returns index of given function in the room used capacity functions list.
+ * Used to store the function in a file, where pointers can't be kept.
+ * @return The index, or -1 if the function isn't on the list.
+ */
+int get_room_used_capacity_func_index(Room_Update_Func func)
+{
+    int i;
+    for (i=0; i < sizeof(terrain_room_used_capacity_func_list)/sizeof(terrain_room_used_capacity_func_list[0]); i++)
+    {
+        if (terrain_room_used_capacity_func_list[i] == func)
+            return i;
+    }
+    return -1;
+}
+
+Room_Update_Func get_room_used_capacity_func(int func_idx)
+{
+    if ((func_idx < 0) || (func_idx >= sizeof(terrain_room_used_capacity_func_list)/sizeof(terrain_room_used_capacity_func_list[0])))
+        return NULL;
+    return terrain_room_used_capacity_func_list[func_idx];
+}
+
 struct SlabConfigStats *get_slab_kind_stats(SlabKind slab_kind)
 {
     if ((slab_kind < 0) || (slab_kind >= slab_conf.slab_types_count))
@@ -989,6 +1035,7 @@ TbBool load_terrain_config_file(const char *textname, const char *fname, unsigne
             WARNMSG("Parsing %s file \"%s\" room blocks failed.",textname,fname);
     }
     //Freeing and exiting
+    clear_conf_blocks_index(buf);
     LbMemoryFree(buf);
     return result;
 }
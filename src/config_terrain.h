@@ -23,6 +23,7 @@
 #include "bflib_basics.h"
 
 #include "config.h"
+#include "room_data.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -161,6 +162,10 @@ struct SlabAttr *get_slab_kind_attrs(SlabKind slab_kind);
 struct SlabAttr *get_slab_attrs(const struct SlabMap *slb);
 struct SlabConfigStats *get_slab_kind_stats(SlabKind slab_kind);
 struct SlabConfigStats *get_slab_stats(struct SlabMap *slb);
+int get_room_total_capacity_func_index(Room_Update_Func func);
+Room_Update_Func get_room_total_capacity_func(int func_idx);
+int get_room_used_capacity_func_index(Room_Update_Func func);
+Room_Update_Func get_room_used_capacity_func(int func_idx);
 const char *room_role_code_name(RoomRole rrole);
 const char *room_code_name(RoomKind rkind);
 const char *slab_code_name(SlabKind slbkind);
@@ -618,6 +618,7 @@ long instf_dig(struct Thing *creatng, long *param)
         }
     }
     check_map_explored(creatng, stl_x, stl_y);
+    imp_stack_slab_changed(subtile_slab_fast(stl_x), subtile_slab_fast(stl_y));
     thing_play_sample(creatng, 72 + UNSYNC_RANDOM(3), NORMAL_PITCH, 0, 3, 0, 4, FULL_LOUDNESS);
     return 1;
 }
@@ -675,6 +676,7 @@ long instf_destroy(struct Thing *creatng, long *param)
     neutralise_enemy_block(creatng->mappos.x.stl.num, creatng->mappos.y.stl.num, creatng->owner);
     remove_traps_around_subtile(slab_subtile_center(slb_x), slab_subtile_center(slb_y), NULL);
     switch_owned_objects_on_destoyed_slab_to_neutral(slb_x, slb_y, prev_owner);
+    imp_stack_slab_changed(slb_x, slb_y);
     dungeon->lvstats.territory_destroyed++;
     return 1;
 }
@@ -802,6 +804,7 @@ long instf_pretty_path(struct Thing *creatng, long *param)
     increase_dungeon_area(creatng->owner, 1);
     dungeon->lvstats.area_claimed++;
     remove_traps_around_subtile(slab_subtile_center(slb_x), slab_subtile_center(slb_y), NULL);
+    imp_stack_slab_changed(slb_x, slb_y);
     return 1;
 }
 
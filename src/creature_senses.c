@@ -20,6 +20,7 @@
 #include "globals.h"
 
 #include "bflib_math.h"
+#include "bflib_memory.h"
 #include "bflib_planar.h"
 #include "creature_states.h"
 #include "thing_list.h"
@@ -36,6 +37,70 @@
 /******************************************************************************/
 DLLIMPORT unsigned char _DK_line_of_sight_2d(const struct Coord3d *pos1, const struct Coord3d *pos2);
 /******************************************************************************/
+/** Amount of entries in creature sight cache; needs to be a power of 2. */
+#define SIGHT_CACHE_SIZE 2048
+/** Size of map regions in which changes are tracked for sight cache, in subtiles. */
+#define SIGHT_CACHE_REGION_SIZE 8
+#define SIGHT_CACHE_REGIONS_ROW (256/SIGHT_CACHE_REGION_SIZE)
+
+/** Kinds of rays which creature sight checks cast; each kind checks the map in a different way. */
+enum SightRayKinds {
+    SRK_None = 0,
+    SRK_Plain,
+    SRK_IgnoringSpecificDoor,
+    SRK_LavaIgnoringSpecificDoor,
+    SRK_LavaIgnoringOwnDoor,
+};
+
+struct SightCacheEntry {
+    GameTurn turn;
+    unsigned short frpos_x;
+    unsigned short frpos_y;
+    unsigned short frpos_z;
+    unsigned short topos_x;
+    unsigned short topos_y;
+    unsigned short topos_z;
+    /** Door thing index or player index, depending on ray kind. */
+    long param;
+    unsigned char kind;
+    unsigned char result;
+    /** Map change stamp at the time the entry was stored. */
+    unsigned long change_stamp;
+    /** Area of subtiles which were checked to get the result. */
+    unsigned short stl_min_x;
+    unsigned short stl_min_y;
+    unsigned short stl_max_x;
+    unsigned short stl_max_y;
+};
+
+/**
+ * Results of rays cast by creature sight checks during the current game turn.
+ * Entries are exact - the whole coordinates of ray ends are compared, so using
+ * the cache doesn't change any result. Entries are dropped when the map is
+ * modified under them, and all entries expire when the turn ends.
+ * Map changes don't visit the entries; every change increases the change stamp
+ * and stores it in map regions it touches, and an entry is checked against
+ * stamps of regions in its area when it is looked up.
+ */
+struct SightCache {
+    struct SightCacheEntry entries[SIGHT_CACHE_SIZE];
+    /** Turn at which the most recent entry was stored. */
+    GameTurn turn;
+    /** Amount of entries stored during that turn. */
+    unsigned long turn_entries;
+    /** Stamp of the most recent map change. */
+    unsigned long change_stamp;
+    /** Stamp of the most recent change within every map region. */
+    unsigned long region_stamps[SIGHT_CACHE_REGIONS_ROW*SIGHT_CACHE_REGIONS_ROW];
+    unsigned long lookups;
+    unsigned long hits;
+    /** Amount of subtiles which didn't have to be walked through thanks to the hits. */
+    unsigned long steps_saved;
+    unsigned long entries_invalidated;
+};
+/******************************************************************************/
+static struct SightCache sight_cache;
+/******************************************************************************/
 TbBool sibling_line_of_sight_ignoring_door(const struct Coord3d *prevpos,
     const struct Coord3d *nextpos, const struct Thing *doortng)
 {
@@ -192,6 +257,10 @@ TbBool line_of_sight_3d_ignoring_specific_door(const struct Coord3d *frpos,
         }
         distance = abs(maxdim2 - maxdim1);
     }
+    // Most rays only cross open slabs; these don't have to be walked through
+    if (map_ray_is_surely_clear(frpos, increase_x, increase_y, increase_z, distance)) {
+        return true;
+    }
     // Go through the distance with given increases
     struct Coord3d prevpos;
     struct Coord3d nextpos;
@@ -368,6 +437,10 @@ TbBool jonty_line_of_sight_3d_including_lava_check_ignoring_specific_door(const
         }
         distance = abs(maxdim2 - maxdim1);
     }
+    // Most rays only cross open slabs; these don't have to be walked through
+    if (map_ray_is_surely_clear(frpos, increase_x, increase_y, increase_z, distance)) {
+        return true;
+    }
     // Go through the distance with given increases
     struct Coord3d prevpos;
     struct Coord3d nextpos;
@@ -544,6 +617,10 @@ TbBool jonty_line_of_sight_3d_including_lava_check_ignoring_own_door(const struc
         }
         distance = abs(maxdim2 - maxdim1);
     }
+    // Most rays only cross open slabs; these don't have to be walked through
+    if (map_ray_is_surely_clear(frpos, increase_x, increase_y, increase_z, distance)) {
+        return true;
+    }
     // Go through the distance with given increases
     struct Coord3d prevpos;
     struct Coord3d nextpos;
@@ -580,6 +657,168 @@ TbBool jonty_line_of_sight_3d_including_lava_check_ignoring_own_door(const struc
     return true;
 }
 
+static unsigned long sight_cache_hash(const struct Coord3d *frpos, const struct Coord3d *topos, unsigned char kind, long param)
+{
+    unsigned long key;
+    key = kind * 0x9E3779B1u;
+    key = (key ^ frpos->x.val) * 0x01000193u;
+    key = (key ^ frpos->y.val) * 0x01000193u;
+    key = (key ^ frpos->z.val) * 0x01000193u;
+    key = (key ^ topos->x.val) * 0x01000193u;
+    key = (key ^ topos->y.val) * 0x01000193u;
+    key = (key ^ topos->z.val) * 0x01000193u;
+    key = (key ^ (unsigned long)param) * 0x01000193u;
+    return (key ^ (key >> 15)) & (SIGHT_CACHE_SIZE-1);
+}
+
+static long sight_cache_region_coord(MapSubtlCoord stl_v)
+{
+    if (stl_v >= SIGHT_CACHE_REGIONS_ROW*SIGHT_CACHE_REGION_SIZE)
+        return SIGHT_CACHE_REGIONS_ROW-1;
+    return stl_v / SIGHT_CACHE_REGION_SIZE;
+}
+
+static TbBool sight_cache_entry_matches(const struct SightCacheEntry *sce, const struct Coord3d *frpos,
+    const struct Coord3d *topos, unsigned char kind, long param)
+{
+    return (sce->kind == kind) && (sce->turn == game.play_gameturn) && (sce->param == param)
+        && (sce->frpos_x == frpos->x.val) && (sce->frpos_y == frpos->y.val) && (sce->frpos_z == frpos->z.val)
+        && (sce->topos_x == topos->x.val) && (sce->topos_y == topos->y.val) && (sce->topos_z == topos->z.val);
+}
+
+/**
+ * Checks whether the map within area of given entry has changed since the entry was stored.
+ */
+static TbBool sight_cache_entry_outdated(const struct SightCacheEntry *sce)
+{
+    long reg_x,reg_y,reg_sx,reg_ex,reg_ey;
+    if (sce->change_stamp == sight_cache.change_stamp)
+        return false;
+    reg_sx = sight_cache_region_coord(sce->stl_min_x);
+    reg_ex = sight_cache_region_coord(sce->stl_max_x);
+    reg_ey = sight_cache_region_coord(sce->stl_max_y);
+    for (reg_y = sight_cache_region_coord(sce->stl_min_y); reg_y <= reg_ey; reg_y++)
+    {
+        for (reg_x = reg_sx; reg_x <= reg_ex; reg_x++)
+        {
+            if (sight_cache.region_stamps[reg_y*SIGHT_CACHE_REGIONS_ROW + reg_x] > sce->change_stamp)
+                return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Casts a ray of given kind, or gets its result from the sight cache.
+ * @param kind Kind of the ray, one of SightRayKinds.
+ * @param doortng The door to be ignored, for kinds which require it.
+ * @param plyr_idx Player whose doors are ignored, for kinds which require it.
+ */
+static TbBool creature_sight_ray(unsigned char kind, const struct Coord3d *frpos, const struct Coord3d *topos,
+    const struct Thing *doortng, PlayerNumber plyr_idx)
+{
+    struct SightCacheEntry *sce;
+    long param;
+    TbBool result;
+    if ((kind == SRK_IgnoringSpecificDoor) || (kind == SRK_LavaIgnoringSpecificDoor))
+        param = doortng->index;
+    else
+    if (kind == SRK_LavaIgnoringOwnDoor)
+        param = plyr_idx;
+    else
+        param = 0;
+    sight_cache.lookups++;
+    sce = &sight_cache.entries[sight_cache_hash(frpos, topos, kind, param)];
+    if (sight_cache_entry_matches(sce, frpos, topos, kind, param))
+    {
+        if (!sight_cache_entry_outdated(sce))
+        {
+            sight_cache.hits++;
+            sight_cache.steps_saved += max(abs(topos->x.stl.num - (MapSubtlDelta)frpos->x.stl.num),
+                abs(topos->y.stl.num - (MapSubtlDelta)frpos->y.stl.num));
+            return sce->result;
+        }
+        sight_cache.entries_invalidated++;
+    }
+    switch (kind)
+    {
+    case SRK_IgnoringSpecificDoor:
+        result = line_of_sight_3d_ignoring_specific_door(frpos, topos, doortng);
+        break;
+    case SRK_LavaIgnoringSpecificDoor:
+        result = jonty_line_of_sight_3d_including_lava_check_ignoring_specific_door(frpos, topos, doortng);
+        break;
+    case SRK_LavaIgnoringOwnDoor:
+        result = jonty_line_of_sight_3d_including_lava_check_ignoring_own_door(frpos, topos, plyr_idx);
+        break;
+    case SRK_Plain:
+    default:
+        result = line_of_sight_3d(frpos, topos);
+        break;
+    }
+    sce->turn = game.play_gameturn;
+    sce->frpos_x = frpos->x.val;
+    sce->frpos_y = frpos->y.val;
+    sce->frpos_z = frpos->z.val;
+    sce->topos_x = topos->x.val;
+    sce->topos_y = topos->y.val;
+    sce->topos_z = topos->z.val;
+    sce->param = param;
+    sce->kind = kind;
+    sce->result = result;
+    sce->change_stamp = sight_cache.change_stamp;
+    // Sibling checks may reach the slab center next to the ray, so include a margin
+    sce->stl_min_x = max((long)min(frpos->x.stl.num, topos->x.stl.num) - STL_PER_SLB, 0);
+    sce->stl_min_y = max((long)min(frpos->y.stl.num, topos->y.stl.num) - STL_PER_SLB, 0);
+    sce->stl_max_x = max(frpos->x.stl.num, topos->x.stl.num) + STL_PER_SLB;
+    sce->stl_max_y = max(frpos->y.stl.num, topos->y.stl.num) + STL_PER_SLB;
+    if (sight_cache.turn != game.play_gameturn)
+    {
+        sight_cache.turn = game.play_gameturn;
+        sight_cache.turn_entries = 0;
+    }
+    sight_cache.turn_entries++;
+    return result;
+}
+
+/**
+ * Marks given area of the map as changed, so that creature sight cache entries which depend on it are dropped.
+ * Called through map_solidity_changed_in_area(), whenever solidity of the map changes.
+ * The entries are not visited here; they're checked against the change when they're looked up.
+ */
+void invalidate_creature_sight_cache_area(MapSubtlCoord start_x, MapSubtlCoord start_y, MapSubtlCoord end_x, MapSubtlCoord end_y)
+{
+    long reg_x,reg_y,reg_sx,reg_ex,reg_ey;
+    // Entries from previous turns are not valid anyway
+    if ((sight_cache.turn != game.play_gameturn) || (sight_cache.turn_entries == 0))
+        return;
+    sight_cache.change_stamp++;
+    reg_sx = sight_cache_region_coord(max(start_x, 0));
+    reg_ex = sight_cache_region_coord(max(end_x, 0));
+    reg_ey = sight_cache_region_coord(max(end_y, 0));
+    for (reg_y = sight_cache_region_coord(max(start_y, 0)); reg_y <= reg_ey; reg_y++)
+    {
+        for (reg_x = reg_sx; reg_x <= reg_ex; reg_x++)
+        {
+            sight_cache.region_stamps[reg_y*SIGHT_CACHE_REGIONS_ROW + reg_x] = sight_cache.change_stamp;
+        }
+    }
+}
+
+/**
+ * Drops all entries of creature sight cache, and logs how useful the cache was.
+ */
+void clear_creature_sight_cache(void)
+{
+    if (sight_cache.lookups > 0)
+    {
+        SYNCMSG("Creature sight cache: %lu rays checked, %lu saved (%lu%%), %lu subtile steps saved, %lu entries invalidated",
+            sight_cache.lookups, sight_cache.hits, sight_cache.hits * 100 / sight_cache.lookups,
+            sight_cache.steps_saved, sight_cache.entries_invalidated);
+    }
+    LbMemorySet(&sight_cache, 0, sizeof(sight_cache));
+}
+
 TbBool jonty_creature_can_see_thing_including_lava_check(const struct Thing *creatng, const struct Thing *thing)
 {
     struct CreatureStats *crstat;
@@ -603,11 +842,11 @@ TbBool jonty_creature_can_see_thing_including_lava_check(const struct Thing *cre
             SYNCDBG(17, "The %s index %d owned by player %d checks w/o lava %s index %d",
                 thing_model_name(creatng),(int)creatng->index,(int)creatng->owner,thing_model_name(thing),(int)thing->index);
             // Check bottom of the thing
-            if (line_of_sight_3d_ignoring_specific_door(&eyepos, &tgtpos, thing))
+            if (creature_sight_ray(SRK_IgnoringSpecificDoor, &eyepos, &tgtpos, thing, creatng->owner))
                 return true;
             // Check top of the thing
             tgtpos.z.val += thing->clipbox_size_yz;
-            if (line_of_sight_3d_ignoring_specific_door(&eyepos, &tgtpos, thing))
+            if (creature_sight_ray(SRK_IgnoringSpecificDoor, &eyepos, &tgtpos, thing, creatng->owner))
                 return true;
             return false;
         } else
@@ -615,11 +854,11 @@ TbBool jonty_creature_can_see_thing_including_lava_check(const struct Thing *cre
             SYNCDBG(17, "The %s index %d owned by player %d checks with lava %s index %d",
                 thing_model_name(creatng),(int)creatng->index,(int)creatng->owner,thing_model_name(thing),(int)thing->index);
             // Check bottom of the thing
-            if (jonty_line_of_sight_3d_including_lava_check_ignoring_specific_door(&eyepos, &tgtpos, thing))
+            if (creature_sight_ray(SRK_LavaIgnoringSpecificDoor, &eyepos, &tgtpos, thing, creatng->owner))
                 return true;
             // Check top of the thing
             tgtpos.z.val += thing->clipbox_size_yz;
-            if (jonty_line_of_sight_3d_including_lava_check_ignoring_specific_door(&eyepos, &tgtpos, thing))
+            if (creature_sight_ray(SRK_LavaIgnoringSpecificDoor, &eyepos, &tgtpos, thing, creatng->owner))
                 return true;
             return false;
         }
@@ -631,11 +870,11 @@ TbBool jonty_creature_can_see_thing_including_lava_check(const struct Thing *cre
             SYNCDBG(17, "The %s index %d owned by player %d checks w/o lava %s index %d",
                 thing_model_name(creatng),(int)creatng->index,(int)creatng->owner,thing_model_name(thing),(int)thing->index);
             // Check bottom of the thing
-            if (line_of_sight_3d(&eyepos, &tgtpos))
+            if (creature_sight_ray(SRK_Plain, &eyepos, &tgtpos, INVALID_THING, creatng->owner))
                 return true;
             // Check top of the thing
             tgtpos.z.val += thing->clipbox_size_yz;
-            if (line_of_sight_3d(&eyepos, &tgtpos))
+            if (creature_sight_ray(SRK_Plain, &eyepos, &tgtpos, INVALID_THING, creatng->owner))
                 return true;
             return false;
         } else
@@ -643,11 +882,11 @@ TbBool jonty_creature_can_see_thing_including_lava_check(const struct Thing *cre
             SYNCDBG(17, "The %s index %d owned by player %d checks with lava %s index %d",
                 thing_model_name(creatng),(int)creatng->index,(int)creatng->owner,thing_model_name(thing),(int)thing->index);
             // Check bottom of the thing
-            if (jonty_line_of_sight_3d_including_lava_check_ignoring_own_door(&eyepos, &tgtpos, creatng->owner))
+            if (creature_sight_ray(SRK_LavaIgnoringOwnDoor, &eyepos, &tgtpos, INVALID_THING, creatng->owner))
                 return true;
             // Check top of the thing
             tgtpos.z.val += thing->clipbox_size_yz;
-            if (jonty_line_of_sight_3d_including_lava_check_ignoring_own_door(&eyepos, &tgtpos, creatng->owner))
+            if (creature_sight_ray(SRK_LavaIgnoringOwnDoor, &eyepos, &tgtpos, INVALID_THING, creatng->owner))
                 return true;
             // Check both sides at middle of thing height
             tgtpos.z.val -= thing->clipbox_size_yz / 2;
@@ -658,12 +897,12 @@ TbBool jonty_creature_can_see_thing_including_lava_check(const struct Thing *cre
             // Also 60 deg will shorten distance to the check point, which may better describe real visibility
             tgtpos.x.val = thing->mappos.x.val + distance_with_angle_to_coord_x(thing->clipbox_size_xy/2, angle + LbFPMath_PI/3);
             tgtpos.y.val = thing->mappos.y.val + distance_with_angle_to_coord_y(thing->clipbox_size_xy/2, angle + LbFPMath_PI/3);
-            if (jonty_line_of_sight_3d_including_lava_check_ignoring_own_door(&eyepos, &tgtpos, creatng->owner))
+            if (creature_sight_ray(SRK_LavaIgnoringOwnDoor, &eyepos, &tgtpos, INVALID_THING, creatng->owner))
                 return true;
             // Check right side
             tgtpos.x.val = thing->mappos.x.val + distance_with_angle_to_coord_x(thing->clipbox_size_xy/2, angle - LbFPMath_PI/3);
             tgtpos.y.val = thing->mappos.y.val + distance_with_angle_to_coord_y(thing->clipbox_size_xy/2, angle - LbFPMath_PI/3);
-            if (jonty_line_of_sight_3d_including_lava_check_ignoring_own_door(&eyepos, &tgtpos, creatng->owner))
+            if (creature_sight_ray(SRK_LavaIgnoringOwnDoor, &eyepos, &tgtpos, INVALID_THING, creatng->owner))
                 return true;
             return false;
         }
@@ -730,6 +969,10 @@ TbBool line_of_sight_3d(const struct Coord3d *frpos, const struct Coord3d *topos
         }
         distance = abs(maxdim2 - maxdim1);
     }
+    // Most rays only cross open slabs; these don't have to be walked through
+    if (map_ray_is_surely_clear(frpos, increase_x, increase_y, increase_z, distance)) {
+        return true;
+    }
     // Go through the distance with given increases
     struct Coord3d prevpos;
     struct Coord3d nextpos;
@@ -42,6 +42,9 @@ TbBool line_of_sight_3d(const struct Coord3d *frpos, const struct Coord3d *topos
 TbBool line_of_sight_2d(const struct Coord3d *pos1, const struct Coord3d *pos2);
 
 long get_explore_sight_distance_in_slabs(const struct Thing *thing);
+
+void clear_creature_sight_cache(void);
+void invalidate_creature_sight_cache_area(MapSubtlCoord start_x, MapSubtlCoord start_y, MapSubtlCoord end_x, MapSubtlCoord end_y);
 /******************************************************************************/
 #ifdef __cplusplus
 }
@@ -85,6 +85,7 @@ void clear_dungeons(void)
   }
   LbMemorySet(&bad_dungeon, 0, sizeof(struct Dungeon));
   bad_dungeon.owner = PLAYERS_COUNT;
+  clear_tasks_index();
   game.field_14E4A4 = 0;
   game.field_14E4A0 = 0;
   game.field_14E49E = 0;
@@ -36,6 +36,8 @@ extern "C" {
 #endif
 /******************************************************************************/
 #define DUNGEONS_COUNT          5
+/** Capacity of the digger stack. Deliberately not configurable - the stack is stored in Dungeon
+ * structure and in reinforce stack of the original DLL, which both have to keep their layout. */
 #define DIGGER_TASK_MAX_COUNT  64
 #define DUNGEON_RESEARCH_COUNT 34
 #define MAX_THINGS_IN_HAND      8
@@ -21,6 +21,7 @@
 #include "bflib_basics.h"
 
 #include "config.h"
+#include "config_cache.h"
 #include "config_creature.h"
 #include "config_crtrstates.h"
 #include "config_objects.h"
@@ -32,6 +33,22 @@
 #include "game_legacy.h"
 
 /******************************************************************************/
+typedef TbBool (*Config_Load_Func)(const char *conf_fname, unsigned short flags);
+
+/**
+ * Loads config from the cache if possible; otherwise loads it from text file,
+ * and saves the cache for next time.
+ */
+static TbBool load_config_with_cache(long cache_kind, Config_Load_Func load_func, const char *conf_fname)
+{
+    if (load_config_from_cache(cache_kind))
+        return true;
+    if (!load_func(conf_fname, CnfLd_Standard))
+        return false;
+    save_config_cache(cache_kind);
+    return true;
+}
+
 TbBool load_stats_files(void)
 {
     int i;
@@ -54,29 +71,42 @@ TbBool load_stats_files(void)
       result = false;
     if (!load_creaturestates_config(creature_states_file,CnfLd_ListOnly))
       result = false;
-    if (!load_terrain_config(keeper_terrain_file,CnfLd_Standard))
+    // Names of all things are known now, so the configs cache can be checked
+    update_config_cache_key();
+    if (!load_config_with_cache(CfgCch_Terrain, load_terrain_config, keeper_terrain_file))
       result = false;
     if (!load_objects_config(keeper_objects_file,CnfLd_Standard))
       result = false;
-    if (!load_trapdoor_config(keeper_trapdoor_file,CnfLd_Standard))
+    if (!load_config_with_cache(CfgCch_TrapDoor, load_trapdoor_config, keeper_trapdoor_file))
       result = false;
     if (!load_effects_config(keeper_effects_file,CnfLd_Standard))
       result = false;
     if (!load_lenses_config(keeper_lenses_file,CnfLd_Standard))
       result = false;
-    if (!load_magic_config(keeper_magic_file,CnfLd_Standard))
+    if (!load_config_with_cache(CfgCch_Magic, load_magic_config, keeper_magic_file))
       result = false;
     if (!load_creaturetypes_config(keeper_creaturetp_file,CnfLd_Standard))
       result = false;
     if (!load_creaturestates_config(creature_states_file,CnfLd_Standard))
       result = false;
     // note that rules file requires definitions of magic and creature types
+    // it's not cached - see config_cache.c for why
     if (!load_rules_config(keeper_rules_file,CnfLd_Standard))
       result = false;
-    for (i=1; i < crtr_conf.model_count; i++)
+    // Creature models are the most of config files; use the cache if none of the files changed
+    if (!load_creaturemodel_configs_from_cache())
     {
-      if (!load_creaturemodel_config(i,0))
-        result = false;
+        TbBool models_result;
+        models_result = true;
+        for (i=1; i < crtr_conf.model_count; i++)
+        {
+          if (!load_creaturemodel_config(i,0))
+            models_result = false;
+        }
+        if (models_result)
+            save_creaturemodel_configs_cache();
+        else
+            result = false;
     }
     game.field_149E7B = game.tile_strength;
 //  LbFileSaveAt("!stat11", &game, sizeof(struct Game));
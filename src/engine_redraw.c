@@ -50,6 +50,7 @@
 #include "frontmenu_ingame_map.h"
 #include "creature_graphics.h"
 #include "vidmode.h"
+#include "vidfade.h"
 #include "config.h"
 #include "config_strings.h"
 #include "config_terrain.h"
@@ -234,11 +235,17 @@ void map_fade(unsigned char *outbuf, unsigned char *srcbuf1, unsigned char *srcb
     }
 }
 
-void generate_map_fade_ghost_table(const char *fname, unsigned char *palette, unsigned char *ghost_table)
+/**
+ * Prepares table of colours being the sum of every two colours of given palette.
+ * The table is computed once for every palette, and then loaded from cache.
+ */
+void generate_map_fade_ghost_table(const char *name, unsigned char *palette, unsigned char *ghost_table)
 {
-    if (LbFileLoadAt(fname, ghost_table) != PALETTE_COLORS*PALETTE_COLORS)
+    if (!load_palette_table_cache(name, palette, ghost_table, PALETTE_COLORS*PALETTE_COLORS))
     {
+        struct TbPaletteMatch *pmatch;
         unsigned char *out;
+        pmatch = palette_match_create(palette);
         out = ghost_table;
         int i;
         for (i=0; i < PALETTE_COLORS; i++)
@@ -254,11 +261,12 @@ void generate_map_fade_ghost_table(const char *fname, unsigned char *palette, un
                 r = bpal[0] + spal[0];
                 g = bpal[1] + spal[1];
                 b = bpal[2] + spal[2];
-                *out = LbPaletteFindColour(palette, r, g, b);
+                *out = palette_match_colour(pmatch, palette, r, g, b);
                 out++;
             }
         }
-        LbFileSaveAt(fname, ghost_table, PALETTE_COLORS*PALETTE_COLORS);
+        palette_match_free(pmatch);
+        save_palette_table_cache(name, palette, ghost_table, PALETTE_COLORS*PALETTE_COLORS);
     }
 }
 
@@ -317,7 +325,7 @@ long map_fade_in(long a)
         map_fade_src = poly_pool + PALETTE_COLORS*PALETTE_COLORS;
         map_fade_dest = map_fade_src + 320*200;
         prepare_map_fade_buffers(map_fade_src, map_fade_dest, 320, MyScreenHeight/pixel_size);
-        generate_map_fade_ghost_table("data/mapfadeg.dat", engine_palette, map_fade_ghost_table);
+        generate_map_fade_ghost_table("mapfadeg", engine_palette, map_fade_ghost_table);
     }
     map_fade(lbDisplay.WScreen, map_fade_dest, map_fade_src, pixmap.fade_tables, map_fade_ghost_table,
       a, 320, 200, lbDisplay.GraphicsScreenWidth);
@@ -336,7 +344,7 @@ long map_fade_out(long a)
         map_fade_src = poly_pool + PALETTE_COLORS*PALETTE_COLORS;
         map_fade_dest = map_fade_src + 320*200;
         prepare_map_fade_buffers(map_fade_src, map_fade_dest, 320, MyScreenHeight/pixel_size);
-        generate_map_fade_ghost_table("data/mapfadeg.dat", engine_palette, map_fade_ghost_table);
+        generate_map_fade_ghost_table("mapfadeg", engine_palette, map_fade_ghost_table);
     }
     map_fade(lbDisplay.WScreen, map_fade_dest, map_fade_src, pixmap.fade_tables, map_fade_ghost_table,
       a, 320, 200, lbDisplay.GraphicsScreenWidth);
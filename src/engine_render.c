@@ -1938,38 +1938,42 @@ void do_a_trig_gourad_bl(struct EngineCoord *ep1, struct EngineCoord *ep2, struc
     _DK_do_a_trig_gourad_bl(ep1, ep2, ep3, a4, a5);
 }
 
+/**
+ * Inserts the light into list of nearest lights, which is sorted by distance.
+ * The list is sorted so that the result does not depend on order in which lights are checked.
+ */
 TbBool add_light_to_nearest_list(struct NearestLights *nlgt, long *nlgt_dist, const struct Light *lgt, long dist)
 {
     int i;
     for (i = settings.video_shadows-1; i > 0; i--)
     {
+        if (nlgt_dist[i-1] <= dist)
+            break;
         nlgt_dist[i] = nlgt_dist[i-1];
         nlgt->coord[i] = nlgt->coord[i-1];
     }
-    nlgt_dist[0] = dist;
-    nlgt->coord[0] = lgt->mappos;
+    nlgt_dist[i] = dist;
+    nlgt->coord[i] = lgt->mappos;
     return true;
 }
 
-void find_closest_lights_on_list(struct NearestLights *nlgt, long *nlgt_dist, const struct Coord3d *pos, ThingIndex list_start_idx)
+void find_closest_lights_in_grid_cell(struct NearestLights *nlgt, long *nlgt_dist, const struct Coord3d *pos, long cell_x, long cell_y)
 {
     long i;
     unsigned long k;
-    if (settings.video_shadows < 1)
-        return;
-    i = list_start_idx;
+    i = light_grid_first_light_in_cell(cell_x, cell_y);
     k = 0;
     while (i > 0)
     {
         struct Light *lgt;
         lgt = &game.lish.lights[i];
-        i = lgt->field_26;
-        // Per-light code
-        if ((lgt->flags & 1) != 0)
+        i = light_grid_next_light_in_cell(lgt);
+        // Per-light code; only enabled lights are used, which are the ones on lights lists
+        if ((lgt->flags & (LgtF_Allocated|LgtF_Unkn02)) == (LgtF_Allocated|LgtF_Unkn02))
         {
             long dist;
             dist = get_2d_box_distance(pos, &lgt->mappos);
-            if ((dist < 2560) && (nlgt_dist[settings.video_shadows-1] > dist)
+            if ((dist < SHADOW_SOURCES_MAX_DISTANCE) && (nlgt_dist[settings.video_shadows-1] > dist)
                 && (pos->x.val != lgt->mappos.x.val) && (pos->y.val != lgt->mappos.y.val))
             {
                 add_light_to_nearest_list(nlgt, nlgt_dist, lgt, dist);
@@ -1979,25 +1983,40 @@ void find_closest_lights_on_list(struct NearestLights *nlgt, long *nlgt_dist, co
         k++;
         if (k > LIGHTS_COUNT)
         {
-            ERRORLOG("Infinite loop detected when sweeping lights list");
+            ERRORLOG("Infinite loop detected when sweeping lights grid");
             break;
         }
     }
 }
 
+/**
+ * Finds lights which should cast shadows of a thing at given position.
+ * Only grid cells within shadow casting distance are checked.
+ */
 long find_closest_lights(const struct Coord3d *pos, struct NearestLights *nlgt)
 {
     //return _DK_find_closest_lights(pos, nlgt);
     long count;
     long nlgt_dist[SHADOW_SOURCES_MAX_COUNT];
+    long start_x,start_y,end_x,end_y;
+    long cell_x,cell_y;
     long i;
+    if (settings.video_shadows < 1)
+        return 0;
     for (i = 0; i < SHADOW_SOURCES_MAX_COUNT; i++) {
         nlgt_dist[i] = LONG_MAX;
     }
-    i = game.thing_lists[TngList_StaticLights].index;
-    find_closest_lights_on_list(nlgt, nlgt_dist, pos, i);
-    i = game.thing_lists[TngList_DynamLights].index;
-    find_closest_lights_on_list(nlgt, nlgt_dist, pos, i);
+    start_x = light_grid_cell_coord((long)pos->x.val - SHADOW_SOURCES_MAX_DISTANCE);
+    start_y = light_grid_cell_coord((long)pos->y.val - SHADOW_SOURCES_MAX_DISTANCE);
+    end_x = light_grid_cell_coord((long)pos->x.val + SHADOW_SOURCES_MAX_DISTANCE);
+    end_y = light_grid_cell_coord((long)pos->y.val + SHADOW_SOURCES_MAX_DISTANCE);
+    for (cell_y = start_y; cell_y <= end_y; cell_y++)
+    {
+        for (cell_x = start_x; cell_x <= end_x; cell_x++)
+        {
+            find_closest_lights_in_grid_cell(nlgt, nlgt_dist, pos, cell_x, cell_y);
+        }
+    }
     count = 0;
     for (i = 0; i < SHADOW_SOURCES_MAX_COUNT; i++) {
         if (nlgt_dist[i] == LONG_MAX)
@@ -4903,6 +4922,10 @@ long load_keepersprite_if_needed(unsigned short kspr_idx)
         {
             heapmgr_make_newest(graphics_heap, *hmhndl);
         } else
+        if ((keepsprite[kspr_idx+frame_num] != NULL) || keepsprite_store_link(kspr_idx+frame_num))
+        {
+            // Frame data is in preloaded store, no need to use the heap
+        } else
         {
             if (!load_single_frame(kspr_idx+frame_num))
             {
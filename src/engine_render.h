@@ -273,6 +273,8 @@ struct BasicUnk14 { // sizeof = 24
 };
 
 #define SHADOW_SOURCES_MAX_COUNT 4
+/** Max distance of a light which may cast shadow of a thing, in map coordinates. */
+#define SHADOW_SOURCES_MAX_DISTANCE 2560
 struct NearestLights {
     struct Coord3d coord[SHADOW_SOURCES_MAX_COUNT];
 };
@@ -528,6 +530,7 @@ void draw_map_volume_box(long cor1_x, long cor1_y, long cor2_x, long cor2_y, lon
 unsigned short choose_health_sprite(struct Thing *thing);
 
 void update_engine_settings(struct PlayerInfo *player);
+long find_closest_lights(const struct Coord3d *pos, struct NearestLights *nlgt);
 void display_drawlist(void);
 void draw_view(struct Camera *cam, unsigned char a2);
 void draw_frontview_engine(struct Camera *cam);
@@ -28,6 +28,7 @@
 #include "config.h"
 #include "front_simple.h"
 #include "engine_render.h"
+#include "creature_graphics.h"
 #include "sounds.h"
 
 #ifdef __cplusplus
@@ -46,6 +47,20 @@ DLLIMPORT int _DK_LbFileRead(TbFileHandle handle, void *buffer, unsigned long le
 const char *sound_fname = "sound.dat";
 const char *speech_fname = "speech.dat";
 /******************************************************************************/
+/** Creature sprites file preloaded into memory, so that sprites can be drawn without reading the file. */
+struct KeepSpriteStore {
+    unsigned char *data;
+    unsigned long size;
+    char fname[2048];
+};
+
+/** If false, creature sprites are always loaded through graphics heap. */
+static TbBool keepsprite_store_enabled = true;
+static struct KeepSpriteStore keepsprite_store;
+/** Sprite data pointers within the store; keepsprite[] entries point here for sprites served by the store. */
+static TbSpriteData keepsprite_store_ptr[KEEPSPRITE_LENGTH];
+static struct KeepSpriteHeapStats keepsprite_heap_stats;
+/******************************************************************************/
 long get_smaller_memory_amount(long amount)
 {
     if (amount > 64)
@@ -63,6 +78,79 @@ long get_smaller_memory_amount(long amount)
     return 6;
 }
 
+static void free_keepersprite_store(void)
+{
+    LbMemoryFree(keepsprite_store.data);
+    LbMemorySet(&keepsprite_store, 0, sizeof(keepsprite_store));
+    LbMemorySet(keepsprite_store_ptr, 0, sizeof(keepsprite_store_ptr));
+}
+
+/**
+ * Preloads whole creature sprites file into memory, if it's not too large.
+ * If the store can't be prepared, sprites are loaded through graphics heap.
+ * @return True if the store is ready to use.
+ */
+static TbBool setup_keepersprite_store(const char *fname)
+{
+    TbFileHandle fhandle;
+    unsigned char *data;
+    long len;
+    if (!keepsprite_store_enabled)
+    {
+        free_keepersprite_store();
+        return false;
+    }
+    // The store survives heap manager reset; no need to read the same file again
+    if ((keepsprite_store.data != NULL) && (strcmp(keepsprite_store.fname, fname) == 0)) {
+        return true;
+    }
+    free_keepersprite_store();
+    len = LbFileLength(fname);
+    if ((len <= 0) || (len > KEEPSPRITE_STORE_MAX_SIZE))
+    {
+        WARNLOG("Size of \"%s\" is %ld, it won't be preloaded",fname,len);
+        return false;
+    }
+    data = LbMemoryAlloc(len);
+    if (data == NULL)
+    {
+        WARNLOG("Not enough memory to preload \"%s\"",fname);
+        return false;
+    }
+    fhandle = LbFileOpen(fname, Lb_FILE_MODE_READ_ONLY);
+    if (fhandle == -1)
+    {
+        LbMemoryFree(data);
+        return false;
+    }
+    if (LbFileRead(fhandle, data, len) != len)
+    {
+        WARNLOG("Can not preload \"%s\"",fname);
+        LbFileClose(fhandle);
+        LbMemoryFree(data);
+        return false;
+    }
+    LbFileClose(fhandle);
+    keepsprite_store.data = data;
+    keepsprite_store.size = len;
+    strncpy(keepsprite_store.fname, fname, sizeof(keepsprite_store.fname)-1);
+    SYNCMSG("Preloaded %ld bytes of creature sprites",len);
+    return true;
+}
+
+static void clear_keepsprite_heap_stats(void)
+{
+    struct KeepSpriteHeapStats *khstats;
+    khstats = &keepsprite_heap_stats;
+    if (khstats->frames_count > 0)
+    {
+        SYNCMSG("Creature sprites heap: %lu misses, %lu bytes read in %lu frames; worst frame had %lu misses, %lu bytes read",
+            khstats->total_misses, khstats->total_bytes_read, khstats->frames_count,
+            khstats->max_frame_misses, khstats->max_frame_bytes_read);
+    }
+    LbMemorySet(khstats, 0, sizeof(struct KeepSpriteHeapStats));
+}
+
 TbBool setup_heap_manager(void)
 {
     SYNCDBG(8,"Starting");
@@ -94,6 +182,7 @@ TbBool setup_heap_manager(void)
         ERRORLOG("Can not open JTY file, \"%s\"",fname);
         return false;
     }
+    setup_keepersprite_store(fname);
     for (i=0; i < KEEPSPRITE_LENGTH; i++)
         keepsprite[i] = NULL;
     for (i=0; i < KEEPSPRITE_LENGTH; i++)
@@ -154,6 +243,7 @@ void reset_heap_manager(void)
         keepsprite[i] = NULL;
     for (i=0; i < KEEPSPRITE_LENGTH; i++)
         heap_handle[i] = NULL;
+    clear_keepsprite_heap_stats();
 }
 
 void reset_heap_memory(void)
@@ -161,6 +251,7 @@ void reset_heap_memory(void)
   SYNCDBG(8,"Starting");
   LbMemoryFree(heap);
   heap = NULL;
+  free_keepersprite_store();
 }
 
 TbBool setup_heaps(void)
@@ -310,6 +401,70 @@ TbBool read_heap_item(struct HeapMgrHandle *hmhandle, long offs, long len)
     // TODO make error handling
     _DK_LbFileSeek(file_handle, offs, 0);
     _DK_LbFileRead(file_handle, hmhandle->buf, len);
+    keepsprite_heap_stats.frame_misses++;
+    keepsprite_heap_stats.frame_bytes_read += len;
+    return true;
+}
+
+/**
+ * Allows or disallows preloading creature sprites; used to compare against loading through heap.
+ * Takes effect when the heap manager is set up.
+ */
+void keepsprite_store_set_enabled(TbBool enable)
+{
+    keepsprite_store_enabled = enable;
+}
+
+TbBool keepsprite_store_active(void)
+{
+    return (keepsprite_store.data != NULL);
+}
+
+/**
+ * Makes creature sprite frame data available directly from preloaded store.
+ * @return True if the frame can now be drawn; false if it has to be loaded through heap.
+ */
+TbBool keepsprite_store_link(unsigned short kspr_idx)
+{
+    unsigned long offs,end;
+    if (keepsprite_store.data == NULL) {
+        return false;
+    }
+    if (kspr_idx+1 >= KEEPSPRITE_LENGTH) {
+        return false;
+    }
+    offs = creature_table[kspr_idx].DataOffset;
+    end = creature_table[kspr_idx+1].DataOffset;
+    if ((end < offs) || (end > keepsprite_store.size))
+    {
+        WARNLOG("KeepSprite %d is outside of preloaded data",(int)kspr_idx);
+        return false;
+    }
+    keepsprite_store_ptr[kspr_idx] = keepsprite_store.data + offs;
+    keepsprite[kspr_idx] = &keepsprite_store_ptr[kspr_idx];
     return true;
 }
+
+/**
+ * Closes creature sprites loading statistics of a rendered frame.
+ */
+void keepsprite_heap_frame_done(void)
+{
+    struct KeepSpriteHeapStats *khstats;
+    khstats = &keepsprite_heap_stats;
+    if (khstats->max_frame_misses < khstats->frame_misses)
+        khstats->max_frame_misses = khstats->frame_misses;
+    if (khstats->max_frame_bytes_read < khstats->frame_bytes_read)
+        khstats->max_frame_bytes_read = khstats->frame_bytes_read;
+    khstats->total_misses += khstats->frame_misses;
+    khstats->total_bytes_read += khstats->frame_bytes_read;
+    khstats->frames_count++;
+    khstats->frame_misses = 0;
+    khstats->frame_bytes_read = 0;
+}
+
+void get_keepsprite_heap_stats(struct KeepSpriteHeapStats *stats)
+{
+    LbMemoryCopy(stats, &keepsprite_heap_stats, sizeof(struct KeepSpriteHeapStats));
+}
 /******************************************************************************/
@@ -27,6 +27,24 @@
 extern "C" {
 #endif
 
+/******************************************************************************/
+/** Max size of the creature sprites file which is allowed to be preloaded into memory. */
+#define KEEPSPRITE_STORE_MAX_SIZE (64*1024*1024)
+
+/** Statistics of loading creature sprites through graphics heap; used to measure render hitches. */
+struct KeepSpriteHeapStats {
+    /** Amount of sprites which were not on the heap and had to be read from file, in current frame. */
+    unsigned long frame_misses;
+    /** Amount of bytes read from sprites file, in current frame. */
+    unsigned long frame_bytes_read;
+    unsigned long max_frame_misses;
+    unsigned long max_frame_bytes_read;
+    unsigned long total_misses;
+    unsigned long total_bytes_read;
+    /** Amount of frames finished since the statistics were cleared. */
+    unsigned long frames_count;
+};
+
 /******************************************************************************/
 #pragma pack(1)
 
@@ -48,6 +66,12 @@ void reset_heap_memory(void);
 TbBool setup_heaps(void);
 
 TbBool read_heap_item(struct HeapMgrHandle *hmhandle, long offs, long len);
+
+void keepsprite_store_set_enabled(TbBool enable);
+TbBool keepsprite_store_active(void);
+TbBool keepsprite_store_link(unsigned short kspr_idx);
+void keepsprite_heap_frame_done(void);
+void get_keepsprite_heap_stats(struct KeepSpriteHeapStats *stats);
 /******************************************************************************/
 #ifdef __cplusplus
 }
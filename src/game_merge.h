@@ -29,6 +29,7 @@
 #include "thing_creature.h"
 #include "creature_control.h"
 #include "light_data.h"
+#include "player_complookup.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -113,6 +114,9 @@ struct GameAdd {
     char quick_messages[QUICK_MESSAGES_COUNT][MESSAGE_TEXT_LEN];
     struct SacrificeRecipe sacrifice_recipes[MAX_SACRIFICE_RECIPES];
     struct LightSystemState lightst;
+    /** Max amount of checks done by one computer player in a game turn; zero means no limit. */
+    unsigned char computer_checks_per_turn;
+    struct GoldVeinsMap gold_veins;
 };
 
 #pragma pack()
@@ -0,0 +1,1945 @@
+/******************************************************************************/
+// Free implementation of Bullfrog's Dungeon Keeper strategy game.
+/******************************************************************************/
+/** @file game_selftest.c
+ *     Tests and benchmarks which require game data, run instead of the game.
+ * @par Purpose:
+ *     Verifies that caches and other optimized code paths give the same
+ *     results as the original ones, and measures their speed.
+ * @par Comment:
+ *     Tests are selected with "-selftest <names>" command line option, where
+ *     names are separated by commas; "all" selects all tests, but not benchmarks.
+ *     The game is set up as usual, then the tests are run and the game quits
+ *     with nonzero exit code if any failed. Results are written into the log.
+ * @author   KeeperFX Team
+ * @date     19 Oct 2026 - 19 Oct 2026
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+/******************************************************************************/
+#include "game_selftest.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <SDL/SDL.h>
+#include <SDL/SDL_thread.h>
+#include "globals.h"
+#include "bflib_basics.h"
+#include "bflib_memory.h"
+#include "bflib_datetm.h"
+#include "bflib_fileio.h"
+#include "bflib_dernc.h"
+#include "bflib_video.h"
+#include "bflib_fmvids.h"
+#include "bflib_workers.h"
+
+#include "config.h"
+#include "config_cache.h"
+#include "config_campaigns.h"
+#include "config_creature.h"
+#include "config_magic.h"
+#include "config_objects.h"
+#include "config_terrain.h"
+#include "config_trapdoor.h"
+#include "dungeon_data.h"
+#include "engine_camera.h"
+#include "engine_render.h"
+#include "light_data.h"
+#include "config_settings.h"
+#include "config_lenses.h"
+#include "lens_api.h"
+#include "dungeon_stats.h"
+#include "player_data.h"
+#include "map_data.h"
+#include "map_blocks.h"
+#include "room_util.h"
+#include "spdigger_stack.h"
+#include "thing_data.h"
+#include "thing_list.h"
+#include "thing_creature.h"
+#include "thing_doors.h"
+#include "lvl_script.h"
+#include "lvl_filesdk1.h"
+#include "game_merge.h"
+#include "game_legacy.h"
+#include "keeperfx.hpp"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/******************************************************************************/
+/** How many times the config parsing benchmark loads each config. */
+#define SELFTEST_CONFIG_PARSE_LOOPS 5
+/** How many times the RNC benchmark unpacks each file. */
+#define SELFTEST_RNC_BENCHMARK_LOOPS 20
+/** Amount of diggers created by the digger benchmark. */
+#define SELFTEST_DIGGER_BENCHMARK_DIGGERS 100
+/** Amount of slabs tagged for digging by the digger benchmark. */
+#define SELFTEST_DIGGER_BENCHMARK_TAGS 2000
+/** Amount of game turns processed by the digger benchmark. */
+#define SELFTEST_DIGGER_BENCHMARK_TURNS 2000
+/** Amount of threads logging at once in the log stress test. */
+#define SELFTEST_LOG_STRESS_THREADS 6
+/** Amount of lines logged by every thread in the log stress test. */
+#define SELFTEST_LOG_STRESS_LINES 500000
+/** Every line with index divisible by this is made longer than a log ring slot. */
+#define SELFTEST_LOG_STRESS_LONG_EVERY 997
+#define SELFTEST_LOG_STRESS_LONG_LEN (LOG_RING_LINE_LEN+44)
+/** Amount of lights the lights benchmark tries to create; the lights array may not fit all. */
+#define SELFTEST_LIGHTS_BENCHMARK_LIGHTS 400
+/** Amount of creature positions for which the lights benchmark finds shadow casting lights. */
+#define SELFTEST_LIGHTS_BENCHMARK_CREATURES 600
+#define SELFTEST_LIGHTS_BENCHMARK_FRAMES 100
+#define SELFTEST_LIGHTS_BENCHMARK_RADIUS (10*COORD_PER_STL)
+/** Size of map area covered by lights and creatures; about what is visible on screen. */
+#define SELFTEST_LIGHTS_BENCHMARK_AREA (24*STL_PER_SLB*COORD_PER_STL)
+/** Amount of frames drawn with every lens by the lens benchmark. */
+#define SELFTEST_LENS_BENCHMARK_FRAMES 50
+/** Amount of frames recorded by the movie capture test. */
+#define SELFTEST_MOVIE_FRAMES 60
+/** Width of the frontend image which tests use as captured frame. */
+#define SELFTEST_FRAME_IMAGE_WIDTH 640
+/******************************************************************************/
+typedef TbBool (*SelfTestFunc)(void);
+typedef TbBool (*SelfTestLevelFunc)(LevelNumber lvnum);
+
+enum SelfTestFlags {
+    STF_None      = 0x00,
+    /** Benchmarks and stress tests take long, so they're not selected by "all". */
+    STF_Benchmark = 0x01,
+};
+
+struct SelfTestDesc {
+    const char *name;
+    SelfTestFunc func;
+    unsigned short flags;
+};
+
+/** Block of memory to be compared by a test. */
+struct SelfTestRegion {
+    void *data;
+    unsigned long size;
+};
+
+/** Thread which writes lines in the log stress test. */
+struct SelfTestLogThread {
+    struct TbLog *log;
+    long thread_idx;
+    SDL_Thread *thread;
+};
+
+struct SelfTestState {
+    char names[SELFTEST_NAMES_LEN];
+    long tests_run;
+    long tests_failed;
+};
+/******************************************************************************/
+static TbBool selftest_config_cache(void);
+static TbBool selftest_config_parse(void);
+static TbBool selftest_level_cache(void);
+static TbBool selftest_script_cache(void);
+static TbBool selftest_rnc(void);
+static TbBool selftest_rnc_benchmark(void);
+static TbBool selftest_digger_benchmark(void);
+static TbBool selftest_log_stress(void);
+static TbBool selftest_lights_benchmark(void);
+static TbBool selftest_lens_benchmark(void);
+static TbBool selftest_movie_capture(void);
+/******************************************************************************/
+static const struct SelfTestDesc selftests_list[] = {
+    {"configcache",   selftest_config_cache,       STF_None},
+    {"configparse",   selftest_config_parse,       STF_Benchmark},
+    {"levelcache",    selftest_level_cache,        STF_None},
+    {"scriptcache",   selftest_script_cache,       STF_None},
+    {"rnc",           selftest_rnc,                STF_None},
+    {"rncbench",      selftest_rnc_benchmark,      STF_Benchmark},
+    {"diggerbench",   selftest_digger_benchmark,   STF_Benchmark},
+    {"logstress",     selftest_log_stress,         STF_Benchmark},
+    {"lightsbench",   selftest_lights_benchmark,   STF_Benchmark},
+    {"lensbench",     selftest_lens_benchmark,     STF_Benchmark},
+    {"moviecapture",  selftest_movie_capture,      STF_None},
+    {NULL,            NULL,                        STF_None},
+};
+
+static struct SelfTestState selftest;
+/******************************************************************************/
+TbBool selftest_set_names(const char *names)
+{
+    LbStringCopy(selftest.names, names, sizeof(selftest.names));
+    return (selftest.names[0] != '\0');
+}
+
+TbBool selftest_is_set(void)
+{
+    return (selftest.names[0] != '\0');
+}
+
+int selftest_exit_code(void)
+{
+    if (!selftest_is_set())
+        return 0;
+    return ((selftest.tests_failed > 0) || (selftest.tests_run == 0)) ? 1 : 0;
+}
+
+/**
+ * Checks whether given test was selected in command line.
+ */
+static TbBool selftest_is_selected(const struct SelfTestDesc *stdesc)
+{
+    const char *name;
+    long len;
+    name = selftest.names;
+    while (*name != '\0')
+    {
+        for (len=0; (name[len] != '\0') && (name[len] != ','); len++);
+        if ((len == 3) && (strncasecmp(name, "all", len) == 0) && ((stdesc->flags & STF_Benchmark) == 0))
+            return true;
+        if ((len == strlen(stdesc->name)) && (strncasecmp(name, stdesc->name, len) == 0))
+            return true;
+        name += len;
+        if (*name == ',')
+            name++;
+    }
+    return false;
+}
+
+/**
+ * Runs given function for every level of every campaign.
+ * @return Amount of levels for which the function failed.
+ */
+static long selftest_for_campaigns_levels(SelfTestLevelFunc func)
+{
+    struct GameCampaign *campgn;
+    LevelNumber lvnum;
+    unsigned long i;
+    long n;
+    long failed;
+    failed = 0;
+    for (n=0; n < campaigns_list.items_num; n++)
+    {
+        campgn = &campaigns_list.items[n];
+        if (!change_campaign(campgn->fname))
+        {
+            ERRORLOG("Unable to load campaign \"%s\"",campgn->fname);
+            failed++;
+            continue;
+        }
+        SYNCMSG("Testing levels of campaign \"%s\"",campaign.name);
+        for (i=0; i < campaign.single_levels_count; i++)
+        {
+            lvnum = campaign.single_levels[i];
+            if (!func(lvnum))
+                failed++;
+        }
+        for (i=0; i < campaign.bonus_levels_count; i++)
+        {
+            lvnum = campaign.bonus_levels[i];
+            if (!func(lvnum))
+                failed++;
+        }
+        for (i=0; i < campaign.extra_levels_count; i++)
+        {
+            lvnum = campaign.extra_levels[i];
+            if (!func(lvnum))
+                failed++;
+        }
+        for (i=0; i < campaign.multi_levels_count; i++)
+        {
+            lvnum = campaign.multi_levels[i];
+            if (!func(lvnum))
+                failed++;
+        }
+        for (i=0; i < campaign.freeplay_levels_count; i++)
+        {
+            lvnum = campaign.freeplay_levels[i];
+            if (!func(lvnum))
+                failed++;
+        }
+    }
+    return failed;
+}
+
+/**
+ * Lists memory blocks which loading config files writes to.
+ * @return Amount of regions filled.
+ */
+static long selftest_config_regions(struct SelfTestRegion *regions)
+{
+    long n;
+    n = 0;
+    regions[n].data = &game;              regions[n].size = sizeof(struct Game);             n++;
+    regions[n].data = &gameadd;           regions[n].size = sizeof(struct GameAdd);          n++;
+    regions[n].data = &slab_conf;         regions[n].size = sizeof(struct SlabsConfig);      n++;
+    regions[n].data = &trapdoor_conf;     regions[n].size = sizeof(struct TrapDoorConfig);   n++;
+    regions[n].data = &magic_conf;        regions[n].size = sizeof(struct MagicConfig);      n++;
+    regions[n].data = &object_conf;       regions[n].size = sizeof(struct ObjectsConfig);    n++;
+    regions[n].data = &crtr_conf;         regions[n].size = sizeof(struct CreatureConfig);   n++;
+    regions[n].data = room_data;          regions[n].size = (ROOM_TYPES_COUNT+1)*sizeof(struct RoomData); n++;
+    regions[n].data = get_slab_kind_attrs(0); regions[n].size = SLAB_TYPES_COUNT*sizeof(struct SlabAttr); n++;
+    regions[n].data = spell_info;         regions[n].size = MAGIC_TYPES_COUNT*sizeof(struct SpellInfo); n++;
+    regions[n].data = shot_stats;         regions[n].size = sizeof(shot_stats);              n++;
+    regions[n].data = door_stats;         regions[n].size = sizeof(door_stats);              n++;
+    regions[n].data = slab_desc;          regions[n].size = sizeof(slab_desc);               n++;
+    regions[n].data = room_desc;          regions[n].size = sizeof(room_desc);               n++;
+    regions[n].data = trap_desc;          regions[n].size = sizeof(trap_desc);               n++;
+    regions[n].data = door_desc;          regions[n].size = sizeof(door_desc);               n++;
+    regions[n].data = spell_desc;         regions[n].size = MAGIC_ITEMS_MAX*sizeof(struct NamedCommand); n++;
+    regions[n].data = shot_desc;          regions[n].size = MAGIC_ITEMS_MAX*sizeof(struct NamedCommand); n++;
+    regions[n].data = power_desc;         regions[n].size = MAGIC_ITEMS_MAX*sizeof(struct NamedCommand); n++;
+    return n;
+}
+
+/**
+ * Loads all config files, and stores copy of everything they write to.
+ * @return Newly allocated buffer with the copy, or NULL on failure.
+ */
+static unsigned char *selftest_load_configs(TbBool *result)
+{
+    struct SelfTestRegion regions[32];
+    unsigned char *state;
+    unsigned long size;
+    long regions_num;
+    long i;
+    *result = load_stats_files();
+    regions_num = selftest_config_regions(regions);
+    size = 0;
+    for (i=0; i < regions_num; i++)
+        size += regions[i].size;
+    state = (unsigned char *)LbMemoryAlloc(size);
+    if (state == NULL)
+        return NULL;
+    size = 0;
+    for (i=0; i < regions_num; i++)
+    {
+        LbMemoryCopy(state + size, regions[i].data, regions[i].size);
+        size += regions[i].size;
+    }
+    return state;
+}
+
+/**
+ * Compares two copies made by selftest_load_configs(), and logs which regions differ.
+ */
+static TbBool selftest_config_states_equal(const unsigned char *state1, const unsigned char *state2, const char *desc)
+{
+    struct SelfTestRegion regions[32];
+    unsigned long size;
+    long regions_num;
+    TbBool result;
+    long i;
+    regions_num = selftest_config_regions(regions);
+    result = true;
+    size = 0;
+    for (i=0; i < regions_num; i++)
+    {
+        if (memcmp(state1 + size, state2 + size, regions[i].size) != 0)
+        {
+            ERRORLOG("Configs of campaign \"%s\" differ in region %d when %s",campaign.name,(int)i,desc);
+            result = false;
+        }
+        size += regions[i].size;
+    }
+    return result;
+}
+
+/**
+ * Loads config files of given campaign from text, and then through the cache,
+ * and compares everything they have written to.
+ */
+static TbBool selftest_config_cache_campaign(void)
+{
+    unsigned char *text_state;
+    unsigned char *state;
+    unsigned long loads;
+    TbBool text_result,cache_result;
+    TbBool result;
+    // Load configs from text, without cache
+    config_cache_enabled = false;
+    text_state = selftest_load_configs(&text_result);
+    if (text_state == NULL)
+        return false;
+    result = true;
+    // First pass writes the cache, second loads it
+    config_cache_enabled = true;
+    clear_config_caches();
+    state = selftest_load_configs(&cache_result);
+    if ((state == NULL) || (cache_result != text_result)
+      || !selftest_config_states_equal(text_state, state, "cache is written"))
+        result = false;
+    LbMemoryFree(state);
+    loads = config_cache_loads;
+    state = selftest_load_configs(&cache_result);
+    if ((state == NULL) || (cache_result != text_result)
+      || !selftest_config_states_equal(text_state, state, "loaded from cache"))
+        result = false;
+    LbMemoryFree(state);
+    // Terrain, traps and doors, magic and creature models
+    if (config_cache_loads - loads != 4)
+    {
+        ERRORLOG("Only %lu configs of campaign \"%s\" were loaded from cache",config_cache_loads - loads,campaign.name);
+        result = false;
+    }
+    LbMemoryFree(text_state);
+    return result;
+}
+
+static TbBool selftest_config_cache(void)
+{
+    struct GameCampaign *campgn;
+    TbBool cache_enabled;
+    long failed;
+    long n;
+    cache_enabled = config_cache_enabled;
+    failed = 0;
+    for (n=0; n < campaigns_list.items_num; n++)
+    {
+        campgn = &campaigns_list.items[n];
+        if (!change_campaign(campgn->fname))
+        {
+            ERRORLOG("Unable to load campaign \"%s\"",campgn->fname);
+            failed++;
+            continue;
+        }
+        SYNCMSG("Testing configs of campaign \"%s\"",campaign.name);
+        if (!selftest_config_cache_campaign())
+            failed++;
+    }
+    config_cache_enabled = cache_enabled;
+    // Leave the configs loaded the usual way
+    load_stats_files();
+    return (failed == 0);
+}
+
+/**
+ * Loads all config files a few times, measuring the time.
+ * @return Copy made by selftest_load_configs() on last load, or NULL on failure.
+ */
+static unsigned char *selftest_config_parse_timed(TbClockUSec *total_time)
+{
+    unsigned char *state;
+    TbClockUSec start_time;
+    TbBool result;
+    int i;
+    state = NULL;
+    for (i=0; i < SELFTEST_CONFIG_PARSE_LOOPS; i++)
+    {
+        LbMemoryFree(state);
+        start_time = LbTimerClockMicro();
+        state = selftest_load_configs(&result);
+        *total_time += LbTimerClockMicro() - start_time;
+        if (state == NULL)
+            break;
+    }
+    return state;
+}
+
+/**
+ * Parses campaign files, and all configs of every campaign, with linear search
+ * of config blocks and commands, and then with their index.
+ * Results are compared, and time of both ways is logged.
+ */
+static TbBool selftest_config_parse(void)
+{
+    struct GameCampaign *campgn;
+    unsigned char *linear_state;
+    unsigned char *state;
+    TbClockUSec linear_time,indexed_time,start_time;
+    TbBool cache_enabled;
+    long failed;
+    long n;
+    int i;
+    cache_enabled = config_cache_enabled;
+    config_cache_enabled = false;
+    failed = 0;
+    linear_time = 0;
+    indexed_time = 0;
+    // Campaign files
+    for (i=0; i < SELFTEST_CONFIG_PARSE_LOOPS; i++)
+    {
+        conf_index_enabled = false;
+        start_time = LbTimerClockMicro();
+        load_campaigns_list();
+        linear_time += LbTimerClockMicro() - start_time;
+        conf_index_enabled = true;
+        start_time = LbTimerClockMicro();
+        load_campaigns_list();
+        indexed_time += LbTimerClockMicro() - start_time;
+    }
+    SYNCMSG("Campaign files parsed in %lu us with linear search, %lu us with index",
+        (unsigned long)(linear_time/SELFTEST_CONFIG_PARSE_LOOPS),(unsigned long)(indexed_time/SELFTEST_CONFIG_PARSE_LOOPS));
+    // Config files of every campaign
+    linear_time = 0;
+    indexed_time = 0;
+    for (n=0; n < campaigns_list.items_num; n++)
+    {
+        campgn = &campaigns_list.items[n];
+        if (!change_campaign(campgn->fname))
+        {
+            ERRORLOG("Unable to load campaign \"%s\"",campgn->fname);
+            failed++;
+            continue;
+        }
+        conf_index_enabled = false;
+        linear_state = selftest_config_parse_timed(&linear_time);
+        conf_index_enabled = true;
+        state = selftest_config_parse_timed(&indexed_time);
+        if ((linear_state == NULL) || (state == NULL)
+          || !selftest_config_states_equal(linear_state, state, "parsed with index"))
+            failed++;
+        LbMemoryFree(linear_state);
+        LbMemoryFree(state);
+    }
+    SYNCMSG("Configs of %ld campaigns parsed in %lu us with linear search, %lu us with index",(long)campaigns_list.items_num,
+        (unsigned long)(linear_time/SELFTEST_CONFIG_PARSE_LOOPS),(unsigned long)(indexed_time/SELFTEST_CONFIG_PARSE_LOOPS));
+    config_cache_enabled = cache_enabled;
+    load_stats_files();
+    return (failed == 0);
+}
+
+/**
+ * Initializes given level, with the same random seed every time.
+ * @return True if the level exists.
+ */
+static TbBool selftest_init_level(LevelNumber lvnum)
+{
+    srand(1);
+    set_selected_level_number(lvnum);
+    init_level();
+    if (get_loaded_level_number() != lvnum)
+        return false;
+    return true;
+}
+
+/**
+ * Initializes given level and loads its script, with the same random seed every time.
+ * @return True if the level exists.
+ */
+static TbBool selftest_load_level_script(LevelNumber lvnum)
+{
+    if (!selftest_init_level(lvnum))
+        return false;
+    load_script(lvnum);
+    return true;
+}
+
+/**
+ * Gives offset of the first byte which differs between two memory blocks.
+ * @return The offset, or -1 if the blocks are identical.
+ */
+static long selftest_first_difference(const unsigned char *data1, const unsigned char *data2, unsigned long size)
+{
+    unsigned long i;
+    if (memcmp(data1, data2, size) == 0)
+        return -1;
+    for (i=0; i < size; i++)
+    {
+        if (data1[i] != data2[i])
+            break;
+    }
+    return i;
+}
+
+/**
+ * Stores copy of Game and GameAdd structs after a level was initialized.
+ * Fields which init_level() sets from system time are cleared first.
+ */
+static void selftest_store_level_state(unsigned char *state)
+{
+    game.unsync_rand_seed = 0;
+    game.field_14BB54 = 0;
+    game.field_14BB55 = 0;
+    LbMemoryCopy(state, &game, sizeof(struct Game));
+    LbMemoryCopy(state + sizeof(struct Game), &gameadd, sizeof(struct GameAdd));
+}
+
+/**
+ * Initializes given level from level files and from the level cache, and compares the results.
+ */
+static TbBool selftest_level_cache_level(LevelNumber lvnum)
+{
+    unsigned char *text_state;
+    unsigned char *state;
+    unsigned long loads;
+    long diff;
+    TbBool result;
+    int i;
+    if (lvnum <= 0)
+        return true;
+    text_state = (unsigned char *)LbMemoryAlloc(sizeof(struct Game) + sizeof(struct GameAdd));
+    state = (unsigned char *)LbMemoryAlloc(sizeof(struct Game) + sizeof(struct GameAdd));
+    if ((text_state == NULL) || (state == NULL))
+    {
+        LbMemoryFree(text_state);
+        LbMemoryFree(state);
+        return false;
+    }
+    // Load the level from files, without cache
+    level_cache_enabled = false;
+    if (!selftest_init_level(lvnum))
+    {
+        SYNCMSG("Level %d doesn't exist, skipped",(int)lvnum);
+        LbMemoryFree(text_state);
+        LbMemoryFree(state);
+        return true;
+    }
+    selftest_store_level_state(text_state);
+    // First pass writes the cache, second loads the level from it
+    level_cache_enabled = true;
+    clear_level_cache(lvnum);
+    result = true;
+    for (i=0; i < 2; i++)
+    {
+        loads = level_cache_loads;
+        selftest_init_level(lvnum);
+        if ((i > 0) && (level_cache_loads == loads))
+        {
+            ERRORLOG("Level %d wasn't loaded from cache",(int)lvnum);
+            result = false;
+        }
+        selftest_store_level_state(state);
+        diff = selftest_first_difference(text_state, state, sizeof(struct Game) + sizeof(struct GameAdd));
+        if (diff >= 0)
+        {
+            ERRORLOG("Level %d differs when %s, at offset %ld of %s",(int)lvnum,(i > 0)?"loaded from cache":"cache is written",
+                (diff < sizeof(struct Game))?diff:diff-(long)sizeof(struct Game),(diff < sizeof(struct Game))?"Game":"GameAdd");
+            result = false;
+        }
+    }
+    level_cache_enabled = false;
+    LbMemoryFree(text_state);
+    LbMemoryFree(state);
+    return result;
+}
+
+static TbBool selftest_level_cache(void)
+{
+    TbBool cache_enabled;
+    long failed;
+    cache_enabled = level_cache_enabled;
+    failed = selftest_for_campaigns_levels(selftest_level_cache_level);
+    level_cache_enabled = cache_enabled;
+    return (failed == 0);
+}
+
+/**
+ * Loads level script from text and from compiled form, and compares the results.
+ */
+static TbBool selftest_script_cache_level(LevelNumber lvnum)
+{
+    struct LevelScript *text_script;
+    char *text_messages;
+    long text_version;
+    unsigned long loads;
+    TbBool result;
+    int i;
+    if (lvnum <= 0)
+        return true;
+    text_script = (struct LevelScript *)LbMemoryAlloc(sizeof(struct LevelScript));
+    text_messages = (char *)LbMemoryAlloc(sizeof(gameadd.quick_messages));
+    if ((text_script == NULL) || (text_messages == NULL))
+    {
+        LbMemoryFree(text_script);
+        LbMemoryFree(text_messages);
+        return false;
+    }
+    // Parse the script from text, without cache
+    script_cache_enabled = false;
+    if (!selftest_load_level_script(lvnum))
+    {
+        SYNCMSG("Level %d doesn't exist, skipped",(int)lvnum);
+        LbMemoryFree(text_script);
+        LbMemoryFree(text_messages);
+        return true;
+    }
+    LbMemoryCopy(text_script, &game.script, sizeof(struct LevelScript));
+    LbMemoryCopy(text_messages, gameadd.quick_messages, sizeof(gameadd.quick_messages));
+    text_version = level_file_version;
+    // First pass compiles the script, second loads the compiled form
+    script_cache_enabled = true;
+    clear_script_cache(lvnum);
+    result = true;
+    for (i=0; i < 2; i++)
+    {
+        loads = script_cache_loads;
+        selftest_load_level_script(lvnum);
+        if ((i > 0) && (script_cache_loads == loads))
+        {
+            // Scripts with errors aren't compiled; they're still compared
+            SYNCMSG("Level %d script wasn't loaded from cache",(int)lvnum);
+        }
+        if ((LbMemoryCompare(text_script, &game.script, sizeof(struct LevelScript)) != 0)
+         || (LbMemoryCompare(text_messages, gameadd.quick_messages, sizeof(gameadd.quick_messages)) != 0)
+         || (text_version != level_file_version))
+        {
+            ERRORLOG("Level %d script differs when %s",(int)lvnum,(i > 0)?"loaded from cache":"compiled");
+            result = false;
+        }
+    }
+    script_cache_enabled = false;
+    LbMemoryFree(text_script);
+    LbMemoryFree(text_messages);
+    return result;
+}
+
+static TbBool selftest_script_cache(void)
+{
+    TbBool cache_enabled;
+    long failed;
+    cache_enabled = script_cache_enabled;
+    failed = selftest_for_campaigns_levels(selftest_script_cache_level);
+    script_cache_enabled = cache_enabled;
+    return (failed == 0);
+}
+
+/**
+ * Loads whole file into newly allocated buffer, without unpacking it.
+ * @return The buffer, or NULL if the file couldn't be read.
+ */
+static unsigned char *selftest_load_file(const char *fname, long *len)
+{
+    unsigned char *buf;
+    TbFileHandle handle;
+    *len = LbFileLength(fname);
+    if (*len < 0)
+        return NULL;
+    buf = (unsigned char *)LbMemoryAlloc(*len + 1);
+    if (buf == NULL)
+        return NULL;
+    handle = LbFileOpen(fname, Lb_FILE_MODE_READ_ONLY);
+    if (handle == -1)
+    {
+        LbMemoryFree(buf);
+        return NULL;
+    }
+    if (LbFileRead(handle, buf, *len) != *len)
+    {
+        LbFileClose(handle);
+        LbMemoryFree(buf);
+        return NULL;
+    }
+    LbFileClose(handle);
+    return buf;
+}
+
+/**
+ * Gives unpacked length stored in RNC header, or -1 if the data isn't RNC packed.
+ */
+static long selftest_rnc_unpacked_length(const unsigned char *packed, long packed_len)
+{
+    if ((packed_len < RNC_HEADER_LEN) || (packed[0] != 'R') || (packed[1] != 'N') || (packed[2] != 'C') || (packed[3] != 1))
+        return -1;
+    return ((long)packed[4] << 24) + ((long)packed[5] << 16) + ((long)packed[6] << 8) + (long)packed[7];
+}
+
+/**
+ * Unpacks RNC file and compares the result with reference file, if it exists.
+ * The unpacker also verifies CRC of the unpacked data, which the packer stored in the header.
+ */
+static TbBool selftest_rnc_file(const char *packed_fname, const char *ref_fname)
+{
+    unsigned char *packed;
+    unsigned char *unpacked;
+    unsigned char *ref;
+    long packed_len,unpacked_len,ref_len;
+    long retcode,diff;
+    TbBool result;
+    packed = selftest_load_file(packed_fname, &packed_len);
+    if (packed == NULL)
+    {
+        ERRORLOG("Couldn't read \"%s\"",packed_fname);
+        return false;
+    }
+    unpacked_len = selftest_rnc_unpacked_length(packed, packed_len);
+    if (unpacked_len < 0)
+    {
+        LbMemoryFree(packed);
+        return true;
+    }
+    unpacked = (unsigned char *)LbMemoryAlloc(unpacked_len + 1);
+    if (unpacked == NULL)
+    {
+        LbMemoryFree(packed);
+        return false;
+    }
+    result = true;
+    retcode = rnc_unpack(packed, unpacked, 0);
+    if (retcode != unpacked_len)
+    {
+        ERRORLOG("Unpacking \"%s\" failed: %s",packed_fname,(retcode < 0)?rnc_error(retcode):"wrong length");
+        result = false;
+    }
+    if (result && (ref_fname != NULL) && LbFileExists(ref_fname))
+    {
+        ref = selftest_load_file(ref_fname, &ref_len);
+        if ((ref == NULL) || (ref_len != unpacked_len))
+        {
+            ERRORLOG("Reference \"%s\" size differs from unpacked \"%s\"",ref_fname,packed_fname);
+            result = false;
+        } else
+        {
+            diff = selftest_first_difference(ref, unpacked, unpacked_len);
+            if (diff >= 0)
+            {
+                ERRORLOG("Unpacked \"%s\" differs from \"%s\" at offset %ld",packed_fname,ref_fname,diff);
+                result = false;
+            }
+        }
+        LbMemoryFree(ref);
+    }
+    LbMemoryFree(unpacked);
+    LbMemoryFree(packed);
+    return result;
+}
+
+/**
+ * Unpacks every RNC file in given file group.
+ * If reference files made by "make rnctest" exist, compares with them.
+ * @return Amount of files which failed.
+ */
+static long selftest_rnc_data_files(short fgroup, const char *prefix)
+{
+    struct TbFileFind fileinfo;
+    char packed_fname[2048];
+    char ref_fname[2048];
+    long failed;
+    int rc;
+    failed = 0;
+    rc = LbFileFindFirst(prepare_file_path(fgroup, "*.*"), &fileinfo, 0x21u);
+    while (rc != -1)
+    {
+        prepare_file_path_buf(packed_fname, fgroup, fileinfo.Filename);
+        LbStringCopy(ref_fname, prepare_file_fmtpath(FGrp_Main, "rnctest/%s_%s.raw", prefix, fileinfo.Filename), sizeof(ref_fname));
+        if (!selftest_rnc_file(packed_fname, ref_fname))
+            failed++;
+        rc = LbFileFindNext(&fileinfo);
+    }
+    LbFileFindEnd(&fileinfo);
+    return failed;
+}
+
+/**
+ * Unpacks the files packed by "make rnctest" and compares them with the originals.
+ * @return Amount of files which failed.
+ */
+static long selftest_rnc_packer_files(void)
+{
+    struct TbFileFind fileinfo;
+    char packed_fname[2048];
+    char ref_fname[2048];
+    long failed,count;
+    int rc;
+    failed = 0;
+    count = 0;
+    rc = LbFileFindFirst(prepare_file_path(FGrp_Main, "rnctest/*.pck"), &fileinfo, 0x21u);
+    while (rc != -1)
+    {
+        LbStringCopy(packed_fname, prepare_file_fmtpath(FGrp_Main, "rnctest/%s", fileinfo.Filename), sizeof(packed_fname));
+        LbStringCopy(ref_fname, packed_fname, sizeof(ref_fname));
+        LbStringCopy(ref_fname + strlen(ref_fname) - 4, ".raw", 5);
+        if (!selftest_rnc_file(packed_fname, ref_fname))
+            failed++;
+        count++;
+        rc = LbFileFindNext(&fileinfo);
+    }
+    LbFileFindEnd(&fileinfo);
+    if (count == 0)
+        SYNCMSG("No RNC packer fixtures found; use \"make rnctest\" to create them");
+    return failed;
+}
+
+static TbBool selftest_rnc(void)
+{
+    long failed;
+    failed = selftest_rnc_data_files(FGrp_StdData, "data");
+    failed += selftest_rnc_data_files(FGrp_LoData, "ldata");
+    failed += selftest_rnc_packer_files();
+    return (failed == 0);
+}
+
+/**
+ * Measures RNC unpacking speed on the packed files in data folder.
+ */
+static TbBool selftest_rnc_benchmark(void)
+{
+    struct TbFileFind fileinfo;
+    unsigned char *packed;
+    unsigned char *unpacked;
+    long packed_len,unpacked_len;
+    unsigned long long total_len;
+    TbClockUSec total_time,start_time;
+    TbBool result;
+    int rc,i;
+    total_len = 0;
+    total_time = 0;
+    result = true;
+    rc = LbFileFindFirst(prepare_file_path(FGrp_StdData, "*.*"), &fileinfo, 0x21u);
+    while (rc != -1)
+    {
+        packed = selftest_load_file(prepare_file_path(FGrp_StdData, fileinfo.Filename), &packed_len);
+        unpacked_len = -1;
+        if (packed != NULL)
+            unpacked_len = selftest_rnc_unpacked_length(packed, packed_len);
+        unpacked = NULL;
+        if (unpacked_len >= 0)
+            unpacked = (unsigned char *)LbMemoryAlloc(unpacked_len + 1);
+        if (unpacked != NULL)
+        {
+            start_time = LbTimerClockMicro();
+            for (i=0; i < SELFTEST_RNC_BENCHMARK_LOOPS; i++)
+            {
+                if (rnc_unpack(packed, unpacked, 0) != unpacked_len)
+                {
+                    ERRORLOG("Unpacking \"%s\" failed",fileinfo.Filename);
+                    result = false;
+                    break;
+                }
+            }
+            total_time += LbTimerClockMicro() - start_time;
+            total_len += (unsigned long long)unpacked_len * i;
+        }
+        LbMemoryFree(unpacked);
+        LbMemoryFree(packed);
+        rc = LbFileFindNext(&fileinfo);
+    }
+    LbFileFindEnd(&fileinfo);
+    if (total_time < 1)
+        total_time = 1;
+    SYNCMSG("Unpacked %lu kB in %lu ms, %lu kB/s",(unsigned long)(total_len/1024),(unsigned long)(total_time/1000),
+        (unsigned long)(total_len * 1000000 / 1024 / total_time));
+    return result;
+}
+
+/**
+ * Starts given level of the current campaign as local game, like the "-level" command line option does.
+ * @return True if the level was loaded.
+ */
+static TbBool selftest_start_level(LevelNumber lvnum)
+{
+    struct PlayerInfo *player;
+    srand(1);
+    my_player_number = default_loc_player;
+    game.game_kind = GKind_LocalGame;
+    set_selected_level_number(lvnum);
+    player = get_my_player();
+    player->field_2C = 1;
+    startup_network_game(true);
+    player = get_my_player();
+    player->flgfield_6 &= ~PlaF6_PlyrHasQuit;
+    if (get_loaded_level_number() != lvnum)
+    {
+        ERRORLOG("Couldn't start level %d",(int)lvnum);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Gives first single player level of the current campaign, used by benchmarks.
+ */
+static LevelNumber selftest_benchmark_level(void)
+{
+    if (!is_campaign_loaded())
+    {
+        if (!change_campaign(""))
+            return SINGLEPLAYER_NOTSTARTED;
+    }
+    return campaign.single_levels[0];
+}
+
+/**
+ * Runs game logic for given amount of turns, without drawing or sounds.
+ * @return Time of the slowest turn, in microseconds.
+ */
+static TbClockUSec selftest_process_turns(long turns, TbClockUSec *total_time)
+{
+    TbClockUSec start_time,turn_time,max_time;
+    long i;
+    max_time = 0;
+    for (i=0; i < turns; i++)
+    {
+        start_time = LbTimerClockMicro();
+        game.play_gameturn++;
+        clear_active_dungeons_stats();
+        update_things();
+        process_rooms();
+        process_dungeons();
+        turn_time = LbTimerClockMicro() - start_time;
+        *total_time += turn_time;
+        if (max_time < turn_time)
+            max_time = turn_time;
+    }
+    return max_time;
+}
+
+/**
+ * Tags slabs for digging, starting with the ones nearest to given position.
+ * @return Amount of slabs tagged.
+ */
+static long selftest_tag_slabs_around(PlayerNumber plyr_idx, MapSlabCoord cslb_x, MapSlabCoord cslb_y, long max_count)
+{
+    MapSlabCoord slb_x,slb_y;
+    long count,dist;
+    count = 0;
+    for (dist=0; (dist < map_tiles_x) || (dist < map_tiles_y); dist++)
+    {
+        for (slb_y=cslb_y-dist; slb_y <= cslb_y+dist; slb_y++)
+        {
+            for (slb_x=cslb_x-dist; slb_x <= cslb_x+dist; slb_x++)
+            {
+                // Only the ring at given distance
+                if ((abs(slb_x-cslb_x) != dist) && (abs(slb_y-cslb_y) != dist))
+                    continue;
+                if ((slb_x < 0) || (slb_x >= map_tiles_x) || (slb_y < 0) || (slb_y >= map_tiles_y))
+                    continue;
+                if (count >= max_count)
+                    return count;
+                if (tag_blocks_for_digging_in_area(slab_subtile(slb_x,0), slab_subtile(slb_y,0), plyr_idx))
+                    count++;
+            }
+        }
+    }
+    return count;
+}
+
+static long selftest_count_dungeon_tasks(const struct Dungeon *dungeon)
+{
+    long i,count;
+    count = 0;
+    for (i=0; i < dungeon->field_AF7; i++)
+    {
+        if (dungeon->task_list[i].kind != SDDigTask_None)
+            count++;
+    }
+    return count;
+}
+
+/**
+ * Measures game turns time on a level with a lot of diggers and tagged slabs.
+ */
+static TbBool selftest_digger_benchmark(void)
+{
+    struct Dungeon *dungeon;
+    struct Thing *heartng;
+    LevelNumber lvnum;
+    TbClockUSec total_time,max_time;
+    MapCoord pos_x,pos_y;
+    long diggers_count,tagged_count,tasks_count;
+    long i;
+    lvnum = selftest_benchmark_level();
+    if (!selftest_start_level(lvnum))
+        return false;
+    dungeon = get_players_num_dungeon(my_player_number);
+    heartng = get_player_soul_container(my_player_number);
+    if (thing_is_invalid(heartng))
+    {
+        ERRORLOG("Player %d has no dungeon heart on level %d",(int)my_player_number,(int)lvnum);
+        return false;
+    }
+    // Diggers are placed on the heart room floor, around the heart
+    diggers_count = 0;
+    for (i=0; i < SELFTEST_DIGGER_BENCHMARK_DIGGERS; i++)
+    {
+        pos_x = heartng->mappos.x.val + ((i % 2 == 0) ? ((i % 4) - 1) * 2 * STL_PER_SLB * COORD_PER_STL : 0);
+        pos_y = heartng->mappos.y.val + ((i % 2 != 0) ? ((i % 4) - 2) * 2 * STL_PER_SLB * COORD_PER_STL : 0);
+        if (create_owned_special_digger(pos_x, pos_y, my_player_number))
+            diggers_count++;
+    }
+    tagged_count = selftest_tag_slabs_around(my_player_number, subtile_slab_fast(heartng->mappos.x.stl.num),
+        subtile_slab_fast(heartng->mappos.y.stl.num), SELFTEST_DIGGER_BENCHMARK_TAGS);
+    tasks_count = selftest_count_dungeon_tasks(dungeon);
+    SYNCMSG("Level %d: created %ld diggers, tagged %ld slabs, %ld of them fit in tasks list",
+        (int)lvnum,diggers_count,tagged_count,tasks_count);
+    total_time = 0;
+    max_time = selftest_process_turns(SELFTEST_DIGGER_BENCHMARK_TURNS, &total_time);
+    SYNCMSG("Processed %ld turns in %lu ms, average %lu us, max %lu us; %ld tasks left",(long)SELFTEST_DIGGER_BENCHMARK_TURNS,
+        (unsigned long)(total_time/1000),(unsigned long)(total_time/SELFTEST_DIGGER_BENCHMARK_TURNS),
+        (unsigned long)max_time,selftest_count_dungeon_tasks(dungeon));
+    return (diggers_count > 0);
+}
+
+/**
+ * Writes lines into the stress test log, from one of the test threads.
+ * Some lines are longer than a log ring slot, so they're stored the other way.
+ */
+static int selftest_log_stress_thread(void *arg)
+{
+    struct SelfTestLogThread *lthread;
+    char padding[SELFTEST_LOG_STRESS_LONG_LEN+1];
+    unsigned long i;
+    lthread = (struct SelfTestLogThread *)arg;
+    LbMemorySet(padding, 'a' + lthread->thread_idx, SELFTEST_LOG_STRESS_LONG_LEN);
+    padding[SELFTEST_LOG_STRESS_LONG_LEN] = '\0';
+    for (i=0; i < SELFTEST_LOG_STRESS_LINES; i++)
+    {
+        if ((i % SELFTEST_LOG_STRESS_LONG_EVERY) == 0)
+            LbLogMessage(lthread->log, "STRESS %d %lu %s\n", (int)lthread->thread_idx, i, padding);
+        else
+            LbLogMessage(lthread->log, "STRESS %d %lu\n", (int)lthread->thread_idx, i);
+    }
+    return 0;
+}
+
+/**
+ * Reads the stress test log, and checks whether lines of every thread are complete and in order.
+ */
+static TbBool selftest_log_stress_verify(const char *fname)
+{
+    unsigned long next_line[SELFTEST_LOG_STRESS_THREADS];
+    char text[LOG_LINE_MAX_LEN];
+    FILE *file;
+    unsigned long line_idx,total;
+    int thread_idx,pos,len,i;
+    TbBool result;
+    file = fopen(fname, "r");
+    if (file == NULL)
+    {
+        ERRORLOG("Couldn't open \"%s\"",fname);
+        return false;
+    }
+    for (i=0; i < SELFTEST_LOG_STRESS_THREADS; i++)
+        next_line[i] = 0;
+    total = 0;
+    result = true;
+    while (result && (fgets(text, sizeof(text), file) != NULL))
+    {
+        // Skip the log header
+        if (strncmp(text, "STRESS ", 7) != 0)
+            continue;
+        pos = 0;
+        if ((sscanf(text, "STRESS %d %lu%n", &thread_idx, &line_idx, &pos) < 2)
+          || (thread_idx < 0) || (thread_idx >= SELFTEST_LOG_STRESS_THREADS))
+        {
+            ERRORLOG("Malformed line %lu: \"%.40s\"",total,text);
+            result = false;
+            break;
+        }
+        if (line_idx != next_line[thread_idx])
+        {
+            ERRORLOG("Thread %d line %lu found where line %lu was expected",thread_idx,line_idx,next_line[thread_idx]);
+            result = false;
+            break;
+        }
+        // Long lines have padding made of one letter
+        len = 0;
+        if ((line_idx % SELFTEST_LOG_STRESS_LONG_EVERY) == 0)
+        {
+            if (text[pos] == ' ')
+                pos++;
+            while (text[pos+len] == 'a' + thread_idx)
+                len++;
+        }
+        if ((len != (((line_idx % SELFTEST_LOG_STRESS_LONG_EVERY) == 0) ? SELFTEST_LOG_STRESS_LONG_LEN : 0))
+          || (strcmp(&text[pos+len], "\n") != 0))
+        {
+            ERRORLOG("Thread %d line %lu is damaged",thread_idx,line_idx);
+            result = false;
+            break;
+        }
+        next_line[thread_idx]++;
+        total++;
+    }
+    fclose(file);
+    for (i=0; result && (i < SELFTEST_LOG_STRESS_THREADS); i++)
+    {
+        if (next_line[i] != SELFTEST_LOG_STRESS_LINES)
+        {
+            ERRORLOG("Thread %d wrote %lu lines, but only %lu are in the log",i,(unsigned long)SELFTEST_LOG_STRESS_LINES,next_line[i]);
+            result = false;
+        }
+    }
+    SYNCMSG("Verified %lu log lines",total);
+    return result;
+}
+
+/**
+ * Logs a lot of lines from several threads at once into separate log file,
+ * then checks that all the lines were written, and in order.
+ */
+static TbBool selftest_log_stress(void)
+{
+    struct SelfTestLogThread lthreads[SELFTEST_LOG_STRESS_THREADS];
+    struct TbLog stress_log;
+    char fname[DISKPATH_SIZE];
+    TbClockUSec start_time,total_time;
+    TbBool result;
+    int i;
+    LbStringCopy(fname, prepare_file_path(FGrp_Main, "logstress.log"), sizeof(fname));
+    if (LbLogSetup(&stress_log, fname, 0x01|0x04) != 1)
+    {
+        ERRORLOG("Couldn't set up \"%s\"",fname);
+        return false;
+    }
+    start_time = LbTimerClockMicro();
+    for (i=0; i < SELFTEST_LOG_STRESS_THREADS; i++)
+    {
+        lthreads[i].log = &stress_log;
+        lthreads[i].thread_idx = i;
+        lthreads[i].thread = SDL_CreateThread(selftest_log_stress_thread, &lthreads[i]);
+    }
+    result = true;
+    for (i=0; i < SELFTEST_LOG_STRESS_THREADS; i++)
+    {
+        if (lthreads[i].thread == NULL)
+        {
+            ERRORLOG("Couldn't create thread %d",i);
+            result = false;
+            continue;
+        }
+        SDL_WaitThread(lthreads[i].thread, NULL);
+    }
+    // Closing writes all the lines which are still in the ring
+    LbLogClose(&stress_log);
+    total_time = LbTimerClockMicro() - start_time;
+    SYNCMSG("Logged %lu lines from %d threads in %lu ms",(unsigned long)SELFTEST_LOG_STRESS_LINES*SELFTEST_LOG_STRESS_THREADS,
+        (int)SELFTEST_LOG_STRESS_THREADS,(unsigned long)(total_time/1000));
+    if (result)
+        result = selftest_log_stress_verify(fname);
+    LbFileDelete(fname);
+    return result;
+}
+
+/**
+ * Gives pseudo-random coordinate within given range; the same sequence on every run.
+ */
+static MapCoord selftest_coord_in_range(unsigned long *seed, MapCoord start, MapCoord end)
+{
+    *seed = (*seed) * 1103515245 + 12345;
+    return start + (MapCoord)(((*seed) >> 8) % (unsigned long)(end - start));
+}
+
+/**
+ * Finds distances to the lights which should cast shadows at given position,
+ * by checking every light; it's how find_closest_lights() worked before the lights grid.
+ * @return Amount of lights found; their distances are sorted.
+ */
+static long selftest_closest_lights_linear(const struct Coord3d *pos, long *nlgt_dist)
+{
+    struct Light *lgt;
+    long i,k,n,dist;
+    for (k=0; k < SHADOW_SOURCES_MAX_COUNT; k++)
+        nlgt_dist[k] = LONG_MAX;
+    for (i=1; i < LIGHTS_COUNT; i++)
+    {
+        lgt = &game.lish.lights[i];
+        if ((lgt->flags & (LgtF_Allocated|LgtF_Unkn02)) != (LgtF_Allocated|LgtF_Unkn02))
+            continue;
+        dist = get_2d_box_distance(pos, &lgt->mappos);
+        if ((dist >= SHADOW_SOURCES_MAX_DISTANCE) || (nlgt_dist[settings.video_shadows-1] <= dist)
+          || (pos->x.val == lgt->mappos.x.val) || (pos->y.val == lgt->mappos.y.val))
+            continue;
+        for (k = settings.video_shadows-1; (k > 0) && (nlgt_dist[k-1] > dist); k--)
+            nlgt_dist[k] = nlgt_dist[k-1];
+        nlgt_dist[k] = dist;
+    }
+    for (n=0; (n < SHADOW_SOURCES_MAX_COUNT) && (nlgt_dist[n] != LONG_MAX); n++);
+    return n;
+}
+
+/**
+ * Measures finding lights which cast shadows of many creatures, with a lot of lights around.
+ * Positions of creatures are only used for the lookup, so no creature things are created.
+ * Results of the lights grid are compared with checking every light.
+ */
+static TbBool selftest_lights_benchmark(void)
+{
+    struct Coord3d crtr_pos[SELFTEST_LIGHTS_BENCHMARK_CREATURES];
+    long lights[SELFTEST_LIGHTS_BENCHMARK_LIGHTS];
+    long nlgt_dist[SHADOW_SOURCES_MAX_COUNT];
+    struct NearestLights nlgt;
+    struct InitLight ilght;
+    struct Coord3d pos;
+    struct Thing *heartng;
+    LevelNumber lvnum;
+    MapCoord start_x,start_y,end_x,end_y;
+    TbClockUSec grid_time,linear_time,start_time;
+    unsigned char video_shadows;
+    unsigned long seed;
+    long lights_count,dynamic_count;
+    long frame,i,k,count,linear_count;
+    TbBool result;
+    lvnum = selftest_benchmark_level();
+    if (!selftest_start_level(lvnum))
+        return false;
+    heartng = get_player_soul_container(my_player_number);
+    if (thing_is_invalid(heartng))
+    {
+        ERRORLOG("Player %d has no dungeon heart on level %d",(int)my_player_number,(int)lvnum);
+        return false;
+    }
+    // Area of the map which would be visible on screen, around the heart
+    start_x = max(heartng->mappos.x.val - SELFTEST_LIGHTS_BENCHMARK_AREA/2, COORD_PER_STL);
+    start_y = max(heartng->mappos.y.val - SELFTEST_LIGHTS_BENCHMARK_AREA/2, COORD_PER_STL);
+    end_x = min(start_x + SELFTEST_LIGHTS_BENCHMARK_AREA, (map_subtiles_x-1)*COORD_PER_STL);
+    end_y = min(start_y + SELFTEST_LIGHTS_BENCHMARK_AREA, (map_subtiles_y-1)*COORD_PER_STL);
+    // Dynamic lights are limited by shadow caches, so the rest is static
+    seed = 1;
+    lights_count = 0;
+    dynamic_count = 0;
+    LbMemorySet(&ilght, 0, sizeof(struct InitLight));
+    ilght.field_0 = SELFTEST_LIGHTS_BENCHMARK_RADIUS;
+    ilght.field_2 = 32;
+    for (i=0; i < SELFTEST_LIGHTS_BENCHMARK_LIGHTS; i++)
+    {
+        ilght.mappos.x.val = selftest_coord_in_range(&seed, start_x, end_x);
+        ilght.mappos.y.val = selftest_coord_in_range(&seed, start_y, end_y);
+        ilght.mappos.z.val = 2*COORD_PER_STL;
+        ilght.is_dynamic = 1;
+        lights[lights_count] = light_create_light(&ilght);
+        if (lights[lights_count] != 0) {
+            dynamic_count++;
+        } else {
+            ilght.is_dynamic = 0;
+            lights[lights_count] = light_create_light(&ilght);
+        }
+        if (lights[lights_count] == 0)
+            break;
+        lights_count++;
+    }
+    for (i=0; i < SELFTEST_LIGHTS_BENCHMARK_CREATURES; i++)
+    {
+        crtr_pos[i].x.val = selftest_coord_in_range(&seed, start_x, end_x);
+        crtr_pos[i].y.val = selftest_coord_in_range(&seed, start_y, end_y);
+        crtr_pos[i].z.val = 0;
+    }
+    SYNCMSG("Level %d: created %ld lights, %ld of them dynamic",(int)lvnum,lights_count,dynamic_count);
+    video_shadows = settings.video_shadows;
+    settings.video_shadows = SHADOW_SOURCES_MAX_COUNT;
+    grid_time = 0;
+    linear_time = 0;
+    result = true;
+    for (frame=0; frame < SELFTEST_LIGHTS_BENCHMARK_FRAMES; frame++)
+    {
+        // Dynamic lights move every frame, like the things they're attached to
+        for (i=0; i < dynamic_count; i++)
+        {
+            pos.x.val = selftest_coord_in_range(&seed, start_x, end_x);
+            pos.y.val = selftest_coord_in_range(&seed, start_y, end_y);
+            pos.z.val = 2*COORD_PER_STL;
+            light_set_light_position(lights[i], &pos);
+        }
+        start_time = LbTimerClockMicro();
+        for (i=0; i < SELFTEST_LIGHTS_BENCHMARK_CREATURES; i++)
+        {
+            find_closest_lights(&crtr_pos[i], &nlgt);
+        }
+        grid_time += LbTimerClockMicro() - start_time;
+        start_time = LbTimerClockMicro();
+        for (i=0; i < SELFTEST_LIGHTS_BENCHMARK_CREATURES; i++)
+        {
+            selftest_closest_lights_linear(&crtr_pos[i], nlgt_dist);
+        }
+        linear_time += LbTimerClockMicro() - start_time;
+        // Lights at equal distance may be listed in any order, so only distances are compared
+        for (i=0; result && (i < SELFTEST_LIGHTS_BENCHMARK_CREATURES); i++)
+        {
+            count = find_closest_lights(&crtr_pos[i], &nlgt);
+            linear_count = selftest_closest_lights_linear(&crtr_pos[i], nlgt_dist);
+            if (count != linear_count)
+            {
+                ERRORLOG("Frame %ld: found %ld lights for creature %ld, instead of %ld",frame,count,i,linear_count);
+                result = false;
+                break;
+            }
+            for (k=0; k < count; k++)
+            {
+                if (get_2d_box_distance(&crtr_pos[i], &nlgt.coord[k]) != nlgt_dist[k])
+                {
+                    ERRORLOG("Frame %ld: light %ld of creature %ld is at wrong distance",frame,k,i);
+                    result = false;
+                    break;
+                }
+            }
+        }
+    }
+    settings.video_shadows = video_shadows;
+    SYNCMSG("Lights for %ld creatures in %ld frames found in %lu us with grid, %lu us checking every light",
+        (long)SELFTEST_LIGHTS_BENCHMARK_CREATURES,(long)SELFTEST_LIGHTS_BENCHMARK_FRAMES,
+        (unsigned long)grid_time,(unsigned long)linear_time);
+    for (i=0; i < lights_count; i++)
+        light_delete_light(lights[i]);
+    return result;
+}
+
+/**
+ * Loads the frontend background image, which tests use as captured frame.
+ * @return The image, SELFTEST_FRAME_IMAGE_WIDTH pixels wide, or NULL on error.
+ */
+static unsigned char *selftest_load_frame_image(long *image_height)
+{
+    unsigned char *image;
+    *image_height = 0;
+    image = (unsigned char *)LbMemoryAlloc(LbFileLengthRnc(prepare_file_path(FGrp_LoData, "front.raw")) + 1);
+    if (image == NULL)
+        return NULL;
+    *image_height = LbFileLoadAt(prepare_file_path(FGrp_LoData, "front.raw"), image) / SELFTEST_FRAME_IMAGE_WIDTH;
+    if (*image_height < 1)
+    {
+        LbMemoryFree(image);
+        return NULL;
+    }
+    return image;
+}
+
+/**
+ * Draws given lens effect on the frame for a few turns, the same way as in the game.
+ * @return Checksum of all the output frames.
+ */
+static unsigned long selftest_lens_draw_frames(long effect, unsigned char *dstbuf, unsigned char *srcbuf,
+    long width, long height, TbClockUSec *total_time)
+{
+    TbClockUSec start_time;
+    unsigned long checksum;
+    long i;
+    // Set up from scratch, so that the mist starts at the same place
+    setup_eye_lens(0);
+    setup_eye_lens(effect);
+    checksum = 0;
+    for (i=0; i < SELFTEST_LENS_BENCHMARK_FRAMES; i++)
+    {
+        start_time = LbTimerClockMicro();
+        draw_lens_effect(dstbuf, eye_lens_width, srcbuf, eye_lens_width, width, height, effect);
+        *total_time += LbTimerClockMicro() - start_time;
+        checksum = cache_hash(checksum, dstbuf, eye_lens_width*height);
+    }
+    return checksum;
+}
+
+/**
+ * Draws every lens effect offscreen, on a frame made of the frontend background image,
+ * first with one thread and then with the workers pool. Output checksums have to be equal.
+ */
+static TbBool selftest_lens_benchmark(void)
+{
+    unsigned char *image;
+    unsigned char *srcbuf;
+    unsigned char *dstbuf;
+    TbClockUSec serial_time,parallel_time;
+    unsigned long serial_checksum,parallel_checksum;
+    long width,height,image_height;
+    long workers_count;
+    long effect,x,y;
+    TbBool result;
+    if ((game.flags_cd & MFlg_EyeLensReady) == 0)
+        initialise_eye_lenses();
+    if ((game.flags_cd & MFlg_EyeLensReady) == 0)
+    {
+        ERRORLOG("Eye lenses are disabled or not initialized");
+        return false;
+    }
+    width = MyScreenWidth/pixel_size;
+    height = MyScreenHeight/pixel_size;
+    if ((width > eye_lens_width) || (height > eye_lens_height) || (width < 1) || (height < 1))
+    {
+        ERRORLOG("Screen size %ldx%ld doesn't match eye lens buffer",width,height);
+        return false;
+    }
+    image = selftest_load_frame_image(&image_height);
+    srcbuf = (unsigned char *)LbMemoryAlloc(eye_lens_width * eye_lens_height);
+    dstbuf = (unsigned char *)LbMemoryAlloc(eye_lens_width * eye_lens_height);
+    if ((image == NULL) || (srcbuf == NULL) || (dstbuf == NULL))
+    {
+        ERRORLOG("Couldn't prepare the frame");
+        LbMemoryFree(image);
+        LbMemoryFree(srcbuf);
+        LbMemoryFree(dstbuf);
+        return false;
+    }
+    for (y=0; y < eye_lens_height; y++)
+    {
+        for (x=0; x < eye_lens_width; x++)
+            srcbuf[y*eye_lens_width+x] = image[(y % image_height)*SELFTEST_FRAME_IMAGE_WIDTH + (x % SELFTEST_FRAME_IMAGE_WIDTH)];
+    }
+    LbMemoryFree(image);
+    workers_count = LbWorkersCount();
+    result = true;
+    for (effect=1; effect < lenses_conf.lenses_count; effect++)
+    {
+        serial_time = 0;
+        parallel_time = 0;
+        LbWorkersInit(1);
+        serial_checksum = selftest_lens_draw_frames(effect, dstbuf, srcbuf, width, height, &serial_time);
+        LbWorkersInit(workers_count);
+        parallel_checksum = selftest_lens_draw_frames(effect, dstbuf, srcbuf, width, height, &parallel_time);
+        SYNCMSG("Lens %ld \"%s\" at %ldx%ld: checksum %08lx, %lu us per frame with 1 thread, %lu us with %ld threads",
+            effect,lenses_conf.lenses[effect].code_name,width,height,parallel_checksum,
+            (unsigned long)(serial_time/SELFTEST_LENS_BENCHMARK_FRAMES),
+            (unsigned long)(parallel_time/SELFTEST_LENS_BENCHMARK_FRAMES),workers_count);
+        if (serial_checksum != parallel_checksum)
+        {
+            ERRORLOG("Lens %ld output checksum %08lx differs from %08lx drawn with 1 thread",
+                effect,parallel_checksum,serial_checksum);
+            result = false;
+        }
+    }
+    setup_eye_lens(0);
+    LbMemoryFree(srcbuf);
+    LbMemoryFree(dstbuf);
+    return result;
+}
+
+/**
+ * Makes a frame for the movie capture test. The image scrolls every second frame,
+ * a solid box appears and palette changes from time to time, so that all kinds
+ * of FLI chunks are used by the encoder.
+ */
+static void selftest_movie_make_frame(unsigned char *frame, long line_stride, unsigned char *palette,
+    const unsigned char *image, long image_height, long width, long height, long frame_idx)
+{
+    long shift;
+    long x,y,i;
+    shift = (frame_idx / 2) * 5;
+    for (y=0; y < height; y++)
+    {
+        for (x=0; x < width; x++)
+            frame[y*line_stride+x] = image[((y + shift/3) % image_height)*SELFTEST_FRAME_IMAGE_WIDTH + (x + shift) % SELFTEST_FRAME_IMAGE_WIDTH];
+    }
+    if ((frame_idx % 10) >= 5)
+    {
+        for (y=0; y < height/4; y++)
+        {
+            for (x=0; x < width/3; x++)
+                frame[y*line_stride+x] = frame_idx;
+        }
+    }
+    for (i=0; i < 768; i++)
+        palette[i] = (i * (i % 3 + 1) + frame_idx / 8) & 0x3F;
+}
+
+/**
+ * Records frames of the movie capture test into given file, compressing them
+ * while capturing or with the encoder thread.
+ * @param src_hashes If not NULL, receives checksums of the captured frames, with palette as stored in FLI.
+ */
+static TbBool selftest_movie_record(char *fname, TbBool threaded, const unsigned char *image, long image_height,
+    unsigned long *src_hashes, TbClockUSec *capture_time, TbClockUSec *finish_time)
+{
+    unsigned char palette[768];
+    unsigned char *frame;
+    TbClockUSec start_time;
+    long width,height,line_stride;
+    long i,y;
+    TbBool result;
+    width = MyScreenWidth/pixel_size;
+    height = MyScreenHeight/pixel_size;
+    line_stride = LbGraphicsScreenWidth();
+    frame = (unsigned char *)LbMemoryAlloc(line_stride * height);
+    if (frame == NULL)
+    {
+        ERRORLOG("Couldn't allocate the frame");
+        return false;
+    }
+    if (!anim_open(fname, 0, 0, width, height, 8, 1))
+    {
+        ERRORLOG("Couldn't start recording \"%s\"",fname);
+        LbMemoryFree(frame);
+        return false;
+    }
+    if (threaded && !anim_encoder_start())
+    {
+        ERRORLOG("Couldn't start movie encoder thread");
+        anim_stop();
+        LbMemoryFree(frame);
+        return false;
+    }
+    result = true;
+    for (i=0; i < SELFTEST_MOVIE_FRAMES; i++)
+    {
+        selftest_movie_make_frame(frame, line_stride, palette, image, image_height, width, height, i);
+        start_time = LbTimerClockMicro();
+        if (!anim_record_frame(frame, palette))
+        {
+            ERRORLOG("Recording frame %ld into \"%s\" failed",i,fname);
+            result = false;
+            break;
+        }
+        *capture_time += LbTimerClockMicro() - start_time;
+        if (src_hashes != NULL)
+        {
+            src_hashes[i] = 0;
+            for (y=0; y < height; y++)
+                src_hashes[i] = cache_hash(src_hashes[i], &frame[y*line_stride], width);
+            for (y=0; y < 768; y++)
+                palette[y] <<= 2;
+            src_hashes[i] = cache_hash(src_hashes[i], palette, sizeof(palette));
+        }
+    }
+    start_time = LbTimerClockMicro();
+    if (!anim_stop())
+        result = false;
+    *finish_time += LbTimerClockMicro() - start_time;
+    LbMemoryFree(frame);
+    return result;
+}
+
+/**
+ * Decodes FLI chunk of given type, updating the frame and palette.
+ * @return False if the chunk is damaged or of unsupported type.
+ */
+static TbBool selftest_movie_decode_chunk(unsigned short ctype, const unsigned char *data, long len,
+    unsigned char *frame, unsigned char *palette, long width, long height)
+{
+    const unsigned char *end;
+    unsigned char *dst;
+    long npackets,nlines;
+    long count,x,y,i;
+    end = data + len;
+    switch (ctype)
+    {
+    case FLI_COLOR256:
+        if (len < 2)
+            return false;
+        npackets = *(unsigned short *)data;
+        data += 2;
+        i = 0;
+        for (; npackets > 0; npackets--)
+        {
+            if (data + 2 > end)
+                return false;
+            i += data[0];
+            count = data[1];
+            data += 2;
+            if (count == 0)
+                count = 256;
+            if ((i + count > 256) || (data + 3*count > end))
+                return false;
+            LbMemoryCopy(&palette[3*i], data, 3*count);
+            data += 3*count;
+            i += count;
+        }
+        return true;
+    case FLI_BRUN:
+        for (y=0; y < height; y++)
+        {
+            // Skip the packets count, the line ends when it's filled
+            data++;
+            dst = &frame[y*width];
+            for (x=0; x < width; x += count)
+            {
+                if (data + 2 > end)
+                    return false;
+                count = (signed char)*data;
+                data++;
+                if (count > 0)
+                {
+                    if (x + count > width)
+                        return false;
+                    LbMemorySet(&dst[x], *data, count);
+                    data++;
+                } else
+                {
+                    count = -count;
+                    if ((count == 0) || (x + count > width) || (data + count > end))
+                        return false;
+                    LbMemoryCopy(&dst[x], data, count);
+                    data += count;
+                }
+            }
+        }
+        return true;
+    case FLI_SS2:
+        if (len < 2)
+            return false;
+        nlines = *(unsigned short *)data;
+        data += 2;
+        y = 0;
+        while (nlines > 0)
+        {
+            if (data + 2 > end)
+                return false;
+            npackets = *(short *)data;
+            data += 2;
+            if (npackets < 0)
+            {
+                // Amount of unchanged lines to skip
+                y -= npackets;
+                continue;
+            }
+            if (y >= height)
+                return false;
+            dst = &frame[y*width];
+            x = 0;
+            for (; npackets > 0; npackets--)
+            {
+                if (data + 2 > end)
+                    return false;
+                x += data[0];
+                count = (signed char)data[1];
+                data += 2;
+                if (count >= 0)
+                {
+                    if ((x + 2*count > width) || (data + 2*count > end))
+                        return false;
+                    LbMemoryCopy(&dst[x], data, 2*count);
+                    data += 2*count;
+                    x += 2*count;
+                } else
+                {
+                    count = -count;
+                    if ((x + 2*count > width) || (data + 2 > end))
+                        return false;
+                    for (i=0; i < count; i++)
+                    {
+                        dst[x++] = data[0];
+                        dst[x++] = data[1];
+                    }
+                    data += 2;
+                }
+            }
+            y++;
+            nlines--;
+        }
+        return true;
+    case FLI_LC:
+        if (len < 4)
+            return false;
+        y = *(unsigned short *)data;
+        nlines = *(unsigned short *)(data+2);
+        data += 4;
+        for (; nlines > 0; nlines--, y++)
+        {
+            if ((data >= end) || (y >= height))
+                return false;
+            npackets = *data;
+            data++;
+            dst = &frame[y*width];
+            x = 0;
+            for (; npackets > 0; npackets--)
+            {
+                if (data + 2 > end)
+                    return false;
+                x += data[0];
+                count = (signed char)data[1];
+                data += 2;
+                if (count >= 0)
+                {
+                    if ((x + count > width) || (data + count > end))
+                        return false;
+                    LbMemoryCopy(&dst[x], data, count);
+                    data += count;
+                    x += count;
+                } else
+                {
+                    count = -count;
+                    if ((x + count > width) || (data >= end))
+                        return false;
+                    LbMemorySet(&dst[x], *data, count);
+                    data++;
+                    x += count;
+                }
+            }
+        }
+        return true;
+    case FLI_BLACK:
+        LbMemorySet(frame, 0, width*height);
+        return true;
+    case FLI_COPY:
+        if (len < width*height)
+            return false;
+        LbMemoryCopy(frame, data, width*height);
+        return true;
+    default:
+        return false;
+    }
+}
+
+/**
+ * Decodes FLI movie and computes checksum of every frame, with palette.
+ * @return Amount of frames in the movie, or -1 if it couldn't be decoded.
+ */
+static long selftest_movie_decode(const char *fname, long width, long height, unsigned long *frame_hashes, long max_frames)
+{
+    struct AnimFLIHeader header;
+    struct AnimFLIPrefix prefix;
+    struct AnimFLIChunk chunk;
+    unsigned char palette[768];
+    unsigned char *frame;
+    unsigned char *buf;
+    long len,pos,chunk_pos;
+    long frames_count;
+    long i;
+    buf = selftest_load_file(fname, &len);
+    if (buf == NULL)
+    {
+        ERRORLOG("Couldn't read \"%s\"",fname);
+        return -1;
+    }
+    frame = (unsigned char *)LbMemoryAlloc(width * height);
+    if ((frame == NULL) || (len < (long)sizeof(struct AnimFLIHeader)))
+    {
+        LbMemoryFree(frame);
+        LbMemoryFree(buf);
+        return -1;
+    }
+    LbMemoryCopy(&header, buf, sizeof(struct AnimFLIHeader));
+    if ((header.magic != 0xAF12) || (header.width != width) || (header.height != height))
+    {
+        ERRORLOG("Movie \"%s\" header is wrong",fname);
+        LbMemoryFree(frame);
+        LbMemoryFree(buf);
+        return -1;
+    }
+    LbMemorySet(palette, 0, sizeof(palette));
+    frames_count = 0;
+    for (pos = sizeof(struct AnimFLIHeader); pos < len; pos += prefix.csize)
+    {
+        if (pos + (long)sizeof(struct AnimFLIPrefix) > len)
+            break;
+        LbMemoryCopy(&prefix, &buf[pos], sizeof(struct AnimFLIPrefix));
+        if ((prefix.ctype != FLI_FRAME) || (prefix.csize < (long)sizeof(struct AnimFLIPrefix)) || (pos + prefix.csize > len))
+            break;
+        chunk_pos = pos + (long)sizeof(struct AnimFLIPrefix);
+        for (i=0; i < prefix.nchunks; i++)
+        {
+            if (chunk_pos + (long)sizeof(struct AnimFLIChunk) > pos + prefix.csize)
+                break;
+            LbMemoryCopy(&chunk, &buf[chunk_pos], sizeof(struct AnimFLIChunk));
+            if ((chunk.csize < (long)sizeof(struct AnimFLIChunk)) || (chunk_pos + chunk.csize > pos + prefix.csize))
+                break;
+            if (!selftest_movie_decode_chunk(chunk.ctype, &buf[chunk_pos + sizeof(struct AnimFLIChunk)],
+                chunk.csize - sizeof(struct AnimFLIChunk), frame, palette, width, height))
+                break;
+            chunk_pos += chunk.csize;
+        }
+        if (i < prefix.nchunks)
+            break;
+        if (frames_count < max_frames)
+            frame_hashes[frames_count] = cache_hash(cache_hash(0, frame, width*height), palette, sizeof(palette));
+        frames_count++;
+    }
+    LbMemoryFree(frame);
+    LbMemoryFree(buf);
+    if (pos < len)
+    {
+        ERRORLOG("Movie \"%s\" frame %ld is damaged",fname,frames_count);
+        return -1;
+    }
+    return frames_count;
+}
+
+/**
+ * Records the same frames into two movies, first compressing them while capturing
+ * and then with the encoder thread. Frames decoded from both movies have to be
+ * equal to each other and to the captured frames.
+ * Frames are made offscreen, so the test doesn't need a level to be drawn.
+ */
+static TbBool selftest_movie_capture(void)
+{
+    char sync_fname[2048];
+    char async_fname[2048];
+    unsigned long src_hashes[SELFTEST_MOVIE_FRAMES];
+    unsigned long sync_hashes[SELFTEST_MOVIE_FRAMES];
+    unsigned long async_hashes[SELFTEST_MOVIE_FRAMES];
+    unsigned char *image;
+    TbClockUSec sync_capture_time,sync_finish_time;
+    TbClockUSec async_capture_time,async_finish_time;
+    long width,height,image_height;
+    long sync_frames,async_frames;
+    long i;
+    TbBool result;
+    width = MyScreenWidth/pixel_size;
+    height = MyScreenHeight/pixel_size;
+    if ((LbGraphicsScreenBPP() != 8) || (LbGraphicsScreenWidth() < width))
+    {
+        ERRORLOG("Movies can't be recorded in current screen mode");
+        return false;
+    }
+    image = selftest_load_frame_image(&image_height);
+    if (image == NULL)
+    {
+        ERRORLOG("Couldn't prepare the frame");
+        return false;
+    }
+    LbStringCopy(sync_fname, prepare_file_path(FGrp_SShots, "selftest_sync.flc"), sizeof(sync_fname));
+    LbStringCopy(async_fname, prepare_file_path(FGrp_SShots, "selftest_async.flc"), sizeof(async_fname));
+    sync_capture_time = 0;
+    sync_finish_time = 0;
+    async_capture_time = 0;
+    async_finish_time = 0;
+    result = selftest_movie_record(sync_fname, false, image, image_height, src_hashes,
+        &sync_capture_time, &sync_finish_time);
+    if (result)
+    {
+        result = selftest_movie_record(async_fname, true, image, image_height, NULL,
+            &async_capture_time, &async_finish_time);
+    }
+    LbMemoryFree(image);
+    if (!result)
+        return false;
+    SYNCMSG("Recorded %ld frames at %ldx%ld; capturing took %lu us and finishing %lu us when compressing while capturing, %lu us and %lu us with encoder thread",
+        (long)SELFTEST_MOVIE_FRAMES,width,height,
+        (unsigned long)sync_capture_time,(unsigned long)sync_finish_time,
+        (unsigned long)async_capture_time,(unsigned long)async_finish_time);
+    sync_frames = selftest_movie_decode(sync_fname, width, height, sync_hashes, SELFTEST_MOVIE_FRAMES);
+    async_frames = selftest_movie_decode(async_fname, width, height, async_hashes, SELFTEST_MOVIE_FRAMES);
+    if (sync_frames != SELFTEST_MOVIE_FRAMES)
+    {
+        ERRORLOG("Decoded %ld frames instead of %ld from movie compressed while capturing",sync_frames,(long)SELFTEST_MOVIE_FRAMES);
+        result = false;
+    }
+    if (async_frames != SELFTEST_MOVIE_FRAMES)
+    {
+        ERRORLOG("Decoded %ld frames instead of %ld from movie made by encoder thread",async_frames,(long)SELFTEST_MOVIE_FRAMES);
+        result = false;
+    }
+    for (i=0; result && (i < SELFTEST_MOVIE_FRAMES); i++)
+    {
+        if (sync_hashes[i] != src_hashes[i])
+        {
+            ERRORLOG("Frame %ld compressed while capturing decodes to %08lx instead of %08lx",i,sync_hashes[i],src_hashes[i]);
+            result = false;
+        }
+        if (async_hashes[i] != sync_hashes[i])
+        {
+            ERRORLOG("Frame %ld from encoder thread decodes to %08lx instead of %08lx",i,async_hashes[i],sync_hashes[i]);
+            result = false;
+        }
+    }
+    // Keep the movies for inspection if something went wrong
+    if (result)
+    {
+        LbFileDelete(sync_fname);
+        LbFileDelete(async_fname);
+    }
+    return result;
+}
+
+/**
+ * Runs all tests selected in command line.
+ * @return Amount of failed tests.
+ */
+long selftest_run(void)
+{
+    const struct SelfTestDesc *stdesc;
+    TbClockMSec start_time;
+    TbBool result;
+    selftest.tests_run = 0;
+    selftest.tests_failed = 0;
+    if (!load_campaigns_list())
+    {
+        ERRORLOG("No valid campaign files found");
+    }
+    for (stdesc = selftests_list; stdesc->name != NULL; stdesc++)
+    {
+        if (!selftest_is_selected(stdesc))
+            continue;
+        SYNCMSG("Self test \"%s\" started",stdesc->name);
+        start_time = LbTimerClock();
+        result = stdesc->func();
+        selftest.tests_run++;
+        if (!result)
+            selftest.tests_failed++;
+        SYNCMSG("Self test \"%s\" %s, in %lu ms",stdesc->name,result?"passed":"FAILED",
+            (unsigned long)(LbTimerClock() - start_time));
+    }
+    if (selftest.tests_run == 0)
+        ERRORLOG("No known self test selected by \"%s\"",selftest.names);
+    SYNCMSG("Self tests finished: %ld run, %ld failed",selftest.tests_run,selftest.tests_failed);
+    return selftest.tests_failed;
+}
+/******************************************************************************/
+#ifdef __cplusplus
+}
+#endif
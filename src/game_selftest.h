@@ -0,0 +1,40 @@
+/******************************************************************************/
+// Free implementation of Bullfrog's Dungeon Keeper strategy game.
+/******************************************************************************/
+/** @file game_selftest.h
+ *     Header file for game_selftest.c.
+ * @par Purpose:
+ *     Tests and benchmarks which require game data, run instead of the game.
+ * @par Comment:
+ *     Just a header file - #defines, typedefs, function prototypes etc.
+ * @author   KeeperFX Team
+ * @date     19 Oct 2026 - 19 Oct 2026
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+/******************************************************************************/
+#ifndef DK_GAMESELFTEST_H
+#define DK_GAMESELFTEST_H
+
+#include "bflib_basics.h"
+#include "globals.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/******************************************************************************/
+/** Length of the list of test names given in command line. */
+#define SELFTEST_NAMES_LEN 256
+/******************************************************************************/
+TbBool selftest_set_names(const char *names);
+TbBool selftest_is_set(void);
+long selftest_run(void);
+int selftest_exit_code(void);
+/******************************************************************************/
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,598 @@
+/******************************************************************************/
+// Free implementation of Bullfrog's Dungeon Keeper strategy game.
+/******************************************************************************/
+/** @file game_tournament.c
+ *     Headless matches between computer players, used for tuning computer models.
+ * @par Purpose:
+ *     Runs a list of matches between computer players, each in separate process
+ *     of the game, and stores results of every match in a JSON file.
+ * @par Comment:
+ *     The tournament process only reads the tournament file and starts matches;
+ *     every match is a normal single level game, started with "-aimatch" command
+ *     line option, which makes it skip rendering and frame delays, and quit when
+ *     the match ends.
+ *     Tournament file has [tournament] block with TurnsLimit, Processes (zero
+ *     means one per CPU core), Output (prefix of results file names) and any
+ *     amount of "Match = <level> <model0> <model1> <model2> <model3>" lines.
+ * @author   KeeperFX Team
+ * @date     19 Oct 2026 - 19 Oct 2026
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+/******************************************************************************/
+#include "game_tournament.h"
+
+#include <stdlib.h>
+#include "globals.h"
+#include "bflib_basics.h"
+#include "bflib_memory.h"
+#include "bflib_fileio.h"
+#include "bflib_dernc.h"
+#include "bflib_datetm.h"
+#include "bflib_workers.h"
+
+#include "config.h"
+#include "player_data.h"
+#include "player_utils.h"
+#include "player_computer.h"
+#include "dungeon_data.h"
+#include "game_legacy.h"
+#include "keeperfx.hpp"
+
+#include <windows.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/******************************************************************************/
+/** Max amount of match processes running at once; also limited by what the OS can wait for. */
+#define TOURNAMENT_PROCESSES_MAX 64
+#define TOURNAMENT_CMDLINE_LEN  512
+
+struct TournamentMatchSpec {
+    LevelNumber lvnum;
+    long models[TOURNAMENT_KEEPERS_COUNT];
+};
+
+struct TournamentConfig {
+    char fname[DISKPATH_SIZE];
+    char output_prefix[DISKPATH_SIZE];
+    unsigned long turns_limit;
+    long processes_count;
+    long matches_count;
+    struct TournamentMatchSpec matches[TOURNAMENT_MATCHES_COUNT];
+};
+
+struct TournamentProcess {
+    HANDLE handle;
+    long match_idx;
+};
+
+/** State of the match played by this process. */
+struct TournamentMatch {
+    TbBool active;
+    TbBool finished;
+    long models[TOURNAMENT_KEEPERS_COUNT];
+    unsigned long turns_limit;
+    char out_fname[DISKPATH_SIZE];
+    char log_fname[DISKPATH_SIZE];
+    GameTurn first_turn;
+    TbClockUSec start_time;
+};
+/******************************************************************************/
+const struct NamedCommand tournament_commands[] = {
+  {"TURNSLIMIT",     1},
+  {"PROCESSES",      2},
+  {"OUTPUT",         3},
+  {"MATCH",          4},
+  {NULL,             0},
+  };
+/******************************************************************************/
+static struct TournamentConfig tournament;
+static struct TournamentMatch tournament_match;
+/******************************************************************************/
+TbBool tournament_set_config_file(const char *fname)
+{
+    LbStringCopy(tournament.fname, fname, sizeof(tournament.fname));
+    return (tournament.fname[0] != '\0');
+}
+
+TbBool tournament_is_set(void)
+{
+    return (tournament.fname[0] != '\0');
+}
+
+static TbBool parse_tournament_blocks(char *buf, long len, const char *config_textname)
+{
+    struct TournamentMatchSpec *mtspec;
+    long pos;
+    int i,k,n;
+    int cmd_num;
+    // Block name and parameter word store variables
+    char block_buf[COMMAND_WORD_LEN];
+    char word_buf[COMMAND_WORD_LEN];
+    // Default values
+    tournament.turns_limit = TOURNAMENT_DEFAULT_TURNS_LIMIT;
+    tournament.processes_count = 0;
+    tournament.matches_count = 0;
+    LbStringCopy(tournament.output_prefix, "tournament", sizeof(tournament.output_prefix));
+    // Find the block
+    sprintf(block_buf,"tournament");
+    pos = 0;
+    k = find_conf_block(buf,&pos,len,block_buf);
+    if (k < 0)
+    {
+        WARNMSG("Block [%s] not found in %s file.",block_buf,config_textname);
+        return false;
+    }
+#define COMMAND_TEXT(cmd_num) get_conf_parameter_text(tournament_commands,cmd_num)
+    while (pos<len)
+    {
+        // Finding command number in this line
+        cmd_num = recognize_conf_command(buf,&pos,len,tournament_commands);
+        // Now store the config item in correct place
+        if (cmd_num == -3) break; // if next block starts
+        n = 0;
+        switch (cmd_num)
+        {
+        case 1: // TURNSLIMIT
+            if (get_conf_parameter_single(buf,&pos,len,word_buf,sizeof(word_buf)) > 0)
+            {
+              k = atoi(word_buf);
+              if (k > 0)
+              {
+                  tournament.turns_limit = k;
+                  n++;
+              }
+            }
+            if (n < 1)
+            {
+              CONFWRNLOG("Incorrect value of \"%s\" parameter in [%s] block of %s file.",
+                  COMMAND_TEXT(cmd_num),block_buf,config_textname);
+            }
+            break;
+        case 2: // PROCESSES
+            if (get_conf_parameter_single(buf,&pos,len,word_buf,sizeof(word_buf)) > 0)
+            {
+              k = atoi(word_buf);
+              if (k >= 0)
+              {
+                  tournament.processes_count = k;
+                  n++;
+              }
+            }
+            if (n < 1)
+            {
+              CONFWRNLOG("Incorrect value of \"%s\" parameter in [%s] block of %s file.",
+                  COMMAND_TEXT(cmd_num),block_buf,config_textname);
+            }
+            break;
+        case 3: // OUTPUT
+            if (get_conf_parameter_single(buf,&pos,len,word_buf,sizeof(word_buf)) > 0)
+            {
+              LbStringCopy(tournament.output_prefix, word_buf, sizeof(tournament.output_prefix));
+              n++;
+            }
+            if (n < 1)
+            {
+              CONFWRNLOG("Incorrect value of \"%s\" parameter in [%s] block of %s file.",
+                  COMMAND_TEXT(cmd_num),block_buf,config_textname);
+            }
+            break;
+        case 4: // MATCH
+            if (tournament.matches_count >= TOURNAMENT_MATCHES_COUNT)
+            {
+              CONFWRNLOG("Too many \"%s\" entries in [%s] block of %s file.",
+                  COMMAND_TEXT(cmd_num),block_buf,config_textname);
+              break;
+            }
+            mtspec = &tournament.matches[tournament.matches_count];
+            if (get_conf_parameter_single(buf,&pos,len,word_buf,sizeof(word_buf)) > 0)
+            {
+              mtspec->lvnum = atoi(word_buf);
+              n++;
+            }
+            // Models which are not given are left as the level sets them
+            for (i=0; i < TOURNAMENT_KEEPERS_COUNT; i++)
+            {
+                mtspec->models[i] = -1;
+                if (get_conf_parameter_single(buf,&pos,len,word_buf,sizeof(word_buf)) > 0)
+                {
+                  mtspec->models[i] = atoi(word_buf);
+                  n++;
+                }
+            }
+            if ((n < 1) || (mtspec->lvnum <= 0))
+            {
+              CONFWRNLOG("Incorrect value of \"%s\" parameter in [%s] block of %s file.",
+                  COMMAND_TEXT(cmd_num),block_buf,config_textname);
+              break;
+            }
+            tournament.matches_count++;
+            break;
+        case 0: // comment
+            break;
+        case -1: // end of buffer
+            break;
+        default:
+            CONFWRNLOG("Unrecognized command (%d) in [%s] block of %s file.",
+                cmd_num,block_buf,config_textname);
+            break;
+        }
+        skip_conf_to_next_line(buf,&pos,len);
+    }
+#undef COMMAND_TEXT
+    return true;
+}
+
+static TbBool load_tournament_config(const char *textname, const char *fname)
+{
+    char *buf;
+    long len;
+    TbBool result;
+    SYNCDBG(0,"Reading %s file \"%s\".",textname,fname);
+    len = LbFileLengthRnc(fname);
+    if (len < MIN_CONFIG_FILE_SIZE)
+    {
+        WARNMSG("The %s file \"%s\" doesn't exist or is too small.",textname,fname);
+        return false;
+    }
+    if (len > MAX_CONFIG_FILE_SIZE)
+    {
+        WARNMSG("The %s file \"%s\" is too large.",textname,fname);
+        return false;
+    }
+    buf = (char *)LbMemoryAlloc(len+256);
+    if (buf == NULL)
+        return false;
+    // Loading file data
+    len = LbFileLoadAt(fname, buf);
+    result = (len > 0);
+    if (result)
+    {
+        result = parse_tournament_blocks(buf, len, textname);
+        if (!result)
+            WARNMSG("Parsing %s file \"%s\" tournament block failed.",textname,fname);
+    }
+    //Freeing and exiting
+    clear_conf_blocks_index(buf);
+    LbMemoryFree(buf);
+    return result;
+}
+
+static void tournament_match_fname(char *fname, long match_idx, const char *ext)
+{
+    sprintf(fname, "%s%03d.%s", tournament.output_prefix, (int)match_idx+1, ext);
+}
+
+/**
+ * Starts a process of the game which plays given match.
+ */
+static TbBool tournament_start_match(struct TournamentProcess *proc, const char *exe_fname, long match_idx)
+{
+    struct TournamentMatchSpec *mtspec;
+    char out_fname[DISKPATH_SIZE];
+    char cmdline[TOURNAMENT_CMDLINE_LEN];
+    STARTUPINFO si;
+    PROCESS_INFORMATION pi;
+    mtspec = &tournament.matches[match_idx];
+    tournament_match_fname(out_fname, match_idx, "json");
+    // Remove results of previous runs, so that missing results can be detected
+    if (LbFileExists(out_fname))
+        LbFileDelete(out_fname);
+    sprintf(cmdline, "\"%s\" -nointro -nosound -level %d -aimatch %ld,%ld,%ld,%ld -turnslimit %lu -matchout \"%s\"",
+        exe_fname, (int)mtspec->lvnum, mtspec->models[0], mtspec->models[1], mtspec->models[2], mtspec->models[3],
+        tournament.turns_limit, out_fname);
+    SYNCDBG(8,"Executing: %s",cmdline);
+    proc->match_idx = match_idx;
+    LbMemorySet(&si, 0, sizeof(si));
+    si.cb = sizeof(si);
+    LbMemorySet(&pi, 0, sizeof(pi));
+    if (!CreateProcess(NULL, cmdline, NULL, NULL, FALSE, 0, NULL, NULL, &si, &pi))
+    {
+        ERRORLOG("Cannot start process for match %d",(int)match_idx+1);
+        return false;
+    }
+    CloseHandle(pi.hThread);
+    proc->handle = pi.hProcess;
+    SYNCMSG("Match %d started on level %d",(int)match_idx+1,(int)mtspec->lvnum);
+    return true;
+}
+
+/**
+ * Waits until any of the started match processes ends.
+ * Wake-ups which don't identify one of given processes are ignored, and waiting continues.
+ * @return Index of the finished process in given array, or -1 if waiting is impossible.
+ */
+static long tournament_wait_for_match(struct TournamentProcess *procs, long procs_count)
+{
+    HANDLE handles[TOURNAMENT_PROCESSES_MAX];
+    DWORD ret;
+    long i;
+    for (i=0; i < procs_count; i++)
+        handles[i] = procs[i].handle;
+    while (1)
+    {
+        ret = WaitForMultipleObjects(procs_count, handles, FALSE, INFINITE);
+        if (ret == WAIT_FAILED)
+            return -1;
+        if ((ret >= WAIT_OBJECT_0) && (ret < WAIT_OBJECT_0 + procs_count))
+            break;
+        WARNLOG("Unexpected wait result %lu, still waiting for matches",(unsigned long)ret);
+    }
+    i = ret - WAIT_OBJECT_0;
+    CloseHandle(procs[i].handle);
+    return i;
+}
+
+/**
+ * Plays all matches from the tournament file, running them in parallel processes.
+ * @param exe_fname File name of the game executable, used to start matches.
+ * @return Amount of matches which didn't store their results, or -1 on failure.
+ */
+long tournament_run(const char *exe_fname)
+{
+    struct TournamentProcess procs[TOURNAMENT_PROCESSES_MAX];
+    char out_fname[DISKPATH_SIZE];
+    long procs_count,running;
+    long next_match,done_matches,failed_matches;
+    long i;
+    if (!load_tournament_config("tournament", tournament.fname))
+        return -1;
+    if (tournament.matches_count < 1)
+    {
+        WARNMSG("No matches defined in tournament file \"%s\".",tournament.fname);
+        return -1;
+    }
+    // By default, one process per CPU core
+    procs_count = tournament.processes_count;
+    if (procs_count <= 0)
+        procs_count = LbWorkersCount();
+    if (procs_count > TOURNAMENT_PROCESSES_MAX)
+        procs_count = TOURNAMENT_PROCESSES_MAX;
+    if (procs_count > tournament.matches_count)
+        procs_count = tournament.matches_count;
+    SYNCMSG("Tournament of %d matches started, using %d processes",(int)tournament.matches_count,(int)procs_count);
+    running = 0;
+    next_match = 0;
+    done_matches = 0;
+    failed_matches = 0;
+    while (done_matches < tournament.matches_count)
+    {
+        while ((running < procs_count) && (next_match < tournament.matches_count))
+        {
+            if (tournament_start_match(&procs[running], exe_fname, next_match)) {
+                running++;
+            } else {
+                done_matches++;
+                failed_matches++;
+            }
+            next_match++;
+        }
+        if (running < 1)
+            continue;
+        i = tournament_wait_for_match(procs, running);
+        if (i < 0)
+        {
+            ERRORLOG("Waiting for match processes failed");
+            return -1;
+        }
+        tournament_match_fname(out_fname, procs[i].match_idx, "json");
+        if (LbFileExists(out_fname)) {
+            SYNCMSG("Match %d finished, results stored in \"%s\"",(int)procs[i].match_idx+1,out_fname);
+        } else {
+            WARNLOG("Match %d finished without storing results",(int)procs[i].match_idx+1);
+            failed_matches++;
+        }
+        done_matches++;
+        // Fill the gap with last running process
+        running--;
+        procs[i] = procs[running];
+    }
+    SYNCMSG("Tournament finished, %d of %d matches stored results",(int)(tournament.matches_count-failed_matches),(int)tournament.matches_count);
+    return failed_matches;
+}
+/******************************************************************************/
+/**
+ * Makes this process play a headless match between computer players.
+ * @param models_text Computer model of every keeper, separated with commas; negative value keeps level setting.
+ */
+TbBool tournament_match_set_models(const char *models_text)
+{
+    const char *text;
+    long i;
+    text = models_text;
+    for (i=0; i < TOURNAMENT_KEEPERS_COUNT; i++)
+    {
+        tournament_match.models[i] = -1;
+        if ((text != NULL) && (*text != '\0'))
+        {
+            tournament_match.models[i] = atol(text);
+            text = strchr(text, ',');
+            if (text != NULL)
+                text++;
+        }
+    }
+    if (tournament_match.turns_limit == 0)
+        tournament_match.turns_limit = TOURNAMENT_DEFAULT_TURNS_LIMIT;
+    tournament_match.active = true;
+    tournament_match.finished = false;
+    // No window is needed; the video driver still has to work, as the game draws into its buffers
+    putenv("SDL_VIDEODRIVER=dummy");
+    return true;
+}
+
+void tournament_match_set_turns_limit(unsigned long turns_limit)
+{
+    tournament_match.turns_limit = turns_limit;
+}
+
+void tournament_match_set_output(const char *fname)
+{
+    char *ext;
+    LbStringCopy(tournament_match.out_fname, fname, sizeof(tournament_match.out_fname));
+    // Every match has its own log, as matches run in parallel
+    LbStringCopy(tournament_match.log_fname, fname, sizeof(tournament_match.log_fname)-4);
+    ext = strrchr(tournament_match.log_fname, '.');
+    if (ext != NULL)
+        *ext = '\0';
+    LbStringConcat(tournament_match.log_fname, ".log", sizeof(tournament_match.log_fname));
+}
+
+TbBool tournament_match_active(void)
+{
+    return tournament_match.active;
+}
+
+/**
+ * Returns name of the log file for the match, or NULL if the match doesn't need separate log.
+ */
+const char *tournament_match_log_fname(void)
+{
+    if (!tournament_match.active || (tournament_match.log_fname[0] == '\0'))
+        return NULL;
+    return tournament_match.log_fname;
+}
+
+/**
+ * Sets computer models requested for the match, and puts all keepers under computer control.
+ * Should be called after the level script is loaded, so that models set by the script are replaced.
+ */
+void tournament_match_setup_players(void)
+{
+    struct PlayerInfo *player;
+    struct Dungeon *dungeon;
+    struct Computer2 *comp;
+    PlayerNumber plyr_idx;
+    if (!tournament_match.active)
+        return;
+    for (plyr_idx=0; plyr_idx < TOURNAMENT_KEEPERS_COUNT; plyr_idx++)
+    {
+        player = get_player(plyr_idx);
+        if (!player_exists(player) || (player->field_2C != 1))
+            continue;
+        dungeon = get_players_num_dungeon(plyr_idx);
+        if (dungeon_invalid(dungeon))
+            continue;
+        if (tournament_match.models[plyr_idx] >= 0)
+            setup_a_computer_player(plyr_idx, tournament_match.models[plyr_idx]);
+        // The local player is not a computer player by default
+        dungeon->computer_enabled |= 0x01;
+        comp = get_computer_player(plyr_idx);
+        SYNCMSG("Match player %d controlled by computer model %d",(int)plyr_idx,(int)comp->model);
+    }
+    tournament_match.first_turn = game.play_gameturn;
+    tournament_match.start_time = LbTimerClockMicro();
+}
+
+static TbBool tournament_match_write_results(PlayerNumber winner, TbBool limit_reached)
+{
+    static char buf[4096];
+    struct PlayerInfo *player;
+    struct Dungeon *dungeon;
+    struct Computer2 *comp;
+    TbFileHandle fhandle;
+    TbClockUSec turn_time;
+    unsigned long turns_count;
+    PlayerNumber plyr_idx;
+    long len;
+    turns_count = game.play_gameturn - tournament_match.first_turn;
+    turn_time = 0;
+    if (turns_count > 0)
+        turn_time = (LbTimerClockMicro() - tournament_match.start_time) / turns_count;
+    len = 0;
+    len += sprintf(buf+len, "{\n");
+    len += sprintf(buf+len, "  \"level\": %d,\n", (int)get_loaded_level_number());
+    len += sprintf(buf+len, "  \"winner\": %d,\n", (int)winner);
+    len += sprintf(buf+len, "  \"turns\": %lu,\n", turns_count);
+    len += sprintf(buf+len, "  \"turns_limit_reached\": %s,\n", limit_reached ? "true" : "false");
+    len += sprintf(buf+len, "  \"avg_turn_time_us\": %lu,\n", (unsigned long)turn_time);
+    len += sprintf(buf+len, "  \"players\": [");
+    for (plyr_idx=0; plyr_idx < TOURNAMENT_KEEPERS_COUNT; plyr_idx++)
+    {
+        player = get_player(plyr_idx);
+        dungeon = get_players_num_dungeon(plyr_idx);
+        comp = get_computer_player(plyr_idx);
+        len += sprintf(buf+len, "%s\n    {\"player\": %d, ", (plyr_idx > 0) ? "," : "", (int)plyr_idx);
+        if (!player_exists(player) || dungeon_invalid(dungeon))
+        {
+            len += sprintf(buf+len, "\"exists\": false}");
+            continue;
+        }
+        len += sprintf(buf+len, "\"exists\": true, \"model\": %d, \"alive\": %s, ",
+            (int)comp->model, player_cannot_win(plyr_idx) ? "false" : "true");
+        len += sprintf(buf+len, "\"gold_mined\": %lu, \"money\": %ld, \"creatures\": %d, \"diggers\": %d}",
+            (unsigned long)dungeon->lvstats.gold_mined, (long)dungeon->total_money_owned,
+            (int)dungeon->num_active_creatrs, (int)dungeon->num_active_diggers);
+    }
+    len += sprintf(buf+len, "\n  ]\n}\n");
+    fhandle = LbFileOpen(tournament_match.out_fname, Lb_FILE_MODE_NEW);
+    if (fhandle == -1)
+    {
+        ERRORLOG("Cannot create match results file \"%s\"",tournament_match.out_fname);
+        return false;
+    }
+    if (LbFileWrite(fhandle, buf, len) != len)
+    {
+        ERRORLOG("Cannot write match results file \"%s\"",tournament_match.out_fname);
+        LbFileClose(fhandle);
+        return false;
+    }
+    LbFileClose(fhandle);
+    return true;
+}
+
+/**
+ * Checks whether the match has ended; if it did, stores the results and makes the game quit.
+ * Should be called once every game turn.
+ * @return True if the match has ended.
+ */
+TbBool tournament_match_process_turn(void)
+{
+    struct PlayerInfo *player;
+    PlayerNumber plyr_idx,winner;
+    long alive_count;
+    TbBool limit_reached;
+    if (!tournament_match.active)
+        return false;
+    if (tournament_match.finished)
+        return true;
+    alive_count = 0;
+    winner = -1;
+    for (plyr_idx=0; plyr_idx < TOURNAMENT_KEEPERS_COUNT; plyr_idx++)
+    {
+        player = get_player(plyr_idx);
+        if (!player_exists(player))
+            continue;
+        // Level script may declare a winner before other hearts are destroyed
+        if (player->victory_state == VicS_WonLevel)
+        {
+            winner = plyr_idx;
+            alive_count = 1;
+            break;
+        }
+        if (!player_cannot_win(plyr_idx))
+        {
+            winner = plyr_idx;
+            alive_count++;
+        }
+    }
+    limit_reached = (game.play_gameturn - tournament_match.first_turn >= tournament_match.turns_limit);
+    if ((alive_count > 1) && !limit_reached)
+        return false;
+    if (alive_count != 1)
+        winner = -1;
+    SYNCMSG("Match ended after %lu turns, winner is player %d",(unsigned long)(game.play_gameturn - tournament_match.first_turn),(int)winner);
+    if (tournament_match.out_fname[0] != '\0')
+        tournament_match_write_results(winner, limit_reached && (alive_count > 1));
+    tournament_match.finished = true;
+    exit_keeper = 1;
+    return true;
+}
+/******************************************************************************/
+#ifdef __cplusplus
+}
+#endif
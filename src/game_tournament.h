@@ -0,0 +1,51 @@
+/******************************************************************************/
+// Free implementation of Bullfrog's Dungeon Keeper strategy game.
+/******************************************************************************/
+/** @file game_tournament.h
+ *     Header file for game_tournament.c.
+ * @par Purpose:
+ *     Headless matches between computer players, used for tuning computer models.
+ * @par Comment:
+ *     Just a header file - #defines, typedefs, function prototypes etc.
+ * @author   KeeperFX Team
+ * @date     19 Oct 2026 - 19 Oct 2026
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+/******************************************************************************/
+#ifndef DK_GAMETOURNAMENT_H
+#define DK_GAMETOURNAMENT_H
+
+#include "bflib_basics.h"
+#include "globals.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/******************************************************************************/
+/** Amount of keeper players which can be assigned a computer model in a match. */
+#define TOURNAMENT_KEEPERS_COUNT    4
+/** Max amount of matches listed in one tournament file. */
+#define TOURNAMENT_MATCHES_COUNT  256
+/** Game turns after which a match is ended as a draw, if the tournament file doesn't say otherwise. */
+#define TOURNAMENT_DEFAULT_TURNS_LIMIT 72000
+/******************************************************************************/
+TbBool tournament_set_config_file(const char *fname);
+TbBool tournament_is_set(void);
+long tournament_run(const char *exe_fname);
+
+TbBool tournament_match_set_models(const char *models_text);
+void tournament_match_set_turns_limit(unsigned long turns_limit);
+void tournament_match_set_output(const char *fname);
+TbBool tournament_match_active(void);
+const char *tournament_match_log_fname(void);
+void tournament_match_setup_players(void);
+TbBool tournament_match_process_turn(void);
+/******************************************************************************/
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -87,7 +87,7 @@ enum FFlags {
 
 enum DebugFlags {
     DFlg_ShotsDamage        =  0x01,
-    DFlg_unk02              =  0x02,
+    DFlg_ConditionsCheck    =  0x02,
 };
 
 #pragma pack(1)
@@ -245,6 +245,8 @@ short setup_game(void);
 void game_loop(void);
 short reset_game(void);
 void update(void);
+int clear_active_dungeons_stats(void);
+void process_dungeons(void);
 
 int can_thing_be_queried(struct Thing *thing, long a2);
 struct Thing *get_queryable_object_near(MapCoord pos_x, MapCoord pos_y, long plyr_idx);
@@ -344,6 +346,7 @@ TbBool setup_move_off_lava(struct Thing *thing);
 
 TbPixel get_player_path_colour(unsigned short owner);
 
+void init_level(void);
 void startup_network_game(TbBool local);
 void startup_saved_packet_game(void);
 void faststartup_saved_packet_game(void);
@@ -24,6 +24,7 @@
 #include "bflib_memory.h"
 #include "bflib_fileio.h"
 #include "bflib_dernc.h"
+#include "bflib_workers.h"
 
 #include "config_lenses.h"
 #include "lens_mist.h"
@@ -281,27 +282,49 @@ void reinitialise_eye_lens(long nlens)
   SYNCDBG(18,"Finished");
 }
 
-void draw_displacement_lens(unsigned char *dstbuf, unsigned char *srcbuf, unsigned long *lens_mem, int width, int height, int dstpitch)
+struct DisplacementLensParams {
+    unsigned char *dstbuf;
+    unsigned char *srcbuf;
+    unsigned long *lens_mem;
+    int width;
+    int dstpitch;
+};
+
+static void draw_displacement_lens_rows(void *data, long start_h, long end_h)
 {
+    struct DisplacementLensParams *params;
     int w,h;
     long pos_map;
     unsigned char *dst;
     unsigned long *mem;
-    SYNCDBG(16,"Starting");
-    dst = dstbuf;
-    mem = lens_mem;
-    for (h=0; h < height; h++)
+    params = (struct DisplacementLensParams *)data;
+    dst = params->dstbuf + start_h * params->dstpitch;
+    mem = params->lens_mem + start_h * params->width;
+    for (h=start_h; h < end_h; h++)
     {
-        for (w=0; w < width; w++)
+        for (w=0; w < params->width; w++)
         {
             pos_map = *mem;
-            dst[w] = srcbuf[pos_map];
+            dst[w] = params->srcbuf[pos_map];
             mem++;
         }
-        dst += dstpitch;
+        dst += params->dstpitch;
     }
 }
 
+void draw_displacement_lens(unsigned char *dstbuf, unsigned char *srcbuf, unsigned long *lens_mem, int width, int height, int dstpitch)
+{
+    struct DisplacementLensParams params;
+    SYNCDBG(16,"Starting");
+    params.dstbuf = dstbuf;
+    params.srcbuf = srcbuf;
+    params.lens_mem = lens_mem;
+    params.width = width;
+    params.dstpitch = dstpitch;
+    // Lines are independent, so bands of them may be drawn by all workers
+    LbWorkersRunBands(draw_displacement_lens_rows, &params, height, 32);
+}
+
 void draw_copy(unsigned char *dstbuf, long dstpitch, unsigned char *srcbuf, long srcpitch, long width, long height)
 {
     long i;
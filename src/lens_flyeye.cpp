@@ -24,6 +24,7 @@
 #include "engine_render.h"
 #include "lens_api.h"
 #include "bflib_vidraw.h"
+#include "bflib_workers.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -47,6 +48,7 @@ static unsigned char *lens_Source;
 static long lens_SourcePitch;
 static unsigned char *lens_Screen;
 static long lens_ScreenPitch;
+static long lens_StartLine;
 struct CScan *ScanBuffer;
 /******************************************************************************/
 CHex::CHex(long width, long height)
@@ -268,6 +270,15 @@ void CHex::BlitScan(struct CScan *scan, long h)
   }
 }
 
+static void flyeye_blitsec_band(void *data, long start_idx, long end_idx)
+{
+    long h;
+    for (h=lens_StartLine+start_idx; h < lens_StartLine+end_idx; h++)
+    {
+        CHex::BlitScan(&ScanBuffer[h], h);
+    }
+}
+
 /** Draws displacement on source image, using ScanBuffer for shift data.
  *
  * @param srcbuf Source image buffer.
@@ -279,17 +290,16 @@ void CHex::BlitScan(struct CScan *scan, long h)
  */
 void flyeye_blitsec(unsigned char *srcbuf, long srcpitch, unsigned char *dstbuf, long dstpitch, long start_h, long end_h)
 {
-    long h;
     SYNCDBG(16,"Starting");
     lens_Source = srcbuf;
     lens_SourcePitch = srcpitch;
     lens_Screen = dstbuf;
     lens_ScreenPitch = dstpitch;
-    // Draw lines
-    for (h=start_h; h < end_h; h++)
-    {
-        CHex::BlitScan(&ScanBuffer[h], h);
-    }
+    lens_StartLine = start_h;
+    if (end_h <= start_h)
+        return;
+    // Draw lines; every line is independent, so bands of lines are drawn by all workers
+    LbWorkersRunBands(flyeye_blitsec_band, NULL, end_h - start_h, 32);
 }
 /******************************************************************************/
 #ifdef __cplusplus
@@ -22,6 +22,7 @@
 #include "lens_mist.h"
 #include "globals.h"
 #include "bflib_basics.h"
+#include "bflib_workers.h"
 
 /******************************************************************************/
 class CMistFade {
@@ -31,6 +32,8 @@ class CMistFade {
     void setup(unsigned char *lens_mem, unsigned char *fade, unsigned char *ghost);
     void animset(long a1, long a2);
     void mist(unsigned char *dstbuf, long dstwidth, unsigned char *srcbuf, long srcwidth, long width, long height);
+    void mist_rows(unsigned char *dstbuf, long dstpitch, unsigned char *srcbuf, long srcpitch,
+        long width, long height, long start_h, long end_h);
     void animate(void);
   protected:
     /** Mist data width and height are the same and equal to this dimension */
@@ -87,29 +90,78 @@ void CMistFade::animate(void)
   this->field_F += this->field_1B;
 }
 
+struct MistRowsParams {
+    CMistFade *mist;
+    unsigned char *dstbuf;
+    long dstpitch;
+    unsigned char *srcbuf;
+    long srcpitch;
+    long width;
+    long height;
+};
+
+static void mist_rows_job(void *data, long start_h, long end_h)
+{
+    struct MistRowsParams *params;
+    params = (struct MistRowsParams *)data;
+    params->mist->mist_rows(params->dstbuf, params->dstpitch, params->srcbuf, params->srcpitch,
+        params->width, params->height, start_h, end_h);
+}
+
+static inline unsigned long mist_wrap(long val, unsigned long dim)
+{
+    val %= (long)dim;
+    if (val < 0)
+        val += dim;
+    return val;
+}
+
 void CMistFade::mist(unsigned char *dstbuf, long dstpitch, unsigned char *srcbuf, long srcpitch, long width, long height)
+{
+    struct MistRowsParams params;
+    if ((lens_data == NULL) || (fade_data == NULL))
+    {
+        ERRORLOG("Can't draw Mist as it's not initialized!");
+        return;
+    }
+    params.mist = this;
+    params.dstbuf = dstbuf;
+    params.dstpitch = dstpitch;
+    params.srcbuf = srcbuf;
+    params.srcpitch = srcpitch;
+    params.width = width;
+    params.height = height;
+    LbWorkersRunBands(mist_rows_job, &params, height, 16);
+}
+
+/**
+ * Draws the mist on given range of lines of the image.
+ * Mist position for the first line is computed from the state at image top,
+ * so the image may be split into bands which are drawn independently.
+ */
+void CMistFade::mist_rows(unsigned char *dstbuf, long dstpitch, unsigned char *srcbuf, long srcpitch,
+    long width, long height, long start_h, long end_h)
 {
     unsigned char *src;
     unsigned char *dst;
     unsigned long p2,c2,p1,c1;
     unsigned long lens_div;
+    long line_steps,prev_steps;
     long i,k,n;
     long w,h;
 
-    if ((lens_data == NULL) || (fade_data == NULL))
-    {
-        ERRORLOG("Can't draw Mist as it's not initialized!");
-        return;
-    }
-    src = srcbuf;
-    dst = dstbuf;
-    p2 = this->field_C;
-    c2 = this->field_D;
-    p1 = this->field_E;
-    c1 = this->field_F;
     lens_div = width/(2*lens_dim);
     if (lens_div < 1) lens_div = 1;
-    for (h=height; h > 0; h--)
+    src = srcbuf + start_h * srcpitch;
+    dst = dstbuf + start_h * dstpitch;
+    // Position changes made by every line, and by end of lines above the first one
+    line_steps = width / lens_div;
+    prev_steps = height / lens_div - (height - start_h) / lens_div;
+    p2 = mist_wrap((long)this->field_C + start_h * line_steps - prev_steps * width, lens_dim);
+    c2 = mist_wrap((long)this->field_D + prev_steps, lens_dim);
+    p1 = mist_wrap((long)this->field_E - prev_steps, lens_dim);
+    c1 = mist_wrap((long)this->field_F - start_h * line_steps + prev_steps * width, lens_dim);
+    for (h=height-start_h; h > height-end_h; h--)
     {
         for (w=width; w > 0; w--)
         {
@@ -21,9 +21,13 @@
 #include "globals.h"
 #include "bflib_basics.h"
 #include "bflib_memory.h"
+#include "bflib_math.h"
+#include "bflib_datetm.h"
+#include "bflib_workers.h"
 
 #include "player_data.h"
 #include "map_data.h"
+#include "map_columns.h"
 
 #include "thing_stats.h"
 #include "game_legacy.h"
@@ -33,16 +37,77 @@ extern "C" {
 #endif
 /******************************************************************************/
 DLLIMPORT void _DK_light_remove_light_from_list(struct Light *lgt, struct StructureList *list);
-DLLIMPORT void _DK_light_signal_stat_light_update_in_area(long x1, long y1, long x2, long y2);
 DLLIMPORT void _DK_light_initialise_lighting_tables(void);
 DLLIMPORT void _DK_light_set_light_minimum_size_to_cache(long a1, long a2, long a3);
-DLLIMPORT void _DK_light_set_light_position(long lgt_id, struct Coord3d *pos);
-DLLIMPORT long _DK_light_get_light_intensity(long idx);
-DLLIMPORT long _DK_light_set_light_intensity(long a1, long a2);
-DLLIMPORT void _DK_light_render_area(int startx, int starty, int endx, int endy);
-DLLIMPORT void _DK_light_stat_light_map_clear_area(long x1, long y1, long x2, long y2);
-DLLIMPORT void _DK_light_signal_update_in_area(long sx, long sy, long ex, long ey);
 
+/******************************************************************************/
+/** Size of a square area of static light map which is rebuilt as one job. */
+#define LIGHT_MAP_TILE_SIZE 16
+/** Amount of tiles in a row of static light map; the map has 256 vertices in a row. */
+#define LIGHT_MAP_TILES_ROW (256/LIGHT_MAP_TILE_SIZE)
+#define LIGHT_MAP_TILES_COUNT (LIGHT_MAP_TILES_ROW*LIGHT_MAP_TILES_ROW)
+/** Max range within which a light affects the map, in subtiles. */
+#define LIGHT_MAX_CAST_RANGE LIGHT_MAX_RANGE
+/** Amount of subtile lines stored in light shadows; also used bits in each line. */
+#define LIGHT_SHADOWS_SIZE (2*LIGHT_MAX_CAST_RANGE+1)
+
+/**
+ * Data of static light map rebuild which is in progress.
+ * Filled before the work is split into jobs, then only read by the jobs.
+ */
+struct StatLightRebuild {
+    unsigned short lights[LIGHTS_COUNT];
+    long lights_count;
+    unsigned short tiles[LIGHT_MAP_TILES_COUNT];
+    long tiles_count;
+};
+
+/**
+ * Subtiles around a light which are not in shadow.
+ * Too large to fit in shadow caches of the game structure, so stored outside of it,
+ * one for every light; the game caches are only used to limit amount of dynamic lights.
+ */
+struct LightShadows {
+    unsigned char flags;
+    /** Bitmasks of subtiles lit by the light, for lines around its position. */
+    unsigned long long visible_lines[LIGHT_SHADOWS_SIZE];
+};
+
+/**
+ * Statistics of static light map rebuilds, for debug dumps.
+ */
+struct StatLightRebuildStats {
+    unsigned long rebuilds_count;
+    long last_tiles;
+    long last_lights;
+    long last_casts;
+    TbClockUSec last_time;
+    TbClockUSec max_time;
+    TbClockUSec total_time;
+};
+
+/******************************************************************************/
+/** Shadows of all lights, indexed the same way as lights. */
+static struct LightShadows light_shadows[LIGHTS_COUNT];
+/** Tiles of the static light map which need to be rebuilt. */
+static unsigned char stat_light_dirty_tiles[LIGHT_MAP_TILES_COUNT];
+static struct StatLightRebuild stat_light_rebuild;
+static struct StatLightRebuildStats stat_light_rebuild_stats;
+
+/**
+ * Grid of lights, allowing quick access to lights near given position.
+ * Every allocated light is in a list of lights placed within one grid cell.
+ * Not stored within the game structure, so needs to be rebuilt when lights are loaded.
+ */
+struct LightsGrid {
+    ThingIndex cell_first[LIGHT_GRID_CELLS_COUNT];
+    ThingIndex next[LIGHTS_COUNT];
+    ThingIndex prev[LIGHTS_COUNT];
+    /** Grid cell index, plus one; zero if the light is not in the grid. */
+    unsigned short cell[LIGHTS_COUNT];
+};
+
+static struct LightsGrid lights_grid;
 /******************************************************************************/
 struct Light *light_allocate_light(void)
 {
@@ -114,6 +179,235 @@ void light_shadow_cache_free(struct ShadowCache *shdc)
     LbMemorySet(shdc, 0, sizeof(struct ShadowCache));
 }
 
+/**
+ * Returns the range, in subtiles, within which given light affects the map.
+ */
+long light_get_cast_range(const struct Light *lgt)
+{
+    long range;
+    range = (lgt->radius + COORD_PER_STL - 1) / COORD_PER_STL;
+    if (range > LIGHT_MAX_CAST_RANGE)
+        range = LIGHT_MAX_CAST_RANGE;
+    return range;
+}
+
+/**
+ * Gives the shadows of given light.
+ */
+struct LightShadows *light_get_shadows(const struct Light *lgt)
+{
+    return &light_shadows[lgt->index];
+}
+
+void light_shadow_cache_invalidate(struct Light *lgt)
+{
+    struct LightShadows *lshad;
+    lshad = light_get_shadows(lgt);
+    lshad->flags &= ~ShCF_Valid;
+}
+
+void light_shadow_cache_invalidate_all(void)
+{
+    long i;
+    for (i=0; i < LIGHTS_COUNT; i++) {
+        light_shadows[i].flags &= ~ShCF_Valid;
+    }
+}
+
+/**
+ * Checks whether a ray from light position to given subtile is not blocked by solid columns.
+ * The target subtile itself is not checked, so that walls facing the light are lit.
+ */
+static TbBool light_ray_reaches_subtile(MapSubtlCoord src_x, MapSubtlCoord src_y, long delta_x, long delta_y, long height)
+{
+    long steps,rounding_x,rounding_y;
+    long i;
+    MapSubtlCoord stl_x,stl_y;
+    steps = max(abs(delta_x),abs(delta_y));
+    rounding_x = (delta_x < 0) ? -steps : steps;
+    rounding_y = (delta_y < 0) ? -steps : steps;
+    for (i=1; i < steps; i++)
+    {
+        stl_x = src_x + (2*delta_x*i + rounding_x) / (2*steps);
+        stl_y = src_y + (2*delta_y*i + rounding_y) / (2*steps);
+        if (get_floor_filled_subtiles_at(stl_x, stl_y) > height)
+            return false;
+    }
+    return true;
+}
+
+/**
+ * Computes which subtiles around the light are not in shadow, and stores that in given shadows.
+ * Reads the map only, so may be executed for many lights at once.
+ */
+void light_cast_shadows(const struct Light *lgt, struct LightShadows *lshad)
+{
+    MapSubtlCoord src_x,src_y;
+    long range,height;
+    long delta_x,delta_y;
+    unsigned long long mask;
+    src_x = lgt->mappos.x.stl.num;
+    src_y = lgt->mappos.y.stl.num;
+    height = max(lgt->mappos.z.stl.num, 1);
+    range = light_get_cast_range(lgt);
+    LbMemorySet(lshad->visible_lines, 0, sizeof(lshad->visible_lines));
+    for (delta_y = -range; delta_y <= range; delta_y++)
+    {
+        if ((src_y + delta_y < 0) || (src_y + delta_y > map_subtiles_y))
+            continue;
+        mask = 0;
+        for (delta_x = -range; delta_x <= range; delta_x++)
+        {
+            if ((src_x + delta_x < 0) || (src_x + delta_x > map_subtiles_x))
+                continue;
+            if (light_ray_reaches_subtile(src_x, src_y, delta_x, delta_y, height))
+                mask |= (1ULL << (delta_x + LIGHT_MAX_CAST_RANGE));
+        }
+        lshad->visible_lines[delta_y + LIGHT_MAX_CAST_RANGE] = mask;
+    }
+    lshad->flags |= ShCF_Valid;
+}
+
+/**
+ * Renders light into given rectangle of a lightness map, using its cast shadows.
+ * @param lgt The light to be rendered.
+ * @param lshad Valid shadows of the light.
+ * @param lmap The lightness map; either static light map or subtile lightness.
+ * @param additive If true, light is added to the map; otherwise brightest value is kept.
+ */
+void light_render_light_in_rect(const struct Light *lgt, const struct LightShadows *lshad, unsigned short *lmap,
+    MapSubtlCoord start_x, MapSubtlCoord start_y, MapSubtlCoord end_x, MapSubtlCoord end_y, TbBool additive)
+{
+    MapSubtlCoord src_x,src_y;
+    MapSubtlCoord stl_x,stl_y;
+    long range,radius;
+    long dist,lightness,max_lightness;
+    unsigned long long mask;
+    unsigned short *lptr;
+    src_x = lgt->mappos.x.stl.num;
+    src_y = lgt->mappos.y.stl.num;
+    range = light_get_cast_range(lgt);
+    radius = min(lgt->radius, (range+1)*COORD_PER_STL);
+    if (radius <= 0)
+        return;
+    max_lightness = lgt->intensity << 8;
+    start_x = max(start_x, src_x - range);
+    start_y = max(start_y, src_y - range);
+    end_x = min(end_x, src_x + range);
+    end_y = min(end_y, src_y + range);
+    for (stl_y = start_y; stl_y <= end_y; stl_y++)
+    {
+        mask = lshad->visible_lines[stl_y - src_y + LIGHT_MAX_CAST_RANGE];
+        if (mask == 0)
+            continue;
+        for (stl_x = start_x; stl_x <= end_x; stl_x++)
+        {
+            if ((mask & (1ULL << (stl_x - src_x + LIGHT_MAX_CAST_RANGE))) == 0)
+                continue;
+            dist = LbDiagonalLength(abs(subtile_coord(stl_x,0) - (long)lgt->mappos.x.val),
+                abs(subtile_coord(stl_y,0) - (long)lgt->mappos.y.val));
+            if (dist >= radius)
+                continue;
+            lightness = max_lightness * (radius - dist) / radius;
+            lptr = &lmap[get_subtile_number(stl_x,stl_y)];
+            if (additive)
+            {
+                lightness += *lptr;
+                if (lightness > USHRT_MAX)
+                    lightness = USHRT_MAX;
+                *lptr = lightness;
+            } else
+            if (*lptr < lightness)
+            {
+                *lptr = lightness;
+            }
+        }
+    }
+}
+
+long light_grid_cell_coord(MapCoord pos_v)
+{
+    if (pos_v < 0)
+        return 0;
+    if (pos_v >= subtile_coord(LIGHT_GRID_ROW*LIGHT_GRID_CELL_SIZE,0))
+        return LIGHT_GRID_ROW-1;
+    return coord_subtile(pos_v) / LIGHT_GRID_CELL_SIZE;
+}
+
+static long light_grid_cell_index(const struct Coord3d *pos)
+{
+    return light_grid_cell_coord(pos->y.val) * LIGHT_GRID_ROW + light_grid_cell_coord(pos->x.val);
+}
+
+static void light_grid_remove_light(const struct Light *lgt)
+{
+    struct LightsGrid *lgrid;
+    long lgt_id;
+    lgrid = &lights_grid;
+    lgt_id = lgt->index;
+    if (lgrid->cell[lgt_id] == 0)
+        return;
+    if (lgrid->prev[lgt_id] > 0) {
+        lgrid->next[lgrid->prev[lgt_id]] = lgrid->next[lgt_id];
+    } else {
+        lgrid->cell_first[lgrid->cell[lgt_id]-1] = lgrid->next[lgt_id];
+    }
+    if (lgrid->next[lgt_id] > 0) {
+        lgrid->prev[lgrid->next[lgt_id]] = lgrid->prev[lgt_id];
+    }
+    lgrid->next[lgt_id] = 0;
+    lgrid->prev[lgt_id] = 0;
+    lgrid->cell[lgt_id] = 0;
+}
+
+/**
+ * Puts the light into grid cell matching its position.
+ * Should be called every time the light position changes.
+ */
+static void light_grid_update_light(const struct Light *lgt)
+{
+    struct LightsGrid *lgrid;
+    long lgt_id,cell_idx;
+    lgrid = &lights_grid;
+    lgt_id = lgt->index;
+    cell_idx = light_grid_cell_index(&lgt->mappos);
+    if (lgrid->cell[lgt_id] == cell_idx+1)
+        return;
+    light_grid_remove_light(lgt);
+    lgrid->cell[lgt_id] = cell_idx+1;
+    lgrid->prev[lgt_id] = 0;
+    lgrid->next[lgt_id] = lgrid->cell_first[cell_idx];
+    if (lgrid->next[lgt_id] > 0) {
+        lgrid->prev[lgrid->next[lgt_id]] = lgt_id;
+    }
+    lgrid->cell_first[cell_idx] = lgt_id;
+}
+
+static void light_grid_rebuild(void)
+{
+    struct Light *lgt;
+    long i;
+    LbMemorySet(&lights_grid, 0, sizeof(lights_grid));
+    for (i=1; i < LIGHTS_COUNT; i++)
+    {
+        lgt = &game.lish.lights[i];
+        if ((lgt->flags & LgtF_Allocated) != 0)
+            light_grid_update_light(lgt);
+    }
+}
+
+ThingIndex light_grid_first_light_in_cell(long cell_x, long cell_y)
+{
+    if ((cell_x < 0) || (cell_x >= LIGHT_GRID_ROW) || (cell_y < 0) || (cell_y >= LIGHT_GRID_ROW))
+        return 0;
+    return lights_grid.cell_first[cell_y * LIGHT_GRID_ROW + cell_x];
+}
+
+ThingIndex light_grid_next_light_in_cell(const struct Light *lgt)
+{
+    return lights_grid.next[lgt->index];
+}
+
 TbBool light_add_light_to_list(struct Light *lgt, struct StructureList *list)
 {
   if ((lgt->field_1 & 0x01) != 0)
@@ -153,21 +447,27 @@ long light_create_light(struct InitLight *ilght)
     {
         light_total_stat_lights++;
         light_add_light_to_list(lgt, &game.thing_lists[TngList_StaticLights]);
-        stat_light_needs_updating = 1;
     }
     lgt->flags |= LgtF_Unkn02;
-    lgt->flags |= LgtF_Unkn08;
+    lgt->flags |= LgtF_NeedUpdate;
     lgt->mappos.x.val = ilght->mappos.x.val;
     lgt->mappos.y.val = ilght->mappos.y.val;
     lgt->mappos.z.val = ilght->mappos.z.val;
-    lgt->field_16 = ilght->field_0;
-    lgt->field_2 = ilght->field_2;
+    lgt->radius = ilght->field_0;
+    lgt->intensity = ilght->field_2;
+    lgt->range = light_get_cast_range(lgt);
     k = 2 * ilght->field_3;
     lgt->field_1 = k ^ ((k ^ lgt->field_1) & 0x01);
     set_flag_byte(&lgt->flags,LgtF_Dynamic,ilght->is_dynamic);
     lgt->field_1A = ilght->field_8;
     lgt->field_18 = ilght->field_4;
     lgt->field_12 = ilght->field_12;
+    light_grid_update_light(lgt);
+    if (!ilght->is_dynamic)
+    {
+        light_shadow_cache_invalidate(lgt);
+        light_signal_stat_light_update_in_own_radius(lgt);
+    }
     return lgt->index;
 }
 
@@ -223,6 +523,9 @@ void light_import_system_state(const struct LightSystemState *lightst)
     light_rendered_optimised_dynamic_lights = lightst->rendered_optimised_dynamic_lights;
     light_updated_stat_lights = lightst->updated_stat_lights;
     light_out_of_date_stat_lights = lightst->out_of_date_stat_lights;
+    // Caches are not stored with the state, and lights have changed
+    light_shadow_cache_invalidate_all();
+    light_grid_rebuild();
 }
 
 TbBool lights_stats_debug_dump(void)
@@ -339,6 +642,16 @@ TbBool lights_stats_debug_dump(void)
     {
         WARNLOG("Wrong global lights counter: %ld dynamic lights and counter says %ld.",lgh_dynm,light_total_dynamic_lights);
     }
+    SYNCLOG("Lights per frame: %ld static updated, %ld out of date; %ld dynamic rendered, %ld of them cached",
+        light_updated_stat_lights,light_out_of_date_stat_lights,light_rendered_dynamic_lights,light_rendered_optimised_dynamic_lights);
+    if (stat_light_rebuild_stats.rebuilds_count > 0)
+    {
+        SYNCLOG("Static light map: %lu rebuilds, last had %ld tiles, %ld lights, %ld shadow casts and took %lu us; average %lu us, max %lu us",
+            stat_light_rebuild_stats.rebuilds_count,stat_light_rebuild_stats.last_tiles,stat_light_rebuild_stats.last_lights,
+            stat_light_rebuild_stats.last_casts,(unsigned long)stat_light_rebuild_stats.last_time,
+            (unsigned long)(stat_light_rebuild_stats.total_time/stat_light_rebuild_stats.rebuilds_count),
+            (unsigned long)stat_light_rebuild_stats.max_time);
+    }
     return false;
 }
 
@@ -372,7 +685,43 @@ long light_is_light_allocated(long lgt_id)
 
 void light_set_light_position(long lgt_id, struct Coord3d *pos)
 {
-  _DK_light_set_light_position(lgt_id, pos);
+    struct Light *lgt;
+    TbBool stl_changed;
+    if ((lgt_id <= 0) || (lgt_id >= LIGHTS_COUNT))
+    {
+        ERRORLOG("Attempt to set position of invalid light %d",(int)lgt_id);
+        return;
+    }
+    lgt = &game.lish.lights[lgt_id];
+    if ((lgt->flags & LgtF_Allocated) == 0)
+    {
+        ERRORLOG("Attempt to set position of unallocated light structure %d",(int)lgt_id);
+        return;
+    }
+    if ((lgt->mappos.x.val == pos->x.val) && (lgt->mappos.y.val == pos->y.val)
+     && (lgt->mappos.z.val == pos->z.val))
+        return;
+    // Shadows depend only on the subtile of the light, so moving within it doesn't require new cast
+    stl_changed = (lgt->mappos.x.stl.num != pos->x.stl.num) || (lgt->mappos.y.stl.num != pos->y.stl.num)
+     || (lgt->mappos.z.stl.num != pos->z.stl.num);
+    if ((lgt->flags & LgtF_Dynamic) == 0)
+    {
+        // Static light map has to be updated at both old and new place
+        light_signal_stat_light_update_in_own_radius(lgt);
+        lgt->mappos.x.val = pos->x.val;
+        lgt->mappos.y.val = pos->y.val;
+        lgt->mappos.z.val = pos->z.val;
+        light_signal_stat_light_update_in_own_radius(lgt);
+    } else
+    {
+        lgt->mappos.x.val = pos->x.val;
+        lgt->mappos.y.val = pos->y.val;
+        lgt->mappos.z.val = pos->z.val;
+    }
+    light_grid_update_light(lgt);
+    if (stl_changed)
+        light_shadow_cache_invalidate(lgt);
+    lgt->flags |= LgtF_NeedUpdate;
 }
 
 void light_remove_light_from_list(struct Light *lgt, struct StructureList *list)
@@ -380,14 +729,51 @@ void light_remove_light_from_list(struct Light *lgt, struct StructureList *list)
   _DK_light_remove_light_from_list(lgt, list);
 }
 
+/**
+ * Marks area of the static light map as requiring rebuild.
+ * The rebuild itself is postponed until the light map is rendered.
+ */
 void light_signal_stat_light_update_in_area(long x1, long y1, long x2, long y2)
 {
-  _DK_light_signal_stat_light_update_in_area(x1, y1, x2, y2);
+    long tile_x,tile_y;
+    if (x1 < 0) x1 = 0;
+    if (y1 < 0) y1 = 0;
+    if (x2 > map_subtiles_x) x2 = map_subtiles_x;
+    if (y2 > map_subtiles_y) y2 = map_subtiles_y;
+    if ((x2 < x1) || (y2 < y1))
+        return;
+    for (tile_y = y1/LIGHT_MAP_TILE_SIZE; tile_y <= y2/LIGHT_MAP_TILE_SIZE; tile_y++)
+    {
+        for (tile_x = x1/LIGHT_MAP_TILE_SIZE; tile_x <= x2/LIGHT_MAP_TILE_SIZE; tile_x++)
+        {
+            stat_light_dirty_tiles[tile_y*LIGHT_MAP_TILES_ROW + tile_x] = 1;
+        }
+    }
+    stat_light_needs_updating = 1;
 }
 
+/**
+ * Informs the light system that map geometry in given area has changed.
+ * Shadows of all lights which reach the area have to be re-cast.
+ */
 void light_signal_update_in_area(long sx, long sy, long ex, long ey)
 {
-    _DK_light_signal_update_in_area(sx, sy, ex, ey);
+    struct Light *lgt;
+    long range,i;
+    for (i=1; i < LIGHTS_COUNT; i++)
+    {
+        lgt = &game.lish.lights[i];
+        if ((lgt->flags & LgtF_Allocated) == 0)
+            continue;
+        range = light_get_cast_range(lgt);
+        if ((lgt->mappos.x.stl.num + range < sx) || (lgt->mappos.x.stl.num - range > ex)
+         || (lgt->mappos.y.stl.num + range < sy) || (lgt->mappos.y.stl.num - range > ey))
+            continue;
+        light_shadow_cache_invalidate(lgt);
+        lgt->flags |= LgtF_NeedUpdate;
+        if ((lgt->flags & LgtF_Dynamic) == 0)
+            light_signal_stat_light_update_in_own_radius(lgt);
+    }
 }
 
 void light_signal_stat_light_update_in_own_radius(struct Light *lgt)
@@ -395,7 +781,7 @@ void light_signal_stat_light_update_in_own_radius(struct Light *lgt)
     long start_x,end_x;
     long start_y,end_y;
     long radius;
-    radius = lgt->range;
+    radius = light_get_cast_range(lgt);
     end_y = (long)lgt->mappos.y.stl.num + radius;
     if (end_y >= 255)
         end_y = 255;
@@ -459,23 +845,56 @@ void light_turn_light_on(long idx)
     if ((lgt->flags & LgtF_Dynamic) != 0)
     {
         light_add_light_to_list(lgt, &game.thing_lists[TngList_DynamLights]);
-        lgt->flags |= LgtF_Unkn08;
+        lgt->flags |= LgtF_NeedUpdate;
     } else
     {
         light_add_light_to_list(lgt, &game.thing_lists[TngList_StaticLights]);
-        stat_light_needs_updating = 1;
-        lgt->flags |= LgtF_Unkn08;
+        light_signal_stat_light_update_in_own_radius(lgt);
+        lgt->flags |= LgtF_NeedUpdate;
     }
 }
 
 long light_get_light_intensity(long idx)
 {
-  return _DK_light_get_light_intensity(idx);
+    struct Light *lgt;
+    if ((idx <= 0) || (idx >= LIGHTS_COUNT)) {
+        ERRORLOG("Attempt to get intensity of light %d",(int)idx);
+        return 0;
+    }
+    lgt = &game.lish.lights[idx];
+    if ((lgt->flags & LgtF_Allocated) == 0) {
+        ERRORLOG("Attempt to get intensity of unallocated light structure %d",(int)idx);
+        return 0;
+    }
+    return lgt->intensity;
 }
 
-long light_set_light_intensity(long a1, long a2)
+long light_set_light_intensity(long idx, long intensity)
 {
-  return _DK_light_set_light_intensity(a1, a2);
+    struct Light *lgt;
+    long prev_intensity;
+    if ((idx <= 0) || (idx >= LIGHTS_COUNT)) {
+        ERRORLOG("Attempt to set intensity of light %d",(int)idx);
+        return 0;
+    }
+    lgt = &game.lish.lights[idx];
+    if ((lgt->flags & LgtF_Allocated) == 0) {
+        ERRORLOG("Attempt to set intensity of unallocated light structure %d",(int)idx);
+        return 0;
+    }
+    if (intensity < 0)
+        intensity = 0;
+    if (intensity > UCHAR_MAX)
+        intensity = UCHAR_MAX;
+    prev_intensity = lgt->intensity;
+    if (prev_intensity == intensity)
+        return prev_intensity;
+    lgt->intensity = intensity;
+    lgt->flags |= LgtF_NeedUpdate;
+    // Shadows are still valid, only the static light map needs to be updated
+    if ((lgt->flags & LgtF_Dynamic) == 0)
+        light_signal_stat_light_update_in_own_radius(lgt);
+    return prev_intensity;
 }
 
 void clear_stat_light_map(void)
@@ -497,7 +916,6 @@ void clear_stat_light_map(void)
 void light_delete_light(long idx)
 {
     struct Light *lgt;
-    struct ShadowCache *shdc;
 
     if ((idx <= 0) || (idx >= LIGHTS_COUNT)) {
         ERRORLOG("Attempt to delete light %d",(int)idx);
@@ -508,11 +926,9 @@ void light_delete_light(long idx)
         ERRORLOG("Attempt to delete unallocated light structure %d",(int)idx);
         return;
     }
-    if (lgt->shadow_index > 0)
-    {
-        shdc = &game.lish.shadow_cache[lgt->shadow_index];
-        light_shadow_cache_free(shdc);
-    }
+    if ((lgt->shadow_index > 0) && (lgt->shadow_index < SHADOW_CACHE_COUNT))
+        light_shadow_cache_free(&game.lish.shadow_cache[lgt->shadow_index]);
+    LbMemorySet(light_get_shadows(lgt), 0, sizeof(struct LightShadows));
     if ((lgt->flags & LgtF_Dynamic) != 0)
     {
         light_total_dynamic_lights--;
@@ -523,6 +939,7 @@ void light_delete_light(long idx)
         light_signal_stat_light_update_in_own_radius(lgt);
         light_remove_light_from_list(lgt, &game.thing_lists[TngList_StaticLights]);
     }
+    light_grid_remove_light(lgt);
     light_free_light(lgt);
 }
 
@@ -549,7 +966,10 @@ void light_initialise(void)
         }
         game.lish.field_4614E = 1;
     }
-    stat_light_needs_updating = 1;
+    LbMemorySet(light_shadows, 0, sizeof(light_shadows));
+    LbMemorySet(&lights_grid, 0, sizeof(lights_grid));
+    LbMemorySet(&stat_light_rebuild_stats, 0, sizeof(stat_light_rebuild_stats));
+    light_signal_stat_light_update_in_area(0, 0, map_subtiles_x, map_subtiles_y);
     light_total_dynamic_lights = 0;
     light_total_stat_lights = 0;
     light_rendered_dynamic_lights = 0;
@@ -558,9 +978,26 @@ void light_initialise(void)
     light_out_of_date_stat_lights = 0;
 }
 
+/**
+ * Fills area of the static light map with ambient lightness.
+ */
 void light_stat_light_map_clear_area(long x1, long y1, long x2, long y2)
 {
-  _DK_light_stat_light_map_clear_area(x1, y1, x2, y2);
+    unsigned short ambient;
+    long x,y;
+    SYNCDBG(16,"Starting");
+    if (x1 < 0) x1 = 0;
+    if (y1 < 0) y1 = 0;
+    if (x2 > map_subtiles_x) x2 = map_subtiles_x;
+    if (y2 > map_subtiles_y) y2 = map_subtiles_y;
+    ambient = game.lish.field_46149 << 8;
+    for (y = y1; y <= y2; y++)
+    {
+        for (x = x1; x <= x2; x++)
+        {
+            game.lish.stat_light_map[get_subtile_number(x,y)] = ambient;
+        }
+    }
 }
 
 void light_set_lights_on(char state)
@@ -579,9 +1016,215 @@ void light_set_lights_on(char state)
     light_signal_stat_light_update_in_area(1, 1, map_subtiles_x, map_subtiles_y);
 }
 
-void light_render_area(int startx, int starty, int endx, int endy)
+static TbBool light_in_rect(const struct Light *lgt, MapSubtlCoord start_x, MapSubtlCoord start_y, MapSubtlCoord end_x, MapSubtlCoord end_y)
+{
+    long range;
+    range = light_get_cast_range(lgt);
+    if ((lgt->mappos.x.stl.num + range < start_x) || (lgt->mappos.x.stl.num - range > end_x))
+        return false;
+    if ((lgt->mappos.y.stl.num + range < start_y) || (lgt->mappos.y.stl.num - range > end_y))
+        return false;
+    return true;
+}
+
+static void light_stat_light_tile_rect(long tile_idx, MapSubtlCoord *start_x, MapSubtlCoord *start_y, MapSubtlCoord *end_x, MapSubtlCoord *end_y)
 {
-  _DK_light_render_area(startx, starty, endx, endy);
+    *start_x = (tile_idx % LIGHT_MAP_TILES_ROW) * LIGHT_MAP_TILE_SIZE;
+    *start_y = (tile_idx / LIGHT_MAP_TILES_ROW) * LIGHT_MAP_TILE_SIZE;
+    *end_x = min(*start_x + LIGHT_MAP_TILE_SIZE - 1, map_subtiles_x);
+    *end_y = min(*start_y + LIGHT_MAP_TILE_SIZE - 1, map_subtiles_y);
+}
+
+/**
+ * Job for workers - casts shadows of a light whose shadow cache is out of date.
+ */
+static void light_stat_light_cast_job(void *data, long job_idx)
+{
+    struct StatLightRebuild *rebld;
+    struct Light *lgt;
+    struct LightShadows *lshad;
+    rebld = (struct StatLightRebuild *)data;
+    lgt = &game.lish.lights[rebld->lights[job_idx]];
+    lshad = light_get_shadows(lgt);
+    if ((lshad->flags & ShCF_Valid) == 0)
+        light_cast_shadows(lgt, lshad);
+}
+
+/**
+ * Job for workers - rebuilds one tile of the static light map.
+ * Tiles don't overlap, so every job writes to a different part of the map.
+ */
+static void light_stat_light_tile_job(void *data, long job_idx)
+{
+    struct StatLightRebuild *rebld;
+    struct Light *lgt;
+    MapSubtlCoord start_x,start_y,end_x,end_y;
+    long i;
+    rebld = (struct StatLightRebuild *)data;
+    light_stat_light_tile_rect(rebld->tiles[job_idx], &start_x, &start_y, &end_x, &end_y);
+    light_stat_light_map_clear_area(start_x, start_y, end_x, end_y);
+    for (i=0; i < rebld->lights_count; i++)
+    {
+        lgt = &game.lish.lights[rebld->lights[i]];
+        if (!light_in_rect(lgt, start_x, start_y, end_x, end_y))
+            continue;
+        light_render_light_in_rect(lgt, light_get_shadows(lgt), game.lish.stat_light_map,
+            start_x, start_y, end_x, end_y, false);
+    }
+}
+
+/**
+ * Rebuilds parts of the static light map which were marked as requiring update.
+ * Shadows are re-cast only for lights which have their cache invalidated.
+ * Both stages are split into independent jobs and executed by workers.
+ */
+void light_stat_light_map_rebuild(void)
+{
+    struct StatLightRebuild *rebld;
+    struct Light *lgt;
+    MapSubtlCoord start_x,start_y,end_x,end_y;
+    TbClockUSec start_time;
+    long i,n,tile_x,tile_y;
+    unsigned long k;
+    SYNCDBG(9,"Starting");
+    start_time = LbTimerClockMicro();
+    rebld = &stat_light_rebuild;
+    rebld->tiles_count = 0;
+    for (i=0; i < LIGHT_MAP_TILES_COUNT; i++)
+    {
+        if (stat_light_dirty_tiles[i])
+        {
+            rebld->tiles[rebld->tiles_count] = i;
+            rebld->tiles_count++;
+        }
+    }
+    // Gather lights which affect any of the dirty tiles
+    rebld->lights_count = 0;
+    n = 0;
+    i = game.thing_lists[TngList_StaticLights].index;
+    k = 0;
+    while (i > 0)
+    {
+        lgt = &game.lish.lights[i];
+        i = lgt->field_26;
+        // Per-light code
+        lgt->range = light_get_cast_range(lgt);
+        start_x = max(lgt->mappos.x.stl.num - lgt->range, 0) / LIGHT_MAP_TILE_SIZE;
+        start_y = max(lgt->mappos.y.stl.num - lgt->range, 0) / LIGHT_MAP_TILE_SIZE;
+        end_x = min(lgt->mappos.x.stl.num + lgt->range, 255) / LIGHT_MAP_TILE_SIZE;
+        end_y = min(lgt->mappos.y.stl.num + lgt->range, 255) / LIGHT_MAP_TILE_SIZE;
+        for (tile_y = start_y; tile_y <= end_y; tile_y++)
+        {
+            for (tile_x = start_x; tile_x <= end_x; tile_x++)
+            {
+                if (stat_light_dirty_tiles[tile_y*LIGHT_MAP_TILES_ROW + tile_x])
+                    break;
+            }
+            if (tile_x <= end_x)
+                break;
+        }
+        if (tile_y <= end_y)
+        {
+            if ((light_get_shadows(lgt)->flags & ShCF_Valid) == 0)
+                n++;
+            lgt->flags &= ~LgtF_NeedUpdate;
+            rebld->lights[rebld->lights_count] = lgt->index;
+            rebld->lights_count++;
+        }
+        // Per-light code ends
+        k++;
+        if (k > LIGHTS_COUNT)
+        {
+            ERRORLOG("Infinite loop detected when sweeping lights list");
+            break;
+        }
+    }
+    light_out_of_date_stat_lights = n;
+    LbWorkersRun(light_stat_light_cast_job, rebld, rebld->lights_count);
+    LbWorkersRun(light_stat_light_tile_job, rebld, rebld->tiles_count);
+    LbMemorySet(stat_light_dirty_tiles, 0, sizeof(stat_light_dirty_tiles));
+    light_updated_stat_lights = rebld->lights_count;
+    // Update statistics
+    stat_light_rebuild_stats.rebuilds_count++;
+    stat_light_rebuild_stats.last_tiles = rebld->tiles_count;
+    stat_light_rebuild_stats.last_lights = rebld->lights_count;
+    stat_light_rebuild_stats.last_casts = n;
+    stat_light_rebuild_stats.last_time = LbTimerClockMicro() - start_time;
+    stat_light_rebuild_stats.total_time += stat_light_rebuild_stats.last_time;
+    if (stat_light_rebuild_stats.max_time < stat_light_rebuild_stats.last_time)
+        stat_light_rebuild_stats.max_time = stat_light_rebuild_stats.last_time;
+    SYNCDBG(9,"Rebuilt %ld tiles with %ld lights, %ld shadows cast",rebld->tiles_count,rebld->lights_count,n);
+}
+
+/**
+ * Renders dynamic lights from given list into subtile lightness map.
+ * @return Amount of lights rendered.
+ */
+long light_render_dynamic_lights_on_list(ThingIndex list_start_idx, MapSubtlCoord start_x, MapSubtlCoord start_y, MapSubtlCoord end_x, MapSubtlCoord end_y)
+{
+    struct Light *lgt;
+    struct LightShadows *lshad;
+    long i,n;
+    unsigned long k;
+    n = 0;
+    i = list_start_idx;
+    k = 0;
+    while (i > 0)
+    {
+        lgt = &game.lish.lights[i];
+        i = lgt->field_26;
+        // Per-light code
+        if (light_in_rect(lgt, start_x, start_y, end_x, end_y))
+        {
+            lshad = light_get_shadows(lgt);
+            if ((lshad->flags & ShCF_Valid) == 0) {
+                light_cast_shadows(lgt, lshad);
+            } else {
+                light_rendered_optimised_dynamic_lights++;
+            }
+            lgt->flags &= ~LgtF_NeedUpdate;
+            light_render_light_in_rect(lgt, lshad, game.lish.subtile_lightness,
+                start_x, start_y, end_x, end_y, true);
+            n++;
+        }
+        // Per-light code ends
+        k++;
+        if (k > LIGHTS_COUNT)
+        {
+            ERRORLOG("Infinite loop detected when sweeping lights list");
+            break;
+        }
+    }
+    return n;
+}
+
+/**
+ * Updates subtile lightness within given area.
+ * Static light map is rebuilt if needed and used as a base, then dynamic lights are added.
+ */
+void light_render_area(MapSubtlCoord startx, MapSubtlCoord starty, MapSubtlCoord endx, MapSubtlCoord endy)
+{
+    long y,n;
+    SYNCDBG(6,"Starting");
+    light_rendered_dynamic_lights = 0;
+    light_rendered_optimised_dynamic_lights = 0;
+    light_updated_stat_lights = 0;
+    light_out_of_date_stat_lights = 0;
+    if (stat_light_needs_updating)
+    {
+        light_stat_light_map_rebuild();
+        stat_light_needs_updating = 0;
+    }
+    if ((endx < startx) || (endy < starty))
+        return;
+    for (y = starty; y <= endy; y++)
+    {
+        n = get_subtile_number(startx,y);
+        LbMemoryCopy(&game.lish.subtile_lightness[n], &game.lish.stat_light_map[n],
+            (endx-startx+1)*sizeof(game.lish.stat_light_map[0]));
+    }
+    light_rendered_dynamic_lights = light_render_dynamic_lights_on_list(
+        game.thing_lists[TngList_DynamLights].index, startx, starty, endx, endy);
 }
 
 void update_light_render_area(void)
@@ -25,6 +25,10 @@
 #define LIGHT_MAX_RANGE        30
 #define LIGHTS_COUNT          400
 #define MINIMUM_LIGHTNESS    8192
+/** Size of lights grid cell, in subtiles. */
+#define LIGHT_GRID_CELL_SIZE    8
+#define LIGHT_GRID_ROW       (256/LIGHT_GRID_CELL_SIZE)
+#define LIGHT_GRID_CELLS_COUNT (LIGHT_GRID_ROW*LIGHT_GRID_ROW)
 
 #ifdef __cplusplus
 extern "C" {
@@ -37,19 +41,20 @@ struct StructureList;
 
 enum ShadowCacheFlags {
     ShCF_Allocated = 0x01,
+    ShCF_Valid     = 0x02,
 };
 
 enum LightFlags {
     LgtF_Allocated    = 0x01,
     LgtF_Unkn02       = 0x02,
     LgtF_Dynamic      = 0x04,
-    LgtF_Unkn08       = 0x08,
+    LgtF_NeedUpdate   = 0x08,
 };
 
 struct Light { // sizeof = 46
   unsigned char flags;
   unsigned char field_1;
-  unsigned char field_2;
+  unsigned char intensity;
   unsigned char field_3[2];
   unsigned char range;
   unsigned char field_6;
@@ -58,7 +63,7 @@ struct Light { // sizeof = 46
   unsigned short index;
   unsigned short shadow_index;
   long field_12;
-  unsigned short field_16;
+  unsigned short radius;
   short field_18;
   short field_1A;
   unsigned char field_1C[10];
@@ -126,11 +131,17 @@ void light_set_light_position(long lgt_id, struct Coord3d *pos);
 void light_set_lights_on(char state);
 void light_set_light_minimum_size_to_cache(long a1, long a2, long a3);
 void light_signal_update_in_area(long sx, long sy, long ex, long ey);
+void light_signal_stat_light_update_in_area(long x1, long y1, long x2, long y2);
+void light_signal_stat_light_update_in_own_radius(struct Light *lgt);
 long light_get_total_dynamic_lights(void);
 void light_export_system_state(struct LightSystemState *lightst);
 void light_import_system_state(const struct LightSystemState *lightst);
 TbBool lights_stats_debug_dump(void);
 
+long light_grid_cell_coord(MapCoord pos_v);
+ThingIndex light_grid_first_light_in_cell(long cell_x, long cell_y);
+ThingIndex light_grid_next_light_in_cell(const struct Light *lgt);
+
 /******************************************************************************/
 #ifdef __cplusplus
 }
@@ -28,10 +28,13 @@
 
 #include "front_simple.h"
 #include "config.h"
+#include "config_cache.h"
 #include "config_campaigns.h"
 #include "config_terrain.h"
 #include "light_data.h"
+#include "map_blocks.h"
 #include "map_utils.h"
+#include "room_data.h"
 #include "thing_factory.h"
 #include "engine_textures.h"
 #include "game_legacy.h"
@@ -51,8 +54,143 @@ const char slabdat_fname[] = "slabs.dat";
  * or any other function used beyond first initialization of a level.
   */
 long level_file_version = 0;
+
+/** Whether terrain of loaded levels is stored in, and restored from, the level cache. */
+TbBool level_cache_enabled = false;
+/** Amount of levels which terrain was loaded from the cache; allows checking that the cache was used. */
+unsigned long level_cache_loads = 0;
+/******************************************************************************/
+#define LEVEL_CACHE_MAGIC "KFXL"
+
+/** Level files which the cached terrain is built from. */
+static const char *level_cache_map_file_exts[] = {
+    "dat", "flg", "clm", "own", "wib", "inf", "slb", "wlb",
+};
+
+/** Buffer into which terrain is stored while the level is loaded from files, if the cache is to be written. */
+static unsigned char *level_cache_data = NULL;
 /******************************************************************************/
 
+static unsigned long level_cache_transfer(unsigned char *buf, unsigned long pos, void *data, unsigned long size, TbBool restore)
+{
+    if (buf != NULL)
+    {
+        if (restore)
+            LbMemoryCopy(data, &buf[pos], size);
+        else
+            LbMemoryCopy(&buf[pos], data, size);
+    }
+    return pos + size;
+}
+
+/**
+ * Copies the part of game state which is set by loading terrain of a level,
+ * between the game and given cache buffer.
+ * @param buf The cache buffer, or NULL to only compute size of the data.
+ * @param restore If true, the data is copied from the buffer into the game; otherwise the game data is stored.
+ * @return Size of the terrain data.
+ */
+static unsigned long level_cache_transfer_terrain(unsigned char *buf, TbBool restore)
+{
+    unsigned long pos;
+    pos = 0;
+    pos = level_cache_transfer(buf, pos, game.map, sizeof(game.map), restore);
+    pos = level_cache_transfer(buf, pos, game.navigation_map, sizeof(game.navigation_map), restore);
+    pos = level_cache_transfer(buf, pos, game.slabmap, sizeof(game.slabmap), restore);
+    pos = level_cache_transfer(buf, pos, game.columns_data, sizeof(game.columns_data), restore);
+    pos = level_cache_transfer(buf, pos, &game.field_14AB3F, sizeof(game.field_14AB3F), restore);
+    pos = level_cache_transfer(buf, pos, &game.field_149E6E, sizeof(game.field_149E6E), restore);
+    pos = level_cache_transfer(buf, pos, &game.field_149E7C, sizeof(game.field_149E7C), restore);
+    pos = level_cache_transfer(buf, pos, &game.unrevealed_column_idx, sizeof(game.unrevealed_column_idx), restore);
+    pos = level_cache_transfer(buf, pos, game.field_14A818, sizeof(game.field_14A818), restore);
+    pos = level_cache_transfer(buf, pos, &game.slabset_num, sizeof(game.slabset_num), restore);
+    pos = level_cache_transfer(buf, pos, game.slabset, sizeof(game.slabset), restore);
+    pos = level_cache_transfer(buf, pos, &game.slabobjs_num, sizeof(game.slabobjs_num), restore);
+    pos = level_cache_transfer(buf, pos, game.slabobjs_idx, sizeof(game.slabobjs_idx), restore);
+    pos = level_cache_transfer(buf, pos, game.slabobjs, sizeof(game.slabobjs), restore);
+    pos = level_cache_transfer(buf, pos, game.lish.subtile_lightness, sizeof(game.lish.subtile_lightness), restore);
+    pos = level_cache_transfer(buf, pos, &game.texture_id, sizeof(game.texture_id), restore);
+    return pos;
+}
+
+/**
+ * Copies WLB flags of all slabs between the game and given buffer.
+ * These are set after rooms are created, so they're stored separately from the rest of terrain.
+ */
+static unsigned long level_cache_transfer_wlb(unsigned char *buf, TbBool restore)
+{
+    struct SlabMap *slb;
+    unsigned long x,y;
+    unsigned long i;
+    i = 0;
+    for (y=0; y < map_tiles_y; y++)
+      for (x=0; x < map_tiles_x; x++)
+      {
+        slb = get_slabmap_block(x,y);
+        if (restore)
+          slb->field_5 ^= (slb->field_5 ^ buf[i]) & (0x08|0x10);
+        else
+          buf[i] = slb->field_5 & (0x08|0x10);
+        i++;
+      }
+    return i;
+}
+
+static unsigned long level_cache_data_size(void)
+{
+    return level_cache_transfer_terrain(NULL, false) + map_tiles_y*map_tiles_x;
+}
+
+/**
+ * Computes the cache key from contents of all files which the level terrain is built from,
+ * and from terrain config which affects it.
+ */
+static unsigned long level_cache_compute_key(LevelNumber lvnum)
+{
+    char fname[DISKPATH_SIZE];
+    unsigned long hash;
+    short fgroup;
+    long i;
+    hash = cache_key_init(LEVEL_CACHE_VERSION);
+    hash = cache_hash_long(hash, level_cache_data_size());
+    hash = cache_hash_long(hash, lvnum);
+    fgroup = get_level_fgroup(lvnum);
+    for (i=0; i < sizeof(level_cache_map_file_exts)/sizeof(level_cache_map_file_exts[0]); i++)
+    {
+        LbStringCopy(fname, prepare_file_fmtpath(fgroup,"map%05lu.%s",(unsigned long)lvnum,level_cache_map_file_exts[i]), sizeof(fname));
+        hash = cache_hash_file(hash, fname);
+    }
+    LbStringCopy(fname, prepare_file_path(FGrp_StdData,slabclm_fname), sizeof(fname));
+    hash = cache_hash_file(hash, fname);
+    LbStringCopy(fname, prepare_file_path(FGrp_StdData,slabdat_fname), sizeof(fname));
+    hash = cache_hash_file(hash, fname);
+    LbStringCopy(fname, prepare_file_path(FGrp_StdData,"slabs.tng"), sizeof(fname));
+    hash = cache_hash_file(hash, fname);
+    for (i=0; i < SLAB_TYPES_COUNT; i++)
+    {
+        hash = cache_hash(hash, get_slab_kind_attrs(i), sizeof(struct SlabAttr));
+    }
+    hash = cache_hash(hash, game.block_health, sizeof(game.block_health));
+    return hash;
+}
+
+static void level_cache_fname(char *fname, LevelNumber lvnum)
+{
+    char cmpgn_name[DISKPATH_SIZE];
+    get_cache_campaign_name(cmpgn_name, sizeof(cmpgn_name));
+    LbStringCopy(fname, prepare_file_fmtpath(FGrp_Save, "lvlmap_%s_%05lu.cache", cmpgn_name, (unsigned long)lvnum), DISKPATH_SIZE);
+}
+
+/**
+ * Removes cache file of given level in current campaign.
+ */
+void clear_level_cache(LevelNumber lvnum)
+{
+    char fname[DISKPATH_SIZE];
+    level_cache_fname(fname, lvnum);
+    LbFileDelete(fname);
+}
+
 /**
  * Loads map file with given level number and file extension.
  * @return Returns NULL if the file doesn't exist or is smaller than ldsize;
@@ -1168,6 +1306,9 @@ short load_map_slab_file(unsigned long lv_num)
     LbMemoryFree(buf);
     initialise_map_collides();
     initialise_map_health();
+    // Rooms are not cached, so the terrain needs to be stored before they're created
+    if (level_cache_data != NULL)
+        level_cache_transfer_terrain(level_cache_data, false);
     initialise_extra_slab_info(lv_num);
     return true;
 }
@@ -1259,32 +1400,91 @@ short load_and_setup_map_info(unsigned long lv_num)
     return true;
 }
 
+/**
+ * Sets level terrain from the cache, if it matches current level files.
+ * Things, lights and action points are not cached, and are loaded from files as usual.
+ * @return True if the level was loaded; false if it has to be loaded from files.
+ */
+static TbBool load_level_file_from_cache(LevelNumber lvnum, unsigned long key)
+{
+    char fname[DISKPATH_SIZE];
+    unsigned char *buf;
+    unsigned long data_size;
+    unsigned long pos;
+    level_cache_fname(fname, lvnum);
+    buf = load_cache_file(fname, LEVEL_CACHE_MAGIC, LEVEL_CACHE_VERSION, key, &data_size);
+    if (buf == NULL)
+        return false;
+    if (data_size != level_cache_data_size())
+    {
+        WARNLOG("Level cache \"%s\" has wrong size",fname);
+        LbMemoryFree(buf);
+        return false;
+    }
+    pos = level_cache_transfer_terrain(buf, true);
+    // Caches which depend on map solidity need to drop what they know about previous map
+    map_solidity_changed_in_area(0, 0, map_subtiles_x, map_subtiles_y);
+    load_static_light_file(lvnum);
+    load_texture_map_file(game.texture_id, 2);
+    load_action_point_file(lvnum);
+    initialise_map_rooms();
+    level_cache_transfer_wlb(&buf[pos], true);
+    LbMemoryFree(buf);
+    level_cache_loads++;
+    SYNCMSG("Level terrain loaded from cache \"%s\"",fname);
+    return true;
+}
+
 short load_level_file(LevelNumber lvnum)
 {
     char *fname;
     short fgroup;
     short result;
+    TbBool use_cache;
+    unsigned long cache_key;
+    char cache_fname[DISKPATH_SIZE];
     fgroup = get_level_fgroup(lvnum);
     fname = prepare_file_fmtpath(fgroup,"map%05lu.slb",(unsigned long)lvnum);
     wait_for_cd_to_be_available();
     if (LbFileExists(fname))
     {
         result = true;
-        load_map_data_file(lvnum);
-        load_map_flag_file(lvnum);
-        load_column_file(lvnum);
-        init_whole_blocks();
-        load_slab_file();
-        init_columns();
-        load_static_light_file(lvnum);
-        if (!load_map_ownership_file(lvnum))
-          result = false;
-        load_map_wibble_file(lvnum);
-        load_and_setup_map_info(lvnum);
-        load_texture_map_file(game.texture_id, 2);
-        load_action_point_file(lvnum);
-        if (!load_map_slab_file(lvnum))
-          result = false;
+        use_cache = level_cache_enabled && ((game.operation_flags & GOF_ColumnConvert) == 0);
+        cache_key = 0;
+        if (use_cache)
+            cache_key = level_cache_compute_key(lvnum);
+        if ((!use_cache) || (!load_level_file_from_cache(lvnum, cache_key)))
+        {
+            if (use_cache)
+                level_cache_data = (unsigned char *)LbMemoryAlloc(level_cache_data_size());
+            load_map_data_file(lvnum);
+            load_map_flag_file(lvnum);
+            load_column_file(lvnum);
+            init_whole_blocks();
+            load_slab_file();
+            init_columns();
+            load_static_light_file(lvnum);
+            if (!load_map_ownership_file(lvnum))
+              result = false;
+            load_map_wibble_file(lvnum);
+            load_and_setup_map_info(lvnum);
+            load_texture_map_file(game.texture_id, 2);
+            load_action_point_file(lvnum);
+            if (!load_map_slab_file(lvnum))
+              result = false;
+            if (level_cache_data != NULL)
+            {
+                // Terrain was stored while loading SLB file; only WLB flags are left
+                if (result)
+                {
+                    level_cache_transfer_wlb(&level_cache_data[level_cache_transfer_terrain(NULL, false)], false);
+                    level_cache_fname(cache_fname, lvnum);
+                    save_cache_file(cache_fname, LEVEL_CACHE_MAGIC, LEVEL_CACHE_VERSION, cache_key, level_cache_data, level_cache_data_size());
+                }
+                LbMemoryFree(level_cache_data);
+                level_cache_data = NULL;
+            }
+        }
         if (!load_thing_file(lvnum))
           result = false;
         reinitialise_map_rooms();
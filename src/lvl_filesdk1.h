@@ -30,6 +30,8 @@ extern "C" {
 #define MAX_LIF_SIZE 65535
 #define ANY_MAP_FILE_MAX_SIZE 1048576
 #define DEFAULT_LEVEL_VERSION 0
+/** Version of the level cache file format; needs to be increased when cached game structs change. */
+#define LEVEL_CACHE_VERSION 1
 
 enum LoadMapFileFlags {
     LMFF_None     = 0x00,
@@ -37,6 +39,8 @@ enum LoadMapFileFlags {
 };
 /******************************************************************************/
 extern long level_file_version;
+extern TbBool level_cache_enabled;
+extern unsigned long level_cache_loads;
 /******************************************************************************/
 unsigned char *load_single_map_file_to_buffer(LevelNumber lvnum,const char *fext,long *ldsize,unsigned short flags);
 TbBool find_and_load_lif_files(void);
@@ -49,6 +53,7 @@ TbBool load_thing_file(LevelNumber lv_num);
 TbBool load_action_point_file(LevelNumber lv_num);
 
 TbBool load_map_file(LevelNumber lvnum);
+void clear_level_cache(LevelNumber lvnum);
 /******************************************************************************/
 #ifdef __cplusplus
 }
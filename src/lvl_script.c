@@ -29,6 +29,8 @@
 
 #include "front_simple.h"
 #include "config.h"
+#include "config_cache.h"
+#include "config_campaigns.h"
 #include "config_terrain.h"
 #include "config_trapdoor.h"
 #include "config_rules.h"
@@ -383,6 +385,97 @@ const struct NamedCommand gui_button_group_desc[] = {
   {NULL,               0},
 };
 
+/******************************************************************************/
+/** Distinct value read by script conditions; conditions which read the same value share one entry. */
+struct ConditionInput {
+    PlayerNumber plyr_idx;
+    unsigned char valtype;
+    unsigned char validx;
+    long value;
+    /** Number of the conditions processing pass in which the value was last refreshed. */
+    unsigned long pass;
+    /** Conditions which read this value. */
+    unsigned char conditions[CONDITIONS_COUNT];
+    unsigned char conditions_num;
+};
+
+/**
+ * Index from values read by script conditions to the conditions which read them.
+ * Built from condition definitions, and rebuilt whenever these definitions change.
+ */
+struct ConditionsIndex {
+    struct ConditionInput inputs[CONDITIONS_COUNT*PLAYERS_COUNT];
+    unsigned long inputs_num;
+    /** Copy of conditions for which the index was built. */
+    struct Condition conditions[CONDITIONS_COUNT];
+    unsigned long conditions_num;
+    unsigned char hero_player_num;
+    unsigned char neutral_player_num;
+    /** Values read by every condition, one for each player in range. */
+    unsigned short cond_inputs[CONDITIONS_COUNT][PLAYERS_COUNT];
+    unsigned char cond_inputs_num[CONDITIONS_COUNT];
+    /** Amount of values which were needed to compute last result of the condition. */
+    unsigned char cond_inputs_used[CONDITIONS_COUNT];
+    TbBool cond_indexed[CONDITIONS_COUNT];
+    /** Whether any value read by the condition has changed since it was last evaluated. */
+    TbBool cond_dirty[CONDITIONS_COUNT];
+    TbBool cond_value[CONDITIONS_COUNT];
+    unsigned long pass;
+    TbBool built;
+};
+
+static struct ConditionsIndex conditions_index;
+
+#define SCRIPT_CACHE_MAGIC "KFXS"
+
+/** Kinds of command parameters within compiled script. */
+enum ScriptCacheOperandKinds {
+    SCOP_Text = 1,  /**< Text which the command interprets by itself. */
+    SCOP_Value,     /**< Number resolved when compiling, with the text it was resolved from. */
+    SCOP_Location,  /**< Map location name; resolved when loading, as it depends on map data. */
+    SCOP_Draw,      /**< Value selected when loading, from ranges given to a function. */
+};
+
+/** Kinds of value ranges given to a function which selects random value. */
+enum ScriptCacheDrawKinds {
+    SCDR_Values = 1, /**< Ranges of numbers resolved when compiling. */
+    SCDR_Texts,      /**< List of texts, each being one value. */
+    SCDR_Locations,  /**< Ranges of map location names, resolved when loading. */
+};
+
+/** Start of cached script data; the records follow it. */
+struct ScriptCacheInfo {
+    unsigned long records_count;
+    /** Amount of text lines in the script. */
+    unsigned long lines_count;
+};
+
+struct ScriptCompilerBuffer {
+    unsigned char *data;
+    unsigned long size;
+    unsigned long alloc_size;
+};
+
+/**
+ * Level script in compiled form, recorded while the script is parsed from text.
+ * Every record is a command opcode with its parameters, resolved into numbers
+ * unless they depend on map data. Scripts with errors aren't compiled, so that
+ * the errors are reported every time the level is loaded.
+ */
+struct ScriptCompiler {
+    struct ScriptCompilerBuffer records;
+    unsigned long records_count;
+    /** Ranges given to functions within parameters of the line being parsed; stored with the line. */
+    struct ScriptCompilerBuffer draws[COMMANDDESC_ARGS_COUNT];
+    /** Set if the script can't be stored in compiled form. */
+    TbBool failed;
+};
+
+static struct ScriptCompiler *script_compiler = NULL;
+/** Whether level scripts are cached in compiled form; enabled by command line option. */
+TbBool script_cache_enabled = false;
+/** Amount of level scripts loaded from the cache, for testing. */
+unsigned long script_cache_loads = 0;
 /******************************************************************************/
 DLLIMPORT long _DK_script_support_send_tunneller_to_appropriate_dungeon(struct Thing *thing);
 /******************************************************************************/
@@ -2464,6 +2557,153 @@ void script_add_command(const struct CommandDesc *cmd_desc, const struct ScriptL
     }
 }
 
+static void script_compiler_write(struct ScriptCompilerBuffer *cbuf, const void *buf, unsigned long len)
+{
+    unsigned char *data;
+    unsigned long alloc_size;
+    if (script_compiler->failed)
+        return;
+    if (cbuf->size + len > cbuf->alloc_size)
+    {
+        alloc_size = 2 * cbuf->alloc_size + len + 1024;
+        data = (unsigned char *)LbMemoryGrow(cbuf->data, alloc_size);
+        if (data == NULL)
+        {
+            script_compiler->failed = true;
+            return;
+        }
+        cbuf->data = data;
+        cbuf->alloc_size = alloc_size;
+    }
+    LbMemoryCopy(cbuf->data + cbuf->size, buf, len);
+    cbuf->size += len;
+}
+
+static void script_compiler_write_text(struct ScriptCompilerBuffer *cbuf, const char *text)
+{
+    unsigned long len;
+    len = strlen(text);
+    script_compiler_write(cbuf, &len, sizeof(len));
+    script_compiler_write(cbuf, text, len);
+}
+
+/**
+ * Marks the script being parsed as not possible to compile; used on errors.
+ */
+static void script_compiler_discard(void)
+{
+    if (script_compiler != NULL)
+        script_compiler->failed = true;
+}
+
+static void script_compiler_start_line(void)
+{
+    int i;
+    if (script_compiler == NULL)
+        return;
+    for (i=0; i < COMMANDDESC_ARGS_COUNT; i++)
+        script_compiler->draws[i].size = 0;
+}
+
+/**
+ * Stores value ranges given to a function within parameter of the line being parsed,
+ * so that the value can be selected again when the compiled script is loaded.
+ */
+static void script_compiler_add_draw(int idx, char type_chr, const struct CommandDesc *funcmd_desc, const struct ScriptLine *funscline,
+    const struct MinMax *ranges, const struct MinMax *range_texts, int ranges_num)
+{
+    struct ScriptCompilerBuffer *cbuf;
+    unsigned short func_index;
+    unsigned char draw_kind;
+    unsigned char num;
+    int ri;
+    if (script_compiler == NULL)
+        return;
+    cbuf = &script_compiler->draws[idx];
+    if (toupper(type_chr) == 'A') {
+        draw_kind = SCDR_Texts;
+    } else
+    if ((toupper(type_chr) == 'L') && (level_file_version > 0)) {
+        draw_kind = SCDR_Locations;
+    } else {
+        draw_kind = SCDR_Values;
+    }
+    func_index = funcmd_desc->index;
+    num = ranges_num;
+    script_compiler_write(cbuf, &draw_kind, sizeof(draw_kind));
+    script_compiler_write(cbuf, &func_index, sizeof(func_index));
+    script_compiler_write(cbuf, &num, sizeof(num));
+    for (ri=0; ri < ranges_num; ri++)
+    {
+        switch (draw_kind)
+        {
+        case SCDR_Texts:
+            script_compiler_write_text(cbuf, funscline->tp[ranges[ri].min]);
+            break;
+        case SCDR_Locations:
+            script_compiler_write_text(cbuf, funscline->tp[range_texts[ri].min]);
+            script_compiler_write_text(cbuf, funscline->tp[range_texts[ri].max]);
+            break;
+        default:
+            script_compiler_write(cbuf, &ranges[ri].min, sizeof(ranges[ri].min));
+            script_compiler_write(cbuf, &ranges[ri].max, sizeof(ranges[ri].max));
+            break;
+        }
+    }
+}
+
+/**
+ * Stores script line in compiled form - as command opcode and its parameters.
+ * Parameters are stored as numbers, except texts interpreted by the command itself,
+ * and map locations, which depend on map data and are resolved when loading.
+ */
+static void script_compiler_add_command(const struct CommandDesc *cmd_desc, const struct ScriptLine *scline, int args_count)
+{
+    struct ScriptCompilerBuffer *cbuf;
+    unsigned long line_num;
+    unsigned short opcode;
+    unsigned char args_num;
+    unsigned char kind;
+    int i;
+    if (script_compiler == NULL)
+        return;
+    cbuf = &script_compiler->records;
+    line_num = text_line_number;
+    opcode = cmd_desc->index;
+    args_num = min(args_count, COMMANDDESC_ARGS_COUNT);
+    script_compiler_write(cbuf, &line_num, sizeof(line_num));
+    script_compiler_write(cbuf, &opcode, sizeof(opcode));
+    script_compiler_write(cbuf, &args_num, sizeof(args_num));
+    for (i=0; i < args_num; i++)
+    {
+        if (script_compiler->draws[i].size > 0)
+        {
+            kind = SCOP_Draw;
+            script_compiler_write(cbuf, &kind, sizeof(kind));
+            script_compiler_write(cbuf, script_compiler->draws[i].data, script_compiler->draws[i].size);
+            continue;
+        }
+        switch (toupper(cmd_desc->args[i]))
+        {
+        case 'A':
+            kind = SCOP_Text;
+            script_compiler_write(cbuf, &kind, sizeof(kind));
+            break;
+        case 'L':
+            kind = SCOP_Location;
+            script_compiler_write(cbuf, &kind, sizeof(kind));
+            break;
+        default:
+            kind = SCOP_Value;
+            script_compiler_write(cbuf, &kind, sizeof(kind));
+            script_compiler_write(cbuf, &scline->np[i], sizeof(scline->np[i]));
+            break;
+        }
+        script_compiler_write_text(cbuf, scline->tp[i]);
+    }
+    script_compiler->records_count++;
+}
+
 TbBool script_command_param_to_number(char type_chr, struct ScriptLine *scline, int idx)
 {
     char *text;
@@ -2552,6 +2792,30 @@ TbBool script_command_param_to_text(char type_chr, struct ScriptLine *scline, in
     return true;
 }
 
+/**
+ * Selects random value from given ranges, as DRAWFROM function does.
+ * @return Index of the range containing selected value, or -1 if there are no values.
+ */
+static int script_draw_from_ranges(const struct MinMax *ranges, int ranges_num, long range_total, long *value)
+{
+    long range_index;
+    long range_start;
+    int ri;
+    if (range_total <= 0)
+        return -1;
+    range_index = rand() % range_total;
+    range_start = 0;
+    for (ri=0; ri < ranges_num; ri++)
+    {
+        if ((range_index >= range_start) && (range_index <= range_start + ranges[ri].max - ranges[ri].min)) {
+            *value = ranges[ri].min + range_index - range_start;
+            return ri;
+        }
+        range_start += ranges[ri].max - ranges[ri].min + 1;
+    }
+    return -1;
+}
+
 int script_recognize_params(char **line, const struct CommandDesc *cmd_desc, struct ScriptLine *scline, int *para_level, int expect_level)
 {
     char chr;
@@ -2622,7 +2886,9 @@ int script_recognize_params(char **line, const struct CommandDesc *cmd_desc, str
             case Cmd_DRAWFROM:{
                 // Create array of value ranges
                 struct MinMax ranges[COMMANDDESC_ARGS_COUNT];
-                long range_total, range_index;
+                // Indexes of parameters defining ends of every range
+                struct MinMax range_texts[COMMANDDESC_ARGS_COUNT];
+                long range_total, value;
                 range_total = 0;
                 int fi, ri;
                 if (level_file_version > 0)
@@ -2644,6 +2910,8 @@ int script_recognize_params(char **line, const struct CommandDesc *cmd_desc, str
                             // Values of that type cannot define ranges, as we cannot interpret them
                             ranges[ri].min = fi;
                             ranges[ri].max = fi;
+                            range_texts[ri].min = fi;
+                            range_texts[ri].max = fi;
                             range_total += 1;
                         } else
                         if ((ri > 0) && (strcmp(funscline->tp[fi],"~") == 0))
@@ -2657,6 +2925,7 @@ int script_recognize_params(char **line, const struct CommandDesc *cmd_desc, str
                                 return -1;
                             }
                             ranges[ri].max = funscline->np[fi];
+                            range_texts[ri].max = fi;
                             if (ranges[ri].max < ranges[ri].min) {
                                 SCRPTWRNLOG("Range definition in argument of function \"%s\" within command \"%s\" should have lower value first", funcmd_desc->textptr, scline->tcmnd);
                                 ranges[ri].max = ranges[ri].min;
@@ -2672,6 +2941,8 @@ int script_recognize_params(char **line, const struct CommandDesc *cmd_desc, str
                             }
                             ranges[ri].min = funscline->np[fi];
                             ranges[ri].max = funscline->np[fi];
+                            range_texts[ri].min = fi;
+                            range_texts[ri].max = fi;
                             range_total += 1;
                         }
                     }
@@ -2682,6 +2953,8 @@ int script_recognize_params(char **line, const struct CommandDesc *cmd_desc, str
                     {
                         ranges[fi].min = atol(funscline->tp[0]);
                         ranges[fi].max = atol(funscline->tp[1]);
+                        range_texts[fi].min = 0;
+                        range_texts[fi].max = 1;
                     }
                     if (ranges[fi].max < ranges[fi].min) {
                         SCRPTWRNLOG("Range definition in argument of function \"%s\" within command \"%s\" should have lower value first", funcmd_desc->textptr, scline->tcmnd);
@@ -2689,13 +2962,16 @@ int script_recognize_params(char **line, const struct CommandDesc *cmd_desc, str
                     }
                     range_total += ranges[fi].max - ranges[fi].min + 1;
                     fi++;
+                    ri = fi;
                 }
                 if (range_total <= 0) {
                     SCRPTERRLOG("Arguments of function \"%s\" within command \"%s\" define no values to select from", funcmd_desc->textptr, scline->tcmnd);
+                    script_compiler_discard();
                     break;
                 }
                 if ((funcmd_desc->index != Cmd_RANDOM) && (level_file_version == 0)) {
                     SCRPTERRLOG("The function \"%s\" used within command \"%s\" is not supported in old level format", funcmd_desc->textptr, scline->tcmnd);
+                    script_compiler_discard();
                     break;
                 }
                 // The new RANDOM command stores values to allow selecting different one every turn during gameplay
@@ -2703,31 +2979,33 @@ int script_recognize_params(char **line, const struct CommandDesc *cmd_desc, str
                 {
                     //TODO RANDOM make implementation - store ranges as variable to be used for selecting random value during gameplay
                     SCRPTERRLOG("The function \"%s\" used within command \"%s\" is not supported yet", funcmd_desc->textptr, scline->tcmnd);
+                    script_compiler_discard();
                     break;
                 }
+                // Compiled script stores the ranges, to select the value again every time it's loaded
+                chr = cmd_desc->args[i];
+                if (expect_level > 0) {
+                    script_compiler_discard();
+                } else {
+                    script_compiler_add_draw(i, chr, funcmd_desc, funscline, ranges, range_texts, ri);
+                }
                 // DRAWFROM support - select random index now
-                range_index = rand() % range_total;
-                // Get value from ranges array
-                range_total = 0;
-                for (fi=0; fi < COMMANDDESC_ARGS_COUNT; fi++)
+                fi = script_draw_from_ranges(ranges, ri, range_total, &value);
+                if (fi >= 0)
                 {
-                    if ((range_index >= range_total) && (range_index <= range_total + ranges[fi].max - ranges[fi].min)) {
-                        chr = cmd_desc->args[i];
-                        if (toupper(chr) == 'A') {
-                            strcpy(scline->tp[i], funscline->tp[ranges[fi].min]);
-                        } else {
-                            scline->np[i] = ranges[fi].min + range_index - range_total;
-                            // Set text value for that number
-                            script_command_param_to_text(chr, scline, i);
-                        }
-                        break;
+                    if (toupper(chr) == 'A') {
+                        strcpy(scline->tp[i], funscline->tp[value]);
+                    } else {
+                        scline->np[i] = value;
+                        // Set text value for that number
+                        script_command_param_to_text(chr, scline, i);
                     }
-                    range_total += ranges[fi].max - ranges[fi].min + 1;
                 }
                 SCRPTLOG("Function \"%s\" returned value \"%s\"", funcmd_desc->textptr, scline->tp[i]);
                 };break;
             default:
                 SCRPTWRNLOG("Parameter value \"%s\" is a command which isn't supported as function", scline->tp[i]);
+                script_compiler_discard();
                 break;
             }
             LbMemoryFree(funscline);
@@ -2754,6 +3032,7 @@ long script_scan_line(char *line,TbBool preloaded)
     int para_level;
     char chr;
     SCRIPTDBG(12,"Starting");
+    script_compiler_start_line();
     scline = (struct ScriptLine *)LbMemoryAlloc(sizeof(struct ScriptLine));
     if (scline == NULL)
     {
@@ -2775,6 +3054,7 @@ long script_scan_line(char *line,TbBool preloaded)
     {
         if (isalnum(scline->tcmnd[0])) {
           SCRPTERRLOG("Invalid command, '%s' (lev ver %d)", scline->tcmnd,level_file_version);
+          script_compiler_discard();
         }
         LbMemoryFree(scline);
         return 0;
@@ -2797,6 +3077,7 @@ long script_scan_line(char *line,TbBool preloaded)
     args_count = script_recognize_params(&line, cmd_desc, scline, &para_level, 0);
     if (args_count < 0)
     {
+        script_compiler_discard();
         LbMemoryFree(scline);
         return -1;
     }
@@ -2806,10 +3087,12 @@ long script_scan_line(char *line,TbBool preloaded)
         if (isupper(chr)) // Required arguments have upper-case type letters
         {
             SCRPTERRLOG("Not enough parameters for \"%s\", got only %d", cmd_desc->textptr,(int)args_count);
+            script_compiler_discard();
             LbMemoryFree(scline);
             return -1;
         }
     }
+    script_compiler_add_command(cmd_desc, scline, args_count);
     script_add_command(cmd_desc, scline);
     LbMemoryFree(scline);
     SCRIPTDBG(13,"Finished");
@@ -2832,11 +3115,531 @@ short clear_quick_messages(void)
   return true;
 }
 
+/**
+ * Adds names and parameter types of all commands in given table to the hash.
+ * Compiled script refers to commands by opcode, so any change to the table makes the cache invalid.
+ */
+static unsigned long script_cache_hash_commands(unsigned long hash, const struct CommandDesc *cmdlist_desc)
+{
+    long i;
+    for (i=0; cmdlist_desc[i].textptr != NULL; i++)
+    {
+        hash = cache_hash(hash, cmdlist_desc[i].textptr, strlen(cmdlist_desc[i].textptr)+1);
+        hash = cache_hash(hash, cmdlist_desc[i].args, sizeof(cmdlist_desc[i].args));
+        hash = cache_hash_long(hash, cmdlist_desc[i].index);
+    }
+    return cache_hash_long(hash, i);
+}
+
+/**
+ * Adds all names in given table, with their numbers, to the hash.
+ * Parameters are resolved into numbers using these tables, so the cache depends on them.
+ */
+static unsigned long script_cache_hash_names(unsigned long hash, const struct NamedCommand *desc)
+{
+    long i;
+    for (i=0; desc[i].name != NULL; i++)
+    {
+        hash = cache_hash(hash, desc[i].name, strlen(desc[i].name)+1);
+        hash = cache_hash_long(hash, desc[i].num);
+    }
+    return cache_hash_long(hash, i);
+}
+
+/**
+ * Computes the cache key. Besides the script text, parsing depends on level
+ * file version, which selects the commands table, on the preloading pass,
+ * and on names of creatures and rooms, which come from configs.
+ */
+static unsigned long script_cache_compute_key(const char *script_data, long script_len, TbBool preloaded)
+{
+    unsigned long hash;
+    hash = cache_key_init(SCRIPT_CACHE_VERSION);
+    hash = cache_hash_long(hash, COMMANDDESC_ARGS_COUNT);
+    hash = script_cache_hash_commands(hash, command_desc);
+    hash = script_cache_hash_commands(hash, dk1_command_desc);
+    hash = script_cache_hash_commands(hash, subfunction_desc);
+    hash = script_cache_hash_names(hash, player_desc);
+    hash = script_cache_hash_names(hash, comparison_desc);
+    hash = script_cache_hash_names(hash, creature_desc);
+    hash = script_cache_hash_names(hash, room_desc);
+    hash = cache_hash_long(hash, preloaded);
+    hash = cache_hash_long(hash, level_file_version);
+    hash = cache_hash_long(hash, script_len);
+    return cache_hash(hash, script_data, script_len);
+}
+
+static void script_cache_fname(char *fname, LevelNumber lvnum, TbBool preloaded)
+{
+    char cmpgn_name[DISKPATH_SIZE];
+    get_cache_campaign_name(cmpgn_name, sizeof(cmpgn_name));
+    LbStringCopy(fname, prepare_file_fmtpath(FGrp_Save, "lvlscript_%s_%05lu%s.cache", cmpgn_name, (unsigned long)lvnum, preloaded?"_pre":""), DISKPATH_SIZE);
+}
+
+struct ScriptCacheReader {
+    const unsigned char *data;
+    unsigned long data_size;
+    unsigned long pos;
+};
+
+/** Value ranges of a function, as read from compiled script. */
+struct ScriptCacheDraw {
+    unsigned char kind;
+    const struct CommandDesc *funcmd_desc;
+    unsigned char ranges_num;
+    struct MinMax ranges[COMMANDDESC_ARGS_COUNT];
+    /** Positions of texts within cache data; for locations, texts of both ends of every range. */
+    unsigned long text_pos[COMMANDDESC_ARGS_COUNT][2];
+};
+
+struct ScriptCacheRecord {
+    unsigned long line_num;
+    const struct CommandDesc *cmd_desc;
+    unsigned char args_num;
+    unsigned char operands[COMMANDDESC_ARGS_COUNT];
+    struct ScriptCacheDraw draws[COMMANDDESC_ARGS_COUNT];
+};
+
+static TbBool script_cache_read(struct ScriptCacheReader *rd, void *buf, unsigned long len)
+{
+    if (rd->pos + len > rd->data_size)
+        return false;
+    LbMemoryCopy(buf, rd->data + rd->pos, len);
+    rd->pos += len;
+    return true;
+}
+
+static TbBool script_cache_read_text(struct ScriptCacheReader *rd, char *buf, unsigned long buf_len)
+{
+    unsigned long len;
+    if (!script_cache_read(rd, &len, sizeof(len)))
+        return false;
+    if ((len >= buf_len) || (!script_cache_read(rd, buf, len)))
+        return false;
+    buf[len] = '\0';
+    return true;
+}
+
+/**
+ * Skips text within compiled script, storing its position to read it later.
+ */
+static TbBool script_cache_skip_text(struct ScriptCacheReader *rd, unsigned long *text_pos)
+{
+    unsigned long len;
+    *text_pos = rd->pos;
+    if (!script_cache_read(rd, &len, sizeof(len)))
+        return false;
+    if ((len >= MAX_TEXT_LENGTH) || (rd->pos + len > rd->data_size))
+        return false;
+    rd->pos += len;
+    return true;
+}
+
+/**
+ * Reads text from given position of compiled script; the text was already checked when the record was read.
+ */
+static void script_cache_text_at(const struct ScriptCacheReader *rd, unsigned long text_pos, char *buf)
+{
+    struct ScriptCacheReader text_rd;
+    text_rd.data = rd->data;
+    text_rd.data_size = rd->data_size;
+    text_rd.pos = text_pos;
+    if (!script_cache_read_text(&text_rd, buf, MAX_TEXT_LENGTH))
+        buf[0] = '\0';
+}
+
+static const struct CommandDesc *get_command_desc_by_opcode(const struct CommandDesc *cmdlist_desc, long opcode)
+{
+    long i;
+    for (i=0; cmdlist_desc[i].textptr != NULL; i++)
+    {
+        if (cmdlist_desc[i].index == opcode)
+            return &cmdlist_desc[i];
+    }
+    return NULL;
+}
+
+static TbBool script_cache_read_draw(struct ScriptCacheReader *rd, struct ScriptCacheDraw *draw)
+{
+    unsigned short func_index;
+    int ri;
+    if (!script_cache_read(rd, &draw->kind, sizeof(draw->kind))
+     || !script_cache_read(rd, &func_index, sizeof(func_index))
+     || !script_cache_read(rd, &draw->ranges_num, sizeof(draw->ranges_num)))
+        return false;
+    draw->funcmd_desc = get_command_desc_by_opcode(subfunction_desc, func_index);
+    if ((draw->funcmd_desc == NULL) || (draw->ranges_num < 1) || (draw->ranges_num > COMMANDDESC_ARGS_COUNT))
+        return false;
+    for (ri=0; ri < draw->ranges_num; ri++)
+    {
+        switch (draw->kind)
+        {
+        case SCDR_Values:
+            if (!script_cache_read(rd, &draw->ranges[ri].min, sizeof(draw->ranges[ri].min))
+             || !script_cache_read(rd, &draw->ranges[ri].max, sizeof(draw->ranges[ri].max)))
+                return false;
+            if (draw->ranges[ri].max < draw->ranges[ri].min)
+                return false;
+            break;
+        case SCDR_Texts:
+            if (!script_cache_skip_text(rd, &draw->text_pos[ri][0]))
+                return false;
+            draw->ranges[ri].min = ri;
+            draw->ranges[ri].max = ri;
+            break;
+        case SCDR_Locations:
+            if (!script_cache_skip_text(rd, &draw->text_pos[ri][0])
+             || !script_cache_skip_text(rd, &draw->text_pos[ri][1]))
+                return false;
+            break;
+        default:
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Reads one record of compiled script. Parameters are read into the script line,
+ * except ranges of functions, which are only read into the record.
+ */
+static TbBool script_cache_read_record(struct ScriptCacheReader *rd, struct ScriptCacheRecord *rec, struct ScriptLine *scline)
+{
+    unsigned short opcode;
+    char chr;
+    int i;
+    if (!script_cache_read(rd, &rec->line_num, sizeof(rec->line_num))
+     || !script_cache_read(rd, &opcode, sizeof(opcode))
+     || !script_cache_read(rd, &rec->args_num, sizeof(rec->args_num)))
+        return false;
+    if (level_file_version > 0) {
+        rec->cmd_desc = get_command_desc_by_opcode(command_desc, opcode);
+    } else {
+        rec->cmd_desc = get_command_desc_by_opcode(dk1_command_desc, opcode);
+    }
+    if ((rec->cmd_desc == NULL) || (rec->args_num > COMMANDDESC_ARGS_COUNT))
+        return false;
+    LbMemorySet(scline, 0, sizeof(struct ScriptLine));
+    LbStringCopy(scline->tcmnd, rec->cmd_desc->textptr, MAX_TEXT_LENGTH);
+    for (i=0; i < rec->args_num; i++)
+    {
+        if (!script_cache_read(rd, &rec->operands[i], sizeof(rec->operands[i])))
+            return false;
+        chr = toupper(rec->cmd_desc->args[i]);
+        switch (rec->operands[i])
+        {
+        case SCOP_Draw:
+            if (!script_cache_read_draw(rd, &rec->draws[i]))
+                return false;
+            break;
+        case SCOP_Text:
+            if ((chr != 'A') || !script_cache_read_text(rd, scline->tp[i], MAX_TEXT_LENGTH))
+                return false;
+            break;
+        case SCOP_Location:
+            if ((chr != 'L') || !script_cache_read_text(rd, scline->tp[i], MAX_TEXT_LENGTH))
+                return false;
+            break;
+        case SCOP_Value:
+            if ((chr == 'A') || (chr == 'L') || !isalpha(chr))
+                return false;
+            if (!script_cache_read(rd, &scline->np[i], sizeof(scline->np[i]))
+             || !script_cache_read_text(rd, scline->tp[i], MAX_TEXT_LENGTH))
+                return false;
+            break;
+        default:
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Decreases the reusable command counter, as parsing given amount of text lines would.
+ * Every line counts, including empty lines and comments, which aren't stored in compiled script.
+ */
+static void script_skip_lines(unsigned long lines_count)
+{
+    for (; (lines_count > 0) && (next_command_reusable > 0); lines_count--)
+        next_command_reusable--;
+}
+
+/**
+ * Selects value of a parameter from function ranges stored in compiled script,
+ * the same way as script_recognize_params() does when parsing text.
+ */
+static TbBool script_cache_draw_value(const struct ScriptCacheReader *rd, const struct ScriptCacheDraw *draw,
+    char type_chr, struct ScriptLine *scline, int idx)
+{
+    struct MinMax ranges[COMMANDDESC_ARGS_COUNT];
+    long range_total;
+    long value;
+    int ri;
+    range_total = 0;
+    for (ri=0; ri < draw->ranges_num; ri++)
+    {
+        if (draw->kind == SCDR_Locations)
+        {
+            // Map locations depend on map data, so they can only be resolved now
+            script_cache_text_at(rd, draw->text_pos[ri][0], scline->tp[idx]);
+            if (!script_command_param_to_number(type_chr, scline, idx))
+                return false;
+            ranges[ri].min = scline->np[idx];
+            script_cache_text_at(rd, draw->text_pos[ri][1], scline->tp[idx]);
+            if (!script_command_param_to_number(type_chr, scline, idx))
+                return false;
+            ranges[ri].max = max(scline->np[idx], ranges[ri].min);
+        } else
+        {
+            ranges[ri].min = draw->ranges[ri].min;
+            ranges[ri].max = draw->ranges[ri].max;
+        }
+        range_total += ranges[ri].max - ranges[ri].min + 1;
+    }
+    ri = script_draw_from_ranges(ranges, draw->ranges_num, range_total, &value);
+    if (ri < 0)
+        return false;
+    if (draw->kind == SCDR_Texts)
+    {
+        script_cache_text_at(rd, draw->text_pos[ri][0], scline->tp[idx]);
+    } else
+    {
+        scline->np[idx] = value;
+        script_command_param_to_text(type_chr, scline, idx);
+    }
+    SCRPTLOG("Function \"%s\" returned value \"%s\"", draw->funcmd_desc->textptr, scline->tp[idx]);
+    // Selected location is converted back from text when parsing, which verifies it again
+    if (toupper(type_chr) == 'L')
+        return script_command_param_to_number(type_chr, scline, idx);
+    return true;
+}
+
+/**
+ * Adds command from compiled script. Parameters which depend on map data are resolved,
+ * and values of functions are selected; then the command is added by its opcode.
+ */
+static void script_add_compiled_command(const struct ScriptCacheReader *rd, const struct ScriptCacheRecord *rec, struct ScriptLine *scline)
+{
+    const struct CommandDesc *cmd_desc;
+    int i;
+    script_skip_lines(1);
+    cmd_desc = rec->cmd_desc;
+    for (i=0; i < rec->args_num; i++)
+    {
+        switch (rec->operands[i])
+        {
+        case SCOP_Location:
+            if (!script_command_param_to_number(cmd_desc->args[i], scline, i)) {
+                SCRPTERRLOG("Parameter %d of command \"%s\", type %c, has unexpected value; discarding command", i+1, scline->tcmnd, cmd_desc->args[i]);
+                return;
+            }
+            break;
+        case SCOP_Draw:
+            if (!script_cache_draw_value(rd, &rec->draws[i], cmd_desc->args[i], scline, i)) {
+                SCRPTERRLOG("Parameter %d of command \"%s\", type %c, has unexpected value; discarding command", i+1, scline->tcmnd, cmd_desc->args[i]);
+                return;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+    script_add_command(cmd_desc, scline);
+}
+
+/**
+ * Checks all records of compiled script, or executes them.
+ * Records are checked before any is executed, as a broken cache can't be abandoned halfway.
+ */
+static TbBool script_cache_process_records(const unsigned char *data, unsigned long data_size, TbBool execute)
+{
+    const struct ScriptCacheInfo *info;
+    struct ScriptCacheReader rd;
+    struct ScriptCacheRecord *rec;
+    struct ScriptLine *scline;
+    unsigned long prev_line;
+    unsigned long i;
+    TbBool result;
+    if (data_size < sizeof(struct ScriptCacheInfo))
+        return false;
+    info = (const struct ScriptCacheInfo *)data;
+    scline = (struct ScriptLine *)LbMemoryAlloc(sizeof(struct ScriptLine));
+    rec = (struct ScriptCacheRecord *)LbMemoryAlloc(sizeof(struct ScriptCacheRecord));
+    if ((scline == NULL) || (rec == NULL))
+    {
+        LbMemoryFree(scline);
+        LbMemoryFree(rec);
+        return false;
+    }
+    rd.data = data;
+    rd.data_size = data_size;
+    rd.pos = sizeof(struct ScriptCacheInfo);
+    prev_line = 0;
+    result = true;
+    for (i=0; i < info->records_count; i++)
+    {
+        if (!script_cache_read_record(&rd, rec, scline)
+         || (rec->line_num <= prev_line) || (rec->line_num > info->lines_count))
+        {
+            result = false;
+            break;
+        }
+        if (execute)
+        {
+            script_skip_lines(rec->line_num - prev_line - 1);
+            text_line_number = rec->line_num;
+            script_add_compiled_command(&rd, rec, scline);
+        }
+        prev_line = rec->line_num;
+    }
+    if (result && (rd.pos != rd.data_size))
+        result = false;
+    if (execute)
+    {
+        script_skip_lines(info->lines_count - prev_line);
+        text_line_number = info->lines_count + 1;
+    }
+    LbMemoryFree(scline);
+    LbMemoryFree(rec);
+    return result;
+}
+
+/**
+ * Executes level script from its compiled form, if it's cached for the same script text.
+ * @return True if the script was loaded; false if it has to be parsed from text.
+ */
+static TbBool load_script_from_cache(LevelNumber lvnum, unsigned long key, TbBool preloaded)
+{
+    char fname[DISKPATH_SIZE];
+    unsigned char *buf;
+    unsigned long data_size;
+    script_cache_fname(fname, lvnum, preloaded);
+    buf = load_cache_file(fname, SCRIPT_CACHE_MAGIC, SCRIPT_CACHE_VERSION, key, &data_size);
+    if (buf == NULL)
+        return false;
+    if (!script_cache_process_records(buf, data_size, false))
+    {
+        WARNLOG("Level script cache \"%s\" has invalid records",fname);
+        LbMemoryFree(buf);
+        return false;
+    }
+    script_cache_process_records(buf, data_size, true);
+    LbMemoryFree(buf);
+    script_cache_loads++;
+    SYNCDBG(7,"Level script loaded from cache \"%s\"",fname);
+    return true;
+}
+
+/**
+ * Writes compiled script into the cache.
+ */
+static TbBool save_script_cache(LevelNumber lvnum, unsigned long key, TbBool preloaded, struct ScriptCompiler *compiler, unsigned long lines_count)
+{
+    struct ScriptCacheInfo *info;
+    char fname[DISKPATH_SIZE];
+    unsigned char *buf;
+    unsigned long len;
+    TbBool result;
+    if (compiler->failed)
+    {
+        SYNCDBG(7,"Level script has errors, so it won't be cached");
+        return false;
+    }
+    len = sizeof(struct ScriptCacheInfo) + compiler->records.size;
+    buf = LbMemoryAlloc(len);
+    if (buf == NULL)
+        return false;
+    info = (struct ScriptCacheInfo *)buf;
+    info->records_count = compiler->records_count;
+    info->lines_count = lines_count;
+    if (compiler->records.size > 0)
+        LbMemoryCopy(buf + sizeof(struct ScriptCacheInfo), compiler->records.data, compiler->records.size);
+    script_cache_fname(fname, lvnum, preloaded);
+    result = save_cache_file(fname, SCRIPT_CACHE_MAGIC, SCRIPT_CACHE_VERSION, key, buf, len);
+    LbMemoryFree(buf);
+    return result;
+}
+
+/**
+ * Removes cached compiled scripts of given level, so that they're compiled again.
+ */
+void clear_script_cache(LevelNumber lvnum)
+{
+    char fname[DISKPATH_SIZE];
+    script_cache_fname(fname, lvnum, true);
+    if (LbFileExists(fname))
+        LbFileDelete(fname);
+    script_cache_fname(fname, lvnum, false);
+    if (LbFileExists(fname))
+        LbFileDelete(fname);
+}
+
+static void script_compiler_free(struct ScriptCompiler *compiler)
+{
+    int i;
+    LbMemoryFree(compiler->records.data);
+    for (i=0; i < COMMANDDESC_ARGS_COUNT; i++)
+        LbMemoryFree(compiler->draws[i].data);
+}
+
+/**
+ * Parses level script text, line by line. If script cache is enabled and the script
+ * was compiled before, its cached compiled form is used instead; otherwise the
+ * compiled form is cached.
+ */
+static void script_scan_text(LevelNumber lvnum, char *script_data, long script_len, TbBool preloaded)
+{
+    struct ScriptCompiler compiler;
+    unsigned long key;
+    char *buf;
+    char *buf_end;
+    int lnlen;
+    key = 0;
+    if (script_cache_enabled)
+    {
+        key = script_cache_compute_key(script_data, script_len, preloaded);
+        if (load_script_from_cache(lvnum, key, preloaded))
+            return;
+        LbMemorySet(&compiler, 0, sizeof(struct ScriptCompiler));
+        script_compiler = &compiler;
+    }
+    // Process the file lines
+    buf = script_data;
+    buf_end = script_data+script_len;
+    while (buf < buf_end)
+    {
+      // Find end of the line
+      lnlen = 0;
+      while (&buf[lnlen] < buf_end)
+      {
+        if ((buf[lnlen] == '\r') || (buf[lnlen] == '\n'))
+          break;
+        lnlen++;
+      }
+      // Get rid of the next line characters
+      buf[lnlen] = 0;
+      lnlen++;
+      if (&buf[lnlen] < buf_end)
+      {
+        if ((buf[lnlen] == '\r') || (buf[lnlen] == '\n'))
+          lnlen++;
+      }
+      // Analyze the line
+      script_scan_line(buf, preloaded);
+      // Set new line start
+      text_line_number++;
+      buf += lnlen;
+    }
+    if (script_compiler != NULL)
+    {
+        script_compiler = NULL;
+        save_script_cache(lvnum, key, preloaded, &compiler, text_line_number-1);
+        script_compiler_free(&compiler);
+    }
+}
+
 short preload_script(long lvnum)
 {
-  char *buf;
-  char *buf_end;
-  int lnlen;
   char *script_data;
   long script_len;
   SYNCDBG(7,"Starting");
@@ -2850,34 +3653,7 @@ short preload_script(long lvnum)
   script_data = (char *)load_single_map_file_to_buffer(lvnum,"txt",&script_len,LMFF_None);
   if (script_data == NULL)
     return false;
-  // Process the file lines
-  buf = script_data;
-  buf_end = script_data+script_len;
-  while (buf < buf_end)
-  {
-    // Find end of the line
-    lnlen = 0;
-    while (&buf[lnlen] < buf_end)
-    {
-      if ((buf[lnlen] == '\r') || (buf[lnlen] == '\n'))
-        break;
-      lnlen++;
-    }
-    // Get rid of the next line characters
-    buf[lnlen] = 0;
-    lnlen++;
-    if (&buf[lnlen] < buf_end)
-    {
-      if ((buf[lnlen] == '\r') || (buf[lnlen] == '\n'))
-        lnlen++;
-    }
-    //SCRPTLOG("Analyse");
-    // Analyze the line
-    script_scan_line(buf, true);
-    // Set new line start
-    text_line_number++;
-    buf += lnlen;
-  }
+  script_scan_text(lvnum, script_data, script_len, true);
   LbMemoryFree(script_data);
   SYNCDBG(8,"Finished");
   return true;
@@ -2885,9 +3661,6 @@ short preload_script(long lvnum)
 
 short load_script(long lvnum)
 {
-    char *buf;
-    char *buf_end;
-    int lnlen;
     char *script_data;
     long script_len;
     SYNCDBG(7,"Starting");
@@ -2913,33 +3686,7 @@ short load_script(long lvnum)
     script_data = (char *)load_single_map_file_to_buffer(lvnum,"txt",&script_len,LMFF_None);
     if (script_data == NULL)
       return false;
-    // Process the file lines
-    buf = script_data;
-    buf_end = script_data+script_len;
-    while (buf < buf_end)
-    {
-      // Find end of the line
-      lnlen = 0;
-      while (&buf[lnlen] < buf_end)
-      {
-        if ((buf[lnlen] == '\r') || (buf[lnlen] == '\n'))
-          break;
-        lnlen++;
-      }
-      // Get rid of the next line characters
-      buf[lnlen] = 0;
-      lnlen++;
-      if (&buf[lnlen] < buf_end)
-      {
-        if ((buf[lnlen] == '\r') || (buf[lnlen] == '\n'))
-          lnlen++;
-      }
-      // Analyze the line
-      script_scan_line(buf, false);
-      // Set new line start
-      text_line_number++;
-      buf += lnlen;
-    }
+    script_scan_text(lvnum, script_data, script_len, false);
     LbMemoryFree(script_data);
     if (game.script.win_conditions_num == 0)
       WARNMSG("No WIN GAME conditions in script file.");
@@ -3736,25 +4483,16 @@ TbBool condition_inactive(long cond_idx)
   return false;
 }
 
-void process_condition(struct Condition *condt)
+/**
+ * Computes condition value for players in given range; the condition is met if it's met for any of them.
+ */
+static TbBool get_condition_players_status(struct Condition *condt, int plr_start, int plr_end)
 {
     TbBool new_status;
-    int plr_start, plr_end;
     long i,k;
-    SYNCDBG(18,"Starting for type %d, player %d",(int)condt->variabl_type,(int)condt->plyr_range);
-    if (condition_inactive(condt->condit_idx))
-    {
-        set_flag_byte(&condt->status, 0x01, false);
-        return;
-    }
-    if (get_players_range(condt->plyr_range, &plr_start, &plr_end) < 0)
-    {
-        WARNLOG("Invalid player range %d in CONDITION command %d.",(int)condt->plyr_range,(int)condt->variabl_type);
-        return;
-    }
+    new_status = false;
     if (condt->variabl_type == SVar_ACTION_POINT_TRIGGERED)
     {
-        new_status = false;
         for (i=plr_start; i < plr_end; i++)
         {
             new_status = action_point_activated_by_player(condt->variabl_idx,i);
@@ -3762,7 +4500,6 @@ void process_condition(struct Condition *condt)
         }
     } else
     {
-        new_status = false;
         for (i=plr_start; i < plr_end; i++)
         {
             k = get_condition_value(i, condt->variabl_type, condt->variabl_idx);
@@ -3770,6 +4507,11 @@ void process_condition(struct Condition *condt)
             if (new_status != false) break;
         }
     }
+    return new_status;
+}
+
+static void update_condition_status(struct Condition *condt, TbBool new_status)
+{
     SYNCDBG(19,"Condition type %d status %d",(int)condt->variabl_type,(int)new_status);
     set_flag_byte(&condt->status, 0x01,  new_status);
     if (((condt->status & 0x01) == 0) || ((condt->status & 0x02) != 0))
@@ -3780,17 +4522,217 @@ void process_condition(struct Condition *condt)
         set_flag_byte(&condt->status, 0x02,  true);
         set_flag_byte(&condt->status, 0x04,  true);
     }
+}
+
+void process_condition(struct Condition *condt)
+{
+    TbBool new_status;
+    int plr_start, plr_end;
+    SYNCDBG(18,"Starting for type %d, player %d",(int)condt->variabl_type,(int)condt->plyr_range);
+    if (condition_inactive(condt->condit_idx))
+    {
+        set_flag_byte(&condt->status, 0x01, false);
+        return;
+    }
+    if (get_players_range(condt->plyr_range, &plr_start, &plr_end) < 0)
+    {
+        WARNLOG("Invalid player range %d in CONDITION command %d.",(int)condt->plyr_range,(int)condt->variabl_type);
+        return;
+    }
+    new_status = get_condition_players_status(condt, plr_start, plr_end);
+    update_condition_status(condt, new_status);
     SCRIPTDBG(19,"Finished");
 }
 
+/**
+ * Finds the index entry for value read by script conditions, or adds it if there's none.
+ */
+static long get_condition_input(PlayerNumber plyr_idx, unsigned char valtype, unsigned char validx)
+{
+    struct ConditionInput *inp;
+    long i;
+    for (i=0; i < conditions_index.inputs_num; i++)
+    {
+        inp = &conditions_index.inputs[i];
+        if ((inp->plyr_idx == plyr_idx) && (inp->valtype == valtype) && (inp->validx == validx))
+            return i;
+    }
+    inp = &conditions_index.inputs[conditions_index.inputs_num];
+    inp->plyr_idx = plyr_idx;
+    inp->valtype = valtype;
+    inp->validx = validx;
+    return conditions_index.inputs_num++;
+}
+
+/**
+ * Checks whether the conditions index was built for current script conditions.
+ * Only definitions are compared, as status of the conditions isn't cached.
+ */
+static TbBool conditions_index_matches(void)
+{
+    struct Condition *condt;
+    struct Condition *idxcond;
+    long i;
+    if (!conditions_index.built)
+        return false;
+    if ((conditions_index.conditions_num != game.script.conditions_num)
+     || (conditions_index.hero_player_num != game.hero_player_num)
+     || (conditions_index.neutral_player_num != game.neutral_player_num))
+        return false;
+    for (i=0; i < game.script.conditions_num; i++)
+    {
+        condt = &game.script.conditions[i];
+        idxcond = &conditions_index.conditions[i];
+        if ((condt->condit_idx != idxcond->condit_idx) || (condt->plyr_range != idxcond->plyr_range)
+         || (condt->variabl_type != idxcond->variabl_type) || (condt->variabl_idx != idxcond->variabl_idx)
+         || (condt->operation != idxcond->operation) || (condt->rvalue != idxcond->rvalue))
+            return false;
+    }
+    return true;
+}
+
+static void build_conditions_index(void)
+{
+    struct Condition *condt;
+    struct ConditionInput *inp;
+    int plr_start, plr_end;
+    long i,k,n;
+    SYNCDBG(8,"Indexing %d conditions",(int)game.script.conditions_num);
+    LbMemorySet(&conditions_index, 0, sizeof(struct ConditionsIndex));
+    conditions_index.conditions_num = game.script.conditions_num;
+    conditions_index.hero_player_num = game.hero_player_num;
+    conditions_index.neutral_player_num = game.neutral_player_num;
+    for (i=0; i < game.script.conditions_num; i++)
+    {
+        condt = &game.script.conditions[i];
+        LbMemoryCopy(&conditions_index.conditions[i], condt, sizeof(struct Condition));
+        conditions_index.cond_dirty[i] = true;
+        // Conditions which don't read dungeon values are always processed directly
+        if (condt->variabl_type == SVar_ACTION_POINT_TRIGGERED)
+            continue;
+        if (get_players_range(condt->plyr_range, &plr_start, &plr_end) < 0)
+            continue;
+        for (k=plr_start; k < plr_end; k++)
+        {
+            n = get_condition_input(k, condt->variabl_type, condt->variabl_idx);
+            inp = &conditions_index.inputs[n];
+            inp->conditions[inp->conditions_num] = i;
+            inp->conditions_num++;
+            conditions_index.cond_inputs[i][conditions_index.cond_inputs_num[i]] = n;
+            conditions_index.cond_inputs_num[i]++;
+        }
+        conditions_index.cond_indexed[i] = true;
+    }
+    conditions_index.built = true;
+}
+
+/**
+ * Makes sure the value read by conditions is up to date in current pass.
+ * If the value has changed, conditions which read it are marked for re-evaluation.
+ */
+static void refresh_condition_input(struct ConditionInput *inp)
+{
+    long k,n;
+    if (inp->pass == conditions_index.pass)
+        return;
+    inp->pass = conditions_index.pass;
+    k = get_condition_value(inp->plyr_idx, inp->valtype, inp->validx);
+    if (k != inp->value)
+    {
+        inp->value = k;
+        for (n=0; n < inp->conditions_num; n++)
+            conditions_index.cond_dirty[inp->conditions[n]] = true;
+    }
+}
+
+/**
+ * Returns value of an indexed condition. Every value is computed at most once per pass,
+ * and only if it's needed; values are read in order of players, until one meets the condition.
+ * The previous result is reused if values it was based on are already refreshed and unchanged.
+ */
+static TbBool get_indexed_condition_value(long cond_idx)
+{
+    struct Condition *condt;
+    struct ConditionInput *inp;
+    TbBool new_status;
+    long i;
+    condt = &game.script.conditions[cond_idx];
+    if (!conditions_index.cond_dirty[cond_idx])
+    {
+        for (i=0; i < conditions_index.cond_inputs_used[cond_idx]; i++)
+        {
+            inp = &conditions_index.inputs[conditions_index.cond_inputs[cond_idx][i]];
+            if (inp->pass != conditions_index.pass)
+                break;
+        }
+        if (i >= conditions_index.cond_inputs_used[cond_idx])
+            return conditions_index.cond_value[cond_idx];
+    }
+    new_status = false;
+    for (i=0; i < conditions_index.cond_inputs_num[cond_idx]; i++)
+    {
+        inp = &conditions_index.inputs[conditions_index.cond_inputs[cond_idx][i]];
+        refresh_condition_input(inp);
+        new_status = get_condition_status(condt->operation, inp->value, condt->rvalue);
+        if (new_status != false) {
+            i++;
+            break;
+        }
+    }
+    conditions_index.cond_inputs_used[cond_idx] = i;
+    conditions_index.cond_value[cond_idx] = new_status;
+    conditions_index.cond_dirty[cond_idx] = false;
+    return new_status;
+}
+
+static void process_indexed_condition(long cond_idx)
+{
+    struct Condition *condt;
+    TbBool new_status;
+    condt = &game.script.conditions[cond_idx];
+    SYNCDBG(18,"Starting for type %d, player %d",(int)condt->variabl_type,(int)condt->plyr_range);
+    if (condition_inactive(condt->condit_idx))
+    {
+        set_flag_byte(&condt->status, 0x01, false);
+        return;
+    }
+    new_status = get_indexed_condition_value(cond_idx);
+    if ((start_params.debug_flags & DFlg_ConditionsCheck) != 0)
+    {
+        // Cross-check the indexed value with full evaluation
+        int plr_start, plr_end;
+        TbBool full_status;
+        get_players_range(condt->plyr_range, &plr_start, &plr_end);
+        full_status = get_condition_players_status(condt, plr_start, plr_end);
+        if (full_status != new_status)
+        {
+            ERRORLOG("Turn %lu: indexed condition %d of type %d has status %d, full evaluation gives %d",
+                (unsigned long)game.play_gameturn,(int)cond_idx,(int)condt->variabl_type,(int)new_status,(int)full_status);
+            new_status = full_status;
+        }
+    }
+    update_condition_status(condt, new_status);
+}
+
+/**
+ * Processes script conditions. Values read by conditions are shared through an index,
+ * so that every value is computed at most once per turn, and conditions are evaluated
+ * again only if any value they read has changed.
+ */
 void process_conditions(void)
 {
     long i;
     if (game.script.conditions_num > CONDITIONS_COUNT)
       game.script.conditions_num = CONDITIONS_COUNT;
+    if (!conditions_index_matches())
+      build_conditions_index();
+    conditions_index.pass++;
     for (i=0; i < game.script.conditions_num; i++)
     {
-      process_condition(&game.script.conditions[i]);
+      if (conditions_index.cond_indexed[i])
+        process_indexed_condition(i);
+      else
+        process_condition(&game.script.conditions[i]);
     }
 }
 
@@ -31,6 +31,8 @@ extern "C" {
 
 /******************************************************************************/
 #define COMMANDDESC_ARGS_COUNT    8
+/** Version of the level script cache format; needs to be increased when parsing of commands changes. */
+#define SCRIPT_CACHE_VERSION      2
 
 #define PARTY_TRIGGERS_COUNT     48
 #define CREATURE_PARTYS_COUNT    16
@@ -285,6 +287,8 @@ DLLIMPORT unsigned short _DK_condition_stack[48];
 /******************************************************************************/
 extern const struct CommandDesc command_desc[];
 extern const struct NamedCommand player_desc[];
+extern TbBool script_cache_enabled;
+extern unsigned long script_cache_loads;
 /******************************************************************************/
 TbBool script_support_setup_player_as_computer_keeper(PlayerNumber plyridx, long comp_model);
 TbBool script_support_setup_player_as_zombie_keeper(unsigned short plyridx);
@@ -302,6 +306,7 @@ TbBool get_map_location_code_name(TbMapLocation location, char *name);
 
 short clear_script(void);
 short load_script(long lvl_num);
+void clear_script_cache(LevelNumber lvnum);
 short preload_script(long lvnum);
 /******************************************************************************/
 void script_process_value(unsigned long var_index, unsigned long val1, long val2, long val3, long val4);
@@ -27,6 +27,7 @@
 #include "bflib_mouse.h"
 #include "bflib_filelst.h"
 #include "bflib_network.h"
+#include "bflib_workers.h"
 
 #include "version.h"
 #include "front_simple.h"
@@ -62,8 +63,11 @@
 #include "player_utils.h"
 #include "player_states.h"
 #include "player_computer.h"
+#include "player_complookup.h"
 #include "game_heap.h"
 #include "game_saves.h"
+#include "game_tournament.h"
+#include "game_selftest.h"
 #include "engine_render.h"
 #include "engine_lenses.h"
 #include "engine_camera.h"
@@ -85,6 +89,7 @@
 #include "thing_shots.h"
 #include "thing_navigate.h"
 #include "thing_factory.h"
+#include "spdigger_stack.h"
 #include "slab_data.h"
 #include "room_data.h"
 #include "room_entrance.h"
@@ -97,6 +102,7 @@
 #include "map_blocks.h"
 #include "ariadne_wallhug.h"
 #include "creature_control.h"
+#include "creature_senses.h"
 #include "creature_states.h"
 #include "creature_instances.h"
 #include "creature_graphics.h"
@@ -1639,6 +1645,14 @@ void reinit_level_after_load(void)
     erstats_clear();
     player = get_my_player();
     reinit_tagged_blocks_for_player(player->id_number);
+    clear_creature_sight_cache();
+    clear_slab_open_heights();
+    clear_creature_proximity_grid();
+    clear_digger_stack_side_data();
+    clear_tasks_index();
+    clear_computer_checks_stats();
+    clear_rooms_reachability_memo();
+    clear_rooms_contents_count();
     restore_computer_player_after_load();
     sound_reinit_after_load();
 }
@@ -1825,6 +1839,15 @@ void delete_all_structures(void)
     delete_all_room_structures();
     delete_all_action_point_structures();
     light_initialise();
+    clear_creature_sight_cache();
+    clear_slab_open_heights();
+    clear_creature_proximity_grid();
+    clear_digger_stack_side_data();
+    clear_tasks_index();
+    clear_gold_veins_map();
+    clear_computer_checks_stats();
+    clear_rooms_reachability_memo();
+    clear_rooms_contents_count();
     SYNCDBG(16,"Done");
 }
 
@@ -3649,8 +3672,11 @@ TbBool keeper_wait_for_screen_focus(void)
 void keeper_gameplay_loop(void)
 {
     short do_draw;
+    TbBool headless;
     struct PlayerInfo *player;
     SYNCDBG(5,"Starting");
+    // AI matches are played without drawing and delays
+    headless = tournament_match_active();
     player = get_my_player();
     PaletteSetPlayerPalette(player, engine_palette);
     if ((game.operation_flags & GOF_SingleLevel) != 0)
@@ -3671,17 +3697,27 @@ void keeper_gameplay_loop(void)
 
         // Check if we should redraw screen in this turn
         do_draw = display_should_be_updated_this_turn() || (!LbIsActive());
+        if (headless)
+            do_draw = false;
 
         LbWindowsControl();
         input_eastegg();
         input();
         update();
+        if (headless)
+        {
+            tournament_match_process_turn();
+            continue;
+        }
 
         if (quit_game || exit_keeper)
             do_draw = false;
 
         if ( do_draw )
+        {
             keeper_screen_redraw();
+            keepsprite_heap_frame_done();
+        }
         keeper_wait_for_screen_focus();
         // Direct information/error messages
         if (LbScreenLock() == Lb_SUCCESS)
@@ -4065,6 +4101,7 @@ void post_init_level(void)
     clear_creature_pool();
     setup_computer_players2();
     load_script(get_loaded_level_number());
+    tournament_match_setup_players();
     init_dungeons_research();
     init_dungeons_essential_position();
     create_transferred_creature_on_level();
@@ -4191,6 +4228,9 @@ void faststartup_network_game(void)
     }
     player = get_my_player();
     player->field_2C = 1;
+    // In AI matches, all keepers on the map should be played
+    if (tournament_match_active())
+        fe_computer_players = 1;
     startup_network_game(true);
     player = get_my_player();
     player->flgfield_6 &= ~PlaF6_PlyrHasQuit;
@@ -4520,6 +4560,22 @@ short process_command_line(unsigned short argc, char *argv[])
       {
           smooth_on = 1;
       } else
+      if (strcasecmp(parstr, "nosprstore") == 0)
+      {
+          keepsprite_store_set_enabled(false);
+      } else
+      if (strcasecmp(parstr, "loadtimes") == 0)
+      {
+          lbDataLoadTimingReport = true;
+      } else
+      if (strcasecmp(parstr, "levelcache") == 0)
+      {
+          level_cache_enabled = true;
+      } else
+      if (strcasecmp(parstr, "scriptcache") == 0)
+      {
+          script_cache_enabled = true;
+      } else
       if ( strcasecmp(parstr,"level") == 0 )
       {
         set_flag_byte(&start_params.operation_flags,GOF_SingleLevel,true);
@@ -4575,6 +4631,10 @@ short process_command_line(unsigned short argc, char *argv[])
       {
           start_params.debug_flags |= DFlg_ShotsDamage;
       } else
+      if (strcasecmp(parstr, "dbgconds") == 0)
+      {
+          start_params.debug_flags |= DFlg_ConditionsCheck;
+      } else
       if (strcasecmp(parstr, "compuchat") == 0)
       {
           if (strcasecmp(pr2str,"scarce") == 0) {
@@ -4591,6 +4651,31 @@ short process_command_line(unsigned short argc, char *argv[])
           narg++;
           LbNetwork_InitSessionsFromCmdLine(pr2str);
       } else
+      if (strcasecmp(parstr, "tournament") == 0)
+      {
+          narg++;
+          tournament_set_config_file(pr2str);
+      } else
+      if (strcasecmp(parstr, "aimatch") == 0)
+      {
+          narg++;
+          tournament_match_set_models(pr2str);
+      } else
+      if (strcasecmp(parstr, "turnslimit") == 0)
+      {
+          narg++;
+          tournament_match_set_turns_limit(atol(pr2str));
+      } else
+      if (strcasecmp(parstr, "matchout") == 0)
+      {
+          narg++;
+          tournament_match_set_output(pr2str);
+      } else
+      if (strcasecmp(parstr, "selftest") == 0)
+      {
+          narg++;
+          selftest_set_names(pr2str);
+      } else
       if (strcasecmp(parstr,"alex") == 0)
       {
          set_flag_byte(&start_params.flags_font,FFlg_AlexCheat,true);
@@ -4624,6 +4709,12 @@ int LbBullfrogMain(unsigned short argc, char *argv[])
         LbErrorLogClose();
         return 0;
     }
+    // Matches of a tournament run in parallel, so each needs its own log
+    if (tournament_match_log_fname() != NULL)
+    {
+        LbErrorLogClose();
+        LbErrorLogSetup("/", tournament_match_log_fname(), 5);
+    }
 
     retval = true;
     retval &= (LbTimerInit() != Lb_FAIL);
@@ -4632,10 +4723,22 @@ int LbBullfrogMain(unsigned short argc, char *argv[])
     LbSetIcon(1);
     LbScreenSetDoubleBuffering(true);
     srand(LbTimerClock());
+    // Workers are not required - without them, computations are just not split
+    LbWorkersInit(0);
     if (!retval)
     {
         static const char *msg_text="Basic engine initialization failed.\n";
         error_dialog_fatal(__func__, 1, msg_text);
+        LbWorkersFree();
+        LbErrorLogClose();
+        return 0;
+    }
+    // Tournament process only starts the matches, there's no need to setup the game
+    if (tournament_is_set())
+    {
+        tournament_run(argv[0]);
+        LbScreenReset();
+        LbWorkersFree();
         LbErrorLogClose();
         return 0;
     }
@@ -4667,10 +4770,15 @@ int LbBullfrogMain(unsigned short argc, char *argv[])
     }
     if ( retval )
     {
-        game_loop();
+        // Self tests are run instead of the game
+        if (selftest_is_set())
+            selftest_run();
+        else
+            game_loop();
     }
     reset_game();
     LbScreenReset();
+    LbWorkersFree();
     if ( !retval )
     {
         static const char *msg_text="Setting up game failed.\n";
@@ -4793,7 +4901,7 @@ int main(int argc, char *argv[])
 
 //  LbFileSaveAt("!tmp_file", &_DK_game, sizeof(struct Game));
 
-  return 0;
+  return selftest_exit_code();
 }
 
 #ifdef __cplusplus
@@ -33,6 +33,7 @@
 #include "config_creature.h"
 #include "creature_senses.h"
 #include "player_utils.h"
+#include "player_complookup.h"
 #include "ariadne_wallhug.h"
 #include "spdigger_stack.h"
 #include "frontmenu_ingame_map.h"
@@ -57,6 +58,28 @@ DLLIMPORT long _DK_tag_blocks_for_digging_in_area(long stl_x, long stl_y, signed
 DLLIMPORT void _DK_place_animating_slab_type_on_map(long a1, char ani_frame, unsigned char a3, unsigned char a4, unsigned char slbelem);
 DLLIMPORT void _DK_dump_slab_on_map(long a1, long ani_frame, unsigned char stl_x, unsigned char stl_y, unsigned char owner);
 
+/** Amount of heights at which a subtile may be open; heights above are always solid. */
+#define SLAB_OPEN_HEIGHTS_COUNT 15
+#define SLAB_OPEN_HEIGHTS_ALL   ((1 << SLAB_OPEN_HEIGHTS_COUNT) - 1)
+/** Flag marking the open heights mask as computed; masks without it are recomputed on first use. */
+#define SLAB_OPEN_HEIGHTS_VALID 0x8000
+
+struct SlabOpenHeightsStats {
+    unsigned long rays_checked;
+    unsigned long rays_accepted;
+    /** Amount of subtiles which didn't have to be walked through thanks to accepted rays. */
+    unsigned long steps_saved;
+    unsigned long slabs_computed;
+};
+
+/**
+ * Heights at which every subtile of a slab is open, one bit per height.
+ * Serves as a coarse visibility map - most sight rays cross only open slabs,
+ * and can be accepted without walking through them subtile by subtile.
+ */
+static unsigned short slab_open_heights[85*85];
+static struct SlabOpenHeightsStats slab_open_heights_stats;
+/******************************************************************************/
 const signed short slab_element_around_eight[] = {
     -3, -2, 1, 4, 3, 2, -1, -4
 };
@@ -1210,6 +1233,7 @@ void place_single_slab_type_on_map(SlabKind slbkind, MapSlabCoord slb_x, MapSlab
         room_pretty_list[i] = 0;
         slab_type_list[i] = slbkind;
     }
+    map_solidity_changed_on_slab(slb_x, slb_y);
     struct SlabAttr *place_slbattr;
     place_slbattr = get_slab_kind_attrs(slbkind);
     if (place_slbattr->category == SlbAtCtg_FortifiedWall) {
@@ -1261,6 +1285,7 @@ void dump_slab_on_map(SlabKind slbkind, long slabct_num, MapSubtlCoord stl_x, Ma
     MapSlabCoord slb_x, slb_y;
     slb_x = subtile_slab_fast(stl_x);
     slb_y = subtile_slab_fast(stl_y);
+    map_solidity_changed_on_slab(slb_x, slb_y);
     MapSubtlCoord stl_xa, stl_ya;
     stl_xa = STL_PER_SLB * slb_x;
     stl_ya = STL_PER_SLB * slb_y;
@@ -1335,6 +1360,7 @@ void dump_slab_on_map(SlabKind slbkind, long slabct_num, MapSubtlCoord stl_x, Ma
 
     slb = get_slabmap_block(slb_x, slb_y);
     slb->kind = slbkind;
+    gold_vein_slab_changed(slb_x, slb_y);
     pannel_map_update(stl_xa, stl_ya, STL_PER_SLB, STL_PER_SLB);
     if ((slbkind == SlbT_GUARDPOST) || (slbkind == SlbT_BRIDGE))
     {
@@ -1464,6 +1490,7 @@ void place_slab_type_on_map_f(SlabKind nslab, MapSubtlCoord stl_x, MapSubtlCoord
     skind = alter_rock_style(nslab, slb_x, slb_y, owner);
     slb = get_slabmap_block(slb_x,slb_y);
     slb->kind = skind;
+    gold_vein_slab_changed(slb_x, slb_y);
 
     set_whole_slab_owner(slb_x, slb_y, owner);
     place_single_slab_type_on_map(skind, slb_x, slb_y, owner);
@@ -1644,6 +1671,193 @@ TbBool point_in_map_is_solid(const struct Coord3d *pos)
     return false;
 }
 
+/**
+ * Computes heights at which all subtiles of given slab are open.
+ * Slabs which contain doors are treated as closed at all heights, because
+ * sight checks treat doors in various ways.
+ * @return Open heights mask, with SLAB_OPEN_HEIGHTS_VALID flag set.
+ */
+static unsigned short compute_slab_open_heights(MapSlabCoord slb_x, MapSlabCoord slb_y)
+{
+    MapSubtlCoord stl_x, stl_y;
+    MapSubtlCoord floor_height, ceiling_height;
+    struct Map *mapblk;
+    unsigned short open_mask;
+    if (slab_has_door_thing_on(slb_x, slb_y))
+        return SLAB_OPEN_HEIGHTS_VALID;
+    open_mask = SLAB_OPEN_HEIGHTS_ALL;
+    for (stl_y = slab_subtile(slb_y,0); stl_y <= slab_subtile(slb_y,STL_PER_SLB-1); stl_y++)
+    {
+        for (stl_x = slab_subtile(slb_x,0); stl_x <= slab_subtile(slb_x,STL_PER_SLB-1); stl_x++)
+        {
+            mapblk = get_map_block_at(stl_x, stl_y);
+            if (map_block_invalid(mapblk) || ((mapblk->flags & SlbAtFlg_IsDoor) != 0))
+                return SLAB_OPEN_HEIGHTS_VALID;
+            // Same rules as in point_in_map_is_solid()
+            if (get_map_ceiling_filled_subtiles(mapblk) > 0)
+            {
+                floor_height = 0;
+                ceiling_height = 15;
+                update_floor_and_ceiling_heights_at(stl_x, stl_y, &floor_height, &ceiling_height);
+            } else
+            {
+                floor_height = get_map_floor_filled_subtiles(mapblk);
+                ceiling_height = get_mapblk_filled_subtiles(mapblk);
+            }
+            if (ceiling_height <= floor_height)
+                return SLAB_OPEN_HEIGHTS_VALID;
+            open_mask &= ((1 << ceiling_height) - 1) & ~((1 << floor_height) - 1);
+        }
+    }
+    return (open_mask & SLAB_OPEN_HEIGHTS_ALL) | SLAB_OPEN_HEIGHTS_VALID;
+}
+
+static unsigned short get_slab_open_heights(MapSlabCoord slb_x, MapSlabCoord slb_y)
+{
+    unsigned short *open_mask;
+    open_mask = &slab_open_heights[slb_y * map_tiles_x + slb_x];
+    if ((*open_mask & SLAB_OPEN_HEIGHTS_VALID) == 0)
+    {
+        *open_mask = compute_slab_open_heights(slb_x, slb_y);
+        slab_open_heights_stats.slabs_computed++;
+    }
+    return *open_mask;
+}
+
+/**
+ * Checks whether a sight ray is surely clear, using per-slab masks of open heights.
+ * The ray is given in the form used by line_of_sight_3d() - starting position, increase
+ * per step and amount of steps. Every subtile the exact walk could check, including
+ * the siblings checked on diagonal steps, lies in one of the slabs tested here, so the
+ * function only returns true if the exact walk would also pass.
+ * @return True if the ray is clear; false if it's blocked or couldn't be decided.
+ */
+TbBool map_ray_is_surely_clear(const struct Coord3d *frpos, MapCoordDelta increase_x,
+    MapCoordDelta increase_y, MapCoordDelta increase_z, MapSubtlCoord distance)
+{
+    long major_val, major_inc, minor_val, minor_inc;
+    long major_stl, major_end, minor_a, minor_b, height_a, height_b;
+    long slb_major, slb_minor, slb_minor_end;
+    long k, k_lo, k_hi, ka, kb;
+    unsigned short need_mask, open_mask;
+    TbBool major_is_x;
+    slab_open_heights_stats.rays_checked++;
+    if (distance <= 0)
+        return false;
+    // Walking coordinates are unsigned 16-bit; leave wrapping rays to the exact walk
+    if ((frpos->x.val + increase_x * distance < 0) || (frpos->x.val + increase_x * distance > 0xFFFF)
+     || (frpos->y.val + increase_y * distance < 0) || (frpos->y.val + increase_y * distance > 0xFFFF)
+     || (frpos->z.val + increase_z * distance < 0) || (frpos->z.val + increase_z * distance > 0xFFFF))
+        return false;
+    // Along the major axis, every step moves by exactly one subtile
+    major_is_x = (abs(increase_x) == COORD_PER_STL);
+    if (major_is_x) {
+        major_val = frpos->x.val; major_inc = increase_x;
+        minor_val = frpos->y.val; minor_inc = increase_y;
+    } else {
+        major_val = frpos->y.val; major_inc = increase_y;
+        minor_val = frpos->x.val; minor_inc = increase_x;
+    }
+    k_lo = 0;
+    while (k_lo <= distance)
+    {
+        // Steps which stay within one slab along the major axis
+        major_stl = (major_val + major_inc * k_lo) / COORD_PER_STL;
+        slb_major = subtile_slab_fast(major_stl);
+        if (major_inc > 0)
+            major_end = slab_subtile(slb_major,STL_PER_SLB-1) - major_stl;
+        else
+            major_end = major_stl - slab_subtile(slb_major,0);
+        k_hi = min(k_lo + major_end, distance);
+        // Diagonal steps also check subtiles with coordinates from the neighbouring steps
+        ka = max(k_lo - 1, 0);
+        kb = min(k_hi + 1, distance);
+        minor_a = (minor_val + minor_inc * ka) / COORD_PER_STL;
+        minor_b = (minor_val + minor_inc * kb) / COORD_PER_STL;
+        height_a = (frpos->z.val + increase_z * ka) / COORD_PER_STL;
+        height_b = (frpos->z.val + increase_z * kb) / COORD_PER_STL;
+        if (minor_a > minor_b) {
+            k = minor_a; minor_a = minor_b; minor_b = k;
+        }
+        if (height_a > height_b) {
+            k = height_a; height_a = height_b; height_b = k;
+        }
+        if (height_b >= SLAB_OPEN_HEIGHTS_COUNT)
+            return false;
+        need_mask = ((1 << (height_b+1)) - 1) & ~((1 << height_a) - 1);
+        slb_minor_end = subtile_slab_fast(minor_b);
+        if ((slb_major >= (major_is_x ? map_tiles_x : map_tiles_y))
+         || (slb_minor_end >= (major_is_x ? map_tiles_y : map_tiles_x)))
+            return false;
+        for (slb_minor = subtile_slab_fast(minor_a); slb_minor <= slb_minor_end; slb_minor++)
+        {
+            if (major_is_x)
+                open_mask = get_slab_open_heights(slb_major, slb_minor);
+            else
+                open_mask = get_slab_open_heights(slb_minor, slb_major);
+            if ((open_mask & need_mask) != need_mask)
+                return false;
+        }
+        k_lo = k_hi + 1;
+    }
+    slab_open_heights_stats.rays_accepted++;
+    slab_open_heights_stats.steps_saved += distance;
+    return true;
+}
+
+/**
+ * Informs the sight related caches that solidity of given area of the map has changed.
+ * Needs to be called whenever columns, ceiling heights or doors change in the area.
+ */
+void map_solidity_changed_in_area(MapSubtlCoord start_x, MapSubtlCoord start_y, MapSubtlCoord end_x, MapSubtlCoord end_y)
+{
+    MapSlabCoord slb_x, slb_y, slb_sx, slb_sy, slb_ex, slb_ey;
+    slb_sx = max(subtile_slab(start_x), 0);
+    slb_sy = max(subtile_slab(start_y), 0);
+    slb_ex = min(subtile_slab(end_x), map_tiles_x-1);
+    slb_ey = min(subtile_slab(end_y), map_tiles_y-1);
+    for (slb_y = slb_sy; slb_y <= slb_ey; slb_y++)
+    {
+        for (slb_x = slb_sx; slb_x <= slb_ex; slb_x++)
+        {
+            slab_open_heights[slb_y * map_tiles_x + slb_x] = 0;
+        }
+    }
+    invalidate_creature_sight_cache_area(start_x, start_y, end_x, end_y);
+}
+
+void map_solidity_changed_on_slab(MapSlabCoord slb_x, MapSlabCoord slb_y)
+{
+    map_solidity_changed_in_area(slab_subtile(slb_x,0), slab_subtile(slb_y,0),
+        slab_subtile(slb_x,STL_PER_SLB-1), slab_subtile(slb_y,STL_PER_SLB-1));
+}
+
+void map_solidity_changed_at(struct Map *mapblk)
+{
+    SubtlCodedCoords stl_num;
+    if (map_block_invalid(mapblk))
+        return;
+    stl_num = mapblk - game.map;
+    map_solidity_changed_in_area(stl_num_decode_x(stl_num), stl_num_decode_y(stl_num),
+        stl_num_decode_x(stl_num), stl_num_decode_y(stl_num));
+}
+
+/**
+ * Drops all slab open heights masks, and logs how useful they were.
+ */
+void clear_slab_open_heights(void)
+{
+    if (slab_open_heights_stats.rays_checked > 0)
+    {
+        SYNCMSG("Slab open heights: %lu rays checked, %lu accepted (%lu%%), %lu subtile steps saved, %lu slab masks computed",
+            slab_open_heights_stats.rays_checked, slab_open_heights_stats.rays_accepted,
+            slab_open_heights_stats.rays_accepted * 100 / slab_open_heights_stats.rays_checked,
+            slab_open_heights_stats.steps_saved, slab_open_heights_stats.slabs_computed);
+    }
+    LbMemorySet(slab_open_heights, 0, sizeof(slab_open_heights));
+    LbMemorySet(&slab_open_heights_stats, 0, sizeof(slab_open_heights_stats));
+}
+
 /**
  * Destroys a tall gold slab, replacing it with neutral ground.
  * @param stl_x Slab subtile digged out, X coordinate.
@@ -2134,6 +2348,7 @@ void check_map_explored(struct Thing *creatng, MapSubtlCoord stl_x, MapSubtlCoor
 
 long ceiling_partially_recompute_heights(long sx, long sy, long ex, long ey)
 {
+    map_solidity_changed_in_area(sx, sy, ex, ey);
     return _DK_ceiling_partially_recompute_heights(sx, sy, ex, ey);
 }
 
@@ -53,6 +53,12 @@ TbBool set_slab_explored(PlayerNumber plyr_idx, MapSlabCoord slb_x, MapSlabCoord
 void update_floor_and_ceiling_heights_at(MapSubtlCoord stl_x, MapSubtlCoord stl_y,
     MapSubtlCoord *floor_height, MapSubtlCoord *ceiling_height);
 TbBool point_in_map_is_solid(const struct Coord3d *pos);
+TbBool map_ray_is_surely_clear(const struct Coord3d *frpos, MapCoordDelta increase_x,
+    MapCoordDelta increase_y, MapCoordDelta increase_z, MapSubtlCoord distance);
+void map_solidity_changed_in_area(MapSubtlCoord start_x, MapSubtlCoord start_y, MapSubtlCoord end_x, MapSubtlCoord end_y);
+void map_solidity_changed_on_slab(MapSlabCoord slb_x, MapSlabCoord slb_y);
+void map_solidity_changed_at(struct Map *mapblk);
+void clear_slab_open_heights(void);
 TbBool point_in_map_is_solid_ignoring_door(const struct Coord3d *pos, const struct Thing *doortng);
 unsigned short get_point_in_map_solid_flags_ignoring_door(const struct Coord3d *pos, const struct Thing *doortng);
 unsigned short get_point_in_map_solid_flags_ignoring_own_door(const struct Coord3d *pos, PlayerNumber plyr_idx);
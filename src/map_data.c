@@ -25,6 +25,7 @@
 #include "config_terrain.h"
 #include "game_legacy.h"
 #include "frontmenu_ingame_map.h"
+#include "map_blocks.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -186,6 +187,7 @@ void set_mapblk_column_index(struct Map *mapblk, long column_idx)
   }
   // Clear previous and set new
   mapblk->data ^= (mapblk->data ^ ((unsigned long)column_idx)) & 0x7FF;
+  map_solidity_changed_at(mapblk);
 }
 
 /**
@@ -229,6 +231,7 @@ void set_mapblk_filled_subtiles(struct Map *mapblk, long height)
     if (height > 15) height = 15;
     mapblk->data &= ~(0xF000000);
     mapblk->data |= (height << 24) & 0xF000000;
+    map_solidity_changed_at(mapblk);
 }
 
 void reveal_map_subtile(MapSubtlCoord stl_x, MapSubtlCoord stl_y, PlayerNumber plyr_idx)
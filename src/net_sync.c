@@ -26,6 +26,7 @@
 #include "config.h"
 #include "front_network.h"
 #include "player_data.h"
+#include "player_complookup.h"
 #include "game_merge.h"
 #include "net_game.h"
 #include "lens_api.h"
@@ -162,6 +163,8 @@ void resync_game(void)
         receive_resync_game();
     }
     recall_localised_game_structure();
+    // Only the game structure is sent, so the gold veins map may no longer match it on every side
+    clear_gold_veins_map();
     reinit_level_after_load();
     set_flag_byte(&game.system_flags,GSF_NetGameNoSync,false);
     set_flag_byte(&game.system_flags,GSF_NetSeedNoSync,false);
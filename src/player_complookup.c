@@ -24,9 +24,14 @@
 #include "globals.h"
 #include "bflib_basics.h"
 #include "bflib_memory.h"
+#include "bflib_math.h"
 
 #include "map_data.h"
 #include "slab_data.h"
+#include "room_data.h"
+#include "dungeon_data.h"
+#include "thing_data.h"
+#include "game_merge.h"
 #include "game_legacy.h"
 #include "front_simple.h"
 #include "config_terrain.h"
@@ -35,6 +40,12 @@
 extern "C" {
 #endif
 /******************************************************************************/
+/** Value in gold veins map for valuable slabs which aren't part of any listed vein. */
+#define GOLD_VEIN_UNLISTED 0xFF
+/** Flag in gold veins map marking gem slabs. */
+#define GOLD_VEIN_GEMS     0x40
+/** Mask of gold lookup index + 1, stored in gold veins map. */
+#define GOLD_VEIN_IDX_MASK 0x3F
 /******************************************************************************/
 #ifdef __cplusplus
 }
@@ -166,10 +177,26 @@ void check_treasure_map(unsigned char *treasure_map, unsigned short *vein_list,
     } else
     {
         gold_idx = smaller_gold_vein_lookup_idx(gold_slabs, gem_slabs);
+        if (gold_idx != -1) {
+            // The replaced vein is no longer listed
+            for (slb_num=0; slb_num < map_tiles_x*map_tiles_y; slb_num++)
+            {
+                if ((gameadd.gold_veins.slabs[slb_num] != GOLD_VEIN_UNLISTED) && ((gameadd.gold_veins.slabs[slb_num] & GOLD_VEIN_IDX_MASK) == gold_idx+1))
+                    gameadd.gold_veins.slabs[slb_num] = GOLD_VEIN_UNLISTED;
+            }
+        }
     }
     // Write the vein to GoldLookup item
     if (gold_idx != -1)
     {
+        slb_num = get_slab_number(veinslb_x, veinslb_y);
+        for (vein_idx=-1; vein_idx < vein_total; vein_idx++)
+        {
+            if (vein_idx >= 0)
+                slb_num = vein_list[vein_idx];
+            slb = get_slabmap_direct(slb_num);
+            gameadd.gold_veins.slabs[slb_num] = (gold_idx+1) | ((slb->kind == SlbT_GEMS) ? GOLD_VEIN_GEMS : 0);
+        }
         gldlook = get_gold_lookup(gold_idx);
         LbMemorySet(gldlook, 0, sizeof(struct GoldLookup));
         gldlook->flags |= 0x01;
@@ -197,6 +224,13 @@ void check_map_for_gold(void)
     long i;
     SYNCDBG(8,"Starting");
     //_DK_check_map_for_gold();
+    if (gameadd.gold_veins.valid && !gameadd.gold_veins.changed)
+    {
+        // Valuable slabs are the same as at previous scan, so its result can be reused
+        SYNCDBG(8,"No valuable slabs changed, reusing previous scan");
+        LbMemoryCopy(game.gold_lookup, gameadd.gold_veins.scanned, sizeof(gameadd.gold_veins.scanned));
+        return;
+    }
     for (i=0; i < GOLD_LOOKUP_COUNT; i++) {
         LbMemorySet(&game.gold_lookup[i], 0, sizeof(struct GoldLookup));
     }
@@ -215,6 +249,9 @@ void check_map_for_gold(void)
             // Mark areas which are not valuable
             if ((slbattr->block_flags & (SlbAtFlg_Valuable)) == 0) {
                 treasure_map[slb_num] |= 0x01;
+                gameadd.gold_veins.slabs[slb_num] = 0;
+            } else {
+                gameadd.gold_veins.slabs[slb_num] = GOLD_VEIN_UNLISTED;
             }
         }
     }
@@ -231,6 +268,152 @@ void check_map_for_gold(void)
             }
         }
     }
+    LbMemoryCopy(gameadd.gold_veins.scanned, game.gold_lookup, sizeof(gameadd.gold_veins.scanned));
+    gameadd.gold_veins.valid = true;
+    gameadd.gold_veins.changed = false;
     SYNCDBG(8,"Found %ld possible digging locations",gold_next_idx);
 }
+
+/**
+ * Updates gold lookup after given slab has changed, ie. was mined out.
+ * If the slab was a part of listed gold vein, the vein size is decreased, and
+ * the vein is no longer offered to computer players when it has no valuable slabs left.
+ * Coordinates of the vein are kept, as computer players may still be digging to them.
+ */
+void gold_vein_slab_changed(MapSlabCoord slb_x, MapSlabCoord slb_y)
+{
+    struct GoldLookup *gldlook;
+    const struct SlabAttr *slbattr;
+    SlabCodedCoords slb_num;
+    unsigned char vein;
+    TbBool is_valuable;
+    if ((slb_x < 0) || (slb_x >= map_tiles_x) || (slb_y < 0) || (slb_y >= map_tiles_y))
+        return;
+    if (!gameadd.gold_veins.valid) {
+        gameadd.gold_veins.changed = true;
+        return;
+    }
+    slb_num = get_slab_number(slb_x, slb_y);
+    slbattr = get_slab_attrs(get_slabmap_direct(slb_num));
+    is_valuable = ((slbattr->block_flags & SlbAtFlg_Valuable) != 0);
+    vein = gameadd.gold_veins.slabs[slb_num];
+    if (vein == 0)
+    {
+        if (is_valuable) {
+            gameadd.gold_veins.slabs[slb_num] = GOLD_VEIN_UNLISTED;
+            gameadd.gold_veins.changed = true;
+        }
+        return;
+    }
+    if (is_valuable)
+    {
+        // Gold turned into gems or the other way would also change the scan result
+        if ((vein != GOLD_VEIN_UNLISTED) && (((vein & GOLD_VEIN_GEMS) != 0) != (get_slabmap_direct(slb_num)->kind == SlbT_GEMS)))
+            gameadd.gold_veins.changed = true;
+        return;
+    }
+    gameadd.gold_veins.slabs[slb_num] = 0;
+    gameadd.gold_veins.changed = true;
+    if (vein == GOLD_VEIN_UNLISTED)
+        return;
+    gldlook = get_gold_lookup((vein & GOLD_VEIN_IDX_MASK) - 1);
+    if ((vein & GOLD_VEIN_GEMS) != 0)
+    {
+        if (gldlook->num_gem_slabs > 0)
+            gldlook->num_gem_slabs--;
+    } else
+    {
+        if (gldlook->num_gold_slabs > 0)
+            gldlook->num_gold_slabs--;
+        if (gldlook->field_A > 0)
+            gldlook->field_A--;
+    }
+    if ((gldlook->num_gold_slabs == 0) && (gldlook->num_gem_slabs == 0))
+    {
+        SYNCDBG(8,"Vein %d at (%d,%d) is mined out",(int)gold_lookup_index(gldlook),(int)gldlook->x_stl_num,(int)gldlook->y_stl_num);
+        gldlook->flags &= ~0x01;
+    }
+}
+
+/**
+ * Forgets the gold veins map, so that the next gold check does a full scan.
+ * To be called when a level is started, or when game state is replaced by network resync.
+ * Saved games store the map, so it shouldn't be cleared after loading.
+ */
+void clear_gold_veins_map(void)
+{
+    gameadd.gold_veins.valid = false;
+    gameadd.gold_veins.changed = true;
+}
+
+/**
+ * Finds listed gold vein nearest to given position, which the player isn't already digging to.
+ * Distance is reduced by radius of the vein area, the same way computer players compare veins.
+ *
+ * @param plyr_idx Player who wants to reach the vein.
+ * @param pos Position to measure distance from.
+ * @param distance Returns distance to the vein in subtiles, or LONG_MAX if no vein was found.
+ * @return The vein lookup entry, or NULL if there's no vein to dig to.
+ */
+struct GoldLookup *find_gold_vein_nearest_to_position(PlayerNumber plyr_idx, const struct Coord3d *pos, long *distance)
+{
+    struct GoldLookup *gldlook;
+    struct GoldLookup *nearlook;
+    MapCoordDelta delta_x,delta_y;
+    long dist,min_dist;
+    long i;
+    nearlook = NULL;
+    min_dist = LONG_MAX;
+    for (i=0; i < GOLD_LOOKUP_COUNT; i++)
+    {
+        gldlook = get_gold_lookup(i);
+        if ((gldlook->flags & 0x01) == 0)
+            continue;
+        if ((plyr_idx >= 0) && (plyr_idx < sizeof(gldlook->player_interested)))
+        {
+            if ((gldlook->player_interested[plyr_idx] & 0x03) != 0)
+                continue;
+        }
+        delta_x = subtile_coord_center(gldlook->x_stl_num) - (MapCoordDelta)pos->x.val;
+        delta_y = subtile_coord_center(gldlook->y_stl_num) - (MapCoordDelta)pos->y.val;
+        dist = coord_subtile(LbDiagonalLength(abs(delta_x), abs(delta_y)));
+        dist -= LbSqrL(gldlook->num_gold_slabs * STL_PER_SLB);
+        dist -= LbSqrL(gldlook->num_gem_slabs * STL_PER_SLB * 4);
+        if (min_dist > dist)
+        {
+            nearlook = gldlook;
+            min_dist = dist;
+        }
+    }
+    *distance = min_dist;
+    return nearlook;
+}
+
+/**
+ * Finds listed gold vein nearest to center of given room, which the room owner isn't already digging to.
+ */
+struct GoldLookup *find_gold_vein_nearest_to_room(const struct Room *room, long *distance)
+{
+    struct Coord3d pos;
+    *distance = LONG_MAX;
+    if (room_is_invalid(room))
+        return NULL;
+    pos.x.val = subtile_coord_center(room->central_stl_x);
+    pos.y.val = subtile_coord_center(room->central_stl_y);
+    pos.z.val = 0;
+    return find_gold_vein_nearest_to_position(room->owner, &pos, distance);
+}
+
+/**
+ * Finds listed gold vein nearest to dungeon heart of given player, which the player isn't already digging to.
+ */
+struct GoldLookup *find_gold_vein_nearest_to_dungeon_heart(PlayerNumber plyr_idx, long *distance)
+{
+    struct Thing *heartng;
+    *distance = LONG_MAX;
+    heartng = get_player_soul_container(plyr_idx);
+    if (thing_is_invalid(heartng))
+        return NULL;
+    return find_gold_vein_nearest_to_position(plyr_idx, &heartng->mappos, distance);
+}
 /******************************************************************************/
@@ -28,6 +28,8 @@
 extern "C" {
 #endif
 /******************************************************************************/
+struct Coord3d;
+struct Room;
 
 /******************************************************************************/
 #pragma pack(1)
@@ -46,11 +48,32 @@ unsigned char field_14[6];
 unsigned short field_1A;
 };
 
+/**
+ * Gold veins map, kept along with gold lookup to update it when valuable slabs change.
+ * It is stored in saved games, so that the gold lookup is updated in the same way
+ * after a game is loaded as it would be if the game was never saved.
+ */
+struct GoldVeinsMap {
+    /** Gold lookup entry of every slab as index + 1 and gem flag; zero for slabs which were not valuable at the last scan. */
+    unsigned char slabs[85*85];
+    /** Set when the map matches the current gold lookup. */
+    TbBool valid;
+    /** Set when a valuable slab was changed since the last scan, so a new scan would give different result. */
+    TbBool changed;
+    /** Gold lookup as it was right after the last scan. */
+    struct GoldLookup scanned[GOLD_LOOKUP_COUNT];
+};
+
 #pragma pack()
 /******************************************************************************/
 void check_map_for_gold(void);
 struct GoldLookup *get_gold_lookup(long idx);
 long gold_lookup_index(const struct GoldLookup *gldlook);
+void gold_vein_slab_changed(MapSlabCoord slb_x, MapSlabCoord slb_y);
+void clear_gold_veins_map(void);
+struct GoldLookup *find_gold_vein_nearest_to_position(PlayerNumber plyr_idx, const struct Coord3d *pos, long *distance);
+struct GoldLookup *find_gold_vein_nearest_to_room(const struct Room *room, long *distance);
+struct GoldLookup *find_gold_vein_nearest_to_dungeon_heart(PlayerNumber plyr_idx, long *distance);
 /******************************************************************************/
 #ifdef __cplusplus
 }
@@ -26,6 +26,7 @@
 #include "bflib_fileio.h"
 #include "bflib_dernc.h"
 #include "bflib_memory.h"
+#include "bflib_datetm.h"
 #include "bflib_math.h"
 
 #include "config.h"
@@ -1414,31 +1415,159 @@ void computer_check_events(struct Computer2 *comp)
     }
 }
 
+struct ComputerCheckStats {
+    const char *name;
+    unsigned long runs;
+    unsigned long deferred;
+    TbClockUSec run_time_total;
+    TbClockUSec run_time_max;
+};
+
+static struct ComputerCheckStats computer_check_stats[PLAYERS_COUNT][COMPUTER_CHECKS_COUNT];
+
+static struct ComputerCheckStats *get_computer_check_stats(const struct Computer2 *comp, long check_idx)
+{
+    PlayerNumber plyr_idx;
+    plyr_idx = comp->dungeon->owner;
+    if ((plyr_idx < 0) || (plyr_idx >= PLAYERS_COUNT))
+        return NULL;
+    return &computer_check_stats[plyr_idx][check_idx];
+}
+
+static TbBool computer_check_is_due(const struct ComputerCheck *ccheck)
+{
+    long delta;
+    if (((ccheck->flags & ComChk_Unkn0001) != 0) || (ccheck->func == NULL))
+        return false;
+    delta = (game.play_gameturn - ccheck->last_run_turn);
+    return (delta > ccheck->turns_interval);
+}
+
+/**
+ * Returns index of the due check which waits longest past its interval, or -1 if none is due.
+ * On equal delays, the check which is first on the list is selected.
+ */
+static long find_most_overdue_computer_check(const struct Computer2 *comp)
+{
+    const struct ComputerCheck *ccheck;
+    long overdue,max_overdue;
+    long i,best_idx;
+    best_idx = -1;
+    max_overdue = 0;
+    for (i=0; i < COMPUTER_CHECKS_COUNT; i++)
+    {
+        ccheck = &comp->checks[i];
+        if ((ccheck->flags & ComChk_Unkn0002) != 0)
+            break;
+        if (!computer_check_is_due(ccheck))
+            continue;
+        overdue = (game.play_gameturn - ccheck->last_run_turn) - ccheck->turns_interval;
+        if ((best_idx < 0) || (overdue > max_overdue))
+        {
+            best_idx = i;
+            max_overdue = overdue;
+        }
+    }
+    return best_idx;
+}
+
+static void run_computer_check(struct Computer2 *comp, long check_idx)
+{
+    struct ComputerCheck *ccheck;
+    struct ComputerCheckStats *stats;
+    TbClockUSec start_time;
+    ccheck = &comp->checks[check_idx];
+    SYNCDBG(8,"Executing check %ld, \"%s\"",check_idx,ccheck->name);
+    start_time = LbTimerClockMicro();
+    ccheck->func(comp, ccheck);
+    ccheck->last_run_turn = game.play_gameturn;
+    stats = get_computer_check_stats(comp, check_idx);
+    if (stats != NULL)
+    {
+        start_time = LbTimerClockMicro() - start_time;
+        stats->name = ccheck->name;
+        stats->runs++;
+        stats->run_time_total += start_time;
+        if (stats->run_time_max < start_time)
+            stats->run_time_max = start_time;
+    }
+}
+
+/**
+ * Executes computer player checks which are due.
+ * Without a limit, all due checks are executed in order of the list. If computer_checks_per_turn
+ * is set, only that many checks are executed in one turn, starting from the ones which are most
+ * overdue; the remaining checks keep their last run turn, so they become more overdue and are
+ * executed on next turns. The limit is an amount of checks, not time - all players in network
+ * game must make the same decisions.
+ */
 TbBool process_checks(struct Computer2 *comp)
 {
     struct ComputerCheck *ccheck;
-    long delta;
+    struct ComputerCheckStats *stats;
+    long checks_done;
     long i;
     SYNCDBG(17,"Starting");
-    for (i=0; i < COMPUTER_CHECKS_COUNT; i++)
+    if (gameadd.computer_checks_per_turn == 0)
+    {
+        for (i=0; i < COMPUTER_CHECKS_COUNT; i++)
+        {
+            ccheck = &comp->checks[i];
+            if (comp->tasks_did <= 0)
+                break;
+            if ((ccheck->flags & ComChk_Unkn0002) != 0)
+                break;
+            if (computer_check_is_due(ccheck))
+                run_computer_check(comp, i);
+        }
+        return true;
+    }
+    for (checks_done=0; checks_done < gameadd.computer_checks_per_turn; checks_done++)
     {
-        ccheck = &comp->checks[i];
         if (comp->tasks_did <= 0)
             break;
+        i = find_most_overdue_computer_check(comp);
+        if (i < 0)
+            break;
+        run_computer_check(comp, i);
+    }
+    // Count the checks which are still due, as deferred
+    for (i=0; i < COMPUTER_CHECKS_COUNT; i++)
+    {
+        ccheck = &comp->checks[i];
         if ((ccheck->flags & ComChk_Unkn0002) != 0)
             break;
-        if ((ccheck->flags & ComChk_Unkn0001) == 0)
+        if (!computer_check_is_due(ccheck))
+            continue;
+        SYNCDBG(9,"Deferring check %ld, \"%s\"",i,ccheck->name);
+        stats = get_computer_check_stats(comp, i);
+        if (stats != NULL)
+            stats->deferred++;
+    }
+    return true;
+}
+
+/**
+ * Logs the gathered costs of computer player checks, and clears them.
+ */
+void clear_computer_checks_stats(void)
+{
+    struct ComputerCheckStats *stats;
+    long plyr_idx,i;
+    for (plyr_idx=0; plyr_idx < PLAYERS_COUNT; plyr_idx++)
+    {
+        for (i=0; i < COMPUTER_CHECKS_COUNT; i++)
         {
-            delta = (game.play_gameturn - ccheck->last_run_turn);
-            if ((delta > ccheck->turns_interval) && (ccheck->func != NULL))
+            stats = &computer_check_stats[plyr_idx][i];
+            if (stats->runs > 0)
             {
-                SYNCDBG(8,"Executing check %ld, \"%s\"",i,ccheck->name);
-                ccheck->func(comp, ccheck);
-                ccheck->last_run_turn = game.play_gameturn;
+                SYNCMSG("Player %d check \"%s\": %lu runs taking %lu us on average and %lu us max, %lu deferred",
+                    (int)plyr_idx, (stats->name != NULL) ? stats->name : "", stats->runs,
+                    (unsigned long)(stats->run_time_total / stats->runs), (unsigned long)stats->run_time_max, stats->deferred);
             }
         }
     }
-    return true;
+    LbMemorySet(computer_check_stats, 0, sizeof(computer_check_stats));
 }
 
 TbBool process_processes_and_task(struct Computer2 *comp)
@@ -1451,7 +1580,8 @@ TbBool process_processes_and_task(struct Computer2 *comp)
   {
     if (comp->tasks_did <= 0)
         return false;
-    if ((game.play_gameturn % comp->field_18) == 0)
+    // Shift the turn by player index, so that players with the same interval don't process tasks at the same turn
+    if (((game.play_gameturn + comp->dungeon->owner) % comp->field_18) == 0)
         process_tasks(comp);
     switch (comp->task_state)
     {
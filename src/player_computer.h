@@ -609,6 +609,7 @@ long add_to_trap_location(struct Computer2 *, struct Coord3d *);
 long set_next_process(struct Computer2 *comp);
 void computer_check_events(struct Computer2 *comp);
 TbBool process_checks(struct Computer2 *comp);
+void clear_computer_checks_stats(void);
 GoldAmount get_computer_money_less_cost(const struct Computer2 *comp);
 GoldAmount get_dungeon_money_less_cost(const struct Dungeon *dungeon);
 TbBool creature_could_be_placed_in_better_room(const struct Computer2 *comp, const struct Thing *thing);
@@ -42,6 +42,7 @@
 #include "player_utils.h"
 #include "player_states.h"
 #include "room_workshop.h"
+#include "spdigger_stack.h"
 #include "magic.h"
 #include "gui_frontmenu.h"
 #include "gui_soundmsgs.h"
@@ -1224,6 +1225,7 @@ TbBool player_place_trap_at(MapSubtlCoord stl_x, MapSubtlCoord stl_y, PlayerNumb
         rearm_trap(traptng);
         dungeon->lvstats.traps_armed++;
     }
+    imp_stack_trap_placed(traptng);
     dungeon->camera_deviate_jump = 192;
     if (is_my_player_number(plyr_idx))
         play_non_3d_sample(117);
@@ -457,57 +457,88 @@ struct Thing *treasure_room_eats_gold_piles(struct Room *room, MapSlabCoord slb_
     return hoardtng;
 }
 
-void count_gold_hoardes_in_room(struct Room *room)
+/**
+ * Returns max amount of gold which can be stored in one hoard of given treasure room.
+ */
+static GoldAmount get_room_max_hoard_size(const struct Room *room)
+{
+    long wealth_size_holds;
+    wealth_size_holds = gold_per_hoard / get_wealth_size_types_count();
+    if (room->slabs_count < 1)
+        return 0;
+    return wealth_size_holds * room->total_capacity / room->slabs_count;
+}
+
+/**
+ * Updates gold hoard on one slab of treasure room, and returns amount of gold stored there.
+ * Hoard which exceeds given size limit is trimmed, and gold piles lying on the slab are added to the hoard.
+ * @param room The treasure room.
+ * @param slb_num The room slab to be updated.
+ * @param max_hoard_size_in_room Max amount of gold in one hoard.
+ * @param wealth_size Amount of wealth size of the hoard is added to this variable.
+ */
+static GoldAmount count_gold_hoarde_on_room_slab(struct Room *room, SlabCodedCoords slb_num, GoldAmount max_hoard_size_in_room, int *wealth_size)
+{
+    MapSlabCoord slb_x, slb_y;
+    struct Coord3d pos;
+    slb_x = slb_num_decode_x(slb_num);
+    slb_y = slb_num_decode_y(slb_num);
+    GoldAmount gold_amount;
+    struct Thing *gldtng;
+    gldtng = find_gold_hoarde_at(slab_subtile_center(slb_x), slab_subtile_center(slb_y));
+    if (!thing_is_invalid(gldtng) && (gldtng->valuable.gold_stored > max_hoard_size_in_room))
+    {
+        pos.x.val = gldtng->mappos.x.val;
+        pos.y.val = gldtng->mappos.y.val;
+        pos.z.val = gldtng->mappos.z.val;
+        long drop_amount;
+        drop_amount = remove_gold_from_hoarde(gldtng, room, gldtng->valuable.gold_stored - max_hoard_size_in_room);
+        drop_gold_pile(drop_amount, &pos);
+        gold_amount = gldtng->valuable.gold_stored;
+    } else
+    {
+        gldtng = treasure_room_eats_gold_piles(room, slb_x, slb_y, gldtng);
+        if (!thing_is_invalid(gldtng))
+        {
+            gold_amount = gldtng->valuable.gold_stored;
+        } else {
+            gold_amount = 0;
+        }
+    }
+    if (gold_amount > 0) {
+        *wealth_size += get_wealth_size_of_gold_amount(gold_amount);
+        return gold_amount;
+    }
+    return 0;
+}
+
+/**
+ * Updates gold hoards on room slabs, starting from given slab, and adds their gold to the room counters.
+ * @param room The treasure room.
+ * @param slb_num First slab to be updated; the following slabs in room list are updated as well.
+ * @param base_gold_amount Gold stored in the slabs which are not updated.
+ * @param base_wealth_size Wealth size of hoards on the slabs which are not updated.
+ */
+static void count_gold_hoardes_in_room_slabs(struct Room *room, SlabCodedCoords slb_num, GoldAmount base_gold_amount, int base_wealth_size)
 {
-    //_DK_count_gold_hoardes_in_room(room); return;
     GoldAmount all_gold_amount;
     int all_wealth_size;
-    all_gold_amount = 0;
-    all_wealth_size = 0;
+    all_gold_amount = base_gold_amount;
+    all_wealth_size = base_wealth_size;
     long wealth_size_holds;
     wealth_size_holds = gold_per_hoard / get_wealth_size_types_count();
     GoldAmount max_hoard_size_in_room;
-    max_hoard_size_in_room = wealth_size_holds * room->total_capacity / room->slabs_count;
+    max_hoard_size_in_room = get_room_max_hoard_size(room);
     // First, set the values to something big; this will prevent logging warnings on add/remove_gold_from_hoarde()
     room->used_capacity = room->total_capacity;
     room->capacity_used_for_storage = room->used_capacity * wealth_size_holds;
     long i;
     unsigned long k;
     k = 0;
-    i = room->slabs_list;
+    i = slb_num;
     while (i > 0)
     {
-        MapSlabCoord slb_x, slb_y;
-        struct Coord3d pos;
-        slb_x = slb_num_decode_x(i);
-        slb_y = slb_num_decode_y(i);
-        GoldAmount gold_amount;
-        struct Thing *gldtng;
-        gldtng = find_gold_hoarde_at(slab_subtile_center(slb_x), slab_subtile_center(slb_y));
-        if (!thing_is_invalid(gldtng) && (gldtng->valuable.gold_stored > max_hoard_size_in_room))
-        {
-            pos.x.val = gldtng->mappos.x.val;
-            pos.y.val = gldtng->mappos.y.val;
-            pos.z.val = gldtng->mappos.z.val;
-            long drop_amount;
-            drop_amount = remove_gold_from_hoarde(gldtng, room, gldtng->valuable.gold_stored - max_hoard_size_in_room);
-            drop_gold_pile(drop_amount, &pos);
-            gold_amount = gldtng->valuable.gold_stored;
-        } else
-        {
-            gldtng = treasure_room_eats_gold_piles(room, slb_x, slb_y, gldtng);
-            if (!thing_is_invalid(gldtng))
-            {
-                gold_amount = gldtng->valuable.gold_stored;
-            } else {
-                gold_amount = 0;
-            }
-        }
-        if (gold_amount > 0) {
-            all_gold_amount += gold_amount;
-            all_wealth_size += get_wealth_size_of_gold_amount(gold_amount);
-        }
-
+        all_gold_amount += count_gold_hoarde_on_room_slab(room, i, max_hoard_size_in_room, &all_wealth_size);
         i = get_next_slab_number_in_room(i);
         k++;
         if (k > map_tiles_x * map_tiles_y)
@@ -520,6 +551,12 @@ void count_gold_hoardes_in_room(struct Room *room)
     room->used_capacity = all_wealth_size;
 }
 
+void count_gold_hoardes_in_room(struct Room *room)
+{
+    //_DK_count_gold_hoardes_in_room(room); return;
+    count_gold_hoardes_in_room_slabs(room, room->slabs_list, 0, 0);
+}
+
 void init_reposition_struct(struct RoomReposition * rrepos)
 {
     long i;
@@ -2053,6 +2090,8 @@ void remove_slab_from_room_tiles_list(struct Room *room, MapSlabCoord slb_x, Map
         ERRORLOG("Non-existing slab (%d,%d).",(int)slb_x,(int)slb_y);
         return;
     }
+    // Items on the removed slab are no longer in the room, so it has to be recounted
+    invalidate_room_contents_count(room);
     // If the slab to remove is first in room slabs list - it's simple
     // In this case we need to re-put a flag on first slab
     if (room->slabs_list == slb_num)
@@ -2204,6 +2243,7 @@ struct Room *allocate_free_room_structure(void)
             LbMemorySet(room, 0, sizeof(struct Room));
             room->alloc_flags |= 0x01;
             room->index = i;
+            invalidate_room_contents_count(room);
             return room;
         }
     }
@@ -2503,6 +2543,270 @@ TbBool update_room_total_health(struct Room *room)
     return true;
 }
 
+/**
+ * State of room at the moment its stored items were counted.
+ * Storage counters of rooms are updated incrementally when items are added or taken,
+ * so the recount which follows room integration only needs to look at slabs added since then.
+ */
+struct RoomContentsCount {
+    SlabCodedCoords slabs_list;
+    SlabCodedCoords slabs_list_tail;
+    unsigned short slabs_count;
+    PlayerNumber owner;
+    long total_capacity;
+    GoldAmount max_hoard_size;
+    TbBool valid;
+};
+
+static struct RoomContentsCount room_contents_count[ROOMS_COUNT];
+
+void clear_rooms_contents_count(void)
+{
+    LbMemorySet(room_contents_count, 0, sizeof(room_contents_count));
+}
+
+/**
+ * Makes the next update of room contents recount items on all room slabs.
+ * Needs to be called when slabs are removed from the room, or when items appear on
+ * the room slabs without updating the room counters.
+ */
+void invalidate_room_contents_count(const struct Room *room)
+{
+    if (room_is_invalid(room))
+        return;
+    room_contents_count[room->index].valid = false;
+}
+
+static TbBool room_contents_count_supported(Room_Update_Func cb)
+{
+    return (cb == count_gold_hoardes_in_room) || (cb == count_books_in_room) || (cb == count_crates_in_room);
+}
+
+static void remember_room_contents_count(const struct Room *room)
+{
+    struct RoomContentsCount *rcount;
+    rcount = &room_contents_count[room->index];
+    rcount->slabs_list = room->slabs_list;
+    rcount->slabs_list_tail = room->slabs_list_tail;
+    rcount->slabs_count = room->slabs_count;
+    rcount->owner = room->owner;
+    rcount->total_capacity = room->total_capacity;
+    rcount->max_hoard_size = get_room_max_hoard_size(room);
+    rcount->valid = true;
+}
+
+/**
+ * Counts items stored on given room slab, without moving or removing any of them.
+ * @param room The room which slab is to be checked.
+ * @param cb Storage update function of the room, which defines what the stored items are.
+ * @param slb_num The room slab to be checked.
+ * @param gold_amount If not NULL, gold stored in a hoard on the slab is added to this variable.
+ * @param in_wall If not NULL, is set to true if any of the items is in a solid column.
+ * @return Amount of room capacity used by the items.
+ */
+static long count_stored_items_on_room_slab(const struct Room *room, Room_Update_Func cb, SlabCodedCoords slb_num, GoldAmount *gold_amount, TbBool *in_wall)
+{
+    MapSlabCoord slb_x, slb_y;
+    long count;
+    slb_x = slb_num_decode_x(slb_num);
+    slb_y = slb_num_decode_y(slb_num);
+    count = 0;
+    if (cb == count_gold_hoardes_in_room)
+    {
+        struct Thing *gldtng;
+        gldtng = find_gold_hoarde_at(slab_subtile_center(slb_x), slab_subtile_center(slb_y));
+        if (!thing_is_invalid(gldtng) && (gldtng->valuable.gold_stored > 0))
+        {
+            if (gold_amount != NULL)
+                *gold_amount += gldtng->valuable.gold_stored;
+            count += get_wealth_size_of_gold_amount(gldtng->valuable.gold_stored);
+        }
+        return count;
+    }
+    long dx,dy;
+    for (dy=0; dy < STL_PER_SLB; dy++)
+    {
+        for (dx=0; dx < STL_PER_SLB; dx++)
+        {
+            struct Map *mapblk;
+            mapblk = get_map_block_at(slab_subtile(slb_x,dx), slab_subtile(slb_y,dy));
+            if (map_block_invalid(mapblk))
+                continue;
+            TbBool floor_filled;
+            floor_filled = (get_map_floor_filled_subtiles(mapblk) == 1);
+            long i;
+            unsigned long k;
+            k = 0;
+            i = get_mapwho_thing_index(mapblk);
+            while (i != 0)
+            {
+                struct Thing *thing;
+                thing = thing_get(i);
+                if (thing_is_invalid(thing))
+                {
+                    WARNLOG("Jump out of things array");
+                    break;
+                }
+                i = thing->next_on_mapblk;
+                // Per thing code
+                TbBool stored;
+                if (cb == count_books_in_room) {
+                    stored = (thing->class_id == TCls_Object) && (book_thing_to_power_kind(thing) > 0) && ((thing->alloc_flags & 0x80) == 0);
+                } else {
+                    stored = thing_is_workshop_crate(thing) && !thing_is_dragged_or_pulled(thing) && (thing->owner == room->owner);
+                }
+                if (stored)
+                {
+                    count++;
+                    if ((in_wall != NULL) && (!floor_filled || thing_in_wall_at(thing, &thing->mappos))) {
+                        *in_wall = true;
+                    }
+                }
+                // Per thing code ends
+                k++;
+                if (k > THINGS_COUNT)
+                {
+                    ERRORLOG("Infinite loop detected when sweeping things list");
+                    break;
+                }
+            }
+        }
+    }
+    return count;
+}
+
+/**
+ * Checks if items on given room slab, or on room slabs around it, are in solid columns.
+ * Adding a slab to room may change columns on neighbouring slabs, ie. pillars are placed on room centres.
+ */
+static TbBool room_slab_or_around_has_items_in_wall(const struct Room *room, Room_Update_Func cb, SlabCodedCoords slb_num)
+{
+    MapSlabCoord slb_x, slb_y;
+    TbBool in_wall;
+    long n;
+    slb_x = slb_num_decode_x(slb_num);
+    slb_y = slb_num_decode_y(slb_num);
+    in_wall = false;
+    for (n=0; n < MID_AROUND_LENGTH; n++)
+    {
+        MapSlabCoord sslb_x, sslb_y;
+        struct SlabMap *slb;
+        sslb_x = slb_x + (long)mid_around[n].delta_x;
+        sslb_y = slb_y + (long)mid_around[n].delta_y;
+        slb = get_slabmap_block(sslb_x, sslb_y);
+        if (slabmap_block_invalid(slb) || (slb->room_index != room->index))
+            continue;
+        count_stored_items_on_room_slab(room, cb, get_slab_number(sslb_x, sslb_y), NULL, &in_wall);
+        if (in_wall)
+            break;
+    }
+    return in_wall;
+}
+
+/**
+ * Updates storage counters of a room by checking only the slabs added since previous count.
+ * Items stored on the other slabs are already included in the counters, as these are
+ * updated whenever an item is placed in the room or taken from it.
+ * @return True if the counters were updated; false if the room has to be fully recounted.
+ */
+static TbBool update_room_contents_on_new_slabs(struct Room *room, Room_Update_Func cb)
+{
+    struct RoomContentsCount *rcount;
+    struct SlabMap *slb;
+    SlabCodedCoords slb_num;
+    rcount = &room_contents_count[room->index];
+    if (!rcount->valid || (rcount->owner != room->owner) || (rcount->slabs_list != room->slabs_list)
+      || (rcount->slabs_count > room->slabs_count)) {
+        return false;
+    }
+    slb = get_slabmap_direct(rcount->slabs_list_tail);
+    if (slabmap_block_invalid(slb) || (slb->room_index != room->index)) {
+        return false;
+    }
+    if (rcount->slabs_count < room->slabs_count) {
+        slb_num = get_next_slab_number_in_room(rcount->slabs_list_tail);
+    } else {
+        slb_num = 0;
+    }
+    if (cb == count_gold_hoardes_in_room)
+    {
+        // Hoards on previous slabs fit the limit only if it wasn't lowered
+        if (get_room_max_hoard_size(room) < rcount->max_hoard_size) {
+            return false;
+        }
+        if (slb_num > 0) {
+            count_gold_hoardes_in_room_slabs(room, slb_num, room->capacity_used_for_storage, room->used_capacity);
+        }
+        return true;
+    }
+    // Books and crates are repositioned only if they're in walls or exceed room capacity;
+    // if none of these happen, adding new slabs is just adding items stored on them
+    if (room->total_capacity < rcount->total_capacity) {
+        return false;
+    }
+    long used_capacity;
+    unsigned long k;
+    used_capacity = room->used_capacity;
+    k = 0;
+    while (slb_num > 0)
+    {
+        if (room_slab_or_around_has_items_in_wall(room, cb, slb_num)) {
+            return false;
+        }
+        used_capacity += count_stored_items_on_room_slab(room, cb, slb_num, NULL, NULL);
+        slb_num = get_next_slab_number_in_room(slb_num);
+        k++;
+        if (k > room->slabs_count)
+        {
+            ERRORLOG("Infinite loop detected when sweeping room slabs");
+            return false;
+        }
+    }
+    if (used_capacity > room->total_capacity) {
+        return false;
+    }
+    room->used_capacity = used_capacity;
+    room->capacity_used_for_storage = used_capacity;
+    return true;
+}
+
+#if (BFDEBUG_LEVEL > 7)
+/**
+ * Compares incrementally updated storage counters of a room with items really stored on its slabs.
+ * Only in heavylog builds, as it sweeps all room slabs which the incremental update is to avoid.
+ */
+static void verify_room_contents_count(const struct Room *room, Room_Update_Func cb)
+{
+    long used_capacity;
+    GoldAmount gold_amount;
+    unsigned long k;
+    long i;
+    used_capacity = 0;
+    gold_amount = 0;
+    k = 0;
+    i = room->slabs_list;
+    while (i > 0)
+    {
+        used_capacity += count_stored_items_on_room_slab(room, cb, i, &gold_amount, NULL);
+        i = get_next_slab_number_in_room(i);
+        k++;
+        if (k > room->slabs_count)
+        {
+            ERRORLOG("Infinite loop detected when sweeping room slabs");
+            break;
+        }
+    }
+    if (cb != count_gold_hoardes_in_room) {
+        gold_amount = used_capacity;
+    }
+    if ((used_capacity != room->used_capacity) || (gold_amount != room->capacity_used_for_storage))
+    {
+        ERRORLOG("The %s index %d counters are %d/%d, but stored items are %d/%d",room_code_name(room->kind),(int)room->index,
+            (int)room->used_capacity,(int)room->capacity_used_for_storage,(int)used_capacity,(int)gold_amount);
+    }
+}
+#endif
+
 TbBool update_room_contents(struct Room *room)
 {
     struct RoomData *rdata;
@@ -2510,8 +2814,23 @@ TbBool update_room_contents(struct Room *room)
     rdata = room_data_get_for_room(room);
     SYNCDBG(17,"Starting for %s index %d",room_code_name(room->kind),(int)room->index);
     cb = rdata->update_storage_in_room;
-    if (cb != NULL) {
-        cb(room);
+    if (cb != NULL)
+    {
+        if (!room_contents_count_supported(cb))
+        {
+            cb(room);
+        } else
+        if (update_room_contents_on_new_slabs(room, cb))
+        {
+#if (BFDEBUG_LEVEL > 7)
+            verify_room_contents_count(room, cb);
+#endif
+            remember_room_contents_count(room);
+        } else
+        {
+            cb(room);
+            remember_room_contents_count(room);
+        }
     }
     cb = rdata->update_workers_in_room;
     if (cb != NULL) {
@@ -3098,20 +3417,121 @@ TbBool find_first_valid_position_for_thing_anywhere_in_room(const struct Thing *
     return false;
 }
 
-struct Room *find_nearest_room_for_thing_with_spare_capacity(struct Thing *thing, signed char owner, RoomKind rkind, unsigned char nav_flags, long spare)
+/** Amount of entries in the rooms reachability memo; needs to be power of 2. */
+#define ROOM_REACH_MEMO_SIZE 512
+
+/**
+ * Remembers whether a thing can reach a room, for the current game turn.
+ * Job finding functions often first count the rooms where a creature can get, and then
+ * select one of them, which would check the same routes twice.
+ */
+struct RoomReachMemo {
+    GameTurn turn;
+    SubtlCodedCoords thing_stl;
+    ThingIndex thing_idx;
+    RoomIndex room_idx;
+    /** Amount of room slabs, so that a room which has changed is checked again. */
+    unsigned short room_slabs;
+    unsigned char nav_flags;
+    TbBool reachable;
+};
+
+struct RoomCandidate {
+    RoomIndex room_idx;
+    long distance;
+};
+
+static struct RoomReachMemo room_reach_memo[ROOM_REACH_MEMO_SIZE];
+
+void clear_rooms_reachability_memo(void)
 {
-    struct Dungeon *dungeon;
-    struct Room *nearoom;
-    long neardistance,distance;
+    LbMemorySet(room_reach_memo, 0, sizeof(room_reach_memo));
+}
+
+/**
+ * Checks if given thing can get to any valid position inside the room.
+ * For creatures, it also checks whether there is a route to that position.
+ * The result is remembered until end of the game turn, or until the thing moves to another subtile
+ * or the room changes its size.
+ */
+static TbBool thing_can_reach_room(struct Thing *thing, struct Room *room, unsigned char nav_flags)
+{
+    struct RoomReachMemo *memo;
     struct Coord3d pos;
+    SubtlCodedCoords thing_stl;
+    thing_stl = get_subtile_number(thing->mappos.x.stl.num, thing->mappos.y.stl.num);
+    memo = &room_reach_memo[(thing->index * 37 + room->index * 5 + nav_flags) & (ROOM_REACH_MEMO_SIZE-1)];
+    if ((memo->turn == game.play_gameturn) && (memo->thing_idx == thing->index) && (memo->room_idx == room->index)
+      && (memo->thing_stl == thing_stl) && (memo->room_slabs == room->slabs_count) && (memo->nav_flags == nav_flags)) {
+        return memo->reachable;
+    }
+    memo->turn = game.play_gameturn;
+    memo->thing_stl = thing_stl;
+    memo->thing_idx = thing->index;
+    memo->room_idx = room->index;
+    memo->room_slabs = room->slabs_count;
+    memo->nav_flags = nav_flags;
+    memo->reachable = false;
+    if (find_first_valid_position_for_thing_anywhere_in_room(thing, room, &pos))
+    {
+        if (!thing_is_creature(thing) || creature_can_navigate_to(thing, &pos, nav_flags)) {
+            memo->reachable = true;
+        }
+    }
+    return memo->reachable;
+}
+
+/**
+ * Sorts room candidates by distance. Candidates with equal distance stay in the order
+ * they were added in, which is the order of rooms list.
+ */
+static void sort_room_candidates_by_distance(struct RoomCandidate *cands, long count)
+{
+    struct RoomCandidate cand;
+    long i,n;
+    for (i=1; i < count; i++)
+    {
+        cand = cands[i];
+        for (n=i; (n > 0) && (cands[n-1].distance > cand.distance); n--) {
+            cands[n] = cands[n-1];
+        }
+        cands[n] = cand;
+    }
+}
 
+/**
+ * Returns the first room from sorted candidates which the thing can reach.
+ */
+static struct Room *find_first_room_candidate_thing_can_reach(struct Thing *thing, struct RoomCandidate *cands, long count, unsigned char nav_flags)
+{
+    struct Room *room;
+    long i;
+    sort_room_candidates_by_distance(cands, count);
+    for (i=0; i < count; i++)
+    {
+        room = room_get(cands[i].room_idx);
+        if (thing_can_reach_room(thing, room, nav_flags)) {
+            return room;
+        }
+    }
+    return INVALID_ROOM;
+}
+
+/**
+ * Finds nearest room of given kind and owner which has given spare capacity, and which the thing can reach.
+ * Only rooms with enough capacity are checked for reachability, nearest first.
+ */
+struct Room *find_nearest_room_for_thing_with_spare_capacity(struct Thing *thing, signed char owner, RoomKind rkind, unsigned char nav_flags, long spare)
+{
+    struct Dungeon *dungeon;
+    struct RoomCandidate cands[ROOMS_COUNT];
+    long cands_count;
     struct Room *room;
     unsigned long k;
     int i;
     SYNCDBG(18,"Searching for %s with capacity for %s index %d",room_code_name(rkind),thing_model_name(thing),(int)thing->index);
     dungeon = get_dungeon(owner);
-    nearoom = INVALID_ROOM;
-    neardistance = LONG_MAX;
+    cands_count = 0;
     k = 0;
     i = dungeon->room_kind[rkind];
     while (i != 0)
@@ -3124,30 +3544,23 @@ struct Room *find_nearest_room_for_thing_with_spare_capacity(struct Thing *thing
         }
         i = room->next_of_owner;
         // Per-room code
-        // Compute simplified distance - without use of mul or div
-        distance = abs(thing->mappos.x.stl.num - room->central_stl_x)
-                 + abs(thing->mappos.y.stl.num - room->central_stl_y);
-        if ((neardistance > distance) && (room->used_capacity + spare <= room->total_capacity))
+        if (room->used_capacity + spare <= room->total_capacity)
         {
-            if (find_first_valid_position_for_thing_anywhere_in_room(thing, room, &pos))
-            {
-                if ((thing->class_id != TCls_Creature)
-                  || creature_can_navigate_to(thing, &pos, nav_flags))
-                {
-                    neardistance = distance;
-                    nearoom = room;
-                }
-            }
+            // Compute simplified distance - without use of mul or div
+            cands[cands_count].room_idx = room->index;
+            cands[cands_count].distance = abs(thing->mappos.x.stl.num - room->central_stl_x)
+                 + abs(thing->mappos.y.stl.num - room->central_stl_y);
+            cands_count++;
         }
         // Per-room code ends
         k++;
-        if (k > ROOMS_COUNT)
+        if (k >= ROOMS_COUNT)
         {
           ERRORLOG("Infinite loop detected when sweeping rooms list");
           break;
         }
     }
-    return nearoom;
+    return find_first_room_candidate_thing_can_reach(thing, cands, cands_count, nav_flags);
 }
 
 /**
@@ -3180,13 +3593,9 @@ long count_rooms_with_used_capacity_creature_can_navigate_to(struct Thing *thing
         }
         i = room->next_of_owner;
         // Per-room code
-        struct Coord3d pos;
-        if (find_first_valid_position_for_thing_anywhere_in_room(thing, room, &pos) && (room->used_capacity > 0))
+        if ((room->used_capacity > 0) && thing_can_reach_room(thing, room, nav_flags))
         {
-            if (creature_can_navigate_to(thing, &pos, nav_flags))
-            {
-                count++;
-            }
+            count++;
         }
         // Per-room code ends
         k++;
@@ -3227,16 +3636,12 @@ struct Room *find_nth_room_with_used_capacity_creature_can_navigate_to(struct Th
         }
         i = room->next_of_owner;
         // Per-room code
-        struct Coord3d pos;
-        if (find_first_valid_position_for_thing_anywhere_in_room(thing, room, &pos) && (room->used_capacity > 0))
+        if ((room->used_capacity > 0) && thing_can_reach_room(thing, room, nav_flags))
         {
-            if (creature_can_navigate_to(thing, &pos, nav_flags))
-            {
-                if (n > 0) {
-                    n--;
-                } else {
-                    return room;
-                }
+            if (n > 0) {
+                n--;
+            } else {
+                return room;
             }
         }
         // Per-room code ends
@@ -3344,7 +3749,10 @@ struct Room *find_room_nearest_to_position(PlayerNumber plyr_idx, RoomKind rkind
     return near_room;
 }
 
-long get_room_attractiveness_for_thing(const struct Dungeon *dungeon, const struct Room *room, const struct Thing *thing, RoomRole rrole, int needed_capacity)
+/**
+ * Returns how attractive the room is for the thing, without considering enemies near the thing.
+ */
+static long get_room_attractiveness_for_thing_without_enemies(const struct Dungeon *dungeon, const struct Room *room, const struct Thing *thing, RoomRole rrole, int needed_capacity)
 {
     long salary;
     struct CreatureControl *cctrl;
@@ -3395,14 +3803,23 @@ long get_room_attractiveness_for_thing(const struct Dungeon *dungeon, const stru
             attractiveness += room->efficiency / (ROOM_EFFICIENCY_MAX/16);
         }
     }
-    if (attractiveness > 0)
-    {
-        struct Thing *enmtng;
-        enmtng = get_creature_in_range_who_is_enemy_of_able_to_attack_and_not_specdigger(thing->mappos.x.val, thing->mappos.y.val, 10, thing->owner);
-        if (!thing_is_invalid(enmtng)) {
-            // A room with enemies inside is very unattractive, but still possible to select
-            attractiveness = 1;
-        }
+    return attractiveness;
+}
+
+static TbBool thing_has_enemy_nearby(const struct Thing *thing)
+{
+    struct Thing *enmtng;
+    enmtng = get_creature_in_range_who_is_enemy_of_able_to_attack_and_not_specdigger(thing->mappos.x.val, thing->mappos.y.val, 10, thing->owner);
+    return !thing_is_invalid(enmtng);
+}
+
+long get_room_attractiveness_for_thing(const struct Dungeon *dungeon, const struct Room *room, const struct Thing *thing, RoomRole rrole, int needed_capacity)
+{
+    long attractiveness;
+    attractiveness = get_room_attractiveness_for_thing_without_enemies(dungeon, room, thing, rrole, needed_capacity);
+    if ((attractiveness > 0) && thing_has_enemy_nearby(thing)) {
+        // A room with enemies inside is very unattractive, but still possible to select
+        attractiveness = 1;
     }
     return attractiveness;
 }
@@ -3411,8 +3828,11 @@ struct Room *get_room_of_given_role_for_thing(const struct Thing *thing, const s
 {
     struct Room *retroom;
     long retdist;
+    int enemy_nearby;
     retdist = LONG_MAX;
     retroom = INVALID_ROOM;
+    // Enemies are searched near the thing, so the result is the same for all rooms; -1 means not checked yet
+    enemy_nearby = -1;
     RoomKind rkind;
     for (rkind=0; rkind < slab_conf.room_types_count; rkind++)
     {
@@ -3435,9 +3855,13 @@ struct Room *get_room_of_given_role_for_thing(const struct Thing *thing, const s
             i = room->next_of_owner;
             // Per-room code
             long attractiveness;
-            attractiveness = get_room_attractiveness_for_thing(dungeon, room, thing, rrole & get_room_roles(room->kind), needed_capacity);
+            attractiveness = get_room_attractiveness_for_thing_without_enemies(dungeon, room, thing, rrole & get_room_roles(room->kind), needed_capacity);
             if (attractiveness > 0)
             {
+                if (enemy_nearby < 0)
+                    enemy_nearby = thing_has_enemy_nearby(thing);
+                if (enemy_nearby)
+                    attractiveness = 1;
                 long dist;
                 dist =  abs(thing->mappos.y.stl.num - (int)room->central_stl_y);
                 dist += abs(thing->mappos.x.stl.num - (int)room->central_stl_x);
@@ -3491,13 +3915,9 @@ long count_rooms_for_thing(struct Thing *thing, PlayerNumber owner, RoomKind rki
         }
         i = room->next_of_owner;
         // Per-room code
-        struct Coord3d pos;
-        if (find_first_valid_position_for_thing_anywhere_in_room(thing, room, &pos))
+        if (thing_can_reach_room(thing, room, nav_flags))
         {
-            if (!thing_is_creature(thing) || creature_can_navigate_to(thing, &pos, nav_flags))
-            {
-                count++;
-            }
+            count++;
         }
         // Per-room code ends
         k++;
@@ -3538,16 +3958,12 @@ struct Room *find_nth_room_for_thing(struct Thing *thing, PlayerNumber owner, Ro
         }
         i = room->next_of_owner;
         // Per-room code
-        struct Coord3d pos;
-        if (find_first_valid_position_for_thing_anywhere_in_room(thing, room, &pos))
+        if (thing_can_reach_room(thing, room, nav_flags))
         {
-            if (!thing_is_creature(thing) || creature_can_navigate_to(thing, &pos, nav_flags))
-            {
-                if (n > 0) {
-                    n--;
-                } else {
-                    return room;
-                }
+            if (n > 0) {
+                n--;
+            } else {
+                return room;
             }
         }
         // Per-room code ends
@@ -3604,13 +4020,9 @@ long count_rooms_for_thing_with_spare_room_item_capacity(struct Thing *thing, Pl
         }
         i = room->next_of_owner;
         // Per-room code
-        struct Coord3d pos;
-        if (find_first_valid_position_for_thing_anywhere_in_room(thing, room, &pos) && (room->total_capacity > room->capacity_used_for_storage))
+        if ((room->total_capacity > room->capacity_used_for_storage) && thing_can_reach_room(thing, room, nav_flags))
         {
-            if (!thing_is_creature(thing) || creature_can_navigate_to(thing, &pos, nav_flags))
-            {
-                count++;
-            }
+            count++;
         }
         // Per-room code ends
         k++;
@@ -3651,16 +4063,12 @@ struct Room *find_nth_room_for_thing_with_spare_room_item_capacity(struct Thing
         }
         i = room->next_of_owner;
         // Per-room code
-        struct Coord3d pos;
-        if (find_first_valid_position_for_thing_anywhere_in_room(thing, room, &pos) && (room->total_capacity > room->capacity_used_for_storage))
+        if ((room->total_capacity > room->capacity_used_for_storage) && thing_can_reach_room(thing, room, nav_flags))
         {
-            if (!thing_is_creature(thing) || creature_can_navigate_to(thing, &pos, nav_flags))
-            {
-                if (n > 0) {
-                    n--;
-                } else {
-                    return room;
-                }
+            if (n > 0) {
+                n--;
+            } else {
+                return room;
             }
         }
         // Per-room code ends
@@ -3905,7 +4313,10 @@ void kill_room_contents_at_subtile(struct Room *room, PlayerNumber plyr_idx, Map
                     create_effect(&pos, TngEff_Unknown56, thing->owner);
                     struct Room *nxroom;
                     nxroom = get_room_thing_is_on(thing);
-                    update_room_contents(nxroom);
+                    if (!add_item_to_room_capacity(nxroom, true)) {
+                        invalidate_room_contents_count(nxroom);
+                        update_room_contents(nxroom);
+                    }
                 } else
                 // Cannot store the spellbook anywhere - remove the spell
                 {
@@ -3957,7 +4368,10 @@ void kill_room_contents_at_subtile(struct Room *room, PlayerNumber plyr_idx, Map
                     create_effect(&pos, TngEff_Unknown56, thing->owner);
                     struct Room *nxroom;
                     nxroom = get_room_thing_is_on(thing);
-                    update_room_contents(nxroom);
+                    if (!add_item_to_room_capacity(nxroom, true)) {
+                        invalidate_room_contents_count(nxroom);
+                        update_room_contents(nxroom);
+                    }
                 } else
                 // Cannot store the crate anywhere - remove it
                 {
@@ -4227,15 +4641,13 @@ struct Room *place_room(PlayerNumber owner, RoomKind rkind, MapSubtlCoord stl_x,
 
 struct Room *find_nearest_room_for_thing_with_spare_item_capacity(struct Thing *thing, PlayerNumber plyr_idx, RoomKind rkind, unsigned char nav_flags)
 {
-    long retdist;
-    struct Room *retroom;
-    retdist = LONG_MAX;
-    retroom = INVALID_ROOM;
-
+    struct RoomCandidate cands[ROOMS_COUNT];
+    long cands_count;
     struct Dungeon *dungeon;
     long i;
     unsigned long k;
     dungeon = get_dungeon(plyr_idx);
+    cands_count = 0;
     i = dungeon->room_kind[rkind];
     k = 0;
     while (i != 0)
@@ -4249,29 +4661,21 @@ struct Room *find_nearest_room_for_thing_with_spare_item_capacity(struct Thing *
         }
         i = room->next_of_owner;
         // Per-room code
-        long dist;
-        dist = abs(thing->mappos.x.stl.num - room->central_stl_x) + abs(thing->mappos.y.stl.num - room->central_stl_y);
-        if ((dist < retdist) && (room->total_capacity > room->capacity_used_for_storage))
+        if (room->total_capacity > room->capacity_used_for_storage)
         {
-            struct Coord3d pos;
-            if (find_first_valid_position_for_thing_anywhere_in_room(thing, room, &pos))
-            {
-                if (!thing_is_creature(thing) || creature_can_navigate_to(thing, &pos, nav_flags))
-                {
-                    retdist = dist;
-                    retroom = room;
-                }
-            }
+            cands[cands_count].room_idx = room->index;
+            cands[cands_count].distance = abs(thing->mappos.x.stl.num - room->central_stl_x) + abs(thing->mappos.y.stl.num - room->central_stl_y);
+            cands_count++;
         }
         // Per-room code ends
         k++;
-        if (k > ROOMS_COUNT)
+        if (k >= ROOMS_COUNT)
         {
             ERRORLOG("Infinite loop detected when sweeping rooms list");
             break;
         }
     }
-    return retroom;
+    return find_first_room_candidate_thing_can_reach(thing, cands, cands_count, nav_flags);
 }
 
 struct Room * pick_random_room(PlayerNumber plyr_idx, RoomKind rkind)
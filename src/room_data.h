@@ -186,6 +186,9 @@ struct RoomStats *room_stats_get_for_room(const struct Room *room);
 
 long get_room_look_through(RoomKind rkind);
 long compute_room_max_health(long slabs_count,unsigned short efficiency);
+void clear_rooms_reachability_memo(void);
+void clear_rooms_contents_count(void);
+void invalidate_room_contents_count(const struct Room *room);
 void set_room_efficiency(struct Room *room);
 void set_room_capacity(struct Room *room, TbBool skip_integration);
 long get_room_slabs_count(PlayerNumber plyr_idx, RoomKind rkind);
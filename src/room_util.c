@@ -182,6 +182,7 @@ void kill_all_room_slabs_and_contents(struct Room *room)
     }
     room->slabs_list = 0;
     room->slabs_count = 0;
+    invalidate_room_contents_count(room);
 }
 
 void sell_room_slab_when_no_free_room_structures(struct Room *room, long slb_x, long slb_y, unsigned char gnd_slab)
@@ -271,6 +272,7 @@ void recreate_rooms_from_room_slabs(struct Room *room, unsigned char gnd_slab)
     // The old room no longer has any slabs
     room->slabs_list = 0;
     room->slabs_count = 0;
+    invalidate_room_contents_count(room);
 }
 
 TbBool delete_room_slab(MapSlabCoord slb_x, MapSlabCoord slb_y, unsigned char is_destroyed)
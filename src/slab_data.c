@@ -477,6 +477,7 @@ void update_map_collide(SlabKind slbkind, MapSubtlCoord stl_x, MapSubtlCoord stl
     }
     mapblk->flags &= (SlbAtFlg_Unk80|SlbAtFlg_Unk04);
     mapblk->flags |= nflags;
+    map_solidity_changed_at(mapblk);
 }
 
 void do_slab_efficiency_alteration(MapSlabCoord slb_x, MapSlabCoord slb_y)
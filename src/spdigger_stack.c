@@ -21,6 +21,8 @@
 #include "globals.h"
 #include "bflib_basics.h"
 #include "bflib_math.h"
+#include "bflib_memory.h"
+#include "bflib_datetm.h"
 
 #include "creature_states.h"
 #include "creature_states_train.h"
@@ -43,6 +45,7 @@
 #include "power_hand.h"
 #include "map_utils.h"
 #include "map_events.h"
+#include "engine_camera.h"
 #include "ariadne_wallhug.h"
 #include "gui_soundmsgs.h"
 #include "front_simple.h"
@@ -64,6 +67,15 @@ DLLIMPORT long _DK_imp_will_soon_be_converting_at_excluding(struct Thing *creatn
 DLLIMPORT long _DK_imp_already_reinforcing_at_excluding(struct Thing *creatng, long stl_x, long stl_y);
 /******************************************************************************/
 long const dig_pos[] = {0, -1, 1};
+/**
+ * Amount of game turns after which the digger stack is rebuilt from scratch.
+ * Dig, claim, dead body and gold pile tasks are pushed into the stack when they
+ * appear; unconscious bodies, spellbooks, crates and reinforce tasks are only
+ * found by the rebuild, so the period can't be any longer.
+ */
+#define DIGGER_STACK_REBUILD_PERIOD 128
+/** Amount of dropped gold piles which can wait for the digger stack update of one player. */
+#define DIGGER_PENDING_GOLD_PILES 16
 
 /******************************************************************************/
 /**
@@ -132,7 +144,7 @@ long find_in_imp_stack_task_other_than_starting_at(SpDiggerTaskType excl_task_ty
     {
         const struct DiggerStack *dstack;
         dstack = &dungeon->digger_stack[n];
-        if (dstack->task_type != excl_task_type) {
+        if ((dstack->task_type != excl_task_type) && (dstack->task_type != DigTsk_None)) {
             return n;
         }
         n = (n+1) % stack_len;
@@ -158,6 +170,198 @@ long find_in_imp_stack_starting_at(SpDiggerTaskType task_type, long start_pos, c
     return -1;
 }
 
+/******************************************************************************/
+/**
+ * Priority rank of digger task types; lower rank is more important.
+ * Follows the order in which imp_stack_update() fills the stack, and is used
+ * to select an entry to be replaced when a task is pushed into full stack.
+ */
+static const unsigned char digger_task_rank[] = {
+    255, // DigTsk_None
+      7, // DigTsk_ImproveDungeon
+      7, // DigTsk_ConvertDungeon
+      8, // DigTsk_ReinforceWall
+      0, // DigTsk_PickUpUnconscious
+      1, // DigTsk_PickUpCorpse
+      2, // DigTsk_PicksUpSpellBook
+      3, // DigTsk_PicksUpCrateToArm
+      6, // DigTsk_PicksUpCrateForWorkshop
+      4, // DigTsk_DigOrMine
+      5, // DigTsk_PicksUpGoldPile
+};
+
+struct DiggerStackStats {
+    unsigned long rebuilds;
+    TbClockUSec rebuild_time_total;
+    TbClockUSec rebuild_time_max;
+    unsigned long tasks_rebuilt;
+    unsigned long tasks_pushed;
+    unsigned long tasks_replaced;
+    unsigned long tasks_retired;
+};
+
+static struct DiggerStackStats digger_stack_stats[DUNGEONS_COUNT];
+
+/**
+ * Tasks which wait for the next digger stack update of a player.
+ * Checking if a gold pile can be reached needs route finding, so it isn't done
+ * when the gold is dropped, but when one of the player diggers looks for a task.
+ */
+struct DiggerStackPending {
+    ThingIndex gold_piles[DIGGER_PENDING_GOLD_PILES];
+    unsigned short gold_piles_num;
+    /** Set if more gold piles were dropped than could be stored; all gold is then searched. */
+    TbBool gold_piles_overflow;
+};
+
+static struct DiggerStackPending digger_stack_pending[DUNGEONS_COUNT];
+
+static struct DiggerStackStats *get_digger_stack_stats(const struct Dungeon *dungeon)
+{
+    if ((dungeon->owner < 0) || (dungeon->owner >= DUNGEONS_COUNT))
+        return &digger_stack_stats[0];
+    return &digger_stack_stats[dungeon->owner];
+}
+
+static unsigned char get_digger_task_rank(SpDiggerTaskType task_type)
+{
+    if ((task_type < 0) || (task_type >= sizeof(digger_task_rank)/sizeof(digger_task_rank[0])))
+        return 255;
+    return digger_task_rank[task_type];
+}
+
+/**
+ * Returns distance between given subtile and the dungeon heart, used to prioritize tasks of the same rank.
+ */
+static MapCoordDelta get_digger_task_distance_to_heart(const struct Dungeon *dungeon, SubtlCodedCoords stl_num)
+{
+    struct Thing *heartng;
+    heartng = thing_get(dungeon->dnheart_idx);
+    if (thing_is_invalid(heartng))
+        return 0;
+    return get_2d_box_distance_xy(subtile_coord_center(stl_num_decode_x(stl_num)), subtile_coord_center(stl_num_decode_y(stl_num)),
+        heartng->mappos.x.val, heartng->mappos.y.val);
+}
+
+/**
+ * Finds position in full digger stack where a new task could be stored.
+ * The task replaces unused entry, or an entry of lower priority - less important
+ * task type, or the same type but further from the dungeon heart.
+ * @return Position in the stack, or -1 if the new task is less important than all stored ones.
+ */
+static long find_imp_stack_position_to_replace(const struct Dungeon *dungeon, SubtlCodedCoords stl_num, SpDiggerTaskType task_type)
+{
+    const struct DiggerStack *dstack;
+    unsigned char rank, worst_rank;
+    MapCoordDelta dist, worst_dist;
+    long i, worst_pos;
+    rank = get_digger_task_rank(task_type);
+    dist = get_digger_task_distance_to_heart(dungeon, stl_num);
+    worst_pos = -1;
+    worst_rank = rank;
+    worst_dist = dist;
+    for (i=0; i < dungeon->digger_stack_length; i++)
+    {
+        dstack = &dungeon->digger_stack[i];
+        if (dstack->task_type == DigTsk_None)
+            return i;
+        if (get_digger_task_rank(dstack->task_type) < worst_rank)
+            continue;
+        if (get_digger_task_rank(dstack->task_type) == worst_rank)
+        {
+            MapCoordDelta n;
+            n = get_digger_task_distance_to_heart(dungeon, dstack->stl_num);
+            if (n <= worst_dist)
+                continue;
+            worst_dist = n;
+        } else
+        {
+            worst_rank = get_digger_task_rank(dstack->task_type);
+            worst_dist = get_digger_task_distance_to_heart(dungeon, dstack->stl_num);
+        }
+        worst_pos = i;
+    }
+    return worst_pos;
+}
+
+/**
+ * Pushes a new task into digger stack without waiting for the stack rebuild.
+ * If the task is already on the stack, nothing is changed. The task is appended
+ * at end of the stack, so that diggers which are going through the stack will
+ * find it; if the stack is full, unused or less important entry is replaced.
+ * @return True if the task is on the stack after the call.
+ */
+TbBool imp_stack_push_task(struct Dungeon *dungeon, SubtlCodedCoords stl_num, SpDiggerTaskType task_type)
+{
+    struct DiggerStackStats *stats;
+    struct DiggerStack *dstack;
+    long i;
+    if (find_in_imp_stack_using_pos(stl_num, task_type, dungeon) >= 0)
+        return true;
+    stats = get_digger_stack_stats(dungeon);
+    if (dungeon->digger_stack_length < DIGGER_TASK_MAX_COUNT)
+    {
+        add_to_imp_stack_using_pos(stl_num, task_type, dungeon);
+        stats->tasks_pushed++;
+        return true;
+    }
+    i = find_imp_stack_position_to_replace(dungeon, stl_num, task_type);
+    if (i < 0)
+        return false;
+    SYNCDBG(19,"Task %d at %d,%d replaces type %d",(int)task_type,(int)stl_num_decode_x(stl_num),(int)stl_num_decode_y(stl_num),
+        (int)dungeon->digger_stack[i].task_type);
+    dstack = &dungeon->digger_stack[i];
+    dstack->stl_num = stl_num;
+    dstack->task_type = task_type;
+    stats->tasks_pushed++;
+    stats->tasks_replaced++;
+    return true;
+}
+
+/**
+ * Removes task from digger stack without waiting for the stack rebuild.
+ * The entry is only marked as unused, so positions of diggers within the stack stay valid.
+ * @return Amount of retired entries.
+ */
+long imp_stack_retire_task(struct Dungeon *dungeon, SubtlCodedCoords stl_num, SpDiggerTaskType task_type)
+{
+    long i, n;
+    n = 0;
+    for (i=0; i < dungeon->digger_stack_length; i++)
+    {
+        struct DiggerStack *dstack;
+        dstack = &dungeon->digger_stack[i];
+        if ((dstack->stl_num == stl_num) && (dstack->task_type == task_type)) {
+            dstack->task_type = DigTsk_None;
+            n++;
+        }
+    }
+    get_digger_stack_stats(dungeon)->tasks_retired += n;
+    return n;
+}
+
+/**
+ * Logs statistics of digger stacks and clears them, together with tasks waiting for stack update.
+ * To be called when a level is left.
+ */
+void clear_digger_stack_side_data(void)
+{
+    struct DiggerStackStats *stats;
+    long i;
+    for (i=0; i < DUNGEONS_COUNT; i++)
+    {
+        stats = &digger_stack_stats[i];
+        if (stats->rebuilds > 0)
+        {
+            SYNCMSG("Player %d digger stack: %lu rebuilds taking %lu us on average and %lu us max, %lu tasks rebuilt, %lu pushed (%lu replaced), %lu retired",
+                (int)i, stats->rebuilds, (unsigned long)(stats->rebuild_time_total / stats->rebuilds), (unsigned long)stats->rebuild_time_max,
+                stats->tasks_rebuilt, stats->tasks_pushed, stats->tasks_replaced, stats->tasks_retired);
+        }
+    }
+    LbMemorySet(digger_stack_stats, 0, sizeof(digger_stack_stats));
+    LbMemorySet(digger_stack_pending, 0, sizeof(digger_stack_pending));
+}
+
 void remove_task_from_all_other_players_digger_stacks(PlayerNumber skip_plyr_idx, MapSubtlCoord stl_x, MapSubtlCoord stl_y)
 {
     PlayerNumber plyr_idx;
@@ -932,57 +1136,35 @@ long get_random_mining_undug_area_position_for_digger_drop(PlayerNumber plyr_idx
 }
 
 #define UNDUG_MAX_DIST 24
+/**
+ * Finds the nearest dig task which given digger can work on, and a position to dig it from.
+ * Tasks are taken from the tasks spatial index sorted by distance, so that the costly
+ * reachability check is only done until the first matching task is found.
+ * @return Index of the task in tasks list, or -1 if there's no matching task.
+ */
 long get_nearest_undug_area_position_for_digger(struct Thing *thing, MapSubtlCoord *retstl_x, MapSubtlCoord *retstl_y)
 {
     struct CreatureControl *cctrl;
-    struct Dungeon *dungeon;
-    dungeon = get_dungeon(thing->owner);
     cctrl = creature_control_get_from_thing(thing);
-    struct MapTask *mtask;
-    long i,tsk_max;
-    tsk_max = dungeon->field_AF7;
-    if (tsk_max > MAPTASKS_COUNT)
-        tsk_max = MAPTASKS_COUNT;
     MapSubtlCoord digstl_y, digstl_x;
     digstl_x = stl_num_decode_x(cctrl->digger.task_stl);
     digstl_y = stl_num_decode_y(cctrl->digger.task_stl);
-    MapSubtlCoord best_dist;
-    MapSubtlCoord best_stl_x, best_stl_y;
-    int best_tsk_id;
-    best_dist = UNDUG_MAX_DIST;
-    best_tsk_id = -1;
-    best_stl_x = -1;
-    best_stl_y = -1;
-    for (i=0; i < tsk_max; i++)
-    {
-        mtask = &dungeon->task_list[i];
-        if (mtask->kind == SDDigTask_None)
-            continue;
-        if (mtask->kind != SDDigTask_Unknown3)
+    long task_idxs[MAPTASKS_COUNT];
+    long i,n;
+    n = find_dig_tasks_near_from_task_list(thing->owner, digstl_x, digstl_y, UNDUG_MAX_DIST, task_idxs, MAPTASKS_COUNT);
+    for (i=0; i < n; i++)
+    {
+        struct MapTask *mtask;
+        MapSubtlCoord tsk_stl_x,tsk_stl_y;
+        mtask = get_task_list_entry(thing->owner, task_idxs[i]);
+        if (check_place_to_dig_and_get_position(thing, mtask->coords, &tsk_stl_x, &tsk_stl_y))
         {
-            SubtlCodedCoords tsk_stl_num;
-            MapSubtlCoord tsk_dist;
-            tsk_stl_num = mtask->coords;
-            tsk_dist = get_2d_box_distance_xy(digstl_x, digstl_y, stl_num_decode_x(tsk_stl_num), stl_num_decode_y(tsk_stl_num));
-            if (tsk_dist < best_dist)
-            {
-                MapSubtlCoord tsk_stl_x,tsk_stl_y;
-                if (check_place_to_dig_and_get_position(thing, tsk_stl_num, &tsk_stl_x, &tsk_stl_y))
-                {
-                    best_dist = tsk_dist;
-                    best_tsk_id = i;
-                    best_stl_x = tsk_stl_x;
-                    best_stl_y = tsk_stl_y;
-                }
-            }
+            *retstl_x = tsk_stl_x;
+            *retstl_y = tsk_stl_y;
+            return task_idxs[i];
         }
     }
-    if (best_dist >= UNDUG_MAX_DIST) {
-        return -1;
-    }
-    *retstl_x = best_stl_x;
-    *retstl_y = best_stl_y;
-    return best_tsk_id;
+    return -1;
 }
 #undef UNDUG_MAX_DIST
 
@@ -1118,9 +1300,12 @@ long add_to_reinforce_stack_if_need_to(long slb_x, long slb_y, struct Dungeon *d
     return (r_stackpos < DIGGER_TASK_MAX_COUNT - dungeon->digger_stack_length);
 }
 
-long add_to_pretty_to_imp_stack_if_need_to(long slb_x, long slb_y, struct Dungeon *dungeon, int *remain_num)
+/**
+ * Returns the kind of task which diggers of given dungeon should perform to pretty or convert given slab.
+ * @return DigTsk_ImproveDungeon, DigTsk_ConvertDungeon, or DigTsk_None if the slab needs no work.
+ */
+static SpDiggerTaskType get_pretty_task_for_slab(const struct Dungeon *dungeon, MapSlabCoord slb_x, MapSlabCoord slb_y)
 {
-    //return _DK_add_to_pretty_to_imp_stack_if_need_to(slb_x, slb_y, dungeon);
     MapSubtlCoord stl_x, stl_y;
     stl_x = slab_subtile_center(slb_x);
     stl_y = slab_subtile_center(slb_y);
@@ -1129,8 +1314,7 @@ long add_to_pretty_to_imp_stack_if_need_to(long slb_x, long slb_y, struct Dungeo
     if (slb->kind == SlbT_PATH)
     {
         if (subtile_revealed(stl_x, stl_y, dungeon->owner) && slab_by_players_land(dungeon->owner, slb_x, slb_y)) {
-            (*remain_num)--;
-            return add_to_imp_stack_using_pos(get_subtile_number_at_slab_center(slb_x, slb_y), DigTsk_ImproveDungeon, dungeon);
+            return DigTsk_ImproveDungeon;
         }
     } else
     if ((slb->kind == SlbT_CLAIMED) || slab_kind_is_room(slb->kind))
@@ -1138,11 +1322,23 @@ long add_to_pretty_to_imp_stack_if_need_to(long slb_x, long slb_y, struct Dungeo
         if (!players_are_mutual_allies(dungeon->owner, slabmap_owner(slb)))
         {
             if (subtile_revealed(stl_x, stl_y, dungeon->owner) && slab_by_players_land(dungeon->owner, slb_x, slb_y)) {
-                (*remain_num)--;
-                return add_to_imp_stack_using_pos(get_subtile_number_at_slab_center(slb_x, slb_y), DigTsk_ConvertDungeon, dungeon);
+                return DigTsk_ConvertDungeon;
             }
         }
     }
+    return DigTsk_None;
+}
+
+long add_to_pretty_to_imp_stack_if_need_to(long slb_x, long slb_y, struct Dungeon *dungeon, int *remain_num)
+{
+    //return _DK_add_to_pretty_to_imp_stack_if_need_to(slb_x, slb_y, dungeon);
+    SpDiggerTaskType task_type;
+    task_type = get_pretty_task_for_slab(dungeon, slb_x, slb_y);
+    if (task_type != DigTsk_None)
+    {
+        (*remain_num)--;
+        return add_to_imp_stack_using_pos(get_subtile_number_at_slab_center(slb_x, slb_y), task_type, dungeon);
+    }
     return (dungeon->digger_stack_length < DIGGER_TASK_MAX_COUNT);
 }
 
@@ -1439,6 +1635,25 @@ TbBool thing_can_be_picked_to_place_in_player_room(const struct Thing* thing, Pl
     return false;
 }
 
+static TbBool gold_pile_pickable_by_digger(struct Thing *thing, PlayerNumber owner)
+{
+    if (!thing_is_object(thing) || !object_is_gold_pile(thing))
+        return false;
+    // TODO DIGGERS Use thing_can_be_picked_to_place_in_player_room() instead of single conditions
+    //if (thing_can_be_picked_to_place_in_player_room(thing, owner, RoK_TREASURE, TngFRPickF_Default))
+    if (thing_is_picked_up(thing) || thing_is_dragged_or_pulled(thing))
+        return false;
+    if (!thing_revealed(thing, owner))
+        return false;
+    PlayerNumber slb_owner;
+    slb_owner = get_slab_owner_thing_is_on(thing);
+    if ((slb_owner != owner) && (slb_owner != game.neutral_player_num))
+        return false;
+    struct Room *room;
+    room = find_any_navigable_room_for_thing_closer_than(thing, owner, RoK_TREASURE, NavRtF_Default, map_subtiles_x/2 + map_subtiles_y/2);
+    return !room_is_invalid(room);
+}
+
 struct Thing *get_next_unclaimed_gold_thing_pickable_by_digger(PlayerNumber owner, int start_idx)
 {
     struct Thing *thing;
@@ -1452,25 +1667,8 @@ struct Thing *get_next_unclaimed_gold_thing_pickable_by_digger(PlayerNumber owne
             break;
         i = thing->next_of_class;
         // Per-thing code
-        if (thing_is_object(thing) && object_is_gold_pile(thing))
-        {
-            // TODO DIGGERS Use thing_can_be_picked_to_place_in_player_room() instead of single conditions
-            //if (thing_can_be_picked_to_place_in_player_room(thing, owner, RoK_TREASURE, TngFRPickF_Default))
-            if (!thing_is_picked_up(thing) && !thing_is_dragged_or_pulled(thing))
-            {
-                  if (thing_revealed(thing, owner))
-                  {
-                      PlayerNumber slb_owner;
-                      slb_owner = get_slab_owner_thing_is_on(thing);
-                      if ((slb_owner == owner) || (slb_owner == game.neutral_player_num)) {
-                          struct Room *room;
-                          room = find_any_navigable_room_for_thing_closer_than(thing, owner, RoK_TREASURE, NavRtF_Default, map_subtiles_x/2 + map_subtiles_y/2);
-                          if (!room_is_invalid(room)) {
-                              return thing;
-                          }
-                      }
-                }
-            }
+        if (gold_pile_pickable_by_digger(thing, owner)) {
+            return thing;
         }
         // Per-thing code ends
         k++;
@@ -1590,6 +1788,15 @@ int add_unclaimed_unconscious_bodies_to_imp_stack(struct Dungeon *dungeon, int m
     return (max_tasks-remain_num);
 }
 
+static TbBool dead_body_pickable_by_digger(const struct Thing *thing, PlayerNumber owner)
+{
+    if (thing_is_dragged_or_pulled(thing) || (thing->active_state != DCrSt_Unknown02))
+        return false;
+    if ((thing->byte_14 != 0) || !corpse_is_rottable(thing))
+        return false;
+    return thing_revealed(thing, owner);
+}
+
 int add_unclaimed_dead_bodies_to_imp_stack(struct Dungeon *dungeon, int max_tasks)
 {
     struct Thing *thing;
@@ -1621,23 +1828,19 @@ int add_unclaimed_dead_bodies_to_imp_stack(struct Dungeon *dungeon, int max_task
         if ( (dungeon->digger_stack_length >= DIGGER_TASK_MAX_COUNT) || (remain_num <= 0) ) {
             break;
         }
-        if (!thing_is_dragged_or_pulled(thing) && (thing->active_state == DCrSt_Unknown02)
-           && (thing->byte_14 == 0) && corpse_is_rottable(thing))
+        if (dead_body_pickable_by_digger(thing, dungeon->owner))
         {
-            if (thing_revealed(thing, dungeon->owner))
+            if (room_is_invalid(room))
             {
-                if (room_is_invalid(room))
-                {
-                    // Check why the room search failed and inform the player
-                    update_cannot_find_room_wth_spare_capacity_event(dungeon->owner, thing, RoK_GRAVEYARD);
-                    return 0;
-                }
-                stl_num = get_subtile_number(thing->mappos.x.stl.num,thing->mappos.y.stl.num);
-                if (!add_to_imp_stack_using_pos(stl_num, DigTsk_PickUpCorpse, dungeon)) {
-                    break;
-                }
-                remain_num--;
+                // Check why the room search failed and inform the player
+                update_cannot_find_room_wth_spare_capacity_event(dungeon->owner, thing, RoK_GRAVEYARD);
+                return 0;
+            }
+            stl_num = get_subtile_number(thing->mappos.x.stl.num,thing->mappos.y.stl.num);
+            if (!add_to_imp_stack_using_pos(stl_num, DigTsk_PickUpCorpse, dungeon)) {
+                break;
             }
+            remain_num--;
         }
         // Per-thing code ends
         k++;
@@ -2394,15 +2597,58 @@ long check_out_imp_last_did(struct Thing *creatng)
   SYNCDBG(9,"No job found");
   return false;
 }
-//Create list of up to 64 tasks. 
+/**
+ * Pushes tasks which were waiting for the stack update into digger stack of given dungeon.
+ */
+static void imp_stack_push_pending_tasks(struct Dungeon *dungeon)
+{
+    struct DiggerStackPending *pending;
+    struct Thing *gldtng;
+    struct Room *room;
+    long i;
+    if ((dungeon->owner < 0) || (dungeon->owner >= DUNGEONS_COUNT))
+        return;
+    pending = &digger_stack_pending[dungeon->owner];
+    if ((pending->gold_piles_num == 0) && (!pending->gold_piles_overflow))
+        return;
+    room = find_room_with_spare_capacity(dungeon->owner, RoK_TREASURE, 1);
+    if (!room_is_invalid(room))
+    {
+        if (pending->gold_piles_overflow) {
+            add_unclaimed_gold_to_imp_stack(dungeon, DIGGER_TASK_MAX_COUNT/3);
+        }
+        for (i=0; i < pending->gold_piles_num; i++)
+        {
+            // The pile might have been picked up or merged since it was dropped
+            gldtng = thing_get(pending->gold_piles[i]);
+            if (thing_exists(gldtng) && gold_pile_pickable_by_digger(gldtng, dungeon->owner)) {
+                imp_stack_push_task(dungeon, get_subtile_number(gldtng->mappos.x.stl.num,gldtng->mappos.y.stl.num), DigTsk_PicksUpGoldPile);
+            }
+        }
+    }
+    pending->gold_piles_num = 0;
+    pending->gold_piles_overflow = false;
+}
+
+/**
+ * Updates digger stack of the dungeon which owns given digger.
+ * Pushes waiting tasks, and rebuilds the stack from scratch if enough time has passed since last rebuild.
+ * @return True if the stack was rebuilt.
+ */
 TbBool imp_stack_update(struct Thing *creatng)
 {
     struct Dungeon *dungeon;
+    struct DiggerStackStats *stats;
+    TbClockUSec start_time;
     SYNCDBG(18,"Starting");
     dungeon = get_dungeon(creatng->owner);
-    if ((game.play_gameturn - dungeon->digger_stack_update_turn) < 128)
+    if ((game.play_gameturn - dungeon->digger_stack_update_turn) < DIGGER_STACK_REBUILD_PERIOD)
+    {
+        imp_stack_push_pending_tasks(dungeon);
         return 0;
+    }
     SYNCDBG(8,"Updating");
+    start_time = LbTimerClockMicro();
     setup_imp_stack(dungeon);
     if (dungeon_invalid(dungeon)) {
         WARNLOG("Played %d has no dungeon",(int)creatng->owner);
@@ -2421,9 +2667,177 @@ TbBool imp_stack_update(struct Thing *creatng)
     add_pretty_and_convert_to_imp_stack(dungeon, DIGGER_TASK_MAX_COUNT*5/8);
     add_unclaimed_gold_to_imp_stack(dungeon, DIGGER_TASK_MAX_COUNT/3);
     add_reinforce_to_imp_stack(dungeon, DIGGER_TASK_MAX_COUNT);
+    stats = get_digger_stack_stats(dungeon);
+    start_time = LbTimerClockMicro() - start_time;
+    stats->rebuilds++;
+    stats->rebuild_time_total += start_time;
+    if (stats->rebuild_time_max < start_time)
+        stats->rebuild_time_max = start_time;
+    stats->tasks_rebuilt += dungeon->digger_stack_length;
+    imp_stack_push_pending_tasks(dungeon);
     return true;
 }
 
+/**
+ * Updates dig task of given dungeon at given slab, after the slab or its surrounding has changed.
+ * Uses the same conditions as add_undug_to_imp_stack() and add_gems_to_imp_stack().
+ */
+static void imp_stack_update_dig_task_at(struct Dungeon *dungeon, MapSlabCoord slb_x, MapSlabCoord slb_y)
+{
+    struct MapTask *mtask;
+    SubtlCodedCoords stl_num;
+    long task_idx;
+    stl_num = get_subtile_number_at_slab_center(slb_x, slb_y);
+    task_idx = find_dig_from_task_list(dungeon->owner, stl_num);
+    if (task_idx < 0)
+        return;
+    mtask = get_dungeon_task_list_entry(dungeon, task_idx);
+    if ((mtask->kind == SDDigTask_None) || (mtask->kind == SDDigTask_Unknown3))
+        return;
+    if (!subtile_revealed(slab_subtile_center(slb_x), slab_subtile_center(slb_y), dungeon->owner))
+        return;
+    if (!block_has_diggable_side(dungeon->owner, slb_x, slb_y))
+        return;
+    imp_stack_push_task(dungeon, stl_num, DigTsk_DigOrMine);
+}
+
+/**
+ * Updates the digger stack of given player after a block was marked for digging.
+ * Called by the tasks list, so that diggers don't have to wait for the stack rebuild.
+ */
+void imp_stack_dig_task_added(PlayerNumber plyr_idx, SubtlCodedCoords stl_num)
+{
+    struct Dungeon *dungeon;
+    dungeon = get_dungeon(plyr_idx);
+    if (dungeon_invalid(dungeon))
+        return;
+    imp_stack_update_dig_task_at(dungeon, subtile_slab_fast(stl_num_decode_x(stl_num)), subtile_slab_fast(stl_num_decode_y(stl_num)));
+}
+
+/**
+ * Updates the digger stack of given player after a block is no longer marked for digging.
+ */
+void imp_stack_dig_task_removed(PlayerNumber plyr_idx, SubtlCodedCoords stl_num)
+{
+    struct Dungeon *dungeon;
+    dungeon = get_dungeon(plyr_idx);
+    if (dungeon_invalid(dungeon))
+        return;
+    imp_stack_retire_task(dungeon, stl_num, DigTsk_DigOrMine);
+}
+
+/**
+ * Updates digger stacks of all players after given slab was dug out, claimed or neutralised.
+ * Pretty and convert tasks of the slab and its neighbours are re-checked, and dig tasks
+ * on neighbouring slabs are added if they became reachable.
+ */
+void imp_stack_slab_changed(MapSlabCoord slb_x, MapSlabCoord slb_y)
+{
+    struct Dungeon *dungeon;
+    PlayerNumber plyr_idx;
+    long n;
+    for (plyr_idx=0; plyr_idx < DUNGEONS_COUNT; plyr_idx++)
+    {
+        dungeon = get_dungeon(plyr_idx);
+        if (dungeon_invalid(dungeon) || (dungeon->num_active_diggers == 0))
+            continue;
+        for (n=0; n < SMALL_AROUND_SLAB_LENGTH+1; n++)
+        {
+            MapSlabCoord sslb_x, sslb_y;
+            SubtlCodedCoords stl_num;
+            SpDiggerTaskType task_type;
+            if (n < SMALL_AROUND_SLAB_LENGTH) {
+                sslb_x = slb_x + small_around[n].delta_x;
+                sslb_y = slb_y + small_around[n].delta_y;
+            } else {
+                sslb_x = slb_x;
+                sslb_y = slb_y;
+            }
+            if ((sslb_x < 0) || (sslb_x >= map_tiles_x) || (sslb_y < 0) || (sslb_y >= map_tiles_y))
+                continue;
+            stl_num = get_subtile_number_at_slab_center(sslb_x, sslb_y);
+            task_type = get_pretty_task_for_slab(dungeon, sslb_x, sslb_y);
+            if (task_type != DigTsk_ImproveDungeon)
+                imp_stack_retire_task(dungeon, stl_num, DigTsk_ImproveDungeon);
+            if (task_type != DigTsk_ConvertDungeon)
+                imp_stack_retire_task(dungeon, stl_num, DigTsk_ConvertDungeon);
+            if (task_type != DigTsk_None)
+                imp_stack_push_task(dungeon, stl_num, task_type);
+            if (n < SMALL_AROUND_SLAB_LENGTH)
+                imp_stack_update_dig_task_at(dungeon, sslb_x, sslb_y);
+        }
+    }
+}
+
+/**
+ * Remembers a gold pile dropped on the map, so that it's pushed into digger stacks of all players on their next update.
+ */
+void imp_stack_gold_pile_dropped(struct Thing *gldtng)
+{
+    struct DiggerStackPending *pending;
+    struct Dungeon *dungeon;
+    PlayerNumber plyr_idx;
+    long i;
+    for (plyr_idx=0; plyr_idx < DUNGEONS_COUNT; plyr_idx++)
+    {
+        dungeon = get_dungeon(plyr_idx);
+        if (dungeon_invalid(dungeon) || (dungeon->num_active_diggers == 0))
+            continue;
+        pending = &digger_stack_pending[plyr_idx];
+        for (i=0; i < pending->gold_piles_num; i++)
+        {
+            if (pending->gold_piles[i] == gldtng->index)
+                break;
+        }
+        if (i < pending->gold_piles_num)
+            continue;
+        if (pending->gold_piles_num < DIGGER_PENDING_GOLD_PILES) {
+            pending->gold_piles[pending->gold_piles_num] = gldtng->index;
+            pending->gold_piles_num++;
+        } else {
+            pending->gold_piles_overflow = true;
+        }
+    }
+}
+
+/**
+ * Updates digger stacks of all players after a dead body has fallen and can be carried to graveyard.
+ */
+void imp_stack_dead_body_settled(struct Thing *deadtng)
+{
+    struct Dungeon *dungeon;
+    struct Room *room;
+    PlayerNumber plyr_idx;
+    for (plyr_idx=0; plyr_idx < DUNGEONS_COUNT; plyr_idx++)
+    {
+        dungeon = get_dungeon(plyr_idx);
+        if (dungeon_invalid(dungeon) || (dungeon->num_active_diggers == 0))
+            continue;
+        room = find_room_with_spare_capacity(plyr_idx, RoK_GRAVEYARD, 1);
+        if (room_is_invalid(room))
+            continue;
+        if (dead_body_pickable_by_digger(deadtng, plyr_idx)) {
+            imp_stack_push_task(dungeon, get_subtile_number(deadtng->mappos.x.stl.num,deadtng->mappos.y.stl.num), DigTsk_PickUpCorpse);
+        }
+    }
+}
+
+/**
+ * Updates digger stack of the trap owner after an empty trap was placed.
+ */
+void imp_stack_trap_placed(struct Thing *traptng)
+{
+    struct Dungeon *dungeon;
+    if (traptng->trap.num_shots != 0)
+        return;
+    dungeon = get_dungeon(traptng->owner);
+    if (dungeon_invalid(dungeon) || (dungeon->digger_stack_length >= DIGGER_TASK_MAX_COUNT))
+        return;
+    if (add_object_for_trap_to_imp_stack(dungeon, traptng)) {
+        get_digger_stack_stats(dungeon)->tasks_pushed++;
+    }
+}
+
 long check_out_worker_improve_dungeon(struct Thing *thing, struct DiggerStack *dstack)
 {
     MapSubtlCoord stl_x,stl_y;
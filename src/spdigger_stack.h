@@ -92,6 +92,9 @@ long find_in_imp_stack_starting_at(SpDiggerTaskType task_type, long start_pos, c
 long find_in_imp_stack_task_other_than_starting_at(SpDiggerTaskType excl_task_type, long start_pos, const struct Dungeon *dungeon);
 
 TbBool add_to_imp_stack_using_pos(SubtlCodedCoords stl_num, SpDiggerTaskType task_type, struct Dungeon *dungeon);
+TbBool imp_stack_push_task(struct Dungeon *dungeon, SubtlCodedCoords stl_num, SpDiggerTaskType task_type);
+long imp_stack_retire_task(struct Dungeon *dungeon, SubtlCodedCoords stl_num, SpDiggerTaskType task_type);
+void clear_digger_stack_side_data(void);
 TbBool add_object_for_trap_to_imp_stack(struct Dungeon *dungeon, struct Thing *thing);
 void setup_imp_stack(struct Dungeon *dungeon);
 int add_undug_to_imp_stack(struct Dungeon *dungeon, int max_tasks);
@@ -114,6 +117,12 @@ TbBool thing_can_be_picked_to_place_in_player_room(const struct Thing* thing, Pl
 long get_random_mining_undug_area_position_for_digger_drop(PlayerNumber plyr_idx, MapSubtlCoord *retstl_x, MapSubtlCoord *retstl_y);
 
 TbBool imp_stack_update(struct Thing *creatng);
+void imp_stack_dig_task_added(PlayerNumber plyr_idx, SubtlCodedCoords stl_num);
+void imp_stack_dig_task_removed(PlayerNumber plyr_idx, SubtlCodedCoords stl_num);
+void imp_stack_slab_changed(MapSlabCoord slb_x, MapSlabCoord slb_y);
+void imp_stack_gold_pile_dropped(struct Thing *gldtng);
+void imp_stack_dead_body_settled(struct Thing *deadtng);
+void imp_stack_trap_placed(struct Thing *traptng);
 TbBool check_out_imp_stack(struct Thing *creatng);
 long check_out_imp_last_did(struct Thing *creatng);
 long check_place_to_convert_excluding(struct Thing *thing, MapSlabCoord slb_x, MapSlabCoord slb_y);
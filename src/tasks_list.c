@@ -20,16 +20,155 @@
 
 #include "globals.h"
 #include "bflib_basics.h"
+#include "bflib_memory.h"
 
 #include "spdigger_stack.h"
 #include "map_data.h"
 #include "dungeon_data.h"
+#include "engine_camera.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 /******************************************************************************/
+/** Size of a cell of the tasks spatial index, in slabs. */
+#define TASKS_INDEX_CELL_SLABS 4
+#define TASKS_INDEX_CELLS_X ((85+TASKS_INDEX_CELL_SLABS-1)/TASKS_INDEX_CELL_SLABS)
+#define TASKS_INDEX_CELLS_Y ((85+TASKS_INDEX_CELL_SLABS-1)/TASKS_INDEX_CELL_SLABS)
+
+/**
+ * Spatial index of dungeon tasks list. Tasks are linked into lists of map cells,
+ * so that tasks at given slab, or near given place, can be found without sweeping
+ * the whole tasks list. Built from the tasks list when first needed.
+ */
+struct TasksIndex {
+    TbBool valid;
+    /** First task in every cell, as task index + 1. */
+    unsigned short cell_first[TASKS_INDEX_CELLS_X*TASKS_INDEX_CELLS_Y];
+    /** Next task in the same cell, as task index + 1. */
+    unsigned short task_next[MAPTASKS_COUNT];
+    /** Cell of every task, as cell index + 1; zero for tasks which are not indexed. */
+    unsigned short task_cell[MAPTASKS_COUNT];
+};
+/******************************************************************************/
 struct MapTask bad_map_task;
+static struct TasksIndex tasks_index[DUNGEONS_COUNT];
+/******************************************************************************/
+static long tasks_index_cell_for_coords(SubtlCodedCoords stl_num)
+{
+    MapSlabCoord slb_x, slb_y;
+    slb_x = subtile_slab_fast(stl_num_decode_x(stl_num)) / TASKS_INDEX_CELL_SLABS;
+    slb_y = subtile_slab_fast(stl_num_decode_y(stl_num)) / TASKS_INDEX_CELL_SLABS;
+    if ((slb_x < 0) || (slb_x >= TASKS_INDEX_CELLS_X) || (slb_y < 0) || (slb_y >= TASKS_INDEX_CELLS_Y))
+        return -1;
+    return slb_y * TASKS_INDEX_CELLS_X + slb_x;
+}
+
+static void tasks_index_link(struct TasksIndex *tidx, const struct MapTask *mtask, long task_idx)
+{
+    long cell;
+    cell = tasks_index_cell_for_coords(mtask->coords);
+    if (cell < 0)
+        return;
+    tidx->task_next[task_idx] = tidx->cell_first[cell];
+    tidx->task_cell[task_idx] = cell + 1;
+    tidx->cell_first[cell] = task_idx + 1;
+}
+
+static void tasks_index_unlink(struct TasksIndex *tidx, long task_idx)
+{
+    unsigned short *link;
+    long cell;
+    if (tidx->task_cell[task_idx] == 0)
+        return;
+    cell = tidx->task_cell[task_idx] - 1;
+    link = &tidx->cell_first[cell];
+    while (*link != 0)
+    {
+        if (*link == task_idx + 1) {
+            *link = tidx->task_next[task_idx];
+            break;
+        }
+        link = &tidx->task_next[*link - 1];
+    }
+    tidx->task_next[task_idx] = 0;
+    tidx->task_cell[task_idx] = 0;
+}
+
+/**
+ * Returns spatial index of tasks list of given player, rebuilding it if needed.
+ * @return The index, or NULL if the player has no tasks list.
+ */
+static struct TasksIndex *get_tasks_index(PlayerNumber plyr_idx)
+{
+    struct TasksIndex *tidx;
+    struct Dungeon *dungeon;
+    long i,imax;
+    if ((plyr_idx < 0) || (plyr_idx >= DUNGEONS_COUNT))
+        return NULL;
+    tidx = &tasks_index[plyr_idx];
+    if (tidx->valid)
+        return tidx;
+    dungeon = get_dungeon(plyr_idx);
+    LbMemorySet(tidx, 0, sizeof(struct TasksIndex));
+    imax = dungeon->field_AF7;
+    if (imax > MAPTASKS_COUNT)
+        imax = MAPTASKS_COUNT;
+    for (i=0; i < imax; i++)
+    {
+        if (dungeon->task_list[i].kind != SDDigTask_None)
+            tasks_index_link(tidx, &dungeon->task_list[i], i);
+    }
+    tidx->valid = true;
+    return tidx;
+}
+
+/**
+ * Finds task at given slab center, using the tasks spatial index.
+ * Gives the same result as sweeping the tasks list, which would return the lowest index.
+ */
+static long find_in_tasks_index(struct TasksIndex *tidx, const struct Dungeon *dungeon, SubtlCodedCoords srch_tsk, TbBool dig_only)
+{
+    const struct MapTask *mtask;
+    long cell, i, best_idx;
+    cell = tasks_index_cell_for_coords(srch_tsk);
+    if (cell < 0)
+        return -1;
+    best_idx = -1;
+    for (i = tidx->cell_first[cell]; i != 0; i = tidx->task_next[i-1])
+    {
+        mtask = &dungeon->task_list[i-1];
+        if (mtask->coords != srch_tsk)
+            continue;
+        if (dig_only && (mtask->kind == SDDigTask_Unknown3))
+            continue;
+        if ((best_idx < 0) || (i-1 < best_idx))
+            best_idx = i-1;
+    }
+    return best_idx;
+}
+
+/**
+ * Returns if given coded subtile is a slab center, which is where the tasks are placed.
+ * Free entries of the tasks list have zeroed coords, and only these are matched by other searches.
+ */
+static TbBool task_coords_is_slab_center(SubtlCodedCoords stl_num)
+{
+    MapSubtlCoord stl_x, stl_y;
+    stl_x = stl_num_decode_x(stl_num);
+    stl_y = stl_num_decode_y(stl_num);
+    return (stl_slab_center_subtile(stl_x) == stl_x) && (stl_slab_center_subtile(stl_y) == stl_y);
+}
+
+/**
+ * Marks spatial indexes of tasks lists as invalid. To be called when the dungeons are cleared or loaded.
+ */
+void clear_tasks_index(void)
+{
+    long i;
+    for (i=0; i < DUNGEONS_COUNT; i++)
+        tasks_index[i].valid = false;
+}
 /******************************************************************************/
 struct MapTask *get_dungeon_task_list_entry(struct Dungeon *dungeon, long task_idx)
 {
@@ -78,6 +217,12 @@ void add_task_list_entry(PlayerNumber plyr_idx, unsigned char kind, SubtlCodedCo
     mtask = &dungeon->task_list[task_idx];
     mtask->kind = kind;
     mtask->coords = get_subtile_number(taskstl_x, taskstl_y);
+    if (tasks_index[plyr_idx].valid) {
+        tasks_index_link(&tasks_index[plyr_idx], mtask, task_idx);
+    }
+    if (kind != SDDigTask_Unknown3) {
+        imp_stack_dig_task_added(plyr_idx, mtask->coords);
+    }
     dungeon->field_E8F++;
 }
 
@@ -85,8 +230,12 @@ long find_from_task_list(PlayerNumber plyr_idx, SubtlCodedCoords srch_tsk)
 {
   struct Dungeon *dungeon;
   struct MapTask *mtask;
+  struct TasksIndex *tidx;
   long i,imax;
   dungeon = get_dungeon(plyr_idx);
+  tidx = get_tasks_index(plyr_idx);
+  if ((tidx != NULL) && task_coords_is_slab_center(srch_tsk))
+      return find_in_tasks_index(tidx, dungeon, srch_tsk, false);
   imax = dungeon->field_AF7;
   if (imax > MAPTASKS_COUNT)
       imax = MAPTASKS_COUNT;
@@ -103,10 +252,14 @@ long find_from_task_list_by_slab(PlayerNumber plyr_idx, MapSlabCoord slb_x, MapS
 {
   struct Dungeon *dungeon;
   struct MapTask *mtask;
+  struct TasksIndex *tidx;
   long i,imax;
   SubtlCodedCoords srch_tsk;
   srch_tsk = get_subtile_number_at_slab_center(slb_x, slb_y);
   dungeon = get_dungeon(plyr_idx);
+  tidx = get_tasks_index(plyr_idx);
+  if (tidx != NULL)
+      return find_in_tasks_index(tidx, dungeon, srch_tsk, false);
   imax = dungeon->field_AF7;
   if (imax > MAPTASKS_COUNT)
       imax = MAPTASKS_COUNT;
@@ -123,10 +276,14 @@ long find_from_task_list_by_subtile(PlayerNumber plyr_idx, MapSlabCoord stl_x, M
 {
   struct Dungeon *dungeon;
   struct MapTask *mtask;
+  struct TasksIndex *tidx;
   long i,imax;
   SubtlCodedCoords srch_tsk;
   srch_tsk = get_subtile_number(stl_slab_center_subtile(stl_x), stl_slab_center_subtile(stl_y));
   dungeon = get_dungeon(plyr_idx);
+  tidx = get_tasks_index(plyr_idx);
+  if (tidx != NULL)
+      return find_in_tasks_index(tidx, dungeon, srch_tsk, false);
   imax = dungeon->field_AF7;
   if (imax > MAPTASKS_COUNT)
       imax = MAPTASKS_COUNT;
@@ -143,8 +300,12 @@ long find_dig_from_task_list(PlayerNumber plyr_idx, SubtlCodedCoords srch_tsk)
 {
     struct Dungeon *dungeon;
     struct MapTask *mtask;
+    struct TasksIndex *tidx;
     long i,imax;
     dungeon = get_dungeon(plyr_idx);
+    tidx = get_tasks_index(plyr_idx);
+    if ((tidx != NULL) && task_coords_is_slab_center(srch_tsk))
+        return find_in_tasks_index(tidx, dungeon, srch_tsk, true);
     imax = dungeon->field_AF7;
     if (imax > MAPTASKS_COUNT)
         imax = MAPTASKS_COUNT;
@@ -157,6 +318,72 @@ long find_dig_from_task_list(PlayerNumber plyr_idx, SubtlCodedCoords srch_tsk)
     return -1;
 }
 
+/**
+ * Lists dig tasks of given player which are closer than given distance to given subtile.
+ * The tasks are sorted by their distance, and tasks at the same distance by their index,
+ * so that the first matching task is the same one which a sweep through tasks list
+ * looking for the nearest task would select.
+ * @param plyr_idx Player whose tasks list is searched.
+ * @param stl_x,stl_y Subtile from which distance is measured.
+ * @param max_dist Distance, in subtiles, which the tasks have to be closer than.
+ * @param task_idxs Array which receives task indices.
+ * @param max_count Size of the array.
+ * @return Amount of tasks stored in the array.
+ */
+long find_dig_tasks_near_from_task_list(PlayerNumber plyr_idx, MapSubtlCoord stl_x, MapSubtlCoord stl_y, MapSubtlDelta max_dist, long *task_idxs, long max_count)
+{
+    struct Dungeon *dungeon;
+    struct TasksIndex *tidx;
+    const struct MapTask *mtask;
+    MapSubtlDelta dists[MAPTASKS_COUNT];
+    long cell_x, cell_y, cell_min_x, cell_min_y, cell_max_x, cell_max_y;
+    long i, k, n;
+    if (max_count > MAPTASKS_COUNT)
+        max_count = MAPTASKS_COUNT;
+    tidx = get_tasks_index(plyr_idx);
+    if ((tidx == NULL) || (max_dist <= 0))
+        return 0;
+    dungeon = get_dungeon(plyr_idx);
+    cell_min_x = max(stl_x - max_dist + 1, 0) / (STL_PER_SLB*TASKS_INDEX_CELL_SLABS);
+    cell_min_y = max(stl_y - max_dist + 1, 0) / (STL_PER_SLB*TASKS_INDEX_CELL_SLABS);
+    cell_max_x = min((stl_x + max_dist - 1) / (STL_PER_SLB*TASKS_INDEX_CELL_SLABS), TASKS_INDEX_CELLS_X-1);
+    cell_max_y = min((stl_y + max_dist - 1) / (STL_PER_SLB*TASKS_INDEX_CELL_SLABS), TASKS_INDEX_CELLS_Y-1);
+    n = 0;
+    for (cell_y = cell_min_y; cell_y <= cell_max_y; cell_y++)
+    {
+        for (cell_x = cell_min_x; cell_x <= cell_max_x; cell_x++)
+        {
+            for (i = tidx->cell_first[cell_y * TASKS_INDEX_CELLS_X + cell_x]; i != 0; i = tidx->task_next[i-1])
+            {
+                MapSubtlDelta dist;
+                mtask = &dungeon->task_list[i-1];
+                if ((mtask->kind == SDDigTask_None) || (mtask->kind == SDDigTask_Unknown3))
+                    continue;
+                dist = get_2d_box_distance_xy(stl_x, stl_y, stl_num_decode_x(mtask->coords), stl_num_decode_y(mtask->coords));
+                if (dist >= max_dist)
+                    continue;
+                // Insertion sort by distance, then by task index
+                for (k = n; k > 0; k--)
+                {
+                    if ((dists[k-1] < dist) || ((dists[k-1] == dist) && (task_idxs[k-1] < i-1)))
+                        break;
+                    if (k < max_count) {
+                        dists[k] = dists[k-1];
+                        task_idxs[k] = task_idxs[k-1];
+                    }
+                }
+                if (k < max_count) {
+                    dists[k] = dist;
+                    task_idxs[k] = i-1;
+                }
+                if (n < max_count)
+                    n++;
+            }
+        }
+    }
+    return n;
+}
+
 long find_next_dig_in_dungeon_task_list(struct Dungeon *dungeon, long last_dig)
 {
     struct MapTask *mtask;
@@ -190,6 +417,12 @@ long remove_from_task_list(long plyr_idx, long stack_pos)
     }
     struct MapTask *mtask;
     mtask = &dungeon->task_list[stack_pos];
+    if ((mtask->kind != SDDigTask_None) && (mtask->kind != SDDigTask_Unknown3)) {
+        imp_stack_dig_task_removed(plyr_idx, mtask->coords);
+    }
+    if ((plyr_idx >= 0) && (plyr_idx < DUNGEONS_COUNT) && tasks_index[plyr_idx].valid) {
+        tasks_index_unlink(&tasks_index[plyr_idx], stack_pos);
+    }
     mtask->kind = 0;
     mtask->coords = 0;
     dungeon->field_E8F--;
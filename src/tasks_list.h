@@ -54,6 +54,8 @@ long find_from_task_list_by_subtile(PlayerNumber plyr_idx, MapSlabCoord stl_x, M
 long find_dig_from_task_list(PlayerNumber plyr_idx, SubtlCodedCoords srch_tsk);
 long remove_from_task_list(long a1, long a2);
 long find_next_dig_in_dungeon_task_list(struct Dungeon *dungeon, long last_dig);
+long find_dig_tasks_near_from_task_list(PlayerNumber plyr_idx, MapSubtlCoord stl_x, MapSubtlCoord stl_y, MapSubtlDelta max_dist, long *task_idxs, long max_count);
+void clear_tasks_index(void);
 
 /******************************************************************************/
 #ifdef __cplusplus
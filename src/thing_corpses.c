@@ -33,6 +33,7 @@
 #include "creature_states.h"
 #include "creature_graphics.h"
 #include "player_instances.h"
+#include "spdigger_stack.h"
 #include "dungeon_data.h"
 #include "config_creature.h"
 #include "gui_topmsg.h"
@@ -202,6 +203,7 @@ TngUpdateRet update_dead_creature(struct Thing *thing)
                 thing->active_state = DCrSt_Unknown02;
                 i = get_creature_anim(thing, 16);
                 set_thing_draw(thing, i, 64, -1, 1, 0, 2);
+                imp_stack_dead_body_settled(thing);
             }
         } else
         if ( corpse_is_rottable(thing) )
@@ -404,6 +406,7 @@ struct Thing *create_dead_creature(const struct Coord3d *pos, ThingModel model,
         thing->active_state = DCrSt_Unknown02;
         k = get_creature_anim(thing, 17);
         set_thing_draw(thing, k, 256, 300, 0, 0, 2);
+        imp_stack_dead_body_settled(thing);
         break;
     default:
         thing->active_state = DCrSt_Unknown01;
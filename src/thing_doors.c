@@ -63,6 +63,7 @@ char find_door_angle(MapSubtlCoord stl_x, MapSubtlCoord stl_y, PlayerNumber plyr
 
 struct Thing *create_door(struct Coord3d *pos, unsigned short a1, unsigned char a2, unsigned short a3, unsigned char a4)
 {
+  map_solidity_changed_on_slab(subtile_slab_fast(pos->x.stl.num), subtile_slab_fast(pos->y.stl.num));
   return _DK_create_door(pos, a1, a2, a3, a4);
 }
 
@@ -92,6 +93,7 @@ void unlock_door(struct Thing *thing)
 {
     thing->byte_18 = 0;
     game.field_14EA4B = 1;
+    map_solidity_changed_on_slab(subtile_slab_fast(thing->mappos.x.stl.num), subtile_slab_fast(thing->mappos.y.stl.num));
     update_navigation_triangulation(thing->mappos.x.stl.num-1, thing->mappos.y.stl.num-1,
       thing->mappos.x.stl.num+1, thing->mappos.y.stl.num+1);
     pannel_map_update(thing->mappos.x.stl.num-1, thing->mappos.y.stl.num-1, STL_PER_SLB, STL_PER_SLB);
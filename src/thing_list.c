@@ -20,6 +20,7 @@
 
 #include "bflib_basics.h"
 #include "bflib_math.h"
+#include "bflib_memory.h"
 #include "globals.h"
 #include "bflib_sound.h"
 #include "packets.h"
@@ -83,6 +84,158 @@ DLLIMPORT struct Thing *_DK_get_nearest_object_at_position(long stl_x, long stl_
 DLLIMPORT void _DK_place_thing_in_mapwho(struct Thing *thing);
 DLLIMPORT long _DK_collide_filter_thing_is_of_type(const struct Thing *creatng, const struct Thing *sectng, long blocked_flags, long shot_lvl);
 /******************************************************************************/
+/** Size of a cell of the creatures proximity grid, in subtiles. */
+#define CREATURE_GRID_CELL_STL 16
+#define CREATURE_GRID_CELLS_X  (256/CREATURE_GRID_CELL_STL)
+#define CREATURE_GRID_CELLS_Y  (256/CREATURE_GRID_CELL_STL)
+/** Pseudo-cell for creatures which are not placed on map; it is included in every search. */
+#define CREATURE_GRID_UNPLACED (CREATURE_GRID_CELLS_X*CREATURE_GRID_CELLS_Y)
+
+/**
+ * Spatial index of all things on creatures list, for fighters searching for enemies.
+ * Every creature is linked into the cell in which its mapwho block lies; the grid
+ * is updated together with mapwho and the creatures list, so it is always exact.
+ */
+struct CreatureGrid {
+    ThingIndex cell_first[CREATURE_GRID_UNPLACED+1];
+    ThingIndex next[THINGS_COUNT];
+    ThingIndex prev[THINGS_COUNT];
+    /** Cell in which the thing is linked, increased by one; zero if it's not in the grid. */
+    unsigned short cell[THINGS_COUNT];
+    /** Position of every creature on the creatures list, used to keep the list order in searches. */
+    unsigned short list_pos[THINGS_COUNT];
+    /** Largest collision box of creatures linked since the grid was built. */
+    unsigned short max_clipbox;
+    TbBool valid;
+    TbBool list_pos_valid;
+    unsigned long searches;
+    unsigned long candidates_checked;
+    unsigned long creatures_skipped;
+};
+/******************************************************************************/
+static struct CreatureGrid creature_grid;
+/******************************************************************************/
+static unsigned short creature_grid_cell_for_thing(const struct Thing *thing)
+{
+    MapSubtlCoord cell_x, cell_y;
+    if ((thing->alloc_flags & TAlF_IsInMapWho) == 0)
+        return CREATURE_GRID_UNPLACED;
+    cell_x = min(thing->mappos.x.stl.num / CREATURE_GRID_CELL_STL, CREATURE_GRID_CELLS_X-1);
+    cell_y = min(thing->mappos.y.stl.num / CREATURE_GRID_CELL_STL, CREATURE_GRID_CELLS_Y-1);
+    return cell_y * CREATURE_GRID_CELLS_X + cell_x;
+}
+
+static void creature_grid_unlink(ThingIndex tng_idx)
+{
+    unsigned short cell;
+    if (creature_grid.cell[tng_idx] == 0)
+        return;
+    cell = creature_grid.cell[tng_idx] - 1;
+    if (creature_grid.prev[tng_idx] != 0)
+        creature_grid.next[creature_grid.prev[tng_idx]] = creature_grid.next[tng_idx];
+    else
+        creature_grid.cell_first[cell] = creature_grid.next[tng_idx];
+    if (creature_grid.next[tng_idx] != 0)
+        creature_grid.prev[creature_grid.next[tng_idx]] = creature_grid.prev[tng_idx];
+    creature_grid.next[tng_idx] = 0;
+    creature_grid.prev[tng_idx] = 0;
+    creature_grid.cell[tng_idx] = 0;
+}
+
+static void creature_grid_link(const struct Thing *thing)
+{
+    ThingIndex tng_idx;
+    unsigned short cell;
+    tng_idx = thing->index;
+    creature_grid_unlink(tng_idx);
+    cell = creature_grid_cell_for_thing(thing);
+    creature_grid.prev[tng_idx] = 0;
+    creature_grid.next[tng_idx] = creature_grid.cell_first[cell];
+    if (creature_grid.cell_first[cell] != 0)
+        creature_grid.prev[creature_grid.cell_first[cell]] = tng_idx;
+    creature_grid.cell_first[cell] = tng_idx;
+    creature_grid.cell[tng_idx] = cell + 1;
+    if (creature_grid.max_clipbox < thing->clipbox_size_xy)
+        creature_grid.max_clipbox = thing->clipbox_size_xy;
+}
+
+/**
+ * Builds the creatures grid from scratch, using the current creatures list.
+ */
+static void creature_grid_rebuild(void)
+{
+    struct Thing *thing;
+    long i;
+    unsigned long k;
+    LbMemorySet(creature_grid.cell_first, 0, sizeof(creature_grid.cell_first));
+    LbMemorySet(creature_grid.next, 0, sizeof(creature_grid.next));
+    LbMemorySet(creature_grid.prev, 0, sizeof(creature_grid.prev));
+    LbMemorySet(creature_grid.cell, 0, sizeof(creature_grid.cell));
+    creature_grid.max_clipbox = 0;
+    k = 0;
+    i = game.thing_lists[TngList_Creatures].index;
+    while (i != 0)
+    {
+        thing = thing_get(i);
+        if (thing_is_invalid(thing))
+        {
+            ERRORLOG("Jump to invalid thing detected");
+            break;
+        }
+        i = thing->next_of_class;
+        creature_grid_link(thing);
+        k++;
+        if (k > THINGS_COUNT)
+        {
+            ERRORLOG("Infinite loop detected when sweeping things list");
+            break;
+        }
+    }
+    creature_grid.valid = true;
+    creature_grid.list_pos_valid = false;
+}
+
+static void creature_grid_update_list_positions(void)
+{
+    struct Thing *thing;
+    long i;
+    unsigned long k;
+    k = 0;
+    i = game.thing_lists[TngList_Creatures].index;
+    while (i != 0)
+    {
+        thing = thing_get(i);
+        if (thing_is_invalid(thing) || (k >= THINGS_COUNT))
+        {
+            ERRORLOG("Invalid creatures list");
+            break;
+        }
+        creature_grid.list_pos[i] = k;
+        i = thing->next_of_class;
+        k++;
+    }
+    creature_grid.list_pos_valid = true;
+}
+
+/**
+ * Drops the creatures grid, so that it will be rebuilt on next use.
+ * Needs to be called whenever the things are replaced, ie. after loading a saved game.
+ */
+void clear_creature_proximity_grid(void)
+{
+    if (creature_grid.searches > 0)
+    {
+        SYNCMSG("Creature proximity grid: %lu searches, %lu candidates checked, %lu creatures skipped",
+            creature_grid.searches, creature_grid.candidates_checked, creature_grid.creatures_skipped);
+    }
+    LbMemorySet(creature_grid.cell, 0, sizeof(creature_grid.cell));
+    creature_grid.valid = false;
+    creature_grid.list_pos_valid = false;
+    creature_grid.searches = 0;
+    creature_grid.candidates_checked = 0;
+    creature_grid.creatures_skipped = 0;
+}
+/******************************************************************************/
 /**
  * Adds thing at beginning of a StructureList.
  * @param thing
@@ -108,6 +261,12 @@ void add_thing_to_list(struct Thing *thing, struct StructureList *list)
         prevtng->prev_of_class = thing->index;
     }
     list->index = thing->index;
+    if (list == &game.thing_lists[TngList_Creatures])
+    {
+        creature_grid.list_pos_valid = false;
+        if (creature_grid.valid)
+            creature_grid_link(thing);
+    }
 }
 
 void remove_thing_from_list(struct Thing *thing, struct StructureList *slist)
@@ -150,6 +309,10 @@ void remove_thing_from_list(struct Thing *thing, struct StructureList *slist)
         thing->next_of_class = 0;
     }
     thing->alloc_flags &= ~TAlF_IsInStrucList;
+    // Removing doesn't change order of the remaining creatures, so list positions stay valid
+    if (slist == &game.thing_lists[TngList_Creatures]) {
+        creature_grid_unlink(thing->index);
+    }
     if (slist->count <= 0) {
         ERRORLOG("List has < 0 structures");
         return;
@@ -1178,6 +1341,9 @@ void remove_thing_from_mapwho(struct Thing *thing)
     thing->next_on_mapblk = 0;
     thing->prev_on_mapblk = 0;
     thing->alloc_flags &= ~TAlF_IsInMapWho;
+    if (creature_grid.cell[thing->index] != 0) {
+        creature_grid_link(thing);
+    }
 }
 
 void place_thing_in_mapwho(struct Thing *thing)
@@ -1203,6 +1369,9 @@ void place_thing_in_mapwho(struct Thing *thing)
     set_mapwho_thing_index(mapblk, thing->index);
     thing->prev_on_mapblk = 0;
     thing->alloc_flags |= TAlF_IsInMapWho;
+    if (creature_grid.cell[thing->index] != 0) {
+        creature_grid_link(thing);
+    }
 }
 
 struct Thing *find_base_thing_on_mapwho(ThingClass oclass, ThingModel model, MapSubtlCoord stl_x, MapSubtlCoord stl_y)
@@ -1601,10 +1770,98 @@ struct Thing *get_nearest_enemy_creature_possible_to_attack_by(struct Thing *cre
     return get_nth_thing_of_class_with_filter(filter, &param, 0);
 }
 
+/**
+ * Out of creatures which are near given position, returns the one best matching given filter.
+ * Works like get_nth_thing_of_class_with_filter() with tngindex=0, but only visits creatures
+ * from the proximity grid cells which cover given box; the filter has to reject all creatures
+ * outside the box. Creatures are visited in creatures list order, so results are the same.
+ * @param pos Position to search around.
+ * @param box_dist Box distance from the position, beyond which the filter rejects all creatures.
+ */
+struct Thing *get_best_creature_near_with_filter(const struct Coord3d *pos, MapCoordDelta box_dist,
+    Thing_Maximizer_Filter filter, MaxTngFilterParam param)
+{
+    ThingIndex candidates[THINGS_COUNT];
+    long candidates_count;
+    long cell_sx, cell_sy, cell_ex, cell_ey, cell_x, cell_y;
+    long i, n, k;
+    ThingIndex tng_idx;
+    struct Thing *retng;
+    long maximizer, curindex;
+    if (!creature_grid.valid)
+        creature_grid_rebuild();
+    if (!creature_grid.list_pos_valid)
+        creature_grid_update_list_positions();
+    creature_grid.searches++;
+    // Gather the creatures from cells covering the box, plus these not placed on map
+    cell_sx = max(coord_subtile(pos->x.val - box_dist), 0) / CREATURE_GRID_CELL_STL;
+    cell_sy = max(coord_subtile(pos->y.val - box_dist), 0) / CREATURE_GRID_CELL_STL;
+    cell_ex = min(coord_subtile(pos->x.val + box_dist) / CREATURE_GRID_CELL_STL, CREATURE_GRID_CELLS_X-1);
+    cell_ey = min(coord_subtile(pos->y.val + box_dist) / CREATURE_GRID_CELL_STL, CREATURE_GRID_CELLS_Y-1);
+    candidates_count = 0;
+    for (cell_y = cell_sy; cell_y <= cell_ey; cell_y++)
+    {
+        for (cell_x = cell_sx; cell_x <= cell_ex; cell_x++)
+        {
+            for (tng_idx = creature_grid.cell_first[cell_y * CREATURE_GRID_CELLS_X + cell_x]; tng_idx != 0; tng_idx = creature_grid.next[tng_idx])
+            {
+                if (candidates_count >= THINGS_COUNT)
+                    break;
+                candidates[candidates_count++] = tng_idx;
+            }
+        }
+    }
+    for (tng_idx = creature_grid.cell_first[CREATURE_GRID_UNPLACED]; tng_idx != 0; tng_idx = creature_grid.next[tng_idx])
+    {
+        if (candidates_count >= THINGS_COUNT)
+            break;
+        candidates[candidates_count++] = tng_idx;
+    }
+    // Sort the candidates by their position on creatures list
+    for (i=1; i < candidates_count; i++)
+    {
+        tng_idx = candidates[i];
+        for (k=i; (k > 0) && (creature_grid.list_pos[candidates[k-1]] > creature_grid.list_pos[tng_idx]); k--)
+            candidates[k] = candidates[k-1];
+        candidates[k] = tng_idx;
+    }
+    creature_grid.candidates_checked += candidates_count;
+    creature_grid.creatures_skipped += game.thing_lists[TngList_Creatures].count - candidates_count;
+    // Same maximizing rules as in get_nth_thing_of_class_with_filter()
+    maximizer = 0;
+    curindex = 0;
+    retng = INVALID_THING;
+    for (i=0; i < candidates_count; i++)
+    {
+        struct Thing *thing;
+        thing = thing_get(candidates[i]);
+        n = filter(thing, param, maximizer);
+        if (n > maximizer)
+        {
+            retng = thing;
+            maximizer = n;
+            curindex = 0;
+        } else
+        if (n == maximizer)
+        {
+            if (curindex <= 0) {
+                retng = thing;
+            }
+            if (maximizer == LONG_MAX) {
+                break;
+            }
+            curindex++;
+        }
+    }
+    return retng;
+}
+
 struct Thing *get_highest_score_enemy_creature_within_distance_possible_to_attack_by(struct Thing *creatng, MapCoordDelta dist)
 {
     Thing_Maximizer_Filter filter;
     struct CompoundTngFilterParam param;
+    struct CreatureStats *crstat;
+    MapCoordDelta combat_dist;
     SYNCDBG(19,"Starting");
     filter = highest_score_thing_filter_is_enemy_within_distance_which_can_be_attacked_by_creature;
     param.class_id = TCls_Creature;
@@ -1613,7 +1870,16 @@ struct Thing *get_highest_score_enemy_creature_within_distance_possible_to_attac
     param.num1 = creatng->index;
     param.num2 = dist;
     param.num3 = 0;
-    return get_nth_thing_of_class_with_filter(filter, &param, 0);
+    // The filter only accepts enemies which can be heard or seen, within given distance
+    crstat = creature_stats_get_from_thing(creatng);
+    combat_dist = subtile_coord(max(crstat->hearing, crstat->visual_range),0);
+    if (combat_dist > dist - 1)
+        combat_dist = dist - 1;
+    if (combat_dist < 0)
+        return INVALID_THING;
+    // Combat distance is reduced by average size of the creatures
+    return get_best_creature_near_with_filter(&creatng->mappos,
+        combat_dist + (creatng->clipbox_size_xy + creature_grid.max_clipbox) / 2 + 1, filter, &param);
 }
 
 struct Thing *get_random_trap_of_model_owned_by_and_armed(ThingModel tngmodel, PlayerNumber plyr_idx, TbBool armed)
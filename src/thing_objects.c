@@ -44,6 +44,7 @@
 #include "engine_arrays.h"
 #include "sounds.h"
 #include "creature_states_pray.h"
+#include "spdigger_stack.h"
 #include "game_legacy.h"
 #include "keeperfx.hpp"
 
@@ -2238,6 +2239,11 @@ struct Thing *drop_gold_pile(long value, struct Coord3d *pos)
     } else {
         add_gold_to_pile(thing, value);
     }
+    if (!thing_is_invalid(thing)) {
+        imp_stack_gold_pile_dropped(thing);
+        // Treasure room will take the gold pile on its next update
+        invalidate_room_contents_count(subtile_room_get(pos->x.stl.num, pos->y.stl.num));
+    }
     return thing;
 }
 /******************************************************************************/
@@ -25,8 +25,11 @@
 #include "bflib_keybrd.h"
 #include "bflib_datetm.h"
 #include "bflib_video.h"
+#include "bflib_fileio.h"
+#include "bflib_dernc.h"
 
 #include "vidmode.h"
+#include "config.h"
 #include "kjm_input.h"
 #include "front_simple.h"
 #include "player_data.h"
@@ -50,13 +53,118 @@ void fade_out(void)
     LbScreenClear(0);
 }
 
+/**
+ * Prepares nearest colour search structure for computing colour tables in given palette.
+ * If it cannot be allocated, NULL is returned and searches are made without it.
+ */
+struct TbPaletteMatch *palette_match_create(const unsigned char *pal)
+{
+    struct TbPaletteMatch *pmatch;
+    pmatch = (struct TbPaletteMatch *)LbMemoryAlloc(sizeof(struct TbPaletteMatch));
+    if (pmatch == NULL)
+    {
+        WARNLOG("Cannot allocate nearest colour search structure, using slow search");
+        return NULL;
+    }
+    LbPaletteMatchInit(pmatch, pal);
+    return pmatch;
+}
+
+void palette_match_free(struct TbPaletteMatch *pmatch)
+{
+    if (pmatch != NULL)
+        LbMemoryFree(pmatch);
+}
+
+/**
+ * Finds colour in given palette closest to given RGB values.
+ * The palette has to be the one for which the search structure was created.
+ */
+TbPixel palette_match_colour(struct TbPaletteMatch *pmatch, const unsigned char *pal, unsigned char r, unsigned char g, unsigned char b)
+{
+    if (pmatch == NULL)
+        return LbPaletteFindColour(pal, r, g, b);
+    return LbPaletteMatchColour(pmatch, r, g, b);
+}
+
+/**
+ * Loads colour table computed earlier for given palette.
+ * Cached tables are stored in save folder, with the palette hash in file name and header;
+ * tables computed for other palette are never loaded.
+ * @return True if the table was loaded, false if it needs to be computed.
+ */
+TbBool load_palette_table_cache(const char *name, const unsigned char *pal, void *buf, unsigned long len)
+{
+    struct PaletteTableCacheHeader head;
+    TbFileHandle fh;
+    unsigned long pal_hash;
+    char *fname;
+    TbBool result;
+    pal_hash = LbPaletteHash(pal);
+    fname = prepare_file_fmtpath(FGrp_Save,"%s_%08lx.ptc",name,pal_hash);
+    if (LbFileLength(fname) != sizeof(struct PaletteTableCacheHeader) + len)
+        return false;
+    fh = LbFileOpen(fname, Lb_FILE_MODE_READ_ONLY);
+    if (fh == -1)
+        return false;
+    result = (LbFileRead(fh, &head, sizeof(head)) == sizeof(head));
+    if (result)
+    {
+        result = (memcmp(head.magic, PALETTE_TABLE_CACHE_MAGIC, sizeof(head.magic)) == 0)
+            && (head.version == PALETTE_TABLE_CACHE_VERSION)
+            && (head.pal_hash == pal_hash) && (head.data_len == len);
+    }
+    if (result)
+    {
+        result = (LbFileRead(fh, buf, len) == len);
+    }
+    LbFileClose(fh);
+    if (result)
+        SYNCDBG(7,"Loaded cached %s for palette %08lx",name,pal_hash);
+    return result;
+}
+
+/**
+ * Stores colour table computed for given palette, so that it won't have to be computed again.
+ */
+TbBool save_palette_table_cache(const char *name, const unsigned char *pal, const void *buf, unsigned long len)
+{
+    struct PaletteTableCacheHeader head;
+    TbFileHandle fh;
+    char *fname;
+    TbBool result;
+    LbMemoryCopy(head.magic, PALETTE_TABLE_CACHE_MAGIC, sizeof(head.magic));
+    head.version = PALETTE_TABLE_CACHE_VERSION;
+    head.pal_hash = LbPaletteHash(pal);
+    head.data_len = len;
+    fname = prepare_file_fmtpath(FGrp_Save,"%s_%08lx.ptc",name,head.pal_hash);
+    fh = LbFileOpen(fname, Lb_FILE_MODE_NEW);
+    if (fh == -1)
+    {
+        WARNLOG("Cannot create colour table cache file \"%s\"",fname);
+        return false;
+    }
+    result = (LbFileWrite(fh, &head, sizeof(head)) == sizeof(head));
+    if (result)
+        result = (LbFileWrite(fh, buf, len) == len);
+    LbFileClose(fh);
+    if (!result)
+    {
+        WARNLOG("Cannot write colour table cache file \"%s\"",fname);
+        LbFileDelete(fname);
+    }
+    return result;
+}
+
 void compute_fade_tables(struct TbColorTables *coltbl,unsigned char *spal,unsigned char *dpal)
 {
+    struct TbPaletteMatch *pmatch;
     unsigned char *dst;
     unsigned long i,k;
     unsigned long r,g,b;
     unsigned long rr,rg,rb;
     SYNCMSG("Recomputing fade tables");
+    pmatch = palette_match_create(dpal);
     // Intense fade to/from black - slower fade near black
     dst = coltbl->fade_tables;
     for (i=0; i < 32; i++)
@@ -66,7 +174,7 @@ void compute_fade_tables(struct TbColorTables *coltbl,unsigned char *spal,unsign
         r = spal[3*k+0];
         g = spal[3*k+1];
         b = spal[3*k+2];
-        *dst = LbPaletteFindColour(dpal, i * r >> 5, i * g >> 5, i * b >> 5);
+        *dst = palette_match_colour(pmatch, dpal, i * r >> 5, i * g >> 5, i * b >> 5);
         dst++;
       }
     }
@@ -78,7 +186,7 @@ void compute_fade_tables(struct TbColorTables *coltbl,unsigned char *spal,unsign
         r = spal[3*k+0];
         g = spal[3*k+1];
         b = spal[3*k+2];
-        *dst = LbPaletteFindColour(dpal, i * r >> 5, i * g >> 5, i * b >> 5);
+        *dst = palette_match_colour(pmatch, dpal, i * r >> 5, i * g >> 5, i * b >> 5);
         dst++;
       }
     }
@@ -96,13 +204,14 @@ void compute_fade_tables(struct TbColorTables *coltbl,unsigned char *spal,unsign
         r = dpal[3*k+0];
         g = dpal[3*k+1];
         b = dpal[3*k+2];
-        *dst = LbPaletteFindColour(dpal, (rr+2*r) / 3, (rg+2*g) / 3, (rb+2*b) / 3);
+        *dst = palette_match_colour(pmatch, dpal, (rr+2*r) / 3, (rg+2*g) / 3, (rb+2*b) / 3);
         dst++;
       }
     }
+    palette_match_free(pmatch);
 }
 
-void compute_alpha_table(unsigned char *alphtbl, unsigned char *spal, unsigned char *dpal, char dred, char dgreen, char dblue)
+void compute_alpha_table(unsigned char *alphtbl, struct TbPaletteMatch *pmatch, unsigned char *spal, unsigned char *dpal, char dred, char dgreen, char dblue)
 {
     int blendR, blendG, blendB;
     int nrow, n;
@@ -127,7 +236,7 @@ void compute_alpha_table(unsigned char *alphtbl, unsigned char *spal, unsigned c
             if (valB >= 63)
               valB = 63;
             TbPixel c;
-            c = LbPaletteFindColour(dpal, valR, valG, valB);
+            c = palette_match_colour(pmatch, dpal, valR, valG, valB);
             alphtbl[nrow*256 + n] = c;
         }
         blendR += dred;
@@ -138,7 +247,9 @@ void compute_alpha_table(unsigned char *alphtbl, unsigned char *spal, unsigned c
 
 void compute_alpha_tables(struct TbAlphaTables *alphtbls,unsigned char *spal,unsigned char *dpal)
 {
+    struct TbPaletteMatch *pmatch;
     SYNCMSG("Recomputing alpha tables");
+    pmatch = palette_match_create(dpal);
     {
         int n;
         for (n=0; n < 256; n++)
@@ -147,21 +258,24 @@ void compute_alpha_tables(struct TbAlphaTables *alphtbls,unsigned char *spal,uns
         }
     }
     // Every color alpha-blended with shade of grey
-    compute_alpha_table(alphtbls->grey, spal, dpal, 4, 4, 4);
+    compute_alpha_table(alphtbls->grey, pmatch, spal, dpal, 4, 4, 4);
     // Every color alpha-blended with brown/orange
-    compute_alpha_table(alphtbls->orange, spal, dpal, 7, 4, 0);
+    compute_alpha_table(alphtbls->orange, pmatch, spal, dpal, 7, 4, 0);
     // Every color alpha-blended with intense red
-    compute_alpha_table(alphtbls->red, spal, dpal, 6, 1, 1);
+    compute_alpha_table(alphtbls->red, pmatch, spal, dpal, 6, 1, 1);
     // Every color alpha-blended with blue
-    compute_alpha_table(alphtbls->blue, spal, dpal, 2, 2, 6);
+    compute_alpha_table(alphtbls->blue, pmatch, spal, dpal, 2, 2, 6);
     // Every color alpha-blended with green
-    compute_alpha_table(alphtbls->green, spal, dpal, 2, 6, 2);
+    compute_alpha_table(alphtbls->green, pmatch, spal, dpal, 2, 6, 2);
+    palette_match_free(pmatch);
 }
 
 void compute_rgb2idx_table(TbRGBColorTable ctab,unsigned char *spal)
 {
+    struct TbPaletteMatch *pmatch;
     int valR, valG, valB, scaler;
     SYNCMSG("Recomputing rgb-to-index tables");
+    pmatch = palette_match_create(spal);
     scaler = (1<<6)/COLOUR_TABLE_DIMENSION;
     for (valR=0; valR < COLOUR_TABLE_DIMENSION; valR++)
     {
@@ -169,12 +283,13 @@ void compute_rgb2idx_table(TbRGBColorTable ctab,unsigned char *spal)
         {
             for (valB = 0; valB < COLOUR_TABLE_DIMENSION; valB++)
             {
-                TbPixel c = LbPaletteFindColour(spal, scaler * valR + (scaler-1),
+                TbPixel c = palette_match_colour(pmatch, spal, scaler * valR + (scaler-1),
                     scaler * valG + (scaler-1), scaler * valB + (scaler-1));
                 ctab[valR][valG][valB] = c;
             }
         }
     }
+    palette_match_free(pmatch);
 }
 
 /**
@@ -188,8 +303,10 @@ void compute_rgb2idx_table(TbRGBColorTable ctab,unsigned char *spal)
  */
 void compute_shifted_palette_table(TbPixel *ocol, const unsigned char *spal, const unsigned char *dpal, int shiftR, int shiftG, int shiftB)
 {
+    struct TbPaletteMatch *pmatch;
     int valR, valG, valB, i;
     SYNCMSG("Recomputing palette table");
+    pmatch = palette_match_create(dpal);
     for (i=0; i < 256; i++)
     {
         valR = (int)spal[3*i+0] + shiftR;
@@ -201,8 +318,9 @@ void compute_shifted_palette_table(TbPixel *ocol, const unsigned char *spal, con
         valB = (int)spal[3*i+2] + shiftB;
         if (valB >= 63) valB = 63;
         if (valB <   0) valB = 0;
-        ocol[i] = LbPaletteFindColour(dpal, valR, valG, valB);
+        ocol[i] = palette_match_colour(pmatch, dpal, valR, valG, valB);
     }
+    palette_match_free(pmatch);
 }
 
 void ProperFadePalette(unsigned char *pal, long fade_steps, enum TbPaletteFadeFlag flg)
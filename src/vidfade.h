@@ -29,6 +29,8 @@ extern "C" {
 
 #define COLOUR_TABLE_BITS_PER_VALUE 4
 #define COLOUR_TABLE_DIMENSION (1<<COLOUR_TABLE_BITS_PER_VALUE)
+#define PALETTE_TABLE_CACHE_MAGIC "KPTC"
+#define PALETTE_TABLE_CACHE_VERSION 1
 
 /******************************************************************************/
 #pragma pack(1)
@@ -37,6 +39,14 @@ struct Thing;
 struct TbColorTables;
 struct TbAlphaTables;
 struct PlayerInfo;
+/** Header of a file storing colour table computed for specific palette. */
+struct PaletteTableCacheHeader {
+    char magic[4];
+    unsigned long version;
+    unsigned long pal_hash;
+    unsigned long data_len;
+};
+
 typedef unsigned char TbRGBColorTable[COLOUR_TABLE_DIMENSION][COLOUR_TABLE_DIMENSION][COLOUR_TABLE_DIMENSION];
 
 /******************************************************************************/
@@ -55,6 +65,12 @@ void compute_fade_tables(struct TbColorTables *coltbl,unsigned char *spal,unsign
 void ProperFadePalette(unsigned char *pal, long fade_steps, enum TbPaletteFadeFlag flg);
 void ProperForcedFadePalette(unsigned char *pal, long n, enum TbPaletteFadeFlag flg);
 
+struct TbPaletteMatch *palette_match_create(const unsigned char *pal);
+void palette_match_free(struct TbPaletteMatch *pmatch);
+TbPixel palette_match_colour(struct TbPaletteMatch *pmatch, const unsigned char *pal, unsigned char r, unsigned char g, unsigned char b);
+TbBool load_palette_table_cache(const char *name, const unsigned char *pal, void *buf, unsigned long len);
+TbBool save_palette_table_cache(const char *name, const unsigned char *pal, const void *buf, unsigned long len);
+
 void compute_alpha_tables(struct TbAlphaTables *alphtbls,unsigned char *spal,unsigned char *dpal);
 void compute_rgb2idx_table(TbRGBColorTable ctab,unsigned char *spal);
 void compute_shifted_palette_table(TbPixel *ocol, const unsigned char *spal,
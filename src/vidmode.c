@@ -507,8 +507,12 @@ TbBool init_fades_table(void)
     SYNCDBG(0,"Reading %s file \"%s\".",textname,fname);
     if (LbFileLoadAt(fname, &pixmap) != sizeof(struct TbColorTables))
     {
-        compute_fade_tables(&pixmap,engine_palette,engine_palette);
-        LbFileSaveAt(fname, &pixmap, sizeof(struct TbColorTables));
+        // Shipped table not available - use the one computed earlier for current palette
+        if (!load_palette_table_cache("tables", engine_palette, &pixmap, sizeof(struct TbColorTables)))
+        {
+            compute_fade_tables(&pixmap,engine_palette,engine_palette);
+            save_palette_table_cache("tables", engine_palette, &pixmap, sizeof(struct TbColorTables));
+        }
     }
     lbDisplay.FadeTable = pixmap.fade_tables;
     TbPixel cblack = 144;
@@ -531,8 +535,12 @@ TbBool init_alpha_table(void)
     // Loading file data
     if (LbFileLoadAt(fname, &alpha_sprite_table) != sizeof(struct TbAlphaTables))
     {
-        compute_alpha_tables(&alpha_sprite_table,engine_palette,engine_palette);
-        LbFileSaveAt(fname, &alpha_sprite_table, sizeof(struct TbAlphaTables));
+        // Shipped table not available - use the one computed earlier for current palette
+        if (!load_palette_table_cache("alpha", engine_palette, &alpha_sprite_table, sizeof(struct TbAlphaTables)))
+        {
+            compute_alpha_tables(&alpha_sprite_table,engine_palette,engine_palette);
+            save_palette_table_cache("alpha", engine_palette, &alpha_sprite_table, sizeof(struct TbAlphaTables));
+        }
     }
     return true;
 }
@@ -546,8 +554,12 @@ TbBool init_rgb2idx_table(void)
     // Loading file data
     if (LbFileLoadAt(fname, &colours) != sizeof(TbRGBColorTable))
     {
-        compute_rgb2idx_table(colours,engine_palette);
-        LbFileSaveAt(fname, &colours, sizeof(TbRGBColorTable));
+        // Shipped table not available - use the one computed earlier for current palette
+        if (!load_palette_table_cache("colours", engine_palette, &colours, sizeof(TbRGBColorTable)))
+        {
+            compute_rgb2idx_table(colours,engine_palette);
+            save_palette_table_cache("colours", engine_palette, &colours, sizeof(TbRGBColorTable));
+        }
     }
     return true;
 }
@@ -561,8 +573,12 @@ TbBool init_redpal_table(void)
     // Loading file data
     if (LbFileLoadAt(fname, &red_pal) != 256)
     {
-        compute_shifted_palette_table(red_pal, engine_palette, engine_palette, 20, -10, -10);
-        LbFileSaveAt(fname, &red_pal, 256);
+        // Shipped table not available - use the one computed earlier for current palette
+        if (!load_palette_table_cache("redpal", engine_palette, &red_pal, 256))
+        {
+            compute_shifted_palette_table(red_pal, engine_palette, engine_palette, 20, -10, -10);
+            save_palette_table_cache("redpal", engine_palette, &red_pal, 256);
+        }
     }
     return true;
 }
@@ -576,8 +592,12 @@ TbBool init_whitepal_table(void)
     // Loading file data
     if (LbFileLoadAt(fname, &white_pal) != 256)
     {
-        compute_shifted_palette_table(white_pal, engine_palette, engine_palette, 48, 48, 48);
-        LbFileSaveAt(fname, &white_pal, 256);
+        // Shipped table not available - use the one computed earlier for current palette
+        if (!load_palette_table_cache("whitepal", engine_palette, &white_pal, 256))
+        {
+            compute_shifted_palette_table(white_pal, engine_palette, engine_palette, 48, 48, 48);
+            save_palette_table_cache("whitepal", engine_palette, &white_pal, 256);
+        }
     }
     return true;
 }